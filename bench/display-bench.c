@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "display-engine.h"
+#include "tetris-well.h"
+
+/*
+ * Benchmark the display backends by drawing a scripted game.
+ *
+ * Every frame shifts the current tetrimino down one row (and occasionally
+ * sideways), committing it when it lands, and draws the board. Output is sent
+ * to a temporary file rather than a terminal so that the measurements reflect
+ * the cost of composing frames and the number of bytes produced, not the
+ * speed of a terminal emulator.
+ * */
+
+#define BENCH_FRAMES 200000
+
+static const char *backend_names[] = { "curses", "ansi" };
+
+static double bench_backend(int backend, size_t frames, double *bytes_per_frame)
+{
+	struct tetris_well well;
+	struct timespec start, end;
+	struct stat st;
+	int score = 0, lines = 0;
+
+	FILE *out = tmpfile();
+	if (!out) {
+		perror("tmpfile");
+		exit(1);
+	}
+
+	int saved_stdout = dup(STDOUT_FILENO);
+	fflush(stdout);
+	dup2(fileno(out), STDOUT_FILENO);
+
+	tetris_well_init(&well);
+	tetris_well_seed(&well, 1);
+	tetrimino_new(&well);
+
+	if (initialize_display_engine(backend, well.width, well.height)) {
+		fprintf(stderr, "failed to initialize display backend %s\n", backend_names[backend]);
+		exit(1);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (size_t i = 0; i < frames; i++) {
+		if (i % 3 == 0)
+			tetrimino_shift(&well, (i / 24) % 2 ? SHIFT_LEFT : SHIFT_RIGHT);
+
+		if (tetrimino_shift(&well, SHIFT_DOWN) < 0) {
+			int cleared = tetris_well_commit_tetrimino(&well);
+			lines += cleared;
+			score += cleared * 100;
+
+			if (tetrimino_new(&well)) {
+				tetris_well_init(&well);
+				tetrimino_new(&well);
+			}
+		}
+
+		draw_board(&well, NULL, lines / 10, score, lines, 0);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	stop_display_engine();
+
+	fflush(stdout);
+	dup2(saved_stdout, STDOUT_FILENO);
+	close(saved_stdout);
+
+	fstat(fileno(out), &st);
+	fclose(out);
+
+	*bytes_per_frame = (double)st.st_size / (double)frames;
+
+	double elapsed = (double)(end.tv_sec - start.tv_sec) * 1e9 + (double)(end.tv_nsec - start.tv_nsec);
+	return elapsed / (double)frames;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t frames = BENCH_FRAMES;
+	if (argc > 1)
+		frames = strtoul(argv[1], NULL, 10);
+
+	// curses needs a terminal description, even though output goes to a file
+	setenv("TERM", "xterm-256color", 0);
+
+	printf("%-10s %12s %12s\n", "backend", "ns/frame", "bytes/frame");
+	for (int backend = DISPLAY_BACKEND_CURSES; backend <= DISPLAY_BACKEND_ANSI; backend++) {
+		double bytes;
+		double ns = bench_backend(backend, frames, &bytes);
+		printf("%-10s %12.1f %12.1f\n", backend_names[backend], ns, bytes);
+	}
+
+	return 0;
+}
@@ -0,0 +1,80 @@
+#ifndef TETRIS_ANSI_RENDERER_H
+#define TETRIS_ANSI_RENDERER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "tetris-well.h"
+#include "placement.h"
+
+/**
+ * ansi-renderer:
+ * Render the game board into a buffer of ANSI escape sequences, using the same
+ * layout and colors as the curses display backend.
+ *
+ * The renderer remembers the last frame it rendered, and only emits sequences
+ * for cells and score lines that changed since then. The buffer is allocated
+ * once for the worst case (a full redraw), so rendering never allocates.
+ *
+ * usage example:
+ * struct ansi_renderer renderer;
+ * if (ansi_renderer_init(&renderer, well.width, well.height))
+ *     die();
+ *
+ * size_t len = ansi_renderer_draw(&renderer, &well, NULL, level, score, lines, 0);
+ * write(STDOUT_FILENO, renderer.buffer, len);
+ *
+ * ansi_renderer_release(&renderer);
+ * */
+
+struct ansi_renderer {
+	char *buffer;
+	size_t len;
+	size_t alloc;
+
+	size_t width;
+	size_t height;
+	int full_redraw;
+	int attribute;
+	size_t cursor_row;
+	size_t cursor_col;
+
+	uint8_t rendered_frame[BOARD_MAX_HEIGHT][BOARD_MAX_WIDTH];
+	int rendered_level;
+	int rendered_score;
+	int rendered_lines;
+};
+
+/**
+ * Initialize a renderer for a well of the given dimensions. Returns non-zero
+ * if the frame buffer could not be allocated.
+ * */
+int ansi_renderer_init(struct ansi_renderer *renderer, size_t width, size_t height);
+
+/**
+ * Force the next frame to clear the screen and redraw everything.
+ * */
+void ansi_renderer_invalidate(struct ansi_renderer *renderer);
+
+/**
+ * Render the next frame into the renderer buffer, replacing any previous
+ * contents. `hint` and `flags` are as for draw_board(). Returns the number of
+ * bytes rendered, which is zero if nothing changed since the previous frame.
+ * */
+size_t ansi_renderer_draw(struct ansi_renderer *renderer, struct tetris_well *well, const struct placement *hint,
+		int level, int score, int lines, int flags);
+
+/**
+ * Release resources held by the renderer.
+ * */
+void ansi_renderer_release(struct ansi_renderer *renderer);
+
+/**
+ * Decode a single key from the front of a buffer of terminal input, returning
+ * the number of bytes consumed, or zero if the buffer holds an incomplete
+ * escape sequence. The decoded input (one of INPUT_*, or zero for unbound keys)
+ * is stored in `input`. The buffer must not be empty.
+ * */
+size_t ansi_decode_key(const char *buf, size_t len, int *input);
+
+#endif //TETRIS_ANSI_RENDERER_H
@@ -0,0 +1,58 @@
+#ifndef TETRIS_ASCIICAST_H
+#define TETRIS_ASCIICAST_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ansi-renderer.h"
+#include "tetris-well.h"
+
+/**
+ * asciicast:
+ * Record frames of a game into an asciicast v2 file, which can be played
+ * back with asciinema or embedded in a web page.
+ *
+ * Frames are rendered with the ANSI renderer, so recordings look exactly like
+ * the game drawn by the display backends, but no terminal is involved; the
+ * recorder can be driven in real time by the game engine, or much faster than
+ * real time from a replay.
+ *
+ * usage example:
+ * struct asciicast_recorder recorder;
+ * asciicast_recorder_open(&recorder, out, well.width, well.height);
+ *
+ * asciicast_recorder_frame(&recorder, usec, &well, level, score, lines);
+ *
+ * asciicast_recorder_close(&recorder);
+ * */
+
+struct asciicast_recorder {
+	FILE *out;
+	struct ansi_renderer renderer;
+
+	char *escaped;
+	size_t escaped_alloc;
+};
+
+/**
+ * Start a recording of a well of the given dimensions, writing the asciicast
+ * header to `out`. Returns non-zero on error.
+ * */
+int asciicast_recorder_open(struct asciicast_recorder *recorder, FILE *out, size_t width, size_t height);
+
+/**
+ * Record a frame at the given time, in microseconds since the start of the
+ * recording. Frames with no visible change are skipped. Returns non-zero on
+ * error.
+ * */
+int asciicast_recorder_frame(struct asciicast_recorder *recorder, uint64_t usec,
+		struct tetris_well *well, int level, int score, int lines);
+
+/**
+ * Finish the recording and release resources held by the recorder. The output
+ * stream is flushed, but not closed. Returns non-zero if writing failed.
+ * */
+int asciicast_recorder_close(struct asciicast_recorder *recorder);
+
+#endif //TETRIS_ASCIICAST_H
@@ -0,0 +1,121 @@
+#ifndef TETRIS_BOT_PROTOCOL_H
+#define TETRIS_BOT_PROTOCOL_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "tetris-game.h"
+#include "placement.h"
+
+/**
+ * bot-protocol:
+ * A line-oriented text protocol through which an external bot process plays
+ * in place of the keyboard, in the spirit of UCI for chess engines.
+ *
+ * The game connects to the bot, either through its own stdin and stdout or
+ * through a Unix socket on which the bot listens. Several games can be played
+ * at once, so that the positions of all of them are sent to the bot in a
+ * single batch, and the cost of a round trip is shared between them. A batch
+ * holds one position per game, each with the tetrimino that has to be placed
+ * next; the bot is never asked to rank several candidate placements of the
+ * same game, as it searches them itself.
+ *
+ * handshake:
+ * ```
+ * > tetris-bot 1
+ * > games <count> well <width> <height>
+ * < ready
+ * ```
+ *
+ * turns:
+ * Each turn, the game sends one position for each game still in progress,
+ * and the bot answers with one line per position, in the same order:
+ * ```
+ * > batch <count>
+ * > position <game> <piece> <queue> <level> <score> <lines> <row>...
+ * < place <x> <y> <x> <y> <x> <y> <x> <y>
+ * < moves <moves>
+ * < quit
+ * ```
+ * - piece: the current tetrimino, one of I, O, T, S, Z, J or L.
+ * - queue: the upcoming tetriminos in the preview queue of the well, at most
+ *   TETRIMINO_QUEUE_MAX of them, in the order they will appear, or `-` if the
+ *   queue is empty.
+ * - row: one hexadecimal bitmask of occupied cells per row of the well, from
+ *   top to bottom, where bit `i` is column `i`.
+ *
+ * A bot answers with either the four cells at which the tetrimino should come
+ * to rest (`place`), or with the moves that steer it there (`moves`), as a
+ * string of `l` (left), `r` (right), `d` (down) and `x` (rotate), after which
+ * the tetrimino is dropped. `moves -` drops the tetrimino where it spawned.
+ * `quit` gives up the game. A game whose answer is malformed, not a legal
+ * placement, or longer than BOT_LINE_MAX - 1 characters with its newline is
+ * over.
+ *
+ * end of game:
+ * When a game ends, and once every game has ended, the game reports:
+ * ```
+ * > gameover <game> <level> <score> <lines>
+ * > done
+ * ```
+ * */
+
+#define BOT_PROTOCOL_VERSION 1
+
+/*
+ * Long enough for a position in the largest well, and the longest answer a
+ * bot may give.
+ * */
+#define BOT_LINE_MAX 1024
+
+#define BOT_REPLY_PLACE 0
+#define BOT_REPLY_QUIT 1
+#define BOT_REPLY_INVALID 2
+
+struct bot_connection {
+	FILE *in;
+	FILE *out;
+};
+
+/**
+ * Connect to a bot at the given address: `stdio` to talk through stdin and
+ * stdout, or `unix:<path>` to connect to a Unix socket. Returns non-zero if
+ * the connection could not be made.
+ * */
+int bot_connect(struct bot_connection *bot, const char *address);
+
+/**
+ * Introduce the game to the bot, and wait for it to be ready. Returns non-zero
+ * if the bot doesn't answer as expected.
+ * */
+int bot_handshake(struct bot_connection *bot, int games, size_t width, size_t height);
+
+/**
+ * Write the `position` line describing the given game.
+ * */
+void bot_write_position(FILE *out, int id, const struct tetris_game *game);
+
+/**
+ * Read the reply to one position into `line`, which holds `size` bytes.
+ * Returns 0 if a whole line was read, or -1 if the bot stopped answering. A
+ * line that doesn't fit, or that the bot didn't finish with a newline, is
+ * discarded up to its end, and 1 is returned, so that the next reply is read
+ * from the start of its own line.
+ * */
+int bot_read_reply(struct bot_connection *bot, char *line, size_t size);
+
+/**
+ * Parse a reply to a position of the given game. If the bot placed or steered
+ * the tetrimino, the placement it chose is stored in `placement`, and
+ * BOT_REPLY_PLACE is returned. The placement is not yet checked for legality;
+ * see tetris_game_place(). Otherwise, returns BOT_REPLY_QUIT or
+ * BOT_REPLY_INVALID.
+ * */
+int bot_parse_reply(const char *line, const struct tetris_game *game, struct placement *placement);
+
+/**
+ * Close the connection to the bot.
+ * */
+void bot_disconnect(struct bot_connection *bot);
+
+#endif //TETRIS_BOT_PROTOCOL_H
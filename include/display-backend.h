@@ -0,0 +1,26 @@
+#ifndef TETRIS_DISPLAY_BACKEND_H
+#define TETRIS_DISPLAY_BACKEND_H
+
+#include <stddef.h>
+
+#include "tetris-well.h"
+#include "placement.h"
+
+/**
+ * display-backend:
+ * The operations implemented by each display backend. The display engine
+ * forwards the display-engine.h API to the backend selected at
+ * initialization.
+ * */
+struct display_backend {
+	int (*initialize)(size_t width, size_t height);
+	int (*user_input)(int timeout_ms, int wake_fd);
+	size_t (*draw_board)(struct tetris_well *well, const struct placement *hint, int level, int score, int lines,
+			int flags);
+	void (*stop)(void);
+};
+
+extern const struct display_backend curses_display_backend;
+extern const struct display_backend ansi_display_backend;
+
+#endif //TETRIS_DISPLAY_BACKEND_H
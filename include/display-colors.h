@@ -0,0 +1,42 @@
+#ifndef TETRIS_DISPLAY_COLORS_H
+#define TETRIS_DISPLAY_COLORS_H
+
+#include <stdint.h>
+
+#include "tetris-well.h"
+
+/**
+ * Terminal colors used to draw each type of tetrimino. The values match both
+ * the curses COLOR_* constants and the ANSI SGR color offsets.
+ * */
+#define DISPLAY_COLOR_BLACK 0
+#define DISPLAY_COLOR_RED 1
+#define DISPLAY_COLOR_GREEN 2
+#define DISPLAY_COLOR_YELLOW 3
+#define DISPLAY_COLOR_BLUE 4
+#define DISPLAY_COLOR_MAGENTA 5
+#define DISPLAY_COLOR_CYAN 6
+#define DISPLAY_COLOR_WHITE 7
+
+/**
+ * Flag added to the type of a cell in a composed frame to draw it as part of
+ * a hint (an outline of where the current tetrimino could go) rather than a
+ * block. It never collides with a cell type, since those are single bits
+ * below it.
+ * */
+#define CELL_HINT 0x80
+
+struct cell_color {
+	uint8_t cell_type;
+	short color;
+};
+
+extern const struct cell_color cell_colors[7];
+
+/**
+ * Look up the display color for a cell type. Returns DISPLAY_COLOR_BLACK for
+ * empty or unrecognized cells.
+ * */
+short cell_type_color(uint8_t cell_type);
+
+#endif //TETRIS_DISPLAY_COLORS_H
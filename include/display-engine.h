@@ -1,21 +1,53 @@
 #ifndef TETRIS_DISPLAY_ENGINE_H
 #define TETRIS_DISPLAY_ENGINE_H
 
+#include <stdint.h>
+#include <stddef.h>
+
 #include "tetris-well.h"
+#include "tetris-game.h"
+#include "display-colors.h"
+
+/**
+ * display backends:
+ * - DISPLAY_BACKEND_CURSES: draw the game with ncurses.
+ * - DISPLAY_BACKEND_ANSI: put the terminal in raw mode and draw the game with
+ *   ANSI escape sequences directly, writing each frame with a single write().
+ * */
+#define DISPLAY_BACKEND_CURSES 0
+#define DISPLAY_BACKEND_ANSI 1
 
-#define INPUT_LEFT 1
-#define INPUT_RIGHT 2
-#define INPUT_DOWN 3
-#define INPUT_ROTATE 4
-#define INPUT_PAUSE 5
-#define INPUT_STOP 6
-#define INPUT_DROP 7
+/**
+ * Initialize the given display backend for a well of the given dimensions.
+ * Returns non-zero if the backend could not be initialized.
+ * */
+int initialize_display_engine(int backend, size_t width, size_t height);
 
-void initialize_display_engine(void);
+/**
+ * Wait up to `timeout_ms` milliseconds for the player to press a key, and
+ * return the corresponding INPUT_* value. Returns zero if no key was pressed
+ * in time, or if the key is not bound. A negative timeout waits indefinitely.
+ * If `wake_fd` is not negative, also returns zero as soon as it is readable.
+ * */
+int user_input(int timeout_ms, int wake_fd);
 
-int user_input(void);
+/**
+ * draw_board() flags:
+ * - DRAW_DEFER_SCORE: leave the score panel as it is, even if it is out of
+ *   date, so that the bytes are spent on the well instead. The score panel is
+ *   brought up to date by the next frame drawn without this flag.
+ * */
+#define DRAW_DEFER_SCORE 1
 
-void draw_board(struct tetris_well *well, int level, int score, int lines);
+/**
+ * Draw any changes to the well and score panel since the previous frame. If
+ * `hint` is non-NULL, it is drawn as an outline of the current tetrimino in
+ * the empty cells it covers. Returns the number of bytes sent to the
+ * terminal, or an estimate of it for backends that can't measure their
+ * output.
+ * */
+size_t draw_board(struct tetris_well *well, const struct placement *hint, int level, int score, int lines,
+		int flags);
 
 void stop_display_engine(void);
 
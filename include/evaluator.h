@@ -0,0 +1,70 @@
+#ifndef TETRIS_EVALUATOR_H
+#define TETRIS_EVALUATOR_H
+
+#include <stddef.h>
+
+#include "tetris-well.h"
+#include "placement.h"
+
+/**
+ * evaluator:
+ * Judge how good a well is to keep playing from, with a weighted sum of a few
+ * simple features of the board:
+ * - aggregate_height: the sum of the heights of every column.
+ * - holes: the number of empty cells with an occupied cell somewhere above.
+ * - bumpiness: the sum of the differences in height between adjacent columns.
+ * - transitions: the number of times an occupied cell sits next to an empty
+ *   one, along the rows of the stack (with the walls counting as occupied) and
+ *   down its columns (with the floor counting as occupied).
+ * - lines: the number of lines cleared by the placement that led to the board.
+ *
+ * Higher evaluations are better. The evaluator is used to choose placements
+ * for the heuristic rollout policy, and anywhere else a quick judgement of a
+ * placement is needed.
+ * */
+
+struct evaluator_weights {
+	double aggregate_height;
+	double holes;
+	double bumpiness;
+	double transitions;
+	double lines;
+};
+
+struct board_features {
+	int aggregate_height;
+	int holes;
+	int bumpiness;
+	int transitions;
+	int max_height;
+};
+
+/**
+ * Weights that play a reasonable game of tetris without any lookahead.
+ * */
+extern const struct evaluator_weights evaluator_default_weights;
+
+/**
+ * Measure the features of the board in the well, ignoring the current
+ * tetrimino.
+ * */
+void evaluator_features(const struct tetris_well *well, struct board_features *features);
+
+/**
+ * Evaluate the board in the well, given the number of lines cleared by the
+ * placement that led to it.
+ * */
+double evaluator_evaluate(const struct tetris_well *well, int lines,
+		const struct evaluator_weights *weights);
+
+/**
+ * Find the placement of the current tetrimino that leads to the best board,
+ * committing each placement to a copy of the well and evaluating the result.
+ * Returns the index of the best placement (the first, on ties), or `count` if
+ * there are no placements. If `evaluation` is non-NULL, the evaluation of the
+ * best placement is stored there.
+ * */
+size_t evaluator_best_placement(const struct tetris_well *well, const struct placement *placements,
+		size_t count, const struct evaluator_weights *weights, double *evaluation);
+
+#endif //TETRIS_EVALUATOR_H
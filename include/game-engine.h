@@ -1,6 +1,104 @@
 #ifndef TETRIS_GAME_ENGINE_H
 #define TETRIS_GAME_ENGINE_H
 
-int start_game(int *level, int *lines_cleared);
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tetris-game.h"
+#include "hint-engine.h"
+
+#define GAME_DEFAULT_FPS 60
+
+/**
+ * Options for a game played in real time:
+ * - width, height: dimensions of the well. The display engine must be
+ *   initialized with the same dimensions.
+ * - max_fps: the maximum number of frames drawn per second, or zero to draw
+ *   every change as soon as it happens. Frames are only ever drawn when the
+ *   game state changed, and never slow down the game logic.
+ * - replay: if non-NULL, the inputs of the game are written to this stream as
+ *   a replay once the game is over.
+ * - asciicast: if non-NULL, every frame drawn is also recorded to this stream
+ *   as an asciicast.
+ * - max_bandwidth: if non-zero, the number of bytes per second that may be
+ *   sent to the terminal. Once the budget is used up, frames are merged until
+ *   it recovers, and while it runs low the score panel is left out of date in
+ *   favour of the well.
+ * - randomizer: the type of randomizer that generates the tetriminos (see
+ *   randomizer.h).
+ * - telemetry: if non-NULL, an event for every locked tetrimino is written to
+ *   this stream by a background thread (see telemetry.h).
+ * - hints: if non-NULL, a started hint engine that every tetrimino is posted
+ *   to as it spawns; the best placement it finds is drawn over the well until
+ *   the tetrimino locks (see hint-engine.h).
+ * */
+struct game_options {
+	size_t width;
+	size_t height;
+	int max_fps;
+	FILE *replay;
+	FILE *asciicast;
+	unsigned long max_bandwidth;
+	int randomizer;
+	FILE *telemetry;
+	struct hint_engine *hints;
+};
+
+/**
+ * Counters describing what it cost to display a game:
+ * - frames: the number of frames drawn.
+ * - merged_frames: the number of frames that were due, but merged into a
+ *   later frame to stay within the bandwidth budget.
+ * - bytes: the total number of bytes sent to the terminal.
+ * - telemetry_events, telemetry_dropped: the number of telemetry events
+ *   written, and dropped because the writer fell behind.
+ * - wakeups, usec: the number of times the game loop woke up, for input or a
+ *   tick or frame that was due, and how long the game lasted.
+ * */
+struct game_stats {
+	unsigned long frames;
+	unsigned long merged_frames;
+	unsigned long long bytes;
+	unsigned long telemetry_events;
+	unsigned long telemetry_dropped;
+	unsigned long wakeups;
+	uint64_t usec;
+};
+
+/**
+ * Play a game of tetris until the player quits or the well overflows. Returns
+ * the final score. If `stats` is non-NULL, it is filled with display counters
+ * for the session.
+ * */
+int start_game(const struct game_options *options, int *level, int *lines_cleared, struct game_stats *stats);
+
+/**
+ * Round trip times of the bot protocol, per move: the time from sending the
+ * batch holding a position to the bot until its answer to that position
+ * arrives.
+ * - moves: the number of positions the bot answered.
+ * - batches: the number of batches sent.
+ * - total_usec, min_usec, max_usec: the total, shortest and longest round
+ *   trip, over every move.
+ * */
+struct bot_stats {
+	unsigned long moves;
+	unsigned long batches;
+	uint64_t total_usec;
+	uint64_t min_usec;
+	uint64_t max_usec;
+};
+
+/**
+ * Play `games_nr` games at once in wells of the given size, with every move
+ * chosen by the bot at `address` (see bot-protocol.h) rather than read from
+ * the keyboard. Games are played as fast as the bot answers, without gravity
+ * or a display. The final state of each game is left in `games`.
+ *
+ * Returns non-zero if the bot could not be reached, or stopped answering.
+ * */
+int start_bot_games(const char *address, size_t width, size_t height,
+		struct tetris_game *games, int games_nr, struct bot_stats *stats);
 
 #endif //TETRIS_GAME_ENGINE_H
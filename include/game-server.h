@@ -0,0 +1,131 @@
+#ifndef TETRIS_GAME_SERVER_H
+#define TETRIS_GAME_SERVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/un.h>
+
+/**
+ * game-server:
+ * Host many independent games in a single process, for players connecting
+ * over a socket with a terminal (e.g. `telnet` or `nc`).
+ *
+ * Each connection gets a session with its own game, gravity timer and ANSI
+ * renderer (see ansi-renderer.h), and the game is streamed to the client as
+ * ANSI escape sequences, exactly as the ansi display backend draws it. Keys
+ * are read from the connection and decoded the same way. Telnet clients are
+ * asked to switch to character mode on connect, and any other telnet
+ * negotiation is skipped.
+ *
+ * Sessions are served by a small fixed number of worker threads. Each worker
+ * waits on its own epoll instance, and keeps the deadlines of its sessions
+ * (the next gravity tick, and the next frame once a change needs drawing) in
+ * its own timer wheel (see timer-wheel.h), so a session costs a few kilobytes
+ * and no thread, process or signal of its own. Every worker waits for new
+ * connections on the listening socket with EPOLLEXCLUSIVE, so that a new
+ * connection wakes only one of them, and the worker that accepts a connection
+ * serves it until it is closed; workers never share sessions, and so never
+ * take a lock.
+ *
+ * A client that doesn't keep up with its frames never holds up the others:
+ * output it hasn't read yet is kept for it, and frames are merged until it
+ * has caught up.
+ *
+ * addresses:
+ * - unix:<path>: a Unix socket at the given path, which must not exist yet.
+ *   It is removed once the server stops.
+ * - tcp:<port>: a TCP socket on every interface.
+ * - tcp:<host>:<port>: a TCP socket on the given interface.
+ *
+ * usage example:
+ * struct game_server server;
+ * if (server_open(&server, &options))
+ *     die();
+ *
+ * wait_for_shutdown();
+ * server_stop(&server);
+ * */
+
+#define SERVER_DEFAULT_WORKERS 4
+#define SERVER_DEFAULT_MAX_SESSIONS 4096
+
+/**
+ * Options for the server:
+ * - address: where to listen (see above).
+ * - workers: the number of worker threads.
+ * - max_fps: the maximum number of frames sent to each client per second, or
+ *   zero to send every change as soon as it happens.
+ * - width, height: dimensions of the well of every game.
+ * - randomizer: the type of randomizer for every game (see randomizer.h).
+ * - max_sessions: the number of games played at once, beyond which new
+ *   connections are turned away.
+ * */
+struct server_options {
+	const char *address;
+	int workers;
+	int max_fps;
+	size_t width;
+	size_t height;
+	int randomizer;
+	unsigned long max_sessions;
+};
+
+/**
+ * Counters describing the sessions served, valid once the server stopped:
+ * - sessions: the number of games played.
+ * - peak_sessions: the most games played at once.
+ * - rejected: the number of connections turned away because the server was
+ *   full.
+ * - frames, bytes: the number of frames and bytes sent to every client.
+ * - wakeups, usec: the number of times the workers woke up, for events or
+ *   timers, and how long the server ran. Idle and paused games don't wake
+ *   their worker until something happens.
+ * */
+struct server_stats {
+	unsigned long sessions;
+	unsigned long peak_sessions;
+	unsigned long rejected;
+	unsigned long frames;
+	unsigned long long bytes;
+	unsigned long wakeups;
+	uint64_t usec;
+};
+
+struct server_worker;
+
+struct game_server {
+	struct server_options options;
+	int listen_fd;
+	int stop_fd;
+	char unix_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+	struct server_worker *workers;
+	int workers_nr;
+
+	unsigned long active_sessions;
+	uint64_t started;
+	struct server_stats stats;
+};
+
+/**
+ * Fill in default options: listen on nothing, SERVER_DEFAULT_WORKERS workers,
+ * the default frame rate and well, and up to SERVER_DEFAULT_MAX_SESSIONS
+ * games at once.
+ * */
+void server_options_init(struct server_options *options);
+
+/**
+ * Listen at the address in the options, and start the workers. Returns
+ * non-zero if the address is invalid or in use, or if the workers could not
+ * be started.
+ * */
+int server_open(struct game_server *server, const struct server_options *options);
+
+/**
+ * Stop the workers, disconnect every client, and stop listening. The stats of
+ * the server are filled in.
+ * */
+void server_stop(struct game_server *server);
+
+#endif //TETRIS_GAME_SERVER_H
@@ -0,0 +1,88 @@
+#ifndef TETRIS_HIGHSCORES_H
+#define TETRIS_HIGHSCORES_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * highscores:
+ * A high score table kept in a memory-mapped file, shared by every game
+ * process on the machine.
+ *
+ * The file holds an append-only log of results and a small table of the best
+ * HIGHSCORE_TOP results, both updated in place with atomic operations:
+ * - Appending claims the next slot in the log with an atomic increment,
+ *   writes the result there, then offers it to the table. Each entry of the
+ *   table is a single 64-bit key (the score, and the slot of the result in
+ *   the log), and an offered key replaces the smallest key in the table with
+ *   a compare-and-swap if it is larger, retrying if another process got there
+ *   first. Keys only ever grow, so the table always holds the best results.
+ * - Reading the top results copies the table and looks up each key in the
+ *   log, without a lock and without scanning the log.
+ * - Once the log is full, the next process to append compacts it, keeping
+ *   only the results in the table. Appends hold a shared lock on the file and
+ *   compaction an exclusive one, so compaction never moves a result that is
+ *   being written. Readers detect a compaction that happened while they were
+ *   reading with a generation count, and retry.
+ * - The results kept by a compaction are copied aside in the file before the
+ *   log is rewritten, so that if the process dies partway through, the next
+ *   one to take the exclusive lock either finds the old table intact or
+ *   finishes the rewrite.
+ *
+ * usage example:
+ * struct highscores scores;
+ * struct highscore top[10];
+ * highscores_open(&scores, path);
+ *
+ * highscores_add(&scores, &result);
+ * size_t count = highscores_top(&scores, top, 10);
+ *
+ * highscores_close(&scores);
+ * */
+
+#define HIGHSCORE_TOP 64
+#define HIGHSCORE_LOG_MAX 4096
+#define HIGHSCORE_NAME_MAX 32
+
+struct highscore {
+	char name[HIGHSCORE_NAME_MAX];
+	int64_t time;
+	int32_t score;
+	int32_t level;
+	int32_t lines;
+};
+
+struct highscores_file;
+
+struct highscores {
+	int fd;
+	struct highscores_file *file;
+};
+
+/**
+ * Open the high score table at the given path, creating it if it doesn't
+ * exist yet. The file is created readable and writable by everyone (subject
+ * to the umask), so that every user on the machine can record their scores.
+ * Returns non-zero if the file could not be opened, or isn't a high score
+ * table, in which case it is left as it was.
+ * */
+int highscores_open(struct highscores *scores, const char *path);
+
+/**
+ * Record a result. Returns non-zero on error.
+ * */
+int highscores_add(struct highscores *scores, const struct highscore *entry);
+
+/**
+ * Copy up to `count` of the best results to `entries`, best first. Equal
+ * scores are ordered by who got there first. Returns the number of results
+ * copied, at most HIGHSCORE_TOP.
+ * */
+size_t highscores_top(struct highscores *scores, struct highscore *entries, size_t count);
+
+/**
+ * Unmap and close the high score table.
+ * */
+void highscores_close(struct highscores *scores);
+
+#endif //TETRIS_HIGHSCORES_H
@@ -0,0 +1,144 @@
+#ifndef TETRIS_HINT_ENGINE_H
+#define TETRIS_HINT_ENGINE_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "tetris-well.h"
+#include "placement.h"
+#include "search.h"
+#include "opening-book.h"
+
+/**
+ * hint-engine:
+ * Work out where the current tetrimino should go on a background thread,
+ * while the player is still thinking about it.
+ *
+ * Whenever a tetrimino spawns, the game posts the well to the engine, whose
+ * worker looks the position up in the opening book, if it has one, or
+ * searches it (see search.h). A placement from the book is only hinted if the
+ * tetrimino can reach it, and the position is searched otherwise. As soon as
+ * the hint for the current tetrimino is published, the worker places it as
+ * hinted and works out the hint for the next tetrimino too, so that if the
+ * player follows the hint, the next one is ready the moment the tetrimino
+ * locks.
+ *
+ * Neither side ever waits for the other:
+ * - Positions are posted through a slot written only by the game thread, and
+ *   hints published through a slot written only by the worker. Each slot has
+ *   a sequence count that is odd while it is being written, and a reader
+ *   copies the slot and checks that the count didn't change in the meantime.
+ *   The worker retries a torn read; the game thread doesn't, and simply keeps
+ *   the hint it had until the next frame.
+ * - Posting a position raises a flag that makes the search in progress give
+ *   up between two placements, and wakes the worker with a semaphore.
+ * - Publishing a hint signals an eventfd, which the game thread can wait on
+ *   along with the keyboard instead of checking for hints on a timer.
+ *
+ * data structures:
+ *   struct hint
+ *     - piece:
+ *       The number of tetriminos locked before the one the hint is for, as
+ *       given to hint_engine_post(); compare with tetris_game.pieces.
+ *     - has_current, current:
+ *       Whether the current tetrimino has a placement, and the best one.
+ *     - has_next, next:
+ *       Whether the next tetrimino has been worked out yet, and its best
+ *       placement once the current one is placed as hinted.
+ *
+ *   struct hint_engine
+ *     - published_fd:
+ *       An eventfd that becomes readable whenever a hint is published, and
+ *       is drained by hint_engine_read().
+ *     - searched, followed, cancelled:
+ *       The number of positions searched or found in the book, the number of
+ *       hints that were ready in advance because the player followed the
+ *       previous one, and the number of searches given up. Only up to date
+ *       once the engine is stopped.
+ *
+ * usage example:
+ * struct hint_engine engine;
+ * struct hint hint;
+ * hint_engine_start(&engine, &search_options, NULL);
+ *
+ * hint_engine_post(&engine, &game.well, game.pieces);
+ * if (!hint_engine_read(&engine, &hint) && hint.piece == game.pieces && hint.has_current)
+ *     draw_board(&game.well, &hint.current, ...);
+ *
+ * hint_engine_stop(&engine);
+ * */
+
+struct hint {
+	unsigned long piece;
+	int has_current;
+	int has_next;
+	struct placement current;
+	struct placement next;
+};
+
+struct hint_request {
+	unsigned long sequence;
+	unsigned long piece;
+	struct tetris_well well;
+};
+
+struct hint_slot {
+	unsigned long sequence;
+	struct hint hint;
+};
+
+struct hint_engine {
+	struct search_options search;
+	const struct opening_book *book;
+
+	pthread_t worker;
+	sem_t wake;
+	int stop;
+	int cancel;
+
+	struct hint_request request;
+	struct hint_slot published;
+	int published_fd;
+
+	// owned by the worker
+	struct placement *placements;
+	unsigned long handled;
+	int expecting;
+	unsigned long expected_piece;
+	struct tetris_well expected_well;
+	struct placement expected_next;
+
+	unsigned long searched;
+	unsigned long followed;
+	unsigned long cancelled;
+};
+
+/**
+ * Start the worker, searching with the given options and looking positions up
+ * in `book` first, if non-NULL. The book must stay open until the engine is
+ * stopped. Returns non-zero if the worker could not be started.
+ * */
+int hint_engine_start(struct hint_engine *engine, const struct search_options *search,
+		const struct opening_book *book);
+
+/**
+ * Post the well with its newly spawned tetrimino, the tetrimino that follows
+ * `piece` locked ones, giving up on the previous position. Never blocks; must
+ * only be called from one thread.
+ * */
+void hint_engine_post(struct hint_engine *engine, const struct tetris_well *well, unsigned long piece);
+
+/**
+ * Copy the latest hint published, and drain `published_fd`. Never blocks.
+ * Returns non-zero if no hint has been published yet, or if the worker was
+ * publishing one at that very moment.
+ * */
+int hint_engine_read(struct hint_engine *engine, struct hint *hint);
+
+/**
+ * Stop the worker, giving up on any search in progress.
+ * */
+void hint_engine_stop(struct hint_engine *engine);
+
+#endif //TETRIS_HINT_ENGINE_H
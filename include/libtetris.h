@@ -0,0 +1,41 @@
+#ifndef TETRIS_LIBTETRIS_H
+#define TETRIS_LIBTETRIS_H
+
+#include "tetris-game.h"
+#include "randomizer.h"
+#include "placement.h"
+#include "replay.h"
+#include "ansi-renderer.h"
+
+/**
+ * libtetris:
+ * The game logic of tetris as a library, to embed any number of games in a
+ * single process. It is built as both libtetris.a and libtetris.so, and
+ * depends on nothing but pthreads and libm: the terminal frontend (curses,
+ * the keyboard and the display engine) is left to the tetris binary, which
+ * is just one client of the library.
+ *
+ * Every game is a struct tetris_game owned by the caller, and the library
+ * keeps no state of its own, so games need no locking as long as each is
+ * driven by one thread at a time. The only exception is the optional well
+ * metrics (see well-metrics.h), which are process-wide by design.
+ *
+ * A game advances in logic ticks of GAME_TICK_USEC, each with the inputs that
+ * arrived during it, and never looks at the clock, so the caller decides how
+ * fast it runs:
+ * ```
+ * struct tetris_game game;
+ * int inputs[8];
+ * size_t count = 0;
+ *
+ * tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, seed);
+ * while (tetris_game_step(&game, inputs, count))
+ *     count = read_inputs(inputs, 8);
+ * ```
+ *
+ * Bots can skip the individual inputs and place each tetrimino directly with
+ * tetrimino_placements() and tetris_game_place(), and frames can be drawn
+ * into a buffer of ANSI escape sequences with an ansi_renderer.
+ * */
+
+#endif //TETRIS_LIBTETRIS_H
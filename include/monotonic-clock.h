@@ -0,0 +1,27 @@
+#ifndef TETRIS_MONOTONIC_CLOCK_H
+#define TETRIS_MONOTONIC_CLOCK_H
+
+#include <stdint.h>
+
+/**
+ * monotonic-clock:
+ * Read the monotonic clock, which measures the time between two points and
+ * never jumps when the wall clock is set, for pacing games and timing work.
+ *
+ * usage example:
+ * uint64_t start = monotonic_usec();
+ * run_games();
+ * printf("%.3fs\n", monotonic_elapsed_sec(start));
+ * */
+
+/**
+ * The time in microseconds since some fixed point in the past.
+ * */
+uint64_t monotonic_usec(void);
+
+/**
+ * The time in seconds since `start`, a time given by monotonic_usec().
+ * */
+double monotonic_elapsed_sec(uint64_t start);
+
+#endif //TETRIS_MONOTONIC_CLOCK_H
@@ -0,0 +1,119 @@
+#ifndef TETRIS_OPENING_BOOK_H
+#define TETRIS_OPENING_BOOK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "tetris-well.h"
+#include "placement.h"
+
+/**
+ * opening-book:
+ * A precomputed table of the best placement in positions that come up early
+ * in a game, so that a bot doesn't need to search them again (see search.h).
+ *
+ * A position is identified by a 64-bit hash of its canonical form: which cells
+ * of the well are occupied (but not by what), the type of the current
+ * tetrimino, and the tetriminos queued after it, in order. The position of
+ * the current tetrimino is left out, since the book is only consulted for
+ * tetriminos that just spawned. Two positions with the same hash are assumed
+ * to be the same; with 64 bits, a book would need billions of entries before
+ * that is likely to go wrong.
+ *
+ * file format:
+ * A book is a single file, used directly through a read-only shared memory
+ * mapping, so that opening it costs nothing but the mapping, and every process
+ * on the host shares the same pages. In native byte order, the file holds:
+ * - a struct opening_book_header.
+ * - an index of 2^index_bits + 1 uint32_t offsets: the first entry whose hash
+ *   starts with each possible value of its top index_bits bits, followed by
+ *   the number of entries.
+ * - the entries, sorted by hash.
+ *
+ * A lookup takes the top bits of the hash to find the few entries that share
+ * them, in constant time, and the index is sized for a handful of entries per
+ * bucket.
+ *
+ * usage example:
+ * struct opening_book book;
+ * struct placement placement;
+ *
+ * if (opening_book_open(&book, path))
+ *     die();
+ *
+ * // placements from the book are checked by tetris_game_place()
+ * if (opening_book_lookup(&book, &game.well, &placement) || tetris_game_place(&game, &placement)) {
+ *     search_best_placement(&game.well, &options, &placement, NULL);
+ *     tetris_game_place_trusted(&game, &placement);
+ * }
+ *
+ * opening_book_close(&book);
+ * */
+
+#define OPENING_BOOK_MAGIC "tetrisOB"
+#define OPENING_BOOK_VERSION 1
+
+struct opening_book_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t index_bits;
+	uint64_t count;
+	/* the search that found the placements */
+	uint32_t depth;
+	uint32_t beam;
+};
+
+struct opening_book_entry {
+	uint64_t hash;
+	struct placement placement;
+};
+
+struct opening_book {
+	const struct opening_book_header *header;
+	const uint32_t *index;
+	const struct opening_book_entry *entries;
+	size_t size;
+};
+
+/**
+ * The hash of the canonical form of the position in the well.
+ * */
+uint64_t opening_book_hash(const struct tetris_well *well);
+
+/**
+ * Map the book at the given path. Returns non-zero if the file can't be read
+ * or isn't a valid book.
+ * */
+int opening_book_open(struct opening_book *book, const char *path);
+
+/**
+ * Look up the placement for the current tetrimino of the well. Returns
+ * non-zero if the position isn't in the book, or the book was made for a well
+ * of other dimensions.
+ *
+ * The placement is copied from the file as is: opening_book_open() only
+ * checks the layout of the file, so a corrupt book, or a position whose hash
+ * collides with another, can give cells outside the well, overlapping cells,
+ * or a placement the tetrimino can't reach. Check it before placing it, e.g.
+ * with tetris_game_place(), or against tetrimino_placements().
+ * */
+int opening_book_lookup(const struct opening_book *book, const struct tetris_well *well,
+		struct placement *placement);
+
+/**
+ * Unmap the book.
+ * */
+void opening_book_close(struct opening_book *book);
+
+/**
+ * Write a book for a well of the given dimensions from an array of entries,
+ * which is sorted (and stripped of repeated hashes) in place. `depth` and
+ * `beam` record the search that found the placements. Returns non-zero if the
+ * file could not be written.
+ * */
+int opening_book_write(const char *path, struct opening_book_entry *entries, size_t count,
+		size_t width, size_t height, int depth, int beam);
+
+#endif //TETRIS_OPENING_BOOK_H
@@ -0,0 +1,137 @@
+#ifndef TETRIS_PERFECT_CLEAR_H
+#define TETRIS_PERFECT_CLEAR_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "tetris-well.h"
+#include "placement.h"
+
+/**
+ * perfect-clear:
+ * Find sequences of placements of known tetriminos that clear a low board
+ * completely (a "perfect clear").
+ *
+ * A perfect clear of the bottom `rows` rows of the well fills every empty cell
+ * of those rows, and nothing above them, so it takes exactly one tetrimino
+ * for every four empty cells. The solver places the tetriminos in the order
+ * given, only at placements entirely within the rows left to clear, and
+ * backtracks as soon as the board can't be cleared anymore: when a column
+ * that is already full splits the empty cells into groups that aren't
+ * multiples of four, or when the same board was already found to be a dead
+ * end with the same tetriminos left.
+ *
+ * The board is kept as one bitmask of occupied cells per row, and placements
+ * are found with the same moves as tetrimino_placements() (see placement.h),
+ * but on the bitmasks: a tetrimino is reachable in any position entirely
+ * above the stack, and from there is moved down, sideways and rotated, with
+ * the same rotation rules as tetrimino_rotate(). So every solution can be
+ * played out in the game as is.
+ *
+ * The search is split across threads by the placement of the first
+ * tetrimino. Threads share the table of dead ends, which is updated without
+ * locks: entries are single 64-bit hashes, written with compare-and-swap, and
+ * a full table simply stops remembering new dead ends.
+ *
+ * usage example:
+ * struct perfect_clear_problem problem;
+ * struct perfect_clear_options options;
+ * struct perfect_clear_result result;
+ *
+ * if (perfect_clear_from_well(&problem, &well, 0))
+ *     die();
+ *
+ * perfect_clear_options_init(&options);
+ * if (!perfect_clear_solve(&problem, &options, &result) && result.solutions)
+ *     play(result.first.placements, result.first.nr);
+ * */
+
+#define PERFECT_CLEAR_MAX_ROWS 8
+#define PERFECT_CLEAR_MAX_PIECES 32
+
+/**
+ * A board to clear:
+ * - width, height: dimensions of the well.
+ * - rows: the bottom rows of the well as bitmasks of occupied cells, where
+ *   bit j is column j and rows[0] is the bottom row. Rows above the ones to
+ *   clear must be empty.
+ * - clear_rows: the number of rows to clear, or zero for the fewest rows that
+ *   hold the stack and can be cleared with the tetriminos given.
+ * - pieces, pieces_nr: the tetriminos to place, in order, as indexes into
+ *   cell_init_coords. A solution uses as many of them as it needs.
+ * */
+struct perfect_clear_problem {
+	size_t width;
+	size_t height;
+	uint16_t rows[PERFECT_CLEAR_MAX_ROWS];
+	int clear_rows;
+	uint8_t pieces[PERFECT_CLEAR_MAX_PIECES];
+	size_t pieces_nr;
+};
+
+/**
+ * Options for the search:
+ * - threads: the number of threads.
+ * - max_solutions: stop once this many solutions were found, or zero to
+ *   count every solution.
+ * - memo_bits: the dead end table holds 2^memo_bits entries, of 8 bytes each.
+ * */
+struct perfect_clear_options {
+	int threads;
+	unsigned long max_solutions;
+	int memo_bits;
+};
+
+/**
+ * A sequence of placements, one per tetrimino in the order given. Each
+ * placement is in the coordinates of the well at the time it's placed, after
+ * the lines cleared by the placements before it, as tetris_game_place() takes
+ * them.
+ * */
+struct perfect_clear_solution {
+	size_t nr;
+	struct placement placements[PERFECT_CLEAR_MAX_PIECES];
+};
+
+/**
+ * The outcome of a search:
+ * - solutions: the number of solutions found. When stopping at max_solutions,
+ *   threads that find a solution at the same time may go slightly over.
+ * - first: the solution that comes first in the order of the search (by the
+ *   placement of the first tetrimino, then the second, and so on), whatever
+ *   the number of threads, if max_solutions is one or zero.
+ * - clear_rows: the number of rows cleared.
+ * - nodes: the number of boards searched.
+ * */
+struct perfect_clear_result {
+	unsigned long solutions;
+	struct perfect_clear_solution first;
+	int clear_rows;
+	unsigned long long nodes;
+};
+
+/**
+ * Fill in default options: one thread per core, stop at the first solution,
+ * and a dead end table of 2^20 entries.
+ * */
+void perfect_clear_options_init(struct perfect_clear_options *options);
+
+/**
+ * Set up the problem of clearing the board of a well, with its current
+ * tetrimino followed by the queued ones. Returns non-zero if the stack is
+ * taller than PERFECT_CLEAR_MAX_ROWS.
+ * */
+int perfect_clear_from_well(struct perfect_clear_problem *problem, const struct tetris_well *well,
+		int clear_rows);
+
+/**
+ * Search for perfect clears. Returns non-zero if the problem is invalid (the
+ * rows to clear don't hold the stack, leave a number of empty cells that isn't
+ * a multiple of four, or need more tetriminos than given), or if threads or
+ * memory could not be allocated. Otherwise, the result is filled in, with no
+ * solutions if there are none.
+ * */
+int perfect_clear_solve(const struct perfect_clear_problem *problem, const struct perfect_clear_options *options,
+		struct perfect_clear_result *result);
+
+#endif //TETRIS_PERFECT_CLEAR_H
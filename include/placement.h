@@ -0,0 +1,69 @@
+#ifndef TETRIS_PLACEMENT_H
+#define TETRIS_PLACEMENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "tetris-well.h"
+
+/**
+ * placement:
+ * Enumerate every position at which the current tetrimino can come to rest.
+ *
+ * A placement is reachable if the tetrimino can be moved there from where it
+ * spawned with any sequence of left, right and down shifts and rotations,
+ * and can't shift down any further once it's there. This includes positions
+ * that are only reachable by sliding or rotating a tetrimino underneath an
+ * overhang, not just those reachable by dropping it straight down.
+ *
+ * Placements are compared by the cells they cover, so a tetrimino that looks
+ * the same in two orientations (like the I, S and Z types) gives a single
+ * placement for both.
+ *
+ * usage example:
+ * ```
+ * struct placement placements[PLACEMENTS_MAX];
+ *
+ * tetrimino_new(&well);
+ * size_t count = tetrimino_placements(&well, placements);
+ * for (size_t i = 0; i < count; i++) {
+ *     struct tetris_well next = well;
+ *     tetrimino_place(&next, &placements[i]);
+ *     tetris_well_commit_tetrimino(&next);
+ * }
+ * ```
+ * */
+
+/**
+ * An upper bound on the number of placements for any tetrimino in any well;
+ * one for each rotation of the tetrimino at each cell of the largest well.
+ * */
+#define PLACEMENTS_MAX (4 * BOARD_MAX_WIDTH * BOARD_MAX_HEIGHT)
+
+struct placement {
+	uint8_t coords[4][2];
+};
+
+/**
+ * Find every placement reachable by the current tetrimino of the well, writing
+ * them to `placements`, which must have room for PLACEMENTS_MAX entries; the
+ * search runs in that room, so it takes little stack and no heap of its own.
+ * Placements are written in a stable order, sorted by the cells they cover.
+ * The tetrimino itself is left where it is. Returns the number of placements,
+ * which is zero if the tetrimino overlaps with the well where it is.
+ * */
+size_t tetrimino_placements(struct tetris_well *well, struct placement *placements);
+
+/**
+ * Sort the cells of a placement into the order used by tetrimino_placements(),
+ * so that placements covering the same cells compare equal with memcmp().
+ * */
+void placement_normalize(struct placement *placement);
+
+/**
+ * Move the current tetrimino to the given placement, ready to be committed
+ * with tetris_well_commit_tetrimino().
+ * */
+void tetrimino_place(struct tetris_well *well, const struct placement *placement);
+
+#endif //TETRIS_PLACEMENT_H
@@ -0,0 +1,95 @@
+#ifndef TETRIS_RANDOMIZER_H
+#define TETRIS_RANDOMIZER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * randomizer:
+ * Generate the sequence of tetriminos for a game.
+ *
+ * Pieces are generated as indexes into cell_init_coords (0 for the I type
+ * through 6 for the L type). A randomizer is plain data, so a well (and the
+ * randomizer in it) can be copied to explore alternative futures, and two
+ * randomizers initialized with the same type and seed generate the same
+ * sequence.
+ *
+ * randomizers:
+ * - RANDOMIZER_BAG: every run of seven pieces is a shuffled set of all seven
+ *   types, so droughts are short and every type comes up equally often.
+ * - RANDOMIZER_RANDOM: every piece is independently and uniformly random.
+ * - RANDOMIZER_NES: like the original NES game, a piece that repeats the one
+ *   before it is rerolled once, making repeats less likely.
+ * - RANDOMIZER_TGM: like the original Tetris The Grand Master, the last four
+ *   pieces are remembered and a piece in that history is rerolled up to four
+ *   times. The first piece is never an S, Z or O.
+ *
+ * Generating many pieces at once with randomizer_generate() is much cheaper
+ * than generating them one at a time, so simulations can fill a large buffer
+ * ahead of time rather than generating pieces as they go.
+ * */
+
+#define RANDOMIZER_BAG 0
+#define RANDOMIZER_RANDOM 1
+#define RANDOMIZER_NES 2
+#define RANDOMIZER_TGM 3
+#define RANDOMIZER_COUNT 4
+
+struct randomizer {
+	int type;
+	uint64_t rng;
+	uint8_t bag[7];
+	uint8_t bag_left;
+	uint8_t history[4];
+	uint8_t started;
+};
+
+/**
+ * Initialize a randomizer of the given type, seeded with the given value.
+ * */
+void randomizer_init(struct randomizer *randomizer, int type, uint64_t seed);
+
+/**
+ * Reseed the random number generator of a randomizer, keeping the rest of its
+ * state (the rest of the current bag, or the history of recent pieces).
+ * */
+void randomizer_seed(struct randomizer *randomizer, uint64_t seed);
+
+/**
+ * Generate the next `count` pieces of the sequence into `pieces`.
+ * */
+void randomizer_generate(struct randomizer *randomizer, uint8_t *pieces, size_t count);
+
+/**
+ * Look up a randomizer type by name ("bag", "random", "nes" or "tgm").
+ * Returns -1 if there is no randomizer with that name.
+ * */
+int randomizer_parse(const char *name);
+
+/**
+ * The name of a randomizer type, as accepted by randomizer_parse().
+ * */
+const char *randomizer_name(int type);
+
+/**
+ * The state of a random number generator for randomizer_next(), seeded from
+ * any value so that similar seeds give unrelated sequences. Randomizers draw
+ * from this generator, and so does everything else that needs reproducible
+ * random numbers.
+ * */
+uint64_t randomizer_state(uint64_t seed);
+
+/**
+ * The next 64 random bits from a generator (xorshift64*), whose state must
+ * come from randomizer_state() or otherwise be non-zero. The low bits are
+ * the weakest, so small numbers are best taken from the high bits.
+ * */
+uint64_t randomizer_next(uint64_t *state);
+
+/**
+ * Scramble a value so that every bit of the result depends on every bit of
+ * it (the splitmix64 finalizer), for deriving seeds and finishing hashes.
+ * */
+uint64_t randomizer_mix(uint64_t value);
+
+#endif //TETRIS_RANDOMIZER_H
@@ -0,0 +1,81 @@
+#ifndef TETRIS_REPLAY_STATS_H
+#define TETRIS_REPLAY_STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "replay.h"
+
+/**
+ * replay-stats:
+ * Aggregate how tetriminos were placed over any number of replays, by playing
+ * each of them back and looking at every lock.
+ *
+ * The statistics are plain counters, so that those of separate sets of
+ * replays (say, one per thread) add up to those of all of them with
+ * replay_stats_merge(), in any order.
+ *
+ * data structures:
+ *   struct replay_stats
+ *     - games, invalid:
+ *       The number of replays played back, and rejected as invalid.
+ *     - bytes:
+ *       The size of the replay files read, valid or not.
+ *     - pieces, ticks:
+ *       The number of tetriminos locked, and of logic ticks played.
+ *     - cells:
+ *       The number of locks covering each cell, indexed by row from the
+ *       bottom of the well and by column, so that wells of different heights
+ *       line up at the floor.
+ *     - locks, holes, hole_locks:
+ *       Per type of tetrimino (in the order of cell_init_coords): the number
+ *       of locks, the number of holes they created, and the number of locks
+ *       that created any. A hole is an empty cell with a filled cell anywhere
+ *       above it in its column.
+ *     - columns:
+ *       Per type of tetrimino, the number of locks by leftmost column.
+ *     - clears:
+ *       Per level, the number of locks clearing 0, 1, 2, 3 and 4 lines. Levels
+ *       from REPLAY_STATS_LEVELS - 1 up share the last row.
+ * */
+
+#define REPLAY_STATS_LEVELS 30
+
+struct replay_stats {
+	uint64_t games;
+	uint64_t invalid;
+	uint64_t bytes;
+	uint64_t pieces;
+	uint64_t ticks;
+	uint64_t cells[BOARD_MAX_HEIGHT][BOARD_MAX_WIDTH];
+	uint64_t locks[7];
+	uint64_t holes[7];
+	uint64_t hole_locks[7];
+	uint64_t columns[7][BOARD_MAX_WIDTH];
+	uint64_t clears[REPLAY_STATS_LEVELS][5];
+};
+
+/**
+ * Reset every counter.
+ * */
+void replay_stats_init(struct replay_stats *stats);
+
+/**
+ * Play back the replay, adding every lock to the statistics. Returns non-zero,
+ * counting the replay as invalid, if it can't be played back.
+ * */
+int replay_stats_add(struct replay_stats *stats, const struct replay *replay);
+
+/**
+ * Map the replay file at `path`, and add it to the statistics. Returns
+ * non-zero, counting the file as invalid, if it can't be read or isn't a
+ * valid replay.
+ * */
+int replay_stats_add_file(struct replay_stats *stats, const char *path);
+
+/**
+ * Add the counters of `from` to `into`.
+ * */
+void replay_stats_merge(struct replay_stats *into, const struct replay_stats *from);
+
+#endif //TETRIS_REPLAY_STATS_H
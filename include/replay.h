@@ -0,0 +1,133 @@
+#ifndef TETRIS_REPLAY_H
+#define TETRIS_REPLAY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "tetris-game.h"
+
+/**
+ * replay:
+ * Record the inputs of a game so that it can be played back exactly, without
+ * a display and as fast as the game logic allows.
+ *
+ * Since a game is fully determined by its seed, its well dimensions and the
+ * logic tick at which each input was applied, that is all a replay stores.
+ *
+ * file format:
+ * Replays are stored as text, one record per line:
+ * ```
+ * tetris-replay 1
+ * seed <seed>
+ * well <width> <height>
+ * randomizer <name>
+ * <tick> <input>
+ * ...
+ * end <tick>
+ * ```
+ * The `randomizer` record names the randomizer (see randomizer.h), and is
+ * omitted for the default 7-bag randomizer. Input events are listed in the
+ * order they were applied. The `end` record
+ * gives the tick at which the recording stopped, and may be omitted.
+ * */
+
+struct replay_event {
+	unsigned long tick;
+	int input;
+};
+
+struct replay {
+	uint64_t seed;
+	size_t width;
+	size_t height;
+	int randomizer;
+	unsigned long end_tick;
+
+	struct replay_event *events;
+	size_t len;
+	size_t alloc;
+};
+
+/**
+ * Called by replay_run() whenever a frame would be drawn, with the time of the
+ * frame in microseconds since the start of the game.
+ * */
+typedef int (*replay_frame_fn)(void *data, uint64_t usec, struct tetris_game *game);
+
+/**
+ * Steps of a playback at which replay_play() calls back:
+ * - REPLAY_STEP_INPUT: an input was just applied.
+ * - REPLAY_STEP_READY: every input of the current tick was applied, and the
+ *   tick is about to be played, or the playback to end.
+ * - REPLAY_STEP_TICK: a tick was just played.
+ * */
+#define REPLAY_STEP_INPUT 0
+#define REPLAY_STEP_READY 1
+#define REPLAY_STEP_TICK 2
+
+/**
+ * Called by replay_play() at every step of the playback, with one of the
+ * REPLAY_STEP_* values.
+ * */
+typedef int (*replay_step_fn)(void *data, struct tetris_game *game, int step);
+
+/**
+ * Initialize an empty replay for a game with the given seed and dimensions.
+ * */
+void replay_init(struct replay *replay, uint64_t seed, size_t width, size_t height);
+
+/**
+ * Record an input applied to the game after `tick` logic ticks. Returns
+ * non-zero if memory could not be allocated.
+ * */
+int replay_append(struct replay *replay, unsigned long tick, int input);
+
+/**
+ * Write the replay to the given stream. Returns non-zero on error.
+ * */
+int replay_write(const struct replay *replay, FILE *out);
+
+/**
+ * Read a replay from the given stream, initializing `replay`. Returns non-zero
+ * if the stream is not a valid replay.
+ * */
+int replay_read(struct replay *replay, FILE *in);
+
+/**
+ * Parse a replay from `len` bytes of memory, such as a mapped file, like
+ * replay_read(). The data need not be NUL-terminated.
+ * */
+int replay_parse(struct replay *replay, const char *data, size_t len);
+
+/**
+ * Play back the replay from the beginning as fast as possible, leaving the
+ * final state of the game in `game`, and calling `step_fn` at every step of
+ * the playback; a non-zero return value from `step_fn` aborts it.
+ *
+ * Ticks in which nothing can change (see tetris_game_idle_ticks()) are
+ * skipped rather than played one by one, so that a game paused for billions
+ * of ticks plays back as fast as any other, as long as `game->dirty` is
+ * clear: the step function clears it once it has dealt with a change, and
+ * until it does, every tick is played. Returns non-zero if the replay can't
+ * be played back or was aborted.
+ * */
+int replay_play(const struct replay *replay, struct tetris_game *game, replay_step_fn step_fn, void *data);
+
+/**
+ * Play back the replay from the beginning, leaving the final state of the
+ * game in `game`. If `frame_fn` is given, it is called with the game state
+ * for every frame that would be drawn when rendering at most `max_fps` frames
+ * per second (or every change if `max_fps` is zero); a non-zero return value
+ * from `frame_fn` aborts the playback. Returns non-zero if the replay is
+ * invalid or was aborted.
+ * */
+int replay_run(const struct replay *replay, struct tetris_game *game, int max_fps,
+		replay_frame_fn frame_fn, void *data);
+
+/**
+ * Release resources held by the replay.
+ * */
+void replay_release(struct replay *replay);
+
+#endif //TETRIS_REPLAY_H
@@ -0,0 +1,78 @@
+#ifndef TETRIS_ROLLOUT_H
+#define TETRIS_ROLLOUT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "tetris-game.h"
+
+/**
+ * rollout:
+ * Estimate what a position is worth by playing it out many times.
+ *
+ * Each rollout copies the game and places the next `depth` tetriminos with a
+ * simple policy, then records the lines cleared, the points scored and whether
+ * the game survived. The tetriminos already queued in the well are the same
+ * for every rollout, but each rollout gets its own random number stream for
+ * the tetriminos after that (and for the random policy), derived from the seed and the
+ * index of the rollout.
+ *
+ * Rollouts run in parallel threads, in chunks. After each chunk the running
+ * estimates are updated, and once at least `min_rollouts` have run and the
+ * 95% confidence interval of the mean lines cleared is narrower than
+ * `confidence`, the evaluation stops early. Since threads finish their chunks
+ * in no particular order, the number of rollouts in an early stop (and so the
+ * estimates) can vary slightly from run to run; without an early stop, the
+ * results only depend on the seed.
+ *
+ * policies:
+ * - ROLLOUT_POLICY_RANDOM: every reachable placement is equally likely.
+ * - ROLLOUT_POLICY_HEURISTIC: the placement with the best evaluation under
+ *   evaluator_default_weights (see evaluator.h).
+ * */
+
+#define ROLLOUT_POLICY_RANDOM 0
+#define ROLLOUT_POLICY_HEURISTIC 1
+
+struct rollout_options {
+	int policy;
+	int depth;
+	unsigned long min_rollouts;
+	unsigned long max_rollouts;
+	double confidence;
+	int threads;
+	uint64_t seed;
+};
+
+/**
+ * The mean of a measurement over every rollout, and the half width of its 95%
+ * confidence interval.
+ * */
+struct rollout_estimate {
+	double mean;
+	double interval;
+};
+
+struct rollout_result {
+	unsigned long rollouts;
+	struct rollout_estimate lines;
+	struct rollout_estimate score;
+	struct rollout_estimate survival;
+};
+
+/**
+ * Fill in default options: the heuristic policy, 10 tetriminos deep, between
+ * 1000 and 100000 rollouts until the lines are known to within 0.05, and one
+ * thread per core.
+ * */
+void rollout_options_init(struct rollout_options *options);
+
+/**
+ * Run rollouts from the given game, which is left untouched. Returns non-zero
+ * if the rollouts could not be run (the game is already over, or threads or
+ * memory could not be allocated).
+ * */
+int rollout_evaluate(const struct tetris_game *game, const struct rollout_options *options,
+		struct rollout_result *result);
+
+#endif //TETRIS_ROLLOUT_H
@@ -0,0 +1,67 @@
+#ifndef TETRIS_SEARCH_H
+#define TETRIS_SEARCH_H
+
+#include <stddef.h>
+
+#include "tetris-well.h"
+#include "placement.h"
+#include "evaluator.h"
+
+/**
+ * search:
+ * Choose a placement for the current tetrimino by looking ahead through the
+ * tetriminos already queued in the well.
+ *
+ * The search is a beam search: at each level, every placement of the
+ * tetrimino is evaluated on its own (see evaluator.h), and only the `beam`
+ * best are expanded further, by spawning the next queued tetrimino and
+ * placing it in turn. The search goes `depth` tetriminos deep, or until the
+ * queue runs out, whichever comes first, so it only ever relies on what a
+ * player could see, and the same well always gives the same placement. A
+ * line of play is worth the evaluation of the board it ends on, plus the
+ * lines it cleared along the way; lines of play that overflow the well are
+ * worth SEARCH_LOST.
+ *
+ * A search visits up to beam^(depth-1) boards, each costing a call to
+ * tetrimino_placements(), so it is far more expensive than a single
+ * evaluation; see opening-book.h for caching the results.
+ *
+ * usage example:
+ * struct search_options options;
+ * struct placement best;
+ *
+ * search_options_init(&options);
+ * if (!search_best_placement(&well, &options, &best, NULL))
+ *     tetrimino_place(&well, &best);
+ * */
+
+#define SEARCH_MAX_DEPTH 8
+#define SEARCH_MAX_BEAM 16
+#define SEARCH_LOST (-1e9)
+
+struct search_options {
+	int depth;
+	int beam;
+	const struct evaluator_weights *weights;
+	const int *cancel;
+};
+
+/**
+ * Fill in default options: 4 tetriminos deep with a beam of 4, with
+ * evaluator_default_weights, and no way to cancel. If `cancel` is set, the
+ * search gives up as soon as the flag it points to is non-zero; the flag is
+ * read atomically, so another thread may set it.
+ * */
+void search_options_init(struct search_options *options);
+
+/**
+ * Search for the best placement of the current tetrimino of the well, which
+ * is left untouched. If `value` is non-NULL, the value of the best line of
+ * play is stored there. Returns non-zero if the tetrimino has no placements,
+ * the options are out of range, memory could not be allocated, or the search
+ * was cancelled.
+ * */
+int search_best_placement(const struct tetris_well *well, const struct search_options *options,
+		struct placement *best, double *value);
+
+#endif //TETRIS_SEARCH_H
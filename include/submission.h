@@ -0,0 +1,104 @@
+#ifndef TETRIS_SUBMISSION_H
+#define TETRIS_SUBMISSION_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "replay.h"
+
+/**
+ * submission:
+ * A claimed result (score, lines and level) together with the replay of the
+ * game that reached it, and its verification.
+ *
+ * A submission is verified by playing its replay back through the game logic
+ * as fast as it allows, with no display and no clock, and comparing the result
+ * with the claim. Since the score, lines and level of a game only ever grow,
+ * the first tick at which they diverge from the claim is well defined: the
+ * tick at which the game went past a claimed value, or, if the claim is higher
+ * than what the game reached, the tick at which it stopped.
+ *
+ * file format:
+ * A submission is stored as text, a short header followed by the replay (see
+ * replay.h):
+ * ```
+ * tetris-submission 1
+ * score <score>
+ * lines <lines>
+ * level <level>
+ * tetris-replay 1
+ * ...
+ * ```
+ *
+ * verdicts:
+ * - SUBMISSION_ACCEPTED: the replay reaches exactly the claimed result.
+ * - SUBMISSION_INVALID: the submission or its replay can't be parsed, the
+ *   replay can't be played back, or it ends long after the point at which a
+ *   game left alone would have ended on its own.
+ * - SUBMISSION_SCORE, SUBMISSION_LINES, SUBMISSION_LEVEL: the replay doesn't
+ *   reach the claimed result, and this is the first of its values to diverge
+ *   from the claim.
+ * */
+
+#define SUBMISSION_ACCEPTED 0
+#define SUBMISSION_INVALID 1
+#define SUBMISSION_SCORE 2
+#define SUBMISSION_LINES 3
+#define SUBMISSION_LEVEL 4
+
+struct submission {
+	int score;
+	int lines;
+	int level;
+	struct replay replay;
+};
+
+/**
+ * The outcome of a verification: the verdict, the tick at which the replayed
+ * game diverged from the claim (zero if accepted), and the result the replay
+ * actually reached after `ticks` logic ticks.
+ * */
+struct submission_result {
+	int verdict;
+	unsigned long tick;
+	unsigned long ticks;
+	int score;
+	int lines;
+	int level;
+};
+
+/**
+ * Parse a submission from `len` bytes of memory, such as a mapped file,
+ * initializing `submission`. The data need not be NUL-terminated. Returns
+ * non-zero if the data is not a valid submission.
+ * */
+int submission_parse(struct submission *submission, const char *data, size_t len);
+
+/**
+ * Write the submission to the given stream. Returns non-zero on error.
+ * */
+int submission_write(const struct submission *submission, FILE *out);
+
+/**
+ * Play back the replay of the submission and compare the result with the
+ * claim, filling in `result`. Returns the verdict.
+ * */
+int submission_verify(const struct submission *submission, struct submission_result *result);
+
+/**
+ * Map the submission file at `path`, parse and verify it, filling in `result`.
+ * Returns the verdict, SUBMISSION_INVALID if the file can't be read.
+ * */
+int submission_verify_file(const char *path, struct submission_result *result);
+
+/**
+ * The name of the verdict, such as "accepted" or "score".
+ * */
+const char *submission_verdict_name(int verdict);
+
+/**
+ * Release resources held by the submission.
+ * */
+void submission_release(struct submission *submission);
+
+#endif //TETRIS_SUBMISSION_H
@@ -0,0 +1,112 @@
+#ifndef TETRIS_TELEMETRY_H
+#define TETRIS_TELEMETRY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "tetris-game.h"
+
+/**
+ * telemetry:
+ * Record an event for every tetrimino locked into the well, for analytics.
+ *
+ * Each thread that records events gets its own telemetry_buffer, a ring
+ * buffer with a single producer (the thread) and a single consumer (a
+ * background writer thread), so recording an event never takes a lock, never
+ * waits, and never touches the disk. The writer wakes every
+ * TELEMETRY_FLUSH_USEC to write out whatever was recorded as a batch. If the
+ * writer falls so far behind that a buffer fills up, new events are dropped
+ * and counted rather than blocking the game.
+ *
+ * file format:
+ * Events are written as CSV, with a header line:
+ * ```
+ * game,piece,usec,type,x0,y0,x1,y1,x2,y2,x3,y3,lines,lock_usec,score,level
+ * ```
+ * - game: the seed of the game, identifying it among others in the file.
+ * - piece: the number of the tetrimino in the game, from zero.
+ * - usec: the time of the lock, in microseconds since the game started.
+ * - type: the type of the tetrimino, one of I, O, T, S, Z, J or L.
+ * - x0..y3: the cells of the tetrimino, as normalized by placement_normalize().
+ * - lines: the number of lines the lock cleared.
+ * - lock_usec: the game time from spawning the tetrimino to locking it.
+ * - score, level: the score and level after the lock.
+ * */
+
+/**
+ * Events each buffer can hold before it fills up; a power of two.
+ * */
+#define TELEMETRY_BUFFER_EVENTS 1024
+#define TELEMETRY_FLUSH_USEC 100000
+
+struct telemetry_event {
+	uint64_t game;
+	uint64_t usec;
+	uint32_t piece;
+	uint32_t lock_usec;
+	int32_t score;
+	int16_t level;
+	uint8_t type;
+	uint8_t lines;
+	uint8_t cells[4][2];
+};
+
+struct telemetry_buffer {
+	struct telemetry_event events[TELEMETRY_BUFFER_EVENTS];
+	uint64_t head;
+	uint64_t tail;
+	unsigned long dropped;
+	struct telemetry_buffer *next;
+};
+
+/**
+ * A telemetry stream and its writer thread:
+ * - written, dropped: the number of events written to the file, and dropped
+ *   because a buffer was full. Only up to date once the stream is closed.
+ * */
+struct telemetry {
+	FILE *out;
+	pthread_t writer;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	int stop;
+	struct telemetry_buffer *buffers;
+	unsigned long written;
+	unsigned long dropped;
+};
+
+/**
+ * Start a telemetry stream writing to the given file, and its writer thread.
+ * Returns non-zero if the writer could not be started.
+ * */
+int telemetry_open(struct telemetry *telemetry, FILE *out);
+
+/**
+ * Allocate a buffer through which one thread records events to the stream.
+ * Buffers are released when the stream is closed. Returns NULL if the buffer
+ * could not be allocated.
+ * */
+struct telemetry_buffer *telemetry_buffer_open(struct telemetry *telemetry);
+
+/**
+ * Record an event to the buffer without blocking. Returns non-zero if the
+ * buffer was full and the event was dropped.
+ * */
+int telemetry_record(struct telemetry_buffer *buffer, const struct telemetry_event *event);
+
+/**
+ * Fill in an event describing the last tetrimino locked in the game, which
+ * started `usec` microseconds ago with the given seed.
+ * */
+void telemetry_lock_event(struct telemetry_event *event, const struct tetris_game *game,
+		uint64_t seed, uint64_t usec);
+
+/**
+ * Write out every event recorded so far, stop the writer thread and release
+ * the buffers. The file is flushed but not closed. Returns non-zero if any
+ * write failed.
+ * */
+int telemetry_close(struct telemetry *telemetry);
+
+#endif //TETRIS_TELEMETRY_H
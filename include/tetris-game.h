@@ -0,0 +1,163 @@
+#ifndef TETRIS_TETRIS_GAME_H
+#define TETRIS_TETRIS_GAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tetris-well.h"
+#include "placement.h"
+
+/**
+ * tetris-game:
+ * The rules of a game of tetris, independent of any display or clock.
+ *
+ * A game advances in fixed logic ticks of GAME_TICK_USEC microseconds, which
+ * drive gravity, while player inputs are applied between ticks as they
+ * arrive. Since the game never looks at the time itself, the same sequence of
+ * ticks and inputs always produces the same game, however fast it is driven.
+ *
+ * data structures:
+ *   struct tetris_game
+ *     - well:
+ *       The well being played.
+ *     - level, score, lines:
+ *       The current level, score and total number of lines cleared.
+ *     - ticks:
+ *       The number of logic ticks since the game started, paused or not.
+ *     - frames:
+ *       The number of ticks since gravity last shifted the tetrimino down.
+ *     - paused, running:
+ *       Whether the game is paused, and whether it is still in progress.
+ *     - dirty:
+ *       Set whenever the game state visibly changes. The caller clears it once
+ *       the change has been drawn.
+ *     - pieces, spawn_tick:
+ *       The number of tetriminos locked into the well so far, and the tick at
+ *       which the current tetrimino spawned.
+ *     - last_lock:
+ *       The most recently locked tetrimino, valid once `pieces` is non-zero.
+ *       Callers that want to follow every lock can watch `pieces` change.
+ *
+ * basic usage example:
+ * struct tetris_game game;
+ * tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, seed);
+ *
+ * while (game.running) {
+ *     tetris_game_input(&game, next_input());
+ *     tetris_game_tick(&game);
+ * }
+ *
+ * or, with the inputs of each tick gathered up front:
+ * while (tetris_game_step(&game, inputs, count))
+ *     count = next_inputs(inputs);
+ * */
+
+#define INPUT_LEFT 1
+#define INPUT_RIGHT 2
+#define INPUT_DOWN 3
+#define INPUT_ROTATE 4
+#define INPUT_PAUSE 5
+#define INPUT_STOP 6
+#define INPUT_DROP 7
+
+#define GAME_TICK_USEC 20000
+
+/**
+ * A tetrimino locked into the well: its type, the cells it covered (see
+ * placement_normalize()), the number of lines it cleared, and the ticks at
+ * which it spawned and locked.
+ * */
+struct tetris_lock {
+	uint8_t type;
+	struct placement placement;
+	int lines;
+	unsigned long spawn_tick;
+	unsigned long tick;
+};
+
+struct tetris_game {
+	struct tetris_well well;
+	int level;
+	int score;
+	int lines;
+	unsigned long ticks;
+	int frames;
+	int paused;
+	int running;
+	int dirty;
+	unsigned long pieces;
+	unsigned long spawn_tick;
+	struct tetris_lock last_lock;
+};
+
+/**
+ * Initialize a new game in a well of the given dimensions, and spawn the first
+ * tetrimino. The seed fixes the sequence of tetriminos, so that a game can be
+ * replayed from its inputs. Returns non-zero if the dimensions are not
+ * supported.
+ * */
+int tetris_game_init(struct tetris_game *game, size_t width, size_t height, uint64_t seed);
+
+/**
+ * Initialize a new game like tetris_game_init(), but with tetriminos from the
+ * given type of randomizer (see randomizer.h) rather than RANDOMIZER_BAG.
+ * */
+int tetris_game_init_randomizer(struct tetris_game *game, size_t width, size_t height,
+		uint64_t seed, int randomizer);
+
+/**
+ * Apply a single player input (one of INPUT_*) to the game. Zero is ignored.
+ * */
+void tetris_game_input(struct tetris_game *game, int input);
+
+/**
+ * Move the current tetrimino straight to the given placement and commit it,
+ * as if it had been steered there and dropped. Returns non-zero, leaving the
+ * game untouched, if the placement can't be reached by the current tetrimino.
+ * */
+int tetris_game_place(struct tetris_game *game, const struct placement *placement);
+
+/**
+ * Commit a placement like tetris_game_place(), without searching for it again:
+ * for callers holding the placements that tetrimino_placements() just found
+ * for the current tetrimino, which the placement must be one of. Returns
+ * non-zero, leaving the game untouched, if the game is over or paused.
+ * */
+int tetris_game_place_trusted(struct tetris_game *game, const struct placement *placement);
+
+/**
+ * Advance the game by a single logic tick, applying gravity.
+ * */
+void tetris_game_tick(struct tetris_game *game);
+
+/**
+ * Apply the `count` given inputs in order, then advance the game by a single
+ * logic tick: the whole of a tick for callers that drive the game in lockstep,
+ * and the order in which replays apply their inputs. Returns non-zero while
+ * the game is still in progress.
+ * */
+int tetris_game_step(struct tetris_game *game, const int *inputs, size_t count);
+
+/**
+ * Number of upcoming ticks that will change nothing but the tick counters,
+ * so that a caller driven by the clock can sleep through them and catch up
+ * afterwards, as long as it does so before applying the next input. Returns
+ * ULONG_MAX if no tick will change anything until the next input, as when
+ * the game is paused or over.
+ * */
+unsigned long tetris_game_idle_ticks(const struct tetris_game *game);
+
+/**
+ * Play `count` ticks at once, which must all be idle (at most
+ * tetris_game_idle_ticks()), leaving the game as if tetris_game_tick() had
+ * been called `count` times.
+ * */
+void tetris_game_skip_ticks(struct tetris_game *game, unsigned long count);
+
+/**
+ * Number of ticks gravity waits before shifting the tetrimino down a row at
+ * the given level.
+ * */
+int tetris_game_gravity(int level);
+
+#endif //TETRIS_TETRIS_GAME_H
@@ -4,12 +4,16 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#include "randomizer.h"
+
 /**
  * tetris-well:
  * Manipulate the tetris game by creating and manipulating "tetriminos".
  *
  * definitions:
- * - well: the playfield, a 10x24 grid into which the tetriminos fall.
+ * - well: the playfield, a grid into which the tetriminos fall. The standard
+ *   well is 10x24, but any size between BOARD_MIN_WIDTH x BOARD_MIN_HEIGHT
+ *   and BOARD_MAX_WIDTH x BOARD_MAX_HEIGHT may be chosen at initialization.
  * - tetrimino: a "polymino" made up of four square blocks. There are seven types.
  *
  * standard tetrimino types:
@@ -32,12 +36,25 @@
  * data structures:
  *   struct tetris_well
  *     - matrix:
- *       A 10x24 matrix that represents the current state of the well. Each cell
- *       in the matrix describes what type of block lives there.
+ *       A matrix that represents the current state of the well. Each cell
+ *       in the matrix describes what type of block lives there. The matrix is
+ *       always BOARD_MAX_HEIGHT x BOARD_MAX_WIDTH in size, but only the top-left
+ *       `height` rows and `width` columns are part of the well.
+ *     - width, height:
+ *       The dimensions of the well.
  *     - tetrimino_coords:
  *       The coordinates for the current tetrimino.
  *     - tetrimino_type:
  *       The type of the current tetrimino.
+ *     - tetrimino_bag, tetrimino_bag_index:
+ *       The queue of upcoming tetriminos, as indexes into cell_init_coords.
+ *       The queue holds `tetrimino_bag_index` tetriminos, and the next one is
+ *       at the top, `tetrimino_bag[tetrimino_bag_index - 1]`. It is refilled
+ *       from the randomizer seven at a time when it runs out, or topped up by
+ *       tetrimino_preview().
+ *     - randomizer:
+ *       The randomizer that generates the tetriminos (see randomizer.h).
+ *       Wells seeded with the same value produce the same tetriminos.
  *
  * basic usage example:
  * int main(void)
@@ -68,6 +85,17 @@
 #define BOARD_WIDTH 10
 #define BOARD_HEIGHT 24
 
+#define BOARD_MIN_WIDTH 4
+#define BOARD_MIN_HEIGHT 4
+#define BOARD_MAX_WIDTH 16
+#define BOARD_MAX_HEIGHT 128
+
+/**
+ * The longest queue of upcoming tetriminos a well can hold, and so the
+ * furthest that tetrimino_preview() can look ahead.
+ * */
+#define TETRIMINO_QUEUE_MAX 32
+
 #define SHIFT_LEFT 0
 #define SHIFT_RIGHT 1
 #define SHIFT_DOWN 2
@@ -83,12 +111,20 @@
 
 extern const size_t cell_init_coords[7][4][2];
 
+/**
+ * The letters naming the tetriminos, in the order of cell_init_coords.
+ * */
+extern const char tetrimino_names[8];
+
 struct tetris_well {
-	uint8_t matrix[BOARD_HEIGHT][BOARD_WIDTH];
+	uint8_t matrix[BOARD_MAX_HEIGHT][BOARD_MAX_WIDTH];
+	size_t width;
+	size_t height;
 	size_t tetrimino_coords[4][2];
 	uint8_t tetrimino_type;
 	size_t tetrimino_bag_index;
-	size_t tetrimino_bag[7];
+	size_t tetrimino_bag[TETRIMINO_QUEUE_MAX];
+	struct randomizer randomizer;
 };
 
 /**
@@ -100,6 +136,37 @@ struct tetris_well {
  * */
 void tetris_well_init(struct tetris_well *well);
 
+/**
+ * Seed the random number generator of the well, fixing the sequence of
+ * tetriminos produced by tetrimino_new(). Wells are seeded from the clock when
+ * initialized.
+ *
+ * Only the random number generator of the randomizer is reseeded: the
+ * tetriminos already in the queue are kept, as is the rest of the state of the
+ * randomizer (the rest of its current bag, or its history of recent pieces),
+ * so reseeding a well partway through a bag only changes the bags after it.
+ * */
+void tetris_well_seed(struct tetris_well *well, uint64_t seed);
+
+/**
+ * Switch the well to a new randomizer of the given type (see randomizer.h),
+ * seeded with the given value. Any tetriminos in the queue are discarded, so
+ * this is meant to be called before the first tetrimino. Wells use the
+ * RANDOMIZER_BAG randomizer when initialized.
+ * */
+void tetris_well_randomizer(struct tetris_well *well, int type, uint64_t seed);
+
+/**
+ * Initialize the tetris well like tetris_well_init(), but with the given
+ * dimensions rather than the standard BOARD_WIDTH x BOARD_HEIGHT. If the
+ * dimensions are outside of the supported range, the well is left untouched
+ * and this function returns non-zero.
+ *
+ * The matrix is always sized for the largest well, so that wells stay plain
+ * values that can be copied with an assignment whatever their dimensions.
+ * */
+int tetris_well_init_dimensions(struct tetris_well *well, size_t width, size_t height);
+
 /**
  * Add a new random tetrimino to the top of the well. If the new tetrimino
  * overlaps with another on the well, the game cannot continue and this function
@@ -107,6 +174,16 @@ void tetris_well_init(struct tetris_well *well);
  * */
 int tetrimino_new(struct tetris_well *well);
 
+/**
+ * Copy the next `count` tetriminos from the queue to `pieces`, next first,
+ * topping up the queue from the randomizer if it holds too few. At most
+ * TETRIMINO_QUEUE_MAX tetriminos can be previewed; returns the number copied.
+ *
+ * Previewing doesn't change the sequence of tetriminos, only how many of them
+ * have been generated so far.
+ * */
+size_t tetrimino_preview(struct tetris_well *well, size_t *pieces, size_t count);
+
 /**
  * Shift the current tetrimino in the direction given. If the tetrimino cannot be
  * shifted because it reached a wall or boundary, a positive integer is returned.
@@ -131,4 +208,10 @@ int tetrimino_rotate(struct tetris_well *well);
  * */
 int tetris_well_commit_tetrimino(struct tetris_well *well);
 
+/**
+ * The letter naming the tetrimino of the given cell type (see tetrimino_names),
+ * or '-' for an empty cell.
+ * */
+char tetrimino_name(uint8_t type);
+
 #endif //TETRIS_TETRIS_WELL_H
@@ -0,0 +1,85 @@
+#ifndef TETRIS_TIMER_WHEEL_H
+#define TETRIS_TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * timer-wheel:
+ * A hashed timer wheel, for keeping track of the deadlines of many timers at
+ * once without sorting them.
+ *
+ * Time is divided into ticks of TIMER_WHEEL_TICK_USEC, and a timer due at a
+ * given tick is kept in the slot for that tick, modulo TIMER_WHEEL_SLOTS.
+ * Adding and removing a timer takes constant time, and advancing the wheel
+ * only visits the slots for the ticks that passed. Timers due more than a
+ * full turn of the wheel away share a slot with nearer ones, and are simply
+ * passed over until their turn comes.
+ *
+ * Timers are embedded in the structures they belong to, so the wheel never
+ * allocates. A timer fires no earlier than its deadline, and no later than
+ * the end of the tick its deadline falls in, once the wheel is advanced past
+ * it.
+ *
+ * usage example:
+ * struct timer_wheel wheel;
+ * timer_wheel_init(&wheel, now);
+ *
+ * timer_wheel_add(&wheel, &session->timer, now + 20000);
+ *
+ * while (1) {
+ *     wait_for_events(timer_wheel_next(&wheel) - now);
+ *     timer_wheel_advance(&wheel, now, fire, data);
+ * }
+ * */
+
+#define TIMER_WHEEL_TICK_USEC 1000
+#define TIMER_WHEEL_SLOTS 256
+
+struct timer {
+	uint64_t expires;
+	struct timer *next;
+	struct timer **pprev;
+};
+
+struct timer_wheel {
+	uint64_t tick;
+	size_t count;
+	struct timer *slots[TIMER_WHEEL_SLOTS];
+};
+
+/**
+ * Called for each timer that fires. The timer has already been removed from
+ * the wheel, and may be added again.
+ * */
+typedef void (*timer_fn)(void *data, struct timer *timer);
+
+/**
+ * Initialize an empty wheel, starting at the given time in microseconds.
+ * */
+void timer_wheel_init(struct timer_wheel *wheel, uint64_t now);
+
+/**
+ * Arm a timer to fire at the given time in microseconds. The timer must not
+ * already be in a wheel. Timers already due fire on the next advance.
+ * */
+void timer_wheel_add(struct timer_wheel *wheel, struct timer *timer, uint64_t expires);
+
+/**
+ * Disarm a timer, if it is in the wheel.
+ * */
+void timer_wheel_remove(struct timer_wheel *wheel, struct timer *timer);
+
+/**
+ * Fire every timer due at or before the given time, in no particular order.
+ * */
+void timer_wheel_advance(struct timer_wheel *wheel, uint64_t now, timer_fn fn, void *data);
+
+/**
+ * The earliest time at which a timer might be due, or UINT64_MAX if the wheel
+ * is empty. This may be earlier than any timer actually is due, if the
+ * nearest timers are more than a turn of the wheel away.
+ * */
+uint64_t timer_wheel_next(const struct timer_wheel *wheel);
+
+#endif //TETRIS_TIMER_WHEEL_H
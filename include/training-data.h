@@ -0,0 +1,208 @@
+#ifndef TETRIS_TRAINING_DATA_H
+#define TETRIS_TRAINING_DATA_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "tetris-well.h"
+#include "placement.h"
+
+/**
+ * training-data:
+ * Write the decisions of simulated games as records for offline training:
+ * the position, every placement that could have been chosen, the one that
+ * was, and what it earned.
+ *
+ * file format:
+ * A file is a struct training_data_header followed by chunks of up to
+ * `chunk_records` records, all in native byte order. Each chunk is a struct
+ * training_chunk_header holding the number of records `n` in it, followed by
+ * one column after the other, each holding the field of every record in the
+ * chunk:
+ * - game: n x uint64_t, the seed of the game.
+ * - piece: n x uint32_t, the number of the tetrimino in the game, from zero.
+ * - reward: n x int32_t, the points scored by the chosen placement.
+ * - rows: n x height x uint16_t, the occupied cells of the well before the
+ *   placement, one bit plane per row from the top, where bit j is column j.
+ * - candidates_nr: n x uint16_t, the number of candidate placements.
+ * - chosen: n x uint16_t, the index of the chosen placement among them.
+ * - pieces: n x `pieces` x uint8_t, the current tetrimino and then the queued
+ *   ones in the order they come, as indexes into cell_init_coords, padded
+ *   with TRAINING_NO_PIECE.
+ * - lines: n x uint8_t, the lines cleared by the chosen placement.
+ * - done: n x uint8_t, 1 if the game was over after the chosen placement.
+ * - candidates: n x `max_candidates` x struct placement, the reachable
+ *   placements as found by tetrimino_placements(), padded with zeroes.
+ *   Positions with more placements than that keep the first ones, with the
+ *   chosen one in the last slot if it didn't make the cut.
+ *
+ * Every record has the same size, so a column of a chunk is found at an
+ * offset that only depends on `n`, and can be read straight into an array.
+ * Columns are ordered by alignment, and chunks padded to a multiple of eight
+ * bytes, so every column is aligned.
+ *
+ * writing:
+ * Each simulating thread appends records to its own training_stream, which
+ * fills a chunk in memory, column by column, and writes it out in one go once
+ * it's full. With a writer thread, each stream has two chunks: while one is
+ * being written by the writer thread, the other is being filled, so the
+ * simulation only ever waits if the disk falls behind by a whole chunk.
+ *
+ * usage example:
+ * struct training_writer writer;
+ * struct training_stream *stream;
+ *
+ * training_writer_open(&writer, out, &options);
+ * stream = training_stream_open(&writer);
+ * while (playing)
+ *     training_record(stream, &record);
+ * training_writer_close(&writer);
+ * */
+
+#define TRAINING_DATA_MAGIC "tetrisTD"
+#define TRAINING_DATA_VERSION 1
+
+#define TRAINING_NO_PIECE 0xFF
+#define TRAINING_MAX_CANDIDATES 1024
+#define TRAINING_COLUMNS 10
+
+struct training_data_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t pieces;
+	uint32_t max_candidates;
+	uint32_t chunk_records;
+};
+
+/**
+ * The header of a chunk: the number of records in it, and the size of its
+ * columns in bytes, padding included.
+ * */
+struct training_chunk_header {
+	uint32_t records;
+	uint32_t bytes;
+};
+
+/**
+ * Options of a file:
+ * - width, height: dimensions of the well.
+ * - pieces: the number of tetriminos recorded per position, the current one
+ *   included, at most TETRIMINO_QUEUE_MAX + 1.
+ * - max_candidates: the number of candidate placements kept per position, at
+ *   most TRAINING_MAX_CANDIDATES.
+ * - chunk_records: the number of records per chunk.
+ * - writer_thread: whether chunks are written by a writer thread, or by the
+ *   simulating threads themselves.
+ * */
+struct training_options {
+	size_t width;
+	size_t height;
+	size_t pieces;
+	size_t max_candidates;
+	size_t chunk_records;
+	int writer_thread;
+};
+
+/**
+ * A record to append, pointing into the state of the game:
+ * - well: the well before the placement, with the tetrimino to place.
+ * - candidates, candidates_nr, chosen: the reachable placements and the
+ *   index of the one chosen. There must be at least one candidate, and
+ *   `chosen` must be less than `candidates_nr`.
+ * */
+struct training_record {
+	uint64_t game;
+	uint32_t piece;
+	int32_t reward;
+	uint8_t lines;
+	uint8_t done;
+	const struct tetris_well *well;
+	const struct placement *candidates;
+	size_t candidates_nr;
+	size_t chosen;
+};
+
+struct training_chunk {
+	char *data;
+	size_t records;
+};
+
+struct training_writer;
+
+/**
+ * The records of one simulating thread.
+ * - pending: a full chunk handed to the writer thread, or NULL.
+ * */
+struct training_stream {
+	struct training_writer *writer;
+	struct training_chunk chunks[2];
+	struct training_chunk *filling;
+	struct training_chunk *pending;
+	struct training_stream *next;
+};
+
+/**
+ * A file being written, shared by every stream:
+ * - records, bytes: the number of records and bytes written. Only up to date
+ *   once the file is closed.
+ * - failed: set once a write failed; records are dropped from then on.
+ * */
+struct training_writer {
+	FILE *out;
+	struct training_options options;
+	size_t column_size[TRAINING_COLUMNS];
+	size_t column_offset[TRAINING_COLUMNS];
+	size_t chunk_size;
+
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_cond_t written;
+	int stop;
+	struct training_stream *streams;
+
+	unsigned long long records;
+	unsigned long long bytes;
+	int failed;
+};
+
+/**
+ * Fill in default options for a well of the given dimensions: the current
+ * tetrimino and 7 queued ones, up to 64 candidates, chunks of 4096 records,
+ * and a writer thread.
+ * */
+void training_options_init(struct training_options *options, size_t width, size_t height);
+
+/**
+ * Start a file written to `out`, writing its header, and its writer thread
+ * if asked for. Returns non-zero if the options are out of range, or the
+ * header or the thread could not be written or started.
+ * */
+int training_writer_open(struct training_writer *writer, FILE *out, const struct training_options *options);
+
+/**
+ * Allocate a stream through which one thread appends records to the file.
+ * Streams are released when the file is closed. Returns NULL if the stream
+ * could not be allocated.
+ * */
+struct training_stream *training_stream_open(struct training_writer *writer);
+
+/**
+ * Append a record to the stream, writing out its chunk if that fills it.
+ * Returns non-zero if a write failed, or if the record has no candidates or
+ * its chosen placement is not among them, in which case it is not appended.
+ * */
+int training_record(struct training_stream *stream, const struct training_record *record);
+
+/**
+ * Write out every chunk, full or not, stop the writer thread and release the
+ * streams. The file is flushed but not closed. Returns non-zero if any write
+ * failed.
+ * */
+int training_writer_close(struct training_writer *writer);
+
+#endif //TETRIS_TRAINING_DATA_H
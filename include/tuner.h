@@ -0,0 +1,128 @@
+#ifndef TETRIS_TUNER_H
+#define TETRIS_TUNER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "evaluator.h"
+
+/**
+ * tuner:
+ * Tune the weights of the evaluator (see evaluator.h) with a genetic
+ * algorithm.
+ *
+ * The fitness of a set of weights is the mean number of lines it clears over
+ * `games` games of at most `pieces` tetriminos, each placed where the weights
+ * evaluate best. Every candidate of a generation plays the same seeds, so
+ * that they are compared on the same sequences of tetriminos, and every
+ * generation plays new ones, so that the population doesn't fit itself to a
+ * few lucky games. The games of a generation are spread across threads.
+ *
+ * Since scaling every weight by the same positive factor doesn't change which
+ * placement is best, weights are kept as vectors of unit length. Each
+ * generation:
+ * - every candidate is evaluated.
+ * - TUNER_OFFSPRING percent of the population are bred: two parents are the
+ *   fittest of a random tenth of the population each, and the child is the
+ *   average of their weights, weighted by their fitness.
+ * - a child is mutated with a probability of TUNER_MUTATION percent, by
+ *   adding up to `mutation` to a single weight.
+ * - the children replace the least fit candidates.
+ *
+ * Given the same options, tuning always goes the same way, whatever the
+ * number of threads, and a tuner saved between two generations carries on
+ * exactly as if it never stopped.
+ *
+ * checkpoint format:
+ * Tuners are saved as text, one record per line:
+ * ```
+ * tetris-tune 1
+ * seed <seed>
+ * games <games>
+ * pieces <pieces>
+ * mutation <mutation>
+ * generation <generation>
+ * random <state of the random number generator (see randomizer_next())>
+ * candidate <aggregate_height> <holes> <bumpiness> <transitions> <lines>
+ * ...
+ * ```
+ * */
+
+#define TUNER_OFFSPRING 30
+#define TUNER_MUTATION 5
+
+struct tuner_options {
+	size_t population;
+	unsigned long games;
+	unsigned long pieces;
+	int threads;
+	uint64_t seed;
+	double mutation;
+};
+
+/**
+ * A tuner between generations:
+ * - fitness: the fitness of each candidate in the last generation evaluated.
+ * */
+struct tuner {
+	struct tuner_options options;
+	unsigned long generation;
+	uint64_t random;
+	struct evaluator_weights *population;
+	double *fitness;
+};
+
+/**
+ * Fill in default options: a population of 50, playing 20 games of at most
+ * 500 tetriminos per generation, mutations of up to 0.2, and one thread per
+ * core.
+ * */
+void tuner_options_init(struct tuner_options *options);
+
+/**
+ * Start tuning with a random population. Returns non-zero if the options are
+ * out of range, or memory could not be allocated.
+ * */
+int tuner_init(struct tuner *tuner, const struct tuner_options *options);
+
+/**
+ * Evaluate every candidate on the games of the current generation, filling in
+ * `fitness`. Returns non-zero if threads or memory could not be allocated.
+ * */
+int tuner_evaluate(struct tuner *tuner);
+
+/**
+ * Breed the next generation from the fitness of the current one.
+ * */
+void tuner_evolve(struct tuner *tuner);
+
+/**
+ * The index of the fittest candidate of the last generation evaluated.
+ * */
+size_t tuner_best(const struct tuner *tuner);
+
+/**
+ * The number of lines cleared in a single game with the given seed, placing at
+ * most `pieces` tetriminos with the given weights.
+ * */
+unsigned long tuner_play(const struct evaluator_weights *weights, uint64_t seed, unsigned long pieces);
+
+/**
+ * Save the tuner to the given path, replacing any file there in a single
+ * step. Returns non-zero if the file could not be written.
+ * */
+int tuner_save(const struct tuner *tuner, const char *path);
+
+/**
+ * Restore a tuner saved with tuner_save(), to be evaluated with the given
+ * number of threads. Returns non-zero if the file can't be read or isn't a
+ * valid checkpoint.
+ * */
+int tuner_load(struct tuner *tuner, const char *path, int threads);
+
+/**
+ * Release the memory held by the tuner.
+ * */
+void tuner_release(struct tuner *tuner);
+
+#endif //TETRIS_TUNER_H
@@ -0,0 +1,116 @@
+#ifndef TETRIS_WELL_METRICS_H
+#define TETRIS_WELL_METRICS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/**
+ * well-metrics:
+ * Count the operations of the well (see tetris-well.h) as they happen, to find
+ * out which of them games actually spend their time in.
+ *
+ * Counting is compiled in only when TETRIS_WELL_METRICS is defined (configure
+ * with -DTETRIS_WELL_METRICS=ON). Otherwise WELL_METRIC_ADD() expands to
+ * nothing, and the well compiles to the same code as without counters.
+ *
+ * Each thread counts into its own block of counters, with plain loads and
+ * stores rather than atomic read-modify-writes, so threads never contend for
+ * a cache line. Blocks are linked into a list the first time a thread counts
+ * anything, and a thread's counts are folded into a shared total when it
+ * exits. well_metrics_gather() sums up every block on demand.
+ *
+ * Metrics are exported in the Prometheus text format, to a file or to whoever
+ * connects to a Unix socket:
+ * ```
+ * # HELP tetris_well_shifts_total Calls to tetrimino_shift(), by direction.
+ * # TYPE tetris_well_shifts_total counter
+ * tetris_well_shifts_total{direction="left"} 1234
+ * ...
+ * ```
+ * */
+
+#define WELL_METRIC_SHIFTS 0 /* one per direction, indexed by SHIFT_LEFT, SHIFT_RIGHT and SHIFT_DOWN */
+#define WELL_METRIC_ROTATIONS 3
+#define WELL_METRIC_ROTATIONS_BLOCKED 4
+#define WELL_METRIC_OVERLAP_CHECKS 5
+#define WELL_METRIC_COMMITS 6
+#define WELL_METRIC_ROWS_CLEARED 7
+#define WELL_METRIC_BAG_REFILLS 8
+#define WELL_METRICS_NR 9
+
+#ifdef TETRIS_WELL_METRICS
+
+struct well_metrics_block {
+	uint64_t counters[WELL_METRICS_NR];
+	int registered;
+	struct well_metrics_block *prev;
+	struct well_metrics_block *next;
+};
+
+extern __thread struct well_metrics_block well_metrics_local;
+
+void well_metrics_register(void);
+
+#define WELL_METRIC_ADD(metric, n) do { \
+		if (!well_metrics_local.registered) \
+			well_metrics_register(); \
+		__atomic_store_n(&well_metrics_local.counters[metric], \
+				well_metrics_local.counters[metric] + (uint64_t)(n), __ATOMIC_RELAXED); \
+	} while (0)
+
+#else
+
+#define WELL_METRIC_ADD(metric, n) ((void)0)
+
+#endif //TETRIS_WELL_METRICS
+
+/**
+ * A Unix socket serving the metrics from a background thread.
+ * */
+struct well_metrics_server {
+	int listen_fd;
+	int stop_fd;
+	pthread_t thread;
+	char path[108];
+};
+
+/**
+ * Returns non-zero if counting was compiled in.
+ * */
+int well_metrics_enabled(void);
+
+/**
+ * Sum up the counters of every thread, past and present. The sums are all zero
+ * if counting was not compiled in.
+ * */
+void well_metrics_gather(uint64_t counters[WELL_METRICS_NR]);
+
+/**
+ * Write the metrics in the Prometheus text format. Returns non-zero on write
+ * error.
+ * */
+int well_metrics_write(FILE *out);
+
+/**
+ * Write the metrics to the given path, replacing any file there in a single
+ * step, as expected by the textfile collector of the node exporter. Returns
+ * non-zero if the file could not be written.
+ * */
+int well_metrics_save(const char *path);
+
+/**
+ * Serve the metrics on a Unix socket at the given path, until
+ * well_metrics_stop(). Each connection is answered with the metrics and
+ * closed; a connection that sends an HTTP GET request gets an HTTP response,
+ * so that the socket can be scraped directly. Returns non-zero if the socket
+ * or its thread could not be created.
+ * */
+int well_metrics_serve(struct well_metrics_server *server, const char *path);
+
+/**
+ * Stop serving the metrics, and remove the socket.
+ * */
+void well_metrics_stop(struct well_metrics_server *server);
+
+#endif //TETRIS_WELL_METRICS_H
@@ -0,0 +1,351 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "ansi-renderer.h"
+#include "display-engine.h"
+#include "display-colors.h"
+
+/*
+ * Layout of the board on screen (1-based terminal coordinates), matching the
+ * windows created by the curses backend.
+ * */
+#define WELL_TOP 2
+#define WELL_LEFT 2
+#define SCORE_TOP(height) ((height) + 4)
+#define SCORE_ROWS 5
+
+#define ATTRIBUTE_UNKNOWN (-1)
+#define ATTRIBUTE_NONE 0
+#define ATTRIBUTE_HINT 16
+
+#define BOX_HORIZONTAL "\xe2\x94\x80"
+#define BOX_VERTICAL "\xe2\x94\x82"
+#define BOX_TOP_LEFT "\xe2\x94\x8c"
+#define BOX_TOP_RIGHT "\xe2\x94\x90"
+#define BOX_BOTTOM_LEFT "\xe2\x94\x94"
+#define BOX_BOTTOM_RIGHT "\xe2\x94\x98"
+
+static inline void append(struct ansi_renderer *renderer, const char *str, size_t len)
+{
+	assert(renderer->len + len <= renderer->alloc /* frame buffer too small */);
+
+	memcpy(renderer->buffer + renderer->len, str, len);
+	renderer->len += len;
+}
+
+#define append_literal(renderer, str) append((renderer), (str), sizeof(str) - 1)
+
+static inline void append_int(struct ansi_renderer *renderer, int value)
+{
+	char digits[12];
+	size_t i = sizeof(digits);
+	unsigned magnitude = value < 0 ? -(unsigned)value : (unsigned)value;
+
+	do {
+		digits[--i] = (char)('0' + magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude);
+
+	if (value < 0)
+		digits[--i] = '-';
+
+	append(renderer, digits + i, sizeof(digits) - i);
+}
+
+/*
+ * Move the cursor with the shortest sequence available: nothing if it is
+ * already in place, a relative move forward on the same row, or an absolute
+ * move otherwise.
+ * */
+static inline void append_move(struct ansi_renderer *renderer, size_t row, size_t col)
+{
+	if (row == renderer->cursor_row && col == renderer->cursor_col)
+		return;
+
+	if (row == renderer->cursor_row && col > renderer->cursor_col) {
+		size_t distance = col - renderer->cursor_col;
+		append_literal(renderer, "\x1b[");
+		if (distance > 1)
+			append_int(renderer, (int)distance);
+		append_literal(renderer, "C");
+	} else {
+		append_literal(renderer, "\x1b[");
+		append_int(renderer, (int)row);
+		append_literal(renderer, ";");
+		append_int(renderer, (int)col);
+		append_literal(renderer, "H");
+	}
+
+	renderer->cursor_row = row;
+	renderer->cursor_col = col;
+}
+
+/*
+ * Append text that contains no cursor movement of its own, keeping track of
+ * where it leaves the cursor.
+ * */
+static inline void append_text(struct ansi_renderer *renderer, const char *str, size_t len, size_t cols)
+{
+	append(renderer, str, len);
+	renderer->cursor_col += cols;
+}
+
+#define append_text_literal(renderer, str, cols) append_text((renderer), (str), sizeof(str) - 1, (cols))
+
+/*
+ * Attributes are either ATTRIBUTE_NONE for empty cells, the display color plus
+ * one for blocks, drawn in reverse video like the curses color pairs, or the
+ * display color plus ATTRIBUTE_HINT for hints, drawn in the foreground color.
+ * */
+static inline void append_attribute(struct ansi_renderer *renderer, int attribute)
+{
+	if (renderer->attribute == attribute)
+		return;
+
+	if (attribute == ATTRIBUTE_NONE) {
+		append_literal(renderer, "\x1b[0m");
+	} else if (attribute >= ATTRIBUTE_HINT) {
+		append_literal(renderer, "\x1b[0;3");
+		append_int(renderer, attribute - ATTRIBUTE_HINT);
+		append_literal(renderer, "m");
+	} else {
+		append_literal(renderer, "\x1b[0;7;3");
+		append_int(renderer, attribute - 1);
+		append_literal(renderer, ";40m");
+	}
+
+	renderer->attribute = attribute;
+}
+
+static void append_box(struct ansi_renderer *renderer, size_t top, size_t left, size_t rows, size_t cols)
+{
+	append_move(renderer, top, left);
+	append_text_literal(renderer, BOX_TOP_LEFT, 1);
+	for (size_t i = 0; i < cols - 2; i++)
+		append_text_literal(renderer, BOX_HORIZONTAL, 1);
+	append_text_literal(renderer, BOX_TOP_RIGHT, 1);
+
+	for (size_t i = 1; i < rows - 1; i++) {
+		append_move(renderer, top + i, left);
+		append_text_literal(renderer, BOX_VERTICAL, 1);
+		append_move(renderer, top + i, left + cols - 1);
+		append_text_literal(renderer, BOX_VERTICAL, 1);
+	}
+
+	append_move(renderer, top + rows - 1, left);
+	append_text_literal(renderer, BOX_BOTTOM_LEFT, 1);
+	for (size_t i = 0; i < cols - 2; i++)
+		append_text_literal(renderer, BOX_HORIZONTAL, 1);
+	append_text_literal(renderer, BOX_BOTTOM_RIGHT, 1);
+}
+
+/*
+ * Score panel labels are drawn once with the boxes; after that only the value
+ * is rewritten. Values never decrease during a game, so a new value always
+ * covers the old one completely.
+ * */
+#define SCORE_LABEL_COLS 7
+
+static void append_score_value(struct ansi_renderer *renderer, size_t line, int value)
+{
+	append_attribute(renderer, ATTRIBUTE_NONE);
+	append_move(renderer, SCORE_TOP(renderer->height) + 1 + line, WELL_LEFT + 1 + SCORE_LABEL_COLS);
+
+	size_t before = renderer->len;
+	append_int(renderer, value);
+	renderer->cursor_col += renderer->len - before;
+}
+
+int ansi_renderer_init(struct ansi_renderer *renderer, size_t width, size_t height)
+{
+	size_t box_cols = width * 2 + 2;
+
+	/* worst case is a full redraw; budget generously for escape sequences */
+	renderer->alloc = 64
+			+ (height + 2 + SCORE_ROWS) * (box_cols * 3 + 32)
+			+ height * width * 32
+			+ 3 * 64;
+	renderer->buffer = malloc(renderer->alloc);
+	if (!renderer->buffer)
+		return 1;
+
+	renderer->len = 0;
+	renderer->width = width;
+	renderer->height = height;
+
+	ansi_renderer_invalidate(renderer);
+
+	return 0;
+}
+
+void ansi_renderer_invalidate(struct ansi_renderer *renderer)
+{
+	renderer->full_redraw = 1;
+	renderer->attribute = ATTRIBUTE_UNKNOWN;
+	renderer->cursor_row = renderer->cursor_col = 0;
+	renderer->rendered_level = renderer->rendered_score = renderer->rendered_lines = -1;
+}
+
+size_t ansi_renderer_draw(struct ansi_renderer *renderer, struct tetris_well *well, const struct placement *hint,
+		int level, int score, int lines, int flags)
+{
+	uint8_t frame[BOARD_MAX_HEIGHT][BOARD_MAX_WIDTH];
+
+	renderer->len = 0;
+
+	if (renderer->full_redraw) {
+		append_attribute(renderer, ATTRIBUTE_NONE);
+		append_literal(renderer, "\x1b[2J");
+		append_box(renderer, WELL_TOP, WELL_LEFT, renderer->height + 2, renderer->width * 2 + 2);
+		append_box(renderer, SCORE_TOP(renderer->height), WELL_LEFT, SCORE_ROWS, renderer->width * 2 + 2);
+
+		append_move(renderer, SCORE_TOP(renderer->height) + 1, WELL_LEFT + 1);
+		append_text_literal(renderer, "Level: ", SCORE_LABEL_COLS);
+		append_move(renderer, SCORE_TOP(renderer->height) + 2, WELL_LEFT + 1);
+		append_text_literal(renderer, "Score: ", SCORE_LABEL_COLS);
+		append_move(renderer, SCORE_TOP(renderer->height) + 3, WELL_LEFT + 1);
+		append_text_literal(renderer, "Lines: ", SCORE_LABEL_COLS);
+		renderer->full_redraw = 0;
+
+		// the screen was just cleared, so only blocks need to be drawn
+		memset(renderer->rendered_frame, CELL_TYPE_NONE, sizeof(renderer->rendered_frame));
+	}
+
+	for (size_t i = 0; i < renderer->height; i++)
+		memcpy(frame[i], well->matrix[i], sizeof(uint8_t) * renderer->width);
+
+	// overlay the hint where it doesn't cover blocks, then the active tetrimino
+	for (size_t i = 0; hint && well->tetrimino_type != CELL_TYPE_NONE && i < 4; i++) {
+		uint8_t *cell = &frame[hint->coords[i][1]][hint->coords[i][0]];
+		if (*cell == CELL_TYPE_NONE)
+			*cell = CELL_HINT | well->tetrimino_type;
+	}
+
+	for (size_t i = 0; well->tetrimino_type != CELL_TYPE_NONE && i < 4; i++)
+		frame[well->tetrimino_coords[i][1]][well->tetrimino_coords[i][0]] = well->tetrimino_type;
+
+	for (size_t i = 0; i < renderer->height; i++) {
+		for (size_t j = 0; j < renderer->width; j++) {
+			uint8_t cell = frame[i][j];
+			if (cell == renderer->rendered_frame[i][j])
+				continue;
+
+			append_move(renderer, WELL_TOP + 1 + i, WELL_LEFT + 1 + j * 2);
+			if (cell == CELL_TYPE_NONE) {
+				append_attribute(renderer, ATTRIBUTE_NONE);
+				append_text_literal(renderer, "  ", 2);
+			} else if (cell & CELL_HINT) {
+				append_attribute(renderer, cell_type_color(cell & ~CELL_HINT) + ATTRIBUTE_HINT);
+				append_text_literal(renderer, "[]", 2);
+			} else {
+				append_attribute(renderer, cell_type_color(cell) + 1);
+				append_text_literal(renderer, "  ", 2);
+			}
+
+			renderer->rendered_frame[i][j] = cell;
+		}
+	}
+
+	if (flags & DRAW_DEFER_SCORE)
+		return renderer->len;
+
+	if (level != renderer->rendered_level) {
+		append_score_value(renderer, 0, level);
+		renderer->rendered_level = level;
+	}
+
+	if (score != renderer->rendered_score) {
+		append_score_value(renderer, 1, score);
+		renderer->rendered_score = score;
+	}
+
+	if (lines != renderer->rendered_lines) {
+		append_score_value(renderer, 2, lines);
+		renderer->rendered_lines = lines;
+	}
+
+	return renderer->len;
+}
+
+void ansi_renderer_release(struct ansi_renderer *renderer)
+{
+	free(renderer->buffer);
+	renderer->buffer = NULL;
+	renderer->len = renderer->alloc = 0;
+}
+
+size_t ansi_decode_key(const char *buf, size_t len, int *input)
+{
+	*input = 0;
+
+	if (buf[0] != '\x1b') {
+		switch (buf[0]) {
+			case 'a':
+			case 'A':
+				*input = INPUT_LEFT;
+				break;
+			case 's':
+			case 'S':
+				*input = INPUT_DOWN;
+				break;
+			case 'd':
+			case 'D':
+				*input = INPUT_RIGHT;
+				break;
+			case ' ':
+				*input = INPUT_ROTATE;
+				break;
+			case 'p':
+			case 'P':
+				*input = INPUT_PAUSE;
+				break;
+			case 'q':
+			case 'Q':
+				*input = INPUT_STOP;
+				break;
+			case '\r':
+			case '\n':
+				*input = INPUT_DROP;
+				break;
+		}
+
+		return 1;
+	}
+
+	if (len < 2)
+		return 0;
+
+	// CSI (ESC [) and SS3 (ESC O) sequences; a lone ESC is ignored
+	if (buf[1] != '[' && buf[1] != 'O')
+		return 1;
+
+	// skip parameter and intermediate bytes, up to the final byte
+	size_t i = 2;
+	while (i < len && (buf[i] < 0x40 || buf[i] > 0x7E))
+		i++;
+
+	if (i == len)
+		return 0;
+
+	switch (buf[i]) {
+		case 'A':
+			*input = INPUT_ROTATE;
+			break;
+		case 'B':
+			*input = INPUT_DOWN;
+			break;
+		case 'C':
+			*input = INPUT_RIGHT;
+			break;
+		case 'D':
+			*input = INPUT_LEFT;
+			break;
+		case 'M':
+			// keypad enter in application mode
+			*input = buf[1] == 'O' ? INPUT_DROP : 0;
+			break;
+	}
+
+	return i + 1;
+}
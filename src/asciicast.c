@@ -0,0 +1,81 @@
+#include <stdlib.h>
+#include <time.h>
+
+#include "asciicast.h"
+
+/*
+ * Terminal size needed to show the board drawn by the ANSI renderer: the well
+ * and score boxes start on the second row and column, and the score box is
+ * five rows tall.
+ * */
+#define TERMINAL_COLS(width) ((width) * 2 + 4)
+#define TERMINAL_ROWS(height) ((height) + 9)
+
+static const char hex_digits[] = "0123456789abcdef";
+
+int asciicast_recorder_open(struct asciicast_recorder *recorder, FILE *out, size_t width, size_t height)
+{
+	if (ansi_renderer_init(&recorder->renderer, width, height))
+		return 1;
+
+	// worst case, every byte of a frame is a control character escaped as \u00XX
+	recorder->escaped_alloc = recorder->renderer.alloc * 6;
+	recorder->escaped = malloc(recorder->escaped_alloc);
+	if (!recorder->escaped) {
+		ansi_renderer_release(&recorder->renderer);
+		return 1;
+	}
+
+	recorder->out = out;
+	fprintf(out, "{\"version\": 2, \"width\": %zu, \"height\": %zu, \"timestamp\": %ld, "
+			"\"env\": {\"TERM\": \"xterm-256color\"}}\n",
+			TERMINAL_COLS(width), TERMINAL_ROWS(height), (long)time(NULL));
+
+	return ferror(out);
+}
+
+int asciicast_recorder_frame(struct asciicast_recorder *recorder, uint64_t usec,
+		struct tetris_well *well, int level, int score, int lines)
+{
+	size_t len = ansi_renderer_draw(&recorder->renderer, well, NULL, level, score, lines, 0);
+	if (!len)
+		return 0;
+
+	// escape the frame as a JSON string
+	const unsigned char *frame = (const unsigned char *)recorder->renderer.buffer;
+	char *escaped = recorder->escaped;
+	for (size_t i = 0; i < len; i++) {
+		unsigned char c = frame[i];
+
+		if (c == '"' || c == '\\') {
+			*escaped++ = '\\';
+			*escaped++ = (char)c;
+		} else if (c < 0x20) {
+			*escaped++ = '\\';
+			*escaped++ = 'u';
+			*escaped++ = '0';
+			*escaped++ = '0';
+			*escaped++ = hex_digits[c >> 4];
+			*escaped++ = hex_digits[c & 0xF];
+		} else {
+			*escaped++ = (char)c;
+		}
+	}
+
+	fprintf(recorder->out, "[%lu.%06lu, \"o\", \"", (unsigned long)(usec / 1000000), (unsigned long)(usec % 1000000));
+	fwrite(recorder->escaped, 1, (size_t)(escaped - recorder->escaped), recorder->out);
+	fputs("\"]\n", recorder->out);
+
+	return ferror(recorder->out);
+}
+
+int asciicast_recorder_close(struct asciicast_recorder *recorder)
+{
+	int ret = fflush(recorder->out) || ferror(recorder->out);
+
+	free(recorder->escaped);
+	recorder->escaped = NULL;
+	ansi_renderer_release(&recorder->renderer);
+
+	return ret;
+}
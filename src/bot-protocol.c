@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "bot-protocol.h"
+
+int bot_connect(struct bot_connection *bot, const char *address)
+{
+	if (!strcmp(address, "stdio")) {
+		bot->in = stdin;
+		bot->out = stdout;
+		return 0;
+	}
+
+	if (strncmp(address, "unix:", 5) != 0)
+		return 1;
+
+	struct sockaddr_un addr;
+	const char *path = address + 5;
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return 1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return 1;
+
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(fd);
+		return 1;
+	}
+
+	// separate streams for each direction, so that neither buffer gets in the way of the other
+	int out_fd = dup(fd);
+	bot->in = fdopen(fd, "r");
+	bot->out = out_fd < 0 ? NULL : fdopen(out_fd, "w");
+	if (!bot->in || !bot->out) {
+		if (bot->in)
+			fclose(bot->in);
+		else
+			close(fd);
+		if (out_fd >= 0)
+			close(out_fd);
+		return 1;
+	}
+
+	return 0;
+}
+
+int bot_handshake(struct bot_connection *bot, int games, size_t width, size_t height)
+{
+	char line[BOT_LINE_MAX];
+
+	// positions are written a batch at a time, and flushed once per batch
+	setvbuf(bot->out, NULL, _IOFBF, 1 << 16);
+
+	fprintf(bot->out, "tetris-bot %d\n", BOT_PROTOCOL_VERSION);
+	fprintf(bot->out, "games %d well %zu %zu\n", games, width, height);
+	if (fflush(bot->out))
+		return 1;
+
+	if (!fgets(line, sizeof(line), bot->in))
+		return 1;
+
+	return strcmp(line, "ready\n") != 0;
+}
+
+int bot_read_reply(struct bot_connection *bot, char *line, size_t size)
+{
+	if (!fgets(line, (int)size, bot->in))
+		return -1;
+
+	if (strchr(line, '\n'))
+		return 0;
+
+	int c;
+	while ((c = getc(bot->in)) != EOF && c != '\n');
+
+	return 1;
+}
+
+void bot_write_position(FILE *out, int id, const struct tetris_game *game)
+{
+	const struct tetris_well *well = &game->well;
+
+	fprintf(out, "position %d %c ", id, tetrimino_name(well->tetrimino_type));
+
+	if (!well->tetrimino_bag_index)
+		fputc('-', out);
+	for (size_t i = well->tetrimino_bag_index; i > 0; i--)
+		fputc(tetrimino_names[well->tetrimino_bag[i - 1]], out);
+
+	fprintf(out, " %d %d %d", game->level, game->score, game->lines);
+
+	for (size_t i = 0; i < well->height; i++) {
+		unsigned row = 0;
+		for (size_t j = 0; j < well->width; j++) {
+			if (well->matrix[i][j] != CELL_TYPE_NONE)
+				row |= 1u << j;
+		}
+
+		fprintf(out, " %x", row);
+	}
+
+	fputc('\n', out);
+}
+
+int bot_parse_reply(const char *line, const struct tetris_game *game, struct placement *placement)
+{
+	if (!strcmp(line, "quit\n") || !strcmp(line, "quit"))
+		return BOT_REPLY_QUIT;
+
+	if (!strncmp(line, "place ", 6)) {
+		unsigned cells[4][2];
+		char end;
+
+		int ret = sscanf(line + 6, "%u %u %u %u %u %u %u %u %c",
+				&cells[0][0], &cells[0][1], &cells[1][0], &cells[1][1],
+				&cells[2][0], &cells[2][1], &cells[3][0], &cells[3][1], &end);
+		if (ret != 8)
+			return BOT_REPLY_INVALID;
+
+		for (size_t i = 0; i < 4; i++) {
+			if (cells[i][0] >= game->well.width || cells[i][1] >= game->well.height)
+				return BOT_REPLY_INVALID;
+
+			placement->coords[i][0] = (uint8_t)cells[i][0];
+			placement->coords[i][1] = (uint8_t)cells[i][1];
+		}
+
+		return BOT_REPLY_PLACE;
+	}
+
+	if (!strncmp(line, "moves ", 6)) {
+		struct tetris_well well = game->well;
+		const char *moves = line + 6;
+
+		if (*moves == '-')
+			moves++;
+
+		// moves that are blocked are skipped, just like keys pressed against a wall
+		for (; *moves && *moves != '\n'; moves++) {
+			switch (*moves) {
+				case 'l':
+					tetrimino_shift(&well, SHIFT_LEFT);
+					break;
+				case 'r':
+					tetrimino_shift(&well, SHIFT_RIGHT);
+					break;
+				case 'd':
+					tetrimino_shift(&well, SHIFT_DOWN);
+					break;
+				case 'x':
+					tetrimino_rotate(&well);
+					break;
+				default:
+					return BOT_REPLY_INVALID;
+			}
+		}
+
+		while (!tetrimino_shift(&well, SHIFT_DOWN));
+
+		for (size_t i = 0; i < 4; i++) {
+			placement->coords[i][0] = (uint8_t)well.tetrimino_coords[i][0];
+			placement->coords[i][1] = (uint8_t)well.tetrimino_coords[i][1];
+		}
+
+		return BOT_REPLY_PLACE;
+	}
+
+	return BOT_REPLY_INVALID;
+}
+
+void bot_disconnect(struct bot_connection *bot)
+{
+	if (bot->out == stdout) {
+		fflush(stdout);
+		return;
+	}
+
+	fclose(bot->out);
+	fclose(bot->in);
+}
@@ -0,0 +1,150 @@
+#include <unistd.h>
+#include <termios.h>
+#include <poll.h>
+#include <errno.h>
+#include <string.h>
+
+#include "display-engine.h"
+#include "display-backend.h"
+#include "ansi-renderer.h"
+
+/*
+ * How long to wait for the rest of an escape sequence once ESC was read.
+ * */
+#define ESCAPE_TIMEOUT_MS 25
+#define INPUT_BUFFER_SIZE 64
+
+static int ansi_initialize(size_t width, size_t height);
+static int ansi_user_input(int timeout_ms, int wake_fd);
+static size_t ansi_draw_board(struct tetris_well *well, const struct placement *hint, int level, int score, int lines,
+		int flags);
+static void ansi_stop(void);
+
+const struct display_backend ansi_display_backend = {
+		ansi_initialize,
+		ansi_user_input,
+		ansi_draw_board,
+		ansi_stop
+};
+
+static struct ansi_renderer renderer;
+static struct termios original_termios;
+static int termios_saved = 0;
+
+static char input_buffer[INPUT_BUFFER_SIZE];
+static size_t input_len = 0;
+
+static void write_all(const char *buffer, size_t len)
+{
+	while (len) {
+		ssize_t ret = write(STDOUT_FILENO, buffer, len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+
+		buffer += ret;
+		len -= (size_t)ret;
+	}
+}
+
+#define write_literal(str) write_all((str), sizeof(str) - 1)
+
+static int ansi_initialize(size_t width, size_t height)
+{
+	if (ansi_renderer_init(&renderer, width, height))
+		return 1;
+
+	/*
+	 * Like curses cbreak() and noecho(), disable line buffering, echo and
+	 * input translation, but leave signal generation enabled so that ^C
+	 * still interrupts the game.
+	 * */
+	if (!tcgetattr(STDIN_FILENO, &original_termios)) {
+		struct termios raw = original_termios;
+		raw.c_iflag &= ~(tcflag_t)(ICRNL | INLCR | IXON | ISTRIP);
+		raw.c_lflag &= ~(tcflag_t)(ICANON | ECHO | IEXTEN);
+		raw.c_cc[VMIN] = 1;
+		raw.c_cc[VTIME] = 0;
+
+		if (!tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw))
+			termios_saved = 1;
+	}
+
+	// switch to the alternate screen and hide the cursor
+	write_literal("\x1b[?1049h\x1b[?25l");
+
+	input_len = 0;
+
+	return 0;
+}
+
+static int ansi_user_input(int timeout_ms, int wake_fd)
+{
+	int timeout = timeout_ms;
+
+	while (1) {
+		int input = 0;
+		size_t consumed = input_len ? ansi_decode_key(input_buffer, input_len, &input) : 0;
+		if (consumed) {
+			memmove(input_buffer, input_buffer + consumed, input_len - consumed);
+			input_len -= consumed;
+			return input;
+		}
+
+		// give the rest of an incomplete escape sequence a moment to arrive
+		if (input_len)
+			timeout = ESCAPE_TIMEOUT_MS;
+
+		// poll() skips a negative wake_fd
+		struct pollfd fds[2] = { { STDIN_FILENO, POLLIN, 0 }, { wake_fd, POLLIN, 0 } };
+		int ret = poll(fds, 2, timeout);
+		if (ret < 0 && errno == EINTR && input_len)
+			continue;
+
+		// woken up; an incomplete sequence is kept for the next call
+		if (ret > 0 && !fds[0].revents)
+			return 0;
+
+		if (ret <= 0 || input_len == sizeof(input_buffer)) {
+			// treat the incomplete sequence as a lone ESC and drop it
+			if (input_len) {
+				memmove(input_buffer, input_buffer + 1, input_len - 1);
+				input_len--;
+			}
+
+			return 0;
+		}
+
+		ssize_t len = read(STDIN_FILENO, input_buffer + input_len, sizeof(input_buffer) - input_len);
+		if (len < 0)
+			return 0;
+		if (len == 0)
+			return INPUT_STOP;
+
+		input_len += (size_t)len;
+	}
+}
+
+static size_t ansi_draw_board(struct tetris_well *well, const struct placement *hint, int level, int score, int lines,
+		int flags)
+{
+	size_t len = ansi_renderer_draw(&renderer, well, hint, level, score, lines, flags);
+	if (len)
+		write_all(renderer.buffer, len);
+
+	return len;
+}
+
+static void ansi_stop(void)
+{
+	// reset attributes, show the cursor and leave the alternate screen
+	write_literal("\x1b[0m\x1b[?25h\x1b[?1049l");
+
+	if (termios_saved)
+		tcsetattr(STDIN_FILENO, TCSAFLUSH, &original_termios);
+	termios_saved = 0;
+
+	ansi_renderer_release(&renderer);
+}
@@ -0,0 +1,23 @@
+#include <stddef.h>
+
+#include "display-colors.h"
+
+const struct cell_color cell_colors[7] = {
+		{ CELL_TYPE_I, DISPLAY_COLOR_CYAN },
+		{ CELL_TYPE_O, DISPLAY_COLOR_BLUE },
+		{ CELL_TYPE_T, DISPLAY_COLOR_WHITE },
+		{ CELL_TYPE_S, DISPLAY_COLOR_YELLOW },
+		{ CELL_TYPE_Z, DISPLAY_COLOR_GREEN },
+		{ CELL_TYPE_J, DISPLAY_COLOR_MAGENTA },
+		{ CELL_TYPE_L, DISPLAY_COLOR_RED },
+};
+
+short cell_type_color(uint8_t cell_type)
+{
+	for (size_t i = 0; i < 7; i++) {
+		if (cell_colors[i].cell_type == cell_type)
+			return cell_colors[i].color;
+	}
+
+	return DISPLAY_COLOR_BLACK;
+}
@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <ncurses.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include "display-engine.h"
+#include "display-backend.h"
+#include "tetris-well.h"
+
+static WINDOW *well_window;
+static WINDOW *score_window;
+
+/*
+ * Curses writes straight to the terminal's file descriptor, so the bytes sent
+ * for a frame can't be measured; they are estimated instead. Each run of
+ * changed cells costs a cursor move and an attribute change, and each cell
+ * two characters.
+ * */
+#define CURSES_RUN_COST 16
+#define CURSES_CELL_COST 2
+
+/*
+ * The frame most recently drawn to the well window, and the score panel values
+ * most recently printed. Only cells and lines that differ from these are
+ * redrawn. CELL_UNKNOWN is never a valid cell type, and forces a redraw.
+ * */
+#define CELL_UNKNOWN 0xFF
+static uint8_t rendered_frame[BOARD_MAX_HEIGHT][BOARD_MAX_WIDTH];
+static int rendered_level, rendered_score, rendered_lines;
+
+#define ADD_BLOCK(w,x) do { \
+	waddch((w), ' '|A_REVERSE|COLOR_PAIR(x)); \
+	waddch((w), ' '|A_REVERSE|COLOR_PAIR(x)); \
+} while(0)
+#define ADD_HINT(w,x) do { \
+	waddch((w), '['|COLOR_PAIR(x)); \
+	waddch((w), ']'|COLOR_PAIR(x)); \
+} while(0)
+#define ADD_EMPTY(w) do { \
+	waddch((w), ' '); \
+	waddch((w), ' '); \
+} while(0)
+
+static int curses_initialize(size_t width, size_t height);
+static int curses_user_input(int timeout_ms, int wake_fd);
+static size_t curses_draw_board(struct tetris_well *well, const struct placement *hint, int level, int score, int lines,
+		int flags);
+static void curses_stop(void);
+
+const struct display_backend curses_display_backend = {
+		curses_initialize,
+		curses_user_input,
+		curses_draw_board,
+		curses_stop
+};
+
+static int curses_initialize(size_t width, size_t height)
+{
+	initscr();
+
+	cbreak();
+	noecho();
+	keypad(stdscr, TRUE);
+	curs_set(0);
+
+	if (has_colors()) {
+		start_color();
+		for (size_t i = 0; i < 7; i++)
+			init_pair(cell_colors[i].cell_type, cell_colors[i].color, COLOR_BLACK);
+	}
+
+	well_window = newwin(height + 2, width * 2 + 2, 1, 1);
+	box(well_window, 0 , 0);
+	score_window = newwin(5, width * 2 + 2, height + 3, 1);
+	box(score_window, 0 , 0);
+
+	wnoutrefresh(well_window);
+	wnoutrefresh(score_window);
+	doupdate();
+
+	memset(rendered_frame, CELL_UNKNOWN, sizeof(rendered_frame));
+	rendered_level = rendered_score = rendered_lines = -1;
+
+	return 0;
+}
+
+static int curses_user_input(int timeout_ms, int wake_fd)
+{
+	/*
+	 * Curses can only wait for the keyboard, so to wait for wake_fd too, take
+	 * any key curses already holds, or else wait on both descriptors and only
+	 * read a key once stdin is readable.
+	 * */
+	if (wake_fd >= 0) {
+		timeout(0);
+		int key = getch();
+		if (key == ERR) {
+			struct pollfd fds[2] = { { STDIN_FILENO, POLLIN, 0 }, { wake_fd, POLLIN, 0 } };
+			if (poll(fds, 2, timeout_ms) <= 0 || !fds[0].revents)
+				return 0;
+		} else {
+			ungetch(key);
+		}
+
+		timeout_ms = 0;
+	}
+
+	timeout(timeout_ms);
+
+	switch (getch()) {
+		case 'a':
+		case 'A':
+		case KEY_LEFT:
+			return INPUT_LEFT;
+		case 's':
+		case 'S':
+		case KEY_DOWN:
+			return INPUT_DOWN;
+		case 'd':
+		case 'D':
+		case KEY_RIGHT:
+			return INPUT_RIGHT;
+		case ' ':
+		case KEY_UP:
+			return INPUT_ROTATE;
+		case 'p':
+		case 'P':
+			return INPUT_PAUSE;
+		case 'q':
+		case 'Q':
+			return INPUT_STOP;
+		case '\n':
+		case KEY_ENTER:
+			return INPUT_DROP;
+	}
+
+	return 0;
+}
+
+static void curses_stop(void)
+{
+	delwin(well_window);
+	delwin(score_window);
+
+	endwin();
+}
+
+static size_t curses_draw_board(struct tetris_well *well, const struct placement *hint, int level, int score, int lines,
+		int flags)
+{
+	uint8_t frame[BOARD_MAX_HEIGHT][BOARD_MAX_WIDTH];
+	int well_changed = 0, score_changed = 0;
+	size_t bytes = 0;
+
+	for (size_t i = 0; i < well->height; i++)
+		memcpy(frame[i], well->matrix[i], sizeof(uint8_t) * well->width);
+
+	// overlay the hint where it doesn't cover blocks, then the active tetrimino
+	for (size_t i = 0; hint && well->tetrimino_type != CELL_TYPE_NONE && i < 4; i++) {
+		uint8_t *cell = &frame[hint->coords[i][1]][hint->coords[i][0]];
+		if (*cell == CELL_TYPE_NONE)
+			*cell = CELL_HINT | well->tetrimino_type;
+	}
+
+	for (size_t i = 0; well->tetrimino_type != CELL_TYPE_NONE && i < 4; i++)
+		frame[well->tetrimino_coords[i][1]][well->tetrimino_coords[i][0]] = well->tetrimino_type;
+
+	for (size_t i = 0; i < well->height; i++) {
+		int run = 0;
+		for (size_t j = 0; j < well->width; j++) {
+			uint8_t cell = frame[i][j];
+			if (cell == rendered_frame[i][j]) {
+				run = 0;
+				continue;
+			}
+
+			if (!run)
+				bytes += CURSES_RUN_COST;
+			bytes += CURSES_CELL_COST;
+			run = 1;
+
+			wmove(well_window, i + 1, j * 2 + 1);
+			if (cell == CELL_TYPE_NONE)
+				ADD_EMPTY(well_window);
+			else if (cell & CELL_HINT)
+				ADD_HINT(well_window, cell & ~CELL_HINT);
+			else
+				ADD_BLOCK(well_window, cell);
+
+			rendered_frame[i][j] = cell;
+			well_changed = 1;
+		}
+	}
+
+	if (well_changed)
+		wnoutrefresh(well_window);
+
+	if (!(flags & DRAW_DEFER_SCORE)) {
+		if (level != rendered_level) {
+			mvwprintw(score_window, 1, 1, "Level: %d", level);
+			bytes += CURSES_RUN_COST + snprintf(NULL, 0, "Level: %d", level);
+			rendered_level = level;
+			score_changed = 1;
+		}
+
+		if (score != rendered_score) {
+			mvwprintw(score_window, 2, 1, "Score: %d", score);
+			bytes += CURSES_RUN_COST + snprintf(NULL, 0, "Score: %d", score);
+			rendered_score = score;
+			score_changed = 1;
+		}
+
+		if (lines != rendered_lines) {
+			mvwprintw(score_window, 3, 1, "Lines: %d", lines);
+			bytes += CURSES_RUN_COST + snprintf(NULL, 0, "Lines: %d", lines);
+			rendered_lines = lines;
+			score_changed = 1;
+		}
+
+		if (score_changed)
+			wnoutrefresh(score_window);
+	}
+
+	if (well_changed || score_changed)
+		doupdate();
+
+	return bytes;
+}
@@ -0,0 +1,97 @@
+#include "evaluator.h"
+
+/*
+ * These weights are a well known hand tuned set for this choice of features;
+ * they clear lines steadily and rarely top out in a standard well. They
+ * predate transitions, which they leave out.
+ * */
+const struct evaluator_weights evaluator_default_weights = {
+		-0.510066, -0.35663, -0.184483, 0, 0.760666
+};
+
+void evaluator_features(const struct tetris_well *well, struct board_features *features)
+{
+	int previous = 0;
+
+	features->aggregate_height = 0;
+	features->holes = 0;
+	features->bumpiness = 0;
+	features->transitions = 0;
+	features->max_height = 0;
+
+	for (size_t j = 0; j < well->width; j++) {
+		int height = 0;
+
+		for (size_t i = 0; i < well->height; i++) {
+			if (well->matrix[i][j] == CELL_TYPE_NONE) {
+				if (height)
+					features->holes++;
+			} else if (!height) {
+				height = (int)(well->height - i);
+			}
+
+			// the floor below the last row counts as occupied
+			int below = i + 1 == well->height || well->matrix[i + 1][j] != CELL_TYPE_NONE;
+			if (height && below != (well->matrix[i][j] != CELL_TYPE_NONE))
+				features->transitions++;
+		}
+
+		features->aggregate_height += height;
+		if (height > features->max_height)
+			features->max_height = height;
+		if (j)
+			features->bumpiness += height > previous ? height - previous : previous - height;
+
+		previous = height;
+	}
+
+	// the walls on either side count as occupied
+	for (size_t i = well->height - (size_t)features->max_height; i < well->height; i++) {
+		int occupied = 1;
+
+		for (size_t j = 0; j <= well->width; j++) {
+			int cell = j == well->width || well->matrix[i][j] != CELL_TYPE_NONE;
+			if (cell != occupied)
+				features->transitions++;
+			occupied = cell;
+		}
+	}
+}
+
+double evaluator_evaluate(const struct tetris_well *well, int lines,
+		const struct evaluator_weights *weights)
+{
+	struct board_features features;
+	evaluator_features(well, &features);
+
+	return weights->aggregate_height * features.aggregate_height +
+			weights->holes * features.holes +
+			weights->bumpiness * features.bumpiness +
+			weights->transitions * features.transitions +
+			weights->lines * lines;
+}
+
+size_t evaluator_best_placement(const struct tetris_well *well, const struct placement *placements,
+		size_t count, const struct evaluator_weights *weights, double *evaluation)
+{
+	struct tetris_well next;
+	size_t best = count;
+	double best_evaluation = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		next = *well;
+		tetrimino_place(&next, &placements[i]);
+		int lines = tetris_well_commit_tetrimino(&next);
+
+		double value = evaluator_evaluate(&next, lines, weights);
+		if (best == count || value > best_evaluation) {
+			best = i;
+			best_evaluation = value;
+		}
+	}
+
+	if (evaluation)
+		*evaluation = best_evaluation;
+
+	return best;
+}
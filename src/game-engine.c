@@ -1,110 +1,349 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <time.h>
 #include <signal.h>
-#include <unistd.h>
-#include <sys/time.h>
 
 #include "game-engine.h"
 #include "display-engine.h"
+#include "tetris-game.h"
+#include "replay.h"
+#include "asciicast.h"
+#include "bot-protocol.h"
+#include "telemetry.h"
+#include "monotonic-clock.h"
 
-static const int score_chart[] = {0, 40, 100, 300, 1200};
-static const int level_gravity_speeds[] = {
-		48, 43, 38, 33, 28, 23, 18, 13, 8, 6, 5, 5, 5, 4, 4, 4, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1
+/*
+ * The bandwidth budget is a token bucket, refilled at the budgeted rate and
+ * holding up to a quarter second worth of bytes. Frames are drawn only while
+ * the bucket is not in debt, and the score panel is deferred while the bucket
+ * is less than half full.
+ * */
+#define BANDWIDTH_BURST_USEC 250000
+
+struct bandwidth_budget {
+	double rate;
+	double tokens;
+	double burst;
+	uint64_t refilled;
 };
 
-#define update_score(score, level, lines_cleared) (score_chart[lines_cleared > 4 ? 4 : lines_cleared] * (level + 1) + score)
-#define update_level(level, lines_cleared, total_lines_cleared) (level + ((total_lines_cleared) > ((level + 1) * 10) ? 1 : 0))
+static void bandwidth_budget_refill(struct bandwidth_budget *budget, uint64_t now);
+static uint64_t bandwidth_budget_wait(struct bandwidth_budget *budget, double tokens);
+static void record_lock(struct telemetry_buffer *events, const struct tetris_game *game,
+		uint64_t seed, uint64_t usec, unsigned long *locked);
+
+/*
+ * Logic and rendering run on separate schedules. Logic ticks are due every
+ * GAME_TICK_USEC, but the loop only wakes up for the ticks that change
+ * something (see tetris_game_idle_ticks()), and never while paused; the ticks
+ * in between, and any missed while the loop was busy, are caught up as soon
+ * as it wakes up so that gravity never slows down. Frames are only drawn when
+ * the game state changed, and at most once per frame interval; if drawing
+ * falls behind, intermediate states are merged into the next frame rather
+ * than drawn one after the other.
+ * */
+int start_game(const struct game_options *options, int *level, int *lines_cleared, struct game_stats *stats)
+{
+	struct tetris_game game;
+	struct replay replay;
+	struct asciicast_recorder recorder;
+	struct bandwidth_budget budget;
+	struct game_stats session = { 0, 0, 0, 0, 0, 0, 0 };
+	struct telemetry telemetry;
+	struct telemetry_buffer *events = NULL;
+	unsigned long locked = 0;
+	unsigned long posted = ULONG_MAX, shown = ULONG_MAX;
+	struct hint hint, latest;
+	uint64_t frame_interval = options->max_fps > 0 ? 1000000 / (uint64_t)options->max_fps : 0;
+	int drawn_level = -1, drawn_score = -1, drawn_lines = -1;
+
+	*level = 0;
+	*lines_cleared = 0;
+
+	uint64_t now = monotonic_usec();
+	uint64_t seed = now ^ ((uint64_t)time(NULL) << 32);
+	if (tetris_game_init_randomizer(&game, options->width, options->height, seed, options->randomizer))
+		return 0;
+
+	replay_init(&replay, seed, options->width, options->height);
+	replay.randomizer = options->randomizer;
+
+	int recording = options->asciicast &&
+			!asciicast_recorder_open(&recorder, options->asciicast, options->width, options->height);
+
+	int reporting = options->telemetry && !telemetry_open(&telemetry, options->telemetry);
+	if (reporting)
+		events = telemetry_buffer_open(&telemetry);
+
+	uint64_t start = now;
+	uint64_t next_tick = now + GAME_TICK_USEC;
+	uint64_t next_frame = now;
+
+	budget.rate = (double)options->max_bandwidth;
+	budget.burst = budget.rate * BANDWIDTH_BURST_USEC / 1e6;
+	budget.tokens = budget.burst;
+	budget.refilled = now;
+
+	while (game.running) {
+		// the hint engine starts on a tetrimino as soon as it spawns
+		if (options->hints && game.pieces != posted) {
+			hint_engine_post(options->hints, &game.well, game.pieces);
+			posted = game.pieces;
+		}
+
+		// sleep through the ticks in which nothing happens, and indefinitely while paused
+		uint64_t deadline = UINT64_MAX;
+		unsigned long idle = tetris_game_idle_ticks(&game);
+		if (idle != ULONG_MAX)
+			deadline = next_tick + (uint64_t)idle * GAME_TICK_USEC;
+		if (game.dirty && next_frame < deadline)
+			deadline = next_frame;
+
+		// while the hint for the current tetrimino is outstanding, its publication wakes the loop too
+		int wake_fd = options->hints && shown != game.pieces && !game.paused ? options->hints->published_fd : -1;
+
+		int timeout_ms = deadline == UINT64_MAX ? -1 : deadline > now ? (int)((deadline - now + 999) / 1000) : 0;
+		int input = user_input(timeout_ms, wake_fd);
+		session.wakeups++;
+
+		// catch up on the ticks slept through, so that the input lands on the tick it arrived in
+		now = monotonic_usec();
+		while (now >= next_tick) {
+			tetris_game_tick(&game);
+			if (events && game.pieces != locked)
+				record_lock(events, &game, seed, now - start, &locked);
+			next_tick += GAME_TICK_USEC;
+		}
+
+		if (input) {
+			if (options->replay)
+				replay_append(&replay, game.ticks, input);
+
+			tetris_game_input(&game, input);
+			if (events && game.pieces != locked)
+				record_lock(events, &game, seed, now - start, &locked);
+		}
+
+		// a hint for an earlier tetrimino, or a torn read, is simply picked up later
+		if (options->hints && shown != game.pieces && !hint_engine_read(options->hints, &latest) &&
+				latest.piece == game.pieces) {
+			hint = latest;
+			shown = game.pieces;
+			game.dirty |= hint.has_current;
+		}
+
+		if (game.dirty && now >= next_frame) {
+			int flags = 0;
+
+			if (options->max_bandwidth) {
+				bandwidth_budget_refill(&budget, now);
+
+				// over budget; merge this frame into a later one
+				if (budget.tokens < 0) {
+					session.merged_frames++;
+					next_frame = now + bandwidth_budget_wait(&budget, 0);
+					continue;
+				}
+
+				if (budget.tokens < budget.burst / 2)
+					flags |= DRAW_DEFER_SCORE;
+			}
+
+			const struct placement *overlay = shown == game.pieces && hint.has_current ? &hint.current : NULL;
+			size_t bytes = draw_board(&game.well, overlay, game.level, game.score, game.lines, flags);
+			if (recording)
+				asciicast_recorder_frame(&recorder, now - start, &game.well, game.level, game.score, game.lines);
+
+			session.frames++;
+			session.bytes += bytes;
+			budget.tokens -= (double)bytes;
+
+			now = monotonic_usec();
+			next_frame += frame_interval;
+			if (next_frame < now)
+				next_frame = now + frame_interval;
+
+			if (!(flags & DRAW_DEFER_SCORE)) {
+				drawn_level = game.level;
+				drawn_score = game.score;
+				drawn_lines = game.lines;
+			}
+
+			/*
+			 * A deferred score panel keeps the game dirty, to be drawn once the
+			 * budget recovers enough.
+			 * */
+			game.dirty = drawn_level != game.level || drawn_score != game.score || drawn_lines != game.lines;
+			if (game.dirty) {
+				uint64_t recovered = now + bandwidth_budget_wait(&budget, budget.burst / 2);
+				if (next_frame < recovered)
+					next_frame = recovered;
+			}
+		}
+	}
+
+	if (recording)
+		asciicast_recorder_close(&recorder);
 
-static struct tetris_well well;
-static int game_running = 1, paused = 0;
-static int drop = 0;
-static int frames = 0;
-static int *level_ptr = NULL;
+	if (reporting) {
+		telemetry_close(&telemetry);
+		session.telemetry_events = telemetry.written;
+		session.telemetry_dropped = telemetry.dropped;
+	}
 
-struct itimerval timer;
+	if (options->replay) {
+		replay.end_tick = game.ticks;
+		replay_write(&replay, options->replay);
+	}
+	replay_release(&replay);
 
-static void alarm_sig_handler(int sig);
+	session.usec = monotonic_usec() - start;
+	*level = game.level;
+	*lines_cleared = game.lines;
+	if (stats)
+		*stats = session;
 
-int start_game(int *level, int *lines_cleared)
+	return game.score;
+}
+
+/*
+ * Each turn, the positions of every game still in progress are sent in a
+ * single batch and flushed once, and the answers are read back in order.
+ * */
+int start_bot_games(const char *address, size_t width, size_t height,
+		struct tetris_game *games, int games_nr, struct bot_stats *stats)
 {
-	int score = 0;
+	struct bot_connection bot;
+	char line[BOT_LINE_MAX];
+	int ret = 0;
 
-	level_ptr = level;
-	*level = 0;
-	*lines_cleared = 0;
+	memset(stats, 0, sizeof(*stats));
 
-	tetris_well_init(&well);
-	tetrimino_new(&well);
-
-	signal(SIGALRM, alarm_sig_handler);
-	timer.it_value.tv_sec = 0;
-	timer.it_value.tv_usec = 20000;
-	timer.it_interval.tv_sec = 0;
-	timer.it_interval.tv_usec = 20000;
-	setitimer(ITIMER_REAL, &timer, NULL);
-
-	while (game_running) {
-		switch (user_input()) {
-			case INPUT_RIGHT:
-				if (!paused)
-					tetrimino_shift(&well, SHIFT_RIGHT);
-				break;
-			case INPUT_LEFT:
-				if (!paused)
-					tetrimino_shift(&well, SHIFT_LEFT);
-				break;
-			case INPUT_DOWN:
-				if (!paused)
-					drop = 1;
-				break;
-			case INPUT_ROTATE:
-				if (!paused)
-					tetrimino_rotate(&well);
-				break;
-			case INPUT_DROP:
-				while (!tetrimino_shift(&well, SHIFT_DOWN));
-				drop = 1;
-				break;
-			case INPUT_PAUSE:
-				paused = !paused;
-				break;
-			case INPUT_STOP:
-				game_running = 0;
+	// a bot that goes away should end the games, not the process
+	signal(SIGPIPE, SIG_IGN);
+
+	uint64_t seed = monotonic_usec() ^ ((uint64_t)time(NULL) << 32);
+	for (int i = 0; i < games_nr; i++) {
+		if (tetris_game_init(&games[i], width, height, seed + (uint64_t)i))
+			return 1;
+	}
+
+	if (bot_connect(&bot, address))
+		return 1;
+
+	if (bot_handshake(&bot, games_nr, width, height)) {
+		bot_disconnect(&bot);
+		return 1;
+	}
+
+	int *reported = calloc((size_t)games_nr, sizeof(int));
+	if (!reported) {
+		bot_disconnect(&bot);
+		return 1;
+	}
+
+	while (1) {
+		int running = 0;
+		for (int i = 0; i < games_nr; i++) {
+			if (games[i].running) {
+				running++;
+			} else if (!reported[i]) {
+				fprintf(bot.out, "gameover %d %d %d %d\n", i, games[i].level, games[i].score, games[i].lines);
+				reported[i] = 1;
+			}
+		}
+
+		if (!running)
+			break;
+
+		fprintf(bot.out, "batch %d\n", running);
+		for (int i = 0; i < games_nr; i++) {
+			if (games[i].running)
+				bot_write_position(bot.out, i, &games[i]);
+		}
+
+		uint64_t start = monotonic_usec();
+		if (fflush(bot.out)) {
+			ret = 1;
+			break;
 		}
 
-		if (drop && !paused) {
-			if (tetrimino_shift(&well, SHIFT_DOWN) < 0) {
-				int lines = tetris_well_commit_tetrimino(&well);
-				*lines_cleared = *lines_cleared + lines;
-				score = update_score(score, *level, lines);
-				*level = update_level(*level, lines, *lines_cleared);
+		for (int i = 0; i < games_nr && !ret; i++) {
+			struct placement placement;
+
+			if (!games[i].running)
+				continue;
 
-				if (tetrimino_new(&well))
-					game_running = 0;
+			int read = bot_read_reply(&bot, line, sizeof(line));
+			if (read < 0) {
+				ret = 1;
+				break;
 			}
 
-			drop = 0;
+			// the round trip of a move runs from the flush of its batch to its answer
+			uint64_t elapsed = monotonic_usec() - start;
+			if (!stats->moves || elapsed < stats->min_usec)
+				stats->min_usec = elapsed;
+			if (elapsed > stats->max_usec)
+				stats->max_usec = elapsed;
+			stats->total_usec += elapsed;
+			stats->moves++;
+
+			// a bot that gives up or breaks the rules loses the game
+			if (read || bot_parse_reply(line, &games[i], &placement) != BOT_REPLY_PLACE ||
+					tetris_game_place(&games[i], &placement))
+				games[i].running = 0;
 		}
 
-		draw_board(&well, *level, score, *lines_cleared);
+		if (ret)
+			break;
+
+		stats->batches++;
 	}
 
-	timer.it_interval.tv_sec = 0;
-	timer.it_interval.tv_usec = 0;
+	if (!ret) {
+		fprintf(bot.out, "done\n");
+		fflush(bot.out);
+	}
+
+	free(reported);
+	bot_disconnect(&bot);
 
-	return score;
+	return ret;
 }
 
+static void bandwidth_budget_refill(struct bandwidth_budget *budget, uint64_t now)
+{
+	budget->tokens += (double)(now - budget->refilled) * budget->rate / 1e6;
+	if (budget->tokens > budget->burst)
+		budget->tokens = budget->burst;
+
+	budget->refilled = now;
+}
 
-static void alarm_sig_handler(int sig)
+/*
+ * Microseconds until the budget refills to the given number of tokens.
+ * */
+static uint64_t bandwidth_budget_wait(struct bandwidth_budget *budget, double tokens)
 {
-	(void)sig;
+	if (budget->tokens >= tokens)
+		return 0;
 
-	int apparent_level = *level_ptr > 29 ? 29 : *level_ptr;
-	int gravity = level_gravity_speeds[apparent_level];
-	if (!paused)
-		frames++;
+	return (uint64_t)((tokens - budget->tokens) * 1e6 / budget->rate) + 1;
+}
 
-	if (frames > gravity) {
-		frames = 0;
-		drop = 1;
-	}
+/*
+ * Record a telemetry event for the tetrimino that just locked. This only
+ * copies the event into the buffer; the writer thread does the rest.
+ * */
+static void record_lock(struct telemetry_buffer *events, const struct tetris_game *game,
+		uint64_t seed, uint64_t usec, unsigned long *locked)
+{
+	struct telemetry_event event;
+
+	telemetry_lock_event(&event, game, seed, usec);
+	telemetry_record(events, &event);
+	*locked = game->pieces;
 }
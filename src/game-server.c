@@ -0,0 +1,706 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "game-server.h"
+#include "game-engine.h"
+#include "tetris-game.h"
+#include "ansi-renderer.h"
+#include "randomizer.h"
+#include "timer-wheel.h"
+#include "monotonic-clock.h"
+
+#define SERVER_EVENTS 64
+#define SERVER_ACCEPT_BATCH 16
+#define SERVER_BACKLOG 128
+
+/*
+ * Room for the last words to a client (restoring its terminal and the final
+ * score), on top of an unsent frame.
+ * */
+#define SESSION_MESSAGE_MAX 256
+#define SESSION_INPUT_SIZE 64
+
+/*
+ * How long a finished session waits for the client to read its last words
+ * before the connection is closed anyway.
+ * */
+#define SESSION_LINGER_USEC 1000000
+
+/*
+ * Telnet commands, for negotiating character at a time input (RFC 854, 857
+ * and 858).
+ * */
+#define TELNET_IAC 255
+#define TELNET_SB 250
+#define TELNET_SE 240
+#define TELNET_WILL 251
+#define TELNET_DONT 254
+
+#define SESSION_GREETING "\xff\xfb\x01\xff\xfb\x03\x1b[?1049h\x1b[?25l"
+#define SESSION_RESTORE "\x1b[0m\x1b[?25h\x1b[?1049l"
+#define SESSION_FULL "The server is full, try again later.\r\n"
+#define SESSION_SHUTDOWN SESSION_RESTORE "The server is shutting down.\r\n"
+
+#define container_of(ptr, type, member) ((type *)((char *)(ptr) - offsetof(type, member)))
+
+struct session {
+	int fd;
+	struct server_worker *worker;
+	struct session *prev;
+	struct session *next;
+
+	struct tetris_game game;
+	struct ansi_renderer renderer;
+	struct timer timer;
+	uint64_t next_tick;
+	uint64_t next_frame;
+	int closing;
+	int after_cr;
+
+	char input[SESSION_INPUT_SIZE];
+	size_t input_len;
+
+	char *output;
+	size_t output_off;
+	size_t output_len;
+	size_t output_alloc;
+};
+
+struct server_worker {
+	struct game_server *server;
+	pthread_t thread;
+	int epoll_fd;
+	struct timer_wheel wheel;
+	struct session *sessions;
+	struct server_stats stats;
+};
+
+static int server_listen(struct game_server *server, const char *address);
+static void *worker_main(void *data);
+static void worker_accept(struct server_worker *worker);
+static void session_open(struct server_worker *worker, int fd, uint64_t now);
+static void session_event(struct session *session, uint32_t events);
+static void session_timer(void *data, struct timer *timer);
+static void session_update(struct session *session, uint64_t now);
+static void session_catch_up(struct session *session, uint64_t now);
+static void session_read(struct session *session);
+static int session_send(struct session *session, const char *buffer, size_t len);
+static int session_flush(struct session *session);
+static void session_finish(struct session *session, uint64_t now);
+static void session_close(struct session *session);
+static size_t skip_telnet(const unsigned char *buf, size_t len);
+
+void server_options_init(struct server_options *options)
+{
+	options->address = NULL;
+	options->workers = SERVER_DEFAULT_WORKERS;
+	options->max_fps = GAME_DEFAULT_FPS;
+	options->width = BOARD_WIDTH;
+	options->height = BOARD_HEIGHT;
+	options->randomizer = RANDOMIZER_BAG;
+	options->max_sessions = SERVER_DEFAULT_MAX_SESSIONS;
+}
+
+int server_open(struct game_server *server, const struct server_options *options)
+{
+	memset(server, 0, sizeof(*server));
+	server->options = *options;
+	server->listen_fd = -1;
+	server->stop_fd = -1;
+
+	if (options->workers < 1 || !options->address)
+		return 1;
+
+	if (server_listen(server, options->address))
+		return 1;
+
+	server->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	server->workers = calloc((size_t)options->workers, sizeof(struct server_worker));
+	if (server->stop_fd < 0 || !server->workers) {
+		server_stop(server);
+		return 1;
+	}
+
+	uint64_t now = monotonic_usec();
+	server->started = now;
+	for (; server->workers_nr < options->workers; server->workers_nr++) {
+		struct server_worker *worker = &server->workers[server->workers_nr];
+		worker->server = server;
+		timer_wheel_init(&worker->wheel, now);
+
+		// only one worker wakes up for a new connection; every worker wakes up to stop
+		struct epoll_event listen_event = { EPOLLIN | EPOLLEXCLUSIVE, { .ptr = &server->listen_fd } };
+		struct epoll_event stop_event = { EPOLLIN, { .ptr = &server->stop_fd } };
+
+		worker->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		if (worker->epoll_fd < 0 ||
+				epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &listen_event) ||
+				epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, server->stop_fd, &stop_event) ||
+				pthread_create(&worker->thread, NULL, worker_main, worker)) {
+			if (worker->epoll_fd >= 0)
+				close(worker->epoll_fd);
+			server_stop(server);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+void server_stop(struct game_server *server)
+{
+	if (server->stop_fd >= 0) {
+		uint64_t one = 1;
+		if (write(server->stop_fd, &one, sizeof(one)) < 0)
+			perror("eventfd");
+	}
+
+	for (int i = 0; i < server->workers_nr; i++) {
+		struct server_worker *worker = &server->workers[i];
+		pthread_join(worker->thread, NULL);
+
+		// leave the terminals of the remaining clients as they were, if they take it
+		while (worker->sessions) {
+			send(worker->sessions->fd, SESSION_SHUTDOWN, sizeof(SESSION_SHUTDOWN) - 1, MSG_NOSIGNAL);
+			session_close(worker->sessions);
+		}
+		close(worker->epoll_fd);
+
+		server->stats.sessions += worker->stats.sessions;
+		server->stats.rejected += worker->stats.rejected;
+		server->stats.frames += worker->stats.frames;
+		server->stats.bytes += worker->stats.bytes;
+		server->stats.wakeups += worker->stats.wakeups;
+	}
+
+	if (server->started)
+		server->stats.usec = monotonic_usec() - server->started;
+
+	if (server->listen_fd >= 0)
+		close(server->listen_fd);
+	if (server->stop_fd >= 0)
+		close(server->stop_fd);
+	if (server->unix_path[0])
+		unlink(server->unix_path);
+
+	free(server->workers);
+	server->workers = NULL;
+	server->workers_nr = 0;
+	server->listen_fd = server->stop_fd = -1;
+	server->unix_path[0] = '\0';
+}
+
+static int server_listen(struct game_server *server, const char *address)
+{
+	int fd = -1;
+
+	if (!strncmp(address, "unix:", 5)) {
+		struct sockaddr_un addr;
+		const char *path = address + 5;
+		if (!*path || strlen(path) >= sizeof(addr.sun_path))
+			return 1;
+
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		strcpy(addr.sun_path, path);
+
+		fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (fd < 0)
+			return 1;
+		if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+			close(fd);
+			return 1;
+		}
+
+		strcpy(server->unix_path, path);
+	} else if (!strncmp(address, "tcp:", 4)) {
+		char host[256];
+		const char *port = strrchr(address, ':') + 1;
+		size_t host_len = (size_t)(port - 1 - (address + 4));
+		if (!*port || host_len >= sizeof(host))
+			return 1;
+
+		memcpy(host, address + 4, host_len);
+		host[host_len] = '\0';
+
+		struct addrinfo hints, *addrs;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_flags = AI_PASSIVE;
+		if (getaddrinfo(host_len ? host : NULL, port, &hints, &addrs))
+			return 1;
+
+		for (struct addrinfo *ai = addrs; ai; ai = ai->ai_next) {
+			fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+			if (fd < 0)
+				continue;
+
+			int one = 1;
+			setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+			if (!bind(fd, ai->ai_addr, ai->ai_addrlen))
+				break;
+
+			close(fd);
+			fd = -1;
+		}
+
+		freeaddrinfo(addrs);
+		if (fd < 0)
+			return 1;
+	} else {
+		return 1;
+	}
+
+	if (listen(fd, SERVER_BACKLOG) < 0) {
+		close(fd);
+		if (server->unix_path[0])
+			unlink(server->unix_path);
+		server->unix_path[0] = '\0';
+		return 1;
+	}
+
+	server->listen_fd = fd;
+	return 0;
+}
+
+static void *worker_main(void *data)
+{
+	struct server_worker *worker = data;
+	struct game_server *server = worker->server;
+	struct epoll_event events[SERVER_EVENTS];
+
+	while (1) {
+		uint64_t now = monotonic_usec();
+		timer_wheel_advance(&worker->wheel, now, session_timer, worker);
+
+		int timeout = -1;
+		uint64_t next = timer_wheel_next(&worker->wheel);
+		if (next != UINT64_MAX) {
+			now = monotonic_usec();
+			timeout = next <= now ? 0 : (int)((next - now + 999) / 1000);
+		}
+
+		int count = epoll_wait(worker->epoll_fd, events, SERVER_EVENTS, timeout);
+		worker->stats.wakeups++;
+		if (count < 0 && errno != EINTR)
+			break;
+
+		for (int i = 0; i < count; i++) {
+			void *ptr = events[i].data.ptr;
+
+			if (ptr == &server->stop_fd)
+				return NULL;
+
+			if (ptr == &server->listen_fd)
+				worker_accept(worker);
+			else
+				session_event(ptr, events[i].events);
+		}
+	}
+
+	return NULL;
+}
+
+static void worker_accept(struct server_worker *worker)
+{
+	struct game_server *server = worker->server;
+
+	for (int i = 0; i < SERVER_ACCEPT_BATCH; i++) {
+		int fd = accept(server->listen_fd, NULL, NULL);
+		if (fd < 0)
+			return;
+
+		if (fcntl(fd, F_SETFL, O_NONBLOCK) || fcntl(fd, F_SETFD, FD_CLOEXEC)) {
+			close(fd);
+			continue;
+		}
+
+		unsigned long active = __atomic_add_fetch(&server->active_sessions, 1, __ATOMIC_RELAXED);
+		if (active > server->options.max_sessions) {
+			__atomic_sub_fetch(&server->active_sessions, 1, __ATOMIC_RELAXED);
+			if (send(fd, SESSION_FULL, sizeof(SESSION_FULL) - 1, MSG_NOSIGNAL) < 0)
+				errno = 0;
+			close(fd);
+			worker->stats.rejected++;
+			continue;
+		}
+
+		unsigned long peak = __atomic_load_n(&server->stats.peak_sessions, __ATOMIC_RELAXED);
+		while (active > peak && !__atomic_compare_exchange_n(&server->stats.peak_sessions, &peak, active,
+				1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+		session_open(worker, fd, monotonic_usec());
+	}
+}
+
+static void session_open(struct server_worker *worker, int fd, uint64_t now)
+{
+	struct game_server *server = worker->server;
+	struct session *session = calloc(1, sizeof(*session));
+
+	if (!session || ansi_renderer_init(&session->renderer, server->options.width, server->options.height)) {
+		free(session);
+		close(fd);
+		__atomic_sub_fetch(&server->active_sessions, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	// a frame that couldn't be sent, and the last words that may follow it
+	session->output_alloc = session->renderer.alloc + SESSION_MESSAGE_MAX;
+	session->output = malloc(session->output_alloc);
+
+	uint64_t seed = now ^ ((uint64_t)time(NULL) << 32) ^ ((uint64_t)(uintptr_t)session << 16);
+	struct epoll_event event = { EPOLLIN, { .ptr = session } };
+	if (!session->output || tetris_game_init_randomizer(&session->game, server->options.width,
+			server->options.height, seed, server->options.randomizer) ||
+			epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, fd, &event)) {
+		ansi_renderer_release(&session->renderer);
+		free(session->output);
+		free(session);
+		close(fd);
+		__atomic_sub_fetch(&server->active_sessions, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	session->fd = fd;
+	session->worker = worker;
+	session->next = worker->sessions;
+	if (session->next)
+		session->next->prev = session;
+	worker->sessions = session;
+	worker->stats.sessions++;
+
+	session->next_tick = now + GAME_TICK_USEC;
+	session->next_frame = now;
+
+	if (session_send(session, SESSION_GREETING, sizeof(SESSION_GREETING) - 1)) {
+		session_close(session);
+		return;
+	}
+
+	session_update(session, now);
+}
+
+static void session_event(struct session *session, uint32_t events)
+{
+	if (events & (EPOLLHUP | EPOLLERR)) {
+		session_close(session);
+		return;
+	}
+
+	if (events & EPOLLOUT) {
+		if (session_flush(session)) {
+			session_close(session);
+			return;
+		}
+
+		if (session->closing && !session->output_len) {
+			session_close(session);
+			return;
+		}
+	}
+
+	if (events & EPOLLIN) {
+		session_catch_up(session, monotonic_usec());
+		session_read(session);
+		if (session->fd < 0) {
+			session_close(session);
+			return;
+		}
+	}
+
+	session_update(session, monotonic_usec());
+}
+
+static void session_timer(void *data, struct timer *timer)
+{
+	struct session *session = container_of(timer, struct session, timer);
+	uint64_t now = monotonic_usec();
+	(void)data;
+
+	if (session->closing) {
+		session_close(session);
+		return;
+	}
+
+	session_catch_up(session, now);
+	session_update(session, now);
+}
+
+/*
+ * Draw the game if it changed and a frame is due, end the session once the
+ * game is over, and arm the session timer for whatever is due next.
+ * */
+static void session_update(struct session *session, uint64_t now)
+{
+	struct server_worker *worker = session->worker;
+	struct tetris_game *game = &session->game;
+
+	if (session->closing)
+		return;
+
+	if (!game->running) {
+		session_finish(session, now);
+		return;
+	}
+
+	// while a frame is still on its way, changes are merged into the next one
+	int can_draw = game->dirty && !session->output_len;
+	if (can_draw && session->next_frame <= now) {
+		size_t len = ansi_renderer_draw(&session->renderer, &game->well, NULL, game->level, game->score, game->lines, 0);
+		game->dirty = 0;
+		can_draw = 0;
+
+		if (len) {
+			worker->stats.frames++;
+			if (session_send(session, session->renderer.buffer, len)) {
+				session_close(session);
+				return;
+			}
+		}
+
+		if (worker->server->options.max_fps)
+			session->next_frame = now + 1000000 / (uint64_t)worker->server->options.max_fps;
+	}
+
+	// idle sessions, and paused ones, sleep until there is something to do
+	uint64_t expires = UINT64_MAX;
+	unsigned long idle = tetris_game_idle_ticks(game);
+	if (idle != ULONG_MAX)
+		expires = session->next_tick + (uint64_t)idle * GAME_TICK_USEC;
+	if (can_draw && session->next_frame < expires)
+		expires = session->next_frame;
+
+	timer_wheel_remove(&worker->wheel, &session->timer);
+	if (expires != UINT64_MAX)
+		timer_wheel_add(&worker->wheel, &session->timer, expires);
+}
+
+/*
+ * Play the ticks that are due: those slept through while the game was idle
+ * or paused, and any missed while the worker was busy. This must happen
+ * before any input is applied, so that it lands on the tick it arrived in.
+ * */
+static void session_catch_up(struct session *session, uint64_t now)
+{
+	while (session->game.running && session->next_tick <= now) {
+		tetris_game_tick(&session->game);
+		session->next_tick += GAME_TICK_USEC;
+	}
+}
+
+/*
+ * Read and apply whatever keys the client sent. A closed connection is
+ * flagged by closing the socket, leaving the session for the caller to
+ * release.
+ * */
+static void session_read(struct session *session)
+{
+	while (1) {
+		ssize_t len = recv(session->fd, session->input + session->input_len,
+				sizeof(session->input) - session->input_len, 0);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return;
+		if (len <= 0) {
+			close(session->fd);
+			session->fd = -1;
+			return;
+		}
+
+		session->input_len += (size_t)len;
+
+		size_t pos = 0;
+		while (pos < session->input_len) {
+			const char *buf = session->input + pos;
+			size_t left = session->input_len - pos;
+			size_t consumed;
+			int input = 0;
+
+			if ((unsigned char)buf[0] == TELNET_IAC) {
+				consumed = skip_telnet((const unsigned char *)buf, left);
+			} else if (session->after_cr && (buf[0] == '\n' || buf[0] == '\0')) {
+				// telnet sends the return key as CR LF or CR NUL
+				consumed = 1;
+			} else {
+				consumed = ansi_decode_key(buf, left, &input);
+			}
+
+			if (!consumed)
+				break;
+
+			session->after_cr = consumed == 1 && buf[0] == '\r';
+			pos += consumed;
+
+			if (input == INPUT_STOP) {
+				session->game.running = 0;
+				session->input_len = 0;
+				return;
+			}
+
+			if (!session->closing)
+				tetris_game_input(&session->game, input);
+		}
+
+		// an incomplete sequence that fills the buffer will never complete
+		if (!pos && session->input_len == sizeof(session->input))
+			pos = 1;
+
+		memmove(session->input, session->input + pos, session->input_len - pos);
+		session->input_len -= pos;
+	}
+}
+
+/*
+ * Send as much as the socket takes right away, and keep the rest until the
+ * client is ready for it. Returns non-zero if the connection is broken.
+ * */
+static int session_send(struct session *session, const char *buffer, size_t len)
+{
+	size_t sent = 0;
+
+	if (!session->output_len) {
+		while (sent < len) {
+			ssize_t ret = send(session->fd, buffer + sent, len - sent, MSG_NOSIGNAL);
+			if (ret < 0 && errno == EINTR)
+				continue;
+			if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+				break;
+			if (ret < 0)
+				return 1;
+
+			sent += (size_t)ret;
+		}
+
+		session->worker->stats.bytes += sent;
+		if (sent == len)
+			return 0;
+
+		struct epoll_event event = { EPOLLIN | EPOLLOUT, { .ptr = session } };
+		if (epoll_ctl(session->worker->epoll_fd, EPOLL_CTL_MOD, session->fd, &event))
+			return 1;
+	}
+
+	if (session->output_off) {
+		memmove(session->output, session->output + session->output_off, session->output_len);
+		session->output_off = 0;
+	}
+
+	if (session->output_len + len - sent > session->output_alloc)
+		return 1;
+
+	memcpy(session->output + session->output_len, buffer + sent, len - sent);
+	session->output_len += len - sent;
+
+	return 0;
+}
+
+/*
+ * Send output kept for the client, once it is ready for more. Returns
+ * non-zero if the connection is broken.
+ * */
+static int session_flush(struct session *session)
+{
+	while (session->output_len) {
+		ssize_t ret = send(session->fd, session->output + session->output_off, session->output_len, MSG_NOSIGNAL);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return 0;
+		if (ret < 0)
+			return 1;
+
+		session->worker->stats.bytes += (size_t)ret;
+		session->output_off += (size_t)ret;
+		session->output_len -= (size_t)ret;
+	}
+
+	session->output_off = 0;
+
+	struct epoll_event event = { EPOLLIN, { .ptr = session } };
+	return epoll_ctl(session->worker->epoll_fd, EPOLL_CTL_MOD, session->fd, &event) != 0;
+}
+
+/*
+ * Restore the terminal of the client and tell them how they did, then close
+ * the connection once that was sent.
+ * */
+static void session_finish(struct session *session, uint64_t now)
+{
+	struct tetris_game *game = &session->game;
+	char message[SESSION_MESSAGE_MAX];
+
+	int len = snprintf(message, sizeof(message),
+			SESSION_RESTORE "You reached level %d.\r\nYou scored %d points and cleared %d lines.\r\n",
+			game->level, game->score, game->lines);
+
+	session->closing = 1;
+	if (session_send(session, message, (size_t)len) || !session->output_len) {
+		session_close(session);
+		return;
+	}
+
+	timer_wheel_remove(&session->worker->wheel, &session->timer);
+	timer_wheel_add(&session->worker->wheel, &session->timer, now + SESSION_LINGER_USEC);
+}
+
+static void session_close(struct session *session)
+{
+	struct server_worker *worker = session->worker;
+
+	timer_wheel_remove(&worker->wheel, &session->timer);
+
+	if (session->prev)
+		session->prev->next = session->next;
+	else
+		worker->sessions = session->next;
+	if (session->next)
+		session->next->prev = session->prev;
+
+	// closing the socket also removes it from the epoll instance
+	if (session->fd >= 0)
+		close(session->fd);
+
+	ansi_renderer_release(&session->renderer);
+	free(session->output);
+	free(session);
+
+	__atomic_sub_fetch(&worker->server->active_sessions, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Return the length of the telnet command at the front of the buffer, or zero
+ * if it is incomplete. Subnegotiations are skipped up to IAC SE, and an
+ * escaped IAC IAC is dropped like any other unbound key.
+ * */
+static size_t skip_telnet(const unsigned char *buf, size_t len)
+{
+	if (len < 2)
+		return 0;
+
+	if (buf[1] >= TELNET_WILL && buf[1] <= TELNET_DONT)
+		return len < 3 ? 0 : 3;
+
+	if (buf[1] != TELNET_SB)
+		return 2;
+
+	for (size_t i = 2; i + 1 < len; i++) {
+		if (buf[i] == TELNET_IAC && buf[i + 1] == TELNET_SE)
+			return i + 2;
+	}
+
+	return 0;
+}
@@ -0,0 +1,332 @@
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "highscores.h"
+
+#define HIGHSCORES_MAGIC "tetrisHS"
+#define HIGHSCORES_VERSION 1
+
+/*
+ * A key orders results by score, then by slot, earlier slots first. The low
+ * half holds the complement of the slot so that a larger key is always the
+ * better result; zero is never a valid key, and marks an empty table entry.
+ * */
+#define KEY(score, slot) (((uint64_t)(uint32_t)(score) << 32) | (uint64_t)(UINT32_MAX - (uint32_t)(slot)))
+#define KEY_SLOT(key) (UINT32_MAX - (uint32_t)((key) & UINT32_MAX))
+
+/*
+ * The results kept by a compaction are copied to `kept` before the log is
+ * rewritten, and `compacting` is set to their number plus one once they all
+ * are, until the log and table are rewritten from them. These fields come
+ * last, so that a file laid out before they existed is simply extended with
+ * them, zeroed, when opened.
+ * */
+struct highscores_file {
+	char magic[8];
+	uint32_t version;
+	uint32_t capacity;
+	uint64_t generation;
+	uint64_t count;
+	uint64_t top[HIGHSCORE_TOP];
+	struct highscore log[HIGHSCORE_LOG_MAX];
+	uint64_t compacting;
+	struct highscore kept[HIGHSCORE_TOP];
+};
+
+static int valid_header(int fd, off_t size);
+static int all_zero(const void *data, size_t size);
+static void highscores_init_file(struct highscores_file *file);
+static void highscores_offer(struct highscores_file *file, uint64_t key);
+static void highscores_compact(struct highscores_file *file);
+static void highscores_rewrite(struct highscores_file *file);
+static void highscores_recover(struct highscores_file *file);
+static void highscores_wait_compaction(struct highscores *scores);
+static int compare_keys_desc(const void *a, const void *b);
+
+int highscores_open(struct highscores *scores, const char *path)
+{
+	struct stat st;
+
+	int fd = open(path, O_RDWR | O_CREAT, 0666);
+	if (fd < 0)
+		return 1;
+
+	// the first process to open the file lays it out; the others wait for it
+	if (flock(fd, LOCK_EX) || fstat(fd, &st))
+		goto fail;
+
+	/*
+	 * A file that isn't empty is left untouched unless it has the header of a
+	 * table, or has the size of one and is all zeros: a process died between
+	 * extending the file and laying it out.
+	 * */
+	int valid = st.st_size && valid_header(fd, st.st_size);
+	int blank = !valid && st.st_size == (off_t)sizeof(struct highscores_file);
+	if (st.st_size && !valid && !blank)
+		goto fail;
+	if (st.st_size < (off_t)sizeof(struct highscores_file) && ftruncate(fd, sizeof(struct highscores_file)))
+		goto fail;
+
+	void *map = mmap(NULL, sizeof(struct highscores_file), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED)
+		goto fail;
+
+	if (blank && !all_zero(map, sizeof(struct highscores_file))) {
+		munmap(map, sizeof(struct highscores_file));
+		goto fail;
+	}
+
+	scores->fd = fd;
+	scores->file = map;
+
+	if (!valid)
+		highscores_init_file(scores->file);
+	flock(fd, LOCK_UN);
+
+	return 0;
+
+fail:
+	close(fd);
+	return 1;
+}
+
+int highscores_add(struct highscores *scores, const struct highscore *entry)
+{
+	struct highscores_file *file = scores->file;
+
+	if (entry->score < 0)
+		return 1;
+
+	while (1) {
+		if (flock(scores->fd, LOCK_SH))
+			return 1;
+
+		uint64_t slot = __atomic_fetch_add(&file->count, 1, __ATOMIC_ACQ_REL);
+		if (slot < HIGHSCORE_LOG_MAX) {
+			file->log[slot] = *entry;
+			highscores_offer(file, KEY(entry->score, slot));
+
+			flock(scores->fd, LOCK_UN);
+			return 0;
+		}
+
+		// the log is full; whoever gets the exclusive lock first compacts it
+		flock(scores->fd, LOCK_UN);
+		if (flock(scores->fd, LOCK_EX))
+			return 1;
+
+		if (__atomic_load_n(&file->count, __ATOMIC_ACQUIRE) >= HIGHSCORE_LOG_MAX)
+			highscores_compact(file);
+
+		flock(scores->fd, LOCK_UN);
+	}
+}
+
+size_t highscores_top(struct highscores *scores, struct highscore *entries, size_t count)
+{
+	struct highscores_file *file = scores->file;
+	uint64_t keys[HIGHSCORE_TOP];
+	size_t found;
+
+	if (count > HIGHSCORE_TOP)
+		count = HIGHSCORE_TOP;
+
+	while (1) {
+		uint64_t generation = __atomic_load_n(&file->generation, __ATOMIC_ACQUIRE);
+		if (generation & 1) {
+			highscores_wait_compaction(scores);
+			continue;
+		}
+
+		found = 0;
+		for (size_t i = 0; i < HIGHSCORE_TOP; i++) {
+			uint64_t key = __atomic_load_n(&file->top[i], __ATOMIC_ACQUIRE);
+			if (key)
+				keys[found++] = key;
+		}
+
+		qsort(keys, found, sizeof(uint64_t), compare_keys_desc);
+		if (found > count)
+			found = count;
+
+		for (size_t i = 0; i < found; i++)
+			entries[i] = file->log[KEY_SLOT(keys[i])];
+
+		// a compaction moved the results while they were being copied
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&file->generation, __ATOMIC_RELAXED) == generation)
+			return found;
+	}
+}
+
+void highscores_close(struct highscores *scores)
+{
+	munmap(scores->file, sizeof(struct highscores_file));
+	close(scores->fd);
+}
+
+/*
+ * Whether the file starts with the header of a table of this version and
+ * capacity, and is at least as long as one laid out before the compaction
+ * fields were added.
+ * */
+static int valid_header(int fd, off_t size)
+{
+	char header[offsetof(struct highscores_file, generation)];
+	uint32_t version, capacity;
+
+	if (size < (off_t)offsetof(struct highscores_file, compacting) ||
+			pread(fd, header, sizeof(header), 0) != (ssize_t)sizeof(header))
+		return 0;
+
+	memcpy(&version, header + offsetof(struct highscores_file, version), sizeof(version));
+	memcpy(&capacity, header + offsetof(struct highscores_file, capacity), sizeof(capacity));
+
+	return !memcmp(header, HIGHSCORES_MAGIC, 8) && version == HIGHSCORES_VERSION && capacity == HIGHSCORE_LOG_MAX;
+}
+
+static int all_zero(const void *data, size_t size)
+{
+	const unsigned char *bytes = data;
+
+	for (size_t i = 0; i < size; i++) {
+		if (bytes[i])
+			return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Give a new file its header. Called with the exclusive lock held.
+ * */
+static void highscores_init_file(struct highscores_file *file)
+{
+	memcpy(file->magic, HIGHSCORES_MAGIC, 8);
+	file->version = HIGHSCORES_VERSION;
+	file->capacity = HIGHSCORE_LOG_MAX;
+}
+
+/*
+ * Put a key in the table in place of the smallest key, if it is larger.
+ * */
+static void highscores_offer(struct highscores_file *file, uint64_t key)
+{
+	while (1) {
+		size_t smallest = 0;
+		uint64_t smallest_key = UINT64_MAX;
+
+		for (size_t i = 0; i < HIGHSCORE_TOP; i++) {
+			uint64_t current = __atomic_load_n(&file->top[i], __ATOMIC_ACQUIRE);
+			if (current < smallest_key) {
+				smallest = i;
+				smallest_key = current;
+			}
+		}
+
+		if (key <= smallest_key)
+			return;
+
+		if (__atomic_compare_exchange_n(&file->top[smallest], &smallest_key, key, 0,
+				__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			return;
+	}
+}
+
+/*
+ * Move the results in the table to the start of the log, and forget the rest.
+ * Called with the exclusive lock held, so no process is appending.
+ *
+ * The results kept are first copied aside, leaving the log and table as they
+ * were; only once they all are does the compaction start rewriting the log.
+ * A process that dies before that point leaves the old table, and one that
+ * dies after it leaves what it needs to finish the new one.
+ * */
+static void highscores_compact(struct highscores_file *file)
+{
+	uint64_t keys[HIGHSCORE_TOP];
+	size_t count = 0;
+
+	highscores_recover(file);
+	__atomic_fetch_add(&file->generation, 1, __ATOMIC_ACQ_REL);
+
+	for (size_t i = 0; i < HIGHSCORE_TOP; i++) {
+		if (file->top[i])
+			keys[count++] = file->top[i];
+	}
+
+	qsort(keys, count, sizeof(uint64_t), compare_keys_desc);
+	for (size_t i = 0; i < count; i++)
+		file->kept[i] = file->log[KEY_SLOT(keys[i])];
+
+	__atomic_store_n(&file->compacting, count + 1, __ATOMIC_RELEASE);
+	highscores_rewrite(file);
+
+	__atomic_fetch_add(&file->generation, 1, __ATOMIC_ACQ_REL);
+}
+
+/*
+ * Rewrite the log and table from the results kept by a compaction, if one is
+ * in progress. Rewriting only reads `kept`, so it can be started over any
+ * number of times.
+ * */
+static void highscores_rewrite(struct highscores_file *file)
+{
+	uint64_t compacting = __atomic_load_n(&file->compacting, __ATOMIC_ACQUIRE);
+	if (!compacting)
+		return;
+
+	size_t count = (size_t)compacting - 1;
+	memset(file->top, 0, sizeof(file->top));
+	for (size_t i = 0; i < count; i++) {
+		file->log[i] = file->kept[i];
+		file->top[i] = KEY(file->kept[i].score, i);
+	}
+
+	// appends may resume once the count drops, so the rewrite must be over by then
+	__atomic_store_n(&file->compacting, 0, __ATOMIC_RELEASE);
+	__atomic_store_n(&file->count, count, __ATOMIC_RELEASE);
+}
+
+/*
+ * Finish a compaction left behind by a process that died partway through,
+ * which shows as an odd generation once the exclusive lock is free. If it
+ * died before it started rewriting the log, the old table is still intact;
+ * otherwise the rewrite is started over from the results it kept. Called with
+ * the exclusive lock held.
+ * */
+static void highscores_recover(struct highscores_file *file)
+{
+	if (!(__atomic_load_n(&file->generation, __ATOMIC_ACQUIRE) & 1))
+		return;
+
+	highscores_rewrite(file);
+	__atomic_fetch_add(&file->generation, 1, __ATOMIC_ACQ_REL);
+}
+
+/*
+ * Wait for a compaction to finish, rather than spinning on the generation,
+ * and finish it if the process compacting died.
+ * */
+static void highscores_wait_compaction(struct highscores *scores)
+{
+	if (flock(scores->fd, LOCK_EX))
+		return;
+
+	highscores_recover(scores->file);
+	flock(scores->fd, LOCK_UN);
+}
+
+static int compare_keys_desc(const void *a, const void *b)
+{
+	uint64_t left = *(const uint64_t *)a;
+	uint64_t right = *(const uint64_t *)b;
+
+	return (left < right) - (left > right);
+}
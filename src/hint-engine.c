@@ -0,0 +1,284 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "hint-engine.h"
+
+static void *hint_worker(void *data);
+static unsigned long read_request(struct hint_engine *engine, unsigned long *piece, struct tetris_well *well);
+static int handle_request(struct hint_engine *engine, unsigned long piece, struct tetris_well *well);
+static int find_placement(struct hint_engine *engine, struct tetris_well *well, struct placement *placement);
+static int reachable(struct hint_engine *engine, struct tetris_well *well, struct placement *placement);
+static void publish(struct hint_engine *engine, const struct hint *hint);
+static int same_position(const struct tetris_well *a, const struct tetris_well *b);
+
+int hint_engine_start(struct hint_engine *engine, const struct search_options *search,
+		const struct opening_book *book)
+{
+	memset(engine, 0, sizeof(*engine));
+	engine->search = *search;
+	engine->search.cancel = &engine->cancel;
+	engine->book = book;
+
+	// far too large for the stack of the worker
+	if (book && !(engine->placements = malloc(sizeof(*engine->placements) * PLACEMENTS_MAX)))
+		return 1;
+
+	if ((engine->published_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+		free(engine->placements);
+		return 1;
+	}
+
+	if (sem_init(&engine->wake, 0, 0)) {
+		close(engine->published_fd);
+		free(engine->placements);
+		return 1;
+	}
+
+	if (pthread_create(&engine->worker, NULL, hint_worker, engine)) {
+		sem_destroy(&engine->wake);
+		close(engine->published_fd);
+		free(engine->placements);
+		return 1;
+	}
+
+	return 0;
+}
+
+void hint_engine_post(struct hint_engine *engine, const struct tetris_well *well, unsigned long piece)
+{
+	struct hint_request *request = &engine->request;
+	unsigned long sequence = request->sequence;
+
+	__atomic_store_n(&request->sequence, sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	request->piece = piece;
+	request->well = *well;
+	__atomic_store_n(&request->sequence, sequence + 2, __ATOMIC_RELEASE);
+
+	// give up on the previous position, and wake the worker for this one
+	__atomic_store_n(&engine->cancel, 1, __ATOMIC_RELAXED);
+	sem_post(&engine->wake);
+}
+
+int hint_engine_read(struct hint_engine *engine, struct hint *hint)
+{
+	struct hint_slot *slot = &engine->published;
+	uint64_t published;
+
+	// drain before reading, so that a hint published from here on signals again
+	if (read(engine->published_fd, &published, sizeof(published)) < 0 && errno != EAGAIN)
+		return 1;
+
+	unsigned long sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+	if (!sequence || sequence & 1)
+		return 1;
+
+	*hint = slot->hint;
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	return __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) != sequence;
+}
+
+void hint_engine_stop(struct hint_engine *engine)
+{
+	__atomic_store_n(&engine->stop, 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&engine->cancel, 1, __ATOMIC_RELAXED);
+	sem_post(&engine->wake);
+
+	pthread_join(engine->worker, NULL);
+	sem_destroy(&engine->wake);
+	close(engine->published_fd);
+	free(engine->placements);
+}
+
+static void *hint_worker(void *data)
+{
+	struct hint_engine *engine = data;
+	struct tetris_well well;
+	unsigned long piece, sequence;
+
+	while (1) {
+		if (sem_wait(&engine->wake) && errno == EINTR)
+			continue;
+		if (__atomic_load_n(&engine->stop, __ATOMIC_RELAXED))
+			break;
+
+		/*
+		 * Lower the flag before reading the request, so that a position posted
+		 * while this one is being searched still cancels the search.
+		 * */
+		__atomic_store_n(&engine->cancel, 0, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+		// every post wakes the worker, but only the latest position matters
+		if (!(sequence = read_request(engine, &piece, &well)) || sequence == engine->handled)
+			continue;
+
+		/*
+		 * A position posted just after this one was read may have cancelled it;
+		 * the worker is woken up for that position anyway, and retries this one
+		 * if it turns out to be the same.
+		 * */
+		if (!handle_request(engine, piece, &well))
+			engine->handled = sequence;
+	}
+
+	return NULL;
+}
+
+/*
+ * Copy the latest request, returning its sequence count, which is zero if
+ * nothing was posted yet.
+ * */
+static unsigned long read_request(struct hint_engine *engine, unsigned long *piece, struct tetris_well *well)
+{
+	struct hint_request *request = &engine->request;
+	unsigned long sequence;
+
+	while (1) {
+		sequence = __atomic_load_n(&request->sequence, __ATOMIC_ACQUIRE);
+		if (sequence & 1)
+			continue;
+
+		*piece = request->piece;
+		*well = request->well;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+		if (__atomic_load_n(&request->sequence, __ATOMIC_RELAXED) == sequence)
+			break;
+	}
+
+	return sequence;
+}
+
+/*
+ * Publish the hint for the current tetrimino, then work out the next one.
+ * Returns non-zero if the search for the current tetrimino was cancelled.
+ * */
+static int handle_request(struct hint_engine *engine, unsigned long piece, struct tetris_well *well)
+{
+	struct hint hint;
+	struct tetris_well next;
+
+	memset(&hint, 0, sizeof(hint));
+	hint.piece = piece;
+
+	// the player followed the previous hint, so this one was worked out already
+	if (engine->expecting && engine->expected_piece == piece && same_position(&engine->expected_well, well)) {
+		hint.current = engine->expected_next;
+		hint.has_current = 1;
+		engine->followed++;
+	} else if (!find_placement(engine, well, &hint.current)) {
+		hint.has_current = 1;
+	} else if (__atomic_load_n(&engine->cancel, __ATOMIC_RELAXED)) {
+		return 1;
+	}
+
+	engine->expecting = 0;
+	publish(engine, &hint);
+	if (!hint.has_current)
+		return 0;
+
+	next = *well;
+	tetrimino_place(&next, &hint.current);
+	tetris_well_commit_tetrimino(&next);
+	if (tetrimino_new(&next) || find_placement(engine, &next, &hint.next))
+		return 0;
+
+	hint.has_next = 1;
+	publish(engine, &hint);
+
+	engine->expecting = 1;
+	engine->expected_piece = piece + 1;
+	engine->expected_well = next;
+	engine->expected_next = hint.next;
+	return 0;
+}
+
+/*
+ * Find the best placement for the current tetrimino of the well, in the book
+ * or by searching. A placement from the book that the tetrimino can't reach
+ * is searched again. Returns non-zero if it has none, or the search was
+ * cancelled.
+ * */
+static int find_placement(struct hint_engine *engine, struct tetris_well *well, struct placement *placement)
+{
+	if (engine->book && !opening_book_lookup(engine->book, well, placement) &&
+			reachable(engine, well, placement)) {
+		engine->searched++;
+		return 0;
+	}
+
+	if (search_best_placement(well, &engine->search, placement, NULL)) {
+		if (__atomic_load_n(&engine->cancel, __ATOMIC_RELAXED))
+			engine->cancelled++;
+		return 1;
+	}
+
+	engine->searched++;
+	return 0;
+}
+
+/*
+ * Whether the current tetrimino of the well can reach the placement, which
+ * is normalized. Book entries come from a file, which may be corrupt, and
+ * whose hashes may collide.
+ * */
+static int reachable(struct hint_engine *engine, struct tetris_well *well, struct placement *placement)
+{
+	for (size_t i = 0; i < 4; i++) {
+		if (placement->coords[i][0] >= well->width || placement->coords[i][1] >= well->height)
+			return 0;
+	}
+
+	placement_normalize(placement);
+
+	size_t count = tetrimino_placements(well, engine->placements);
+	for (size_t i = 0; i < count; i++) {
+		if (!memcmp(&engine->placements[i], placement, sizeof(*placement)))
+			return 1;
+	}
+
+	return 0;
+}
+
+static void publish(struct hint_engine *engine, const struct hint *hint)
+{
+	struct hint_slot *slot = &engine->published;
+	unsigned long sequence = slot->sequence;
+
+	__atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	slot->hint = *hint;
+	__atomic_store_n(&slot->sequence, sequence + 2, __ATOMIC_RELEASE);
+
+	// a nonblocking eventfd only refuses a write once its counter would overflow, with a wakeup pending anyway
+	uint64_t one = 1;
+	if (write(engine->published_fd, &one, sizeof(one)) < 0)
+		return;
+}
+
+/*
+ * Whether both wells hold the same cells, current tetrimino and queue, and so
+ * would get the same hints.
+ * */
+static int same_position(const struct tetris_well *a, const struct tetris_well *b)
+{
+	if (a->width != b->width || a->height != b->height || a->tetrimino_type != b->tetrimino_type ||
+			a->tetrimino_bag_index != b->tetrimino_bag_index)
+		return 0;
+
+	if (memcmp(a->tetrimino_coords, b->tetrimino_coords, sizeof(a->tetrimino_coords)) ||
+			memcmp(a->tetrimino_bag, b->tetrimino_bag, sizeof(a->tetrimino_bag[0]) * a->tetrimino_bag_index))
+		return 0;
+
+	for (size_t i = 0; i < a->height; i++) {
+		if (memcmp(a->matrix[i], b->matrix[i], a->width))
+			return 0;
+	}
+
+	return 1;
+}
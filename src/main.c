@@ -1,19 +1,463 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <pwd.h>
+#include <signal.h>
+#include <pthread.h>
 
 #include "game-engine.h"
 #include "display-engine.h"
+#include "tetris-well.h"
+#include "highscores.h"
+#include "game-server.h"
+#include "well-metrics.h"
+#include "hint-engine.h"
+#include "opening-book.h"
 
-int main(void)
+#define HIGHSCORE_SHOWN 10
+
+static void print_usage(FILE *stream, const char *prog)
+{
+	fprintf(stream, "usage: %s [--width <n>] [--height <n>] [--display <backend>] [--fps <n>]\n", prog);
+	fprintf(stream, "           [--save-replay <file>] [--asciicast <file>] [--bandwidth <bytes>]\n");
+	fprintf(stream, "           [--randomizer <name>] [--telemetry <file>] [--highscores <file>]\n");
+	fprintf(stream, "           [--hints] [--hint-book <file>]\n");
+	fprintf(stream, "   or: %s [--width <n>] [--height <n>] --bot-protocol <address> [--bot-games <n>]\n", prog);
+	fprintf(stream, "   or: %s [--width <n>] [--height <n>] [--fps <n>] [--randomizer <name>]\n", prog);
+	fprintf(stream, "           --serve <address> [--workers <n>] [--max-sessions <n>]\n");
+	fprintf(stream, "   every mode also takes [--metrics-socket <path>] [--metrics-file <path>]\n");
+	fprintf(stream, "\n");
+	fprintf(stream, "    --width <n>     width of the well, between %d and %d (default %d)\n",
+			BOARD_MIN_WIDTH, BOARD_MAX_WIDTH, BOARD_WIDTH);
+	fprintf(stream, "    --height <n>    height of the well, between %d and %d (default %d)\n",
+			BOARD_MIN_HEIGHT, BOARD_MAX_HEIGHT, BOARD_HEIGHT);
+	fprintf(stream, "    --display <backend>\n");
+	fprintf(stream, "                    draw with 'curses' (default) or raw 'ansi' escape sequences\n");
+	fprintf(stream, "    --fps <n>       draw at most n frames per second, or 0 for no limit (default %d)\n",
+			GAME_DEFAULT_FPS);
+	fprintf(stream, "    --save-replay <file>\n");
+	fprintf(stream, "                    save the inputs of the game to a replay file\n");
+	fprintf(stream, "    --asciicast <file>\n");
+	fprintf(stream, "                    record the game to an asciicast v2 file\n");
+	fprintf(stream, "    --bandwidth <bytes>\n");
+	fprintf(stream, "                    send at most this many bytes per second to the terminal\n");
+	fprintf(stream, "    --randomizer <name>\n");
+	fprintf(stream, "                    deal tetriminos from a shuffled 'bag' (default), at 'random',\n");
+	fprintf(stream, "                    or like the 'nes' or 'tgm' games\n");
+	fprintf(stream, "    --telemetry <file>\n");
+	fprintf(stream, "                    write an event for every locked tetrimino to a CSV file\n");
+	fprintf(stream, "    --highscores <file>\n");
+	fprintf(stream, "                    record the result in a high score table shared by every player\n");
+	fprintf(stream, "    --hints         outline where the current tetrimino should go\n");
+	fprintf(stream, "    --hint-book <file>\n");
+	fprintf(stream, "                    look hints up in an opening book before searching for them\n");
+	fprintf(stream, "    --bot-protocol <address>\n");
+	fprintf(stream, "                    let a bot play through 'stdio' or a socket at 'unix:<path>'\n");
+	fprintf(stream, "    --bot-games <n> number of games the bot plays at once (default 1)\n");
+	fprintf(stream, "    --serve <address>\n");
+	fprintf(stream, "                    host games for players connecting to 'unix:<path>', 'tcp:<port>'\n");
+	fprintf(stream, "                    or 'tcp:<host>:<port>', until interrupted\n");
+	fprintf(stream, "    --workers <n>   number of threads serving players (default %d)\n", SERVER_DEFAULT_WORKERS);
+	fprintf(stream, "    --max-sessions <n>\n");
+	fprintf(stream, "                    most games hosted at once (default %d)\n", SERVER_DEFAULT_MAX_SESSIONS);
+	fprintf(stream, "    --metrics-socket <path>\n");
+	fprintf(stream, "                    serve counts of well operations on a Unix socket while running\n");
+	fprintf(stream, "    --metrics-file <path>\n");
+	fprintf(stream, "                    write counts of well operations to a file on exit\n");
+}
+
+static int play_bot_games(const char *address, int games_nr, size_t width, size_t height)
+{
+	struct tetris_game *games = calloc((size_t)games_nr, sizeof(*games));
+	struct bot_stats stats;
+
+	if (!games) {
+		perror("calloc");
+		return 1;
+	}
+
+	if (start_bot_games(address, width, height, games, games_nr, &stats)) {
+		fprintf(stderr, "bot at '%s' could not be reached or stopped answering\n", address);
+		free(games);
+		return 1;
+	}
+
+	// stdout may be the connection to the bot, so report on stderr
+	for (int i = 0; i < games_nr; i++)
+		fprintf(stderr, "Game %d: reached level %d, scored %d points and cleared %d lines.\n",
+				i, games[i].level, games[i].score, games[i].lines);
+
+	if (stats.moves)
+		fprintf(stderr, "%lu moves in %lu batches; round trip min %.1f us, avg %.1f us, max %.1f us per move.\n",
+				stats.moves, stats.batches, (double)stats.min_usec,
+				(double)stats.total_usec / (double)stats.moves, (double)stats.max_usec);
+
+	free(games);
+	return 0;
+}
+
+/*
+ * Host games until interrupted. SIGINT and SIGTERM are blocked before the
+ * workers start, so that they are only ever delivered here.
+ * */
+static int serve_games(const struct server_options *options)
+{
+	struct game_server server;
+	sigset_t signals;
+	int sig;
+
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+	if (server_open(&server, options)) {
+		fprintf(stderr, "failed to serve games at '%s'\n", options->address);
+		return 1;
+	}
+
+	fprintf(stderr, "Serving games at '%s' with %d workers.\n", options->address, options->workers);
+	sigwait(&signals, &sig);
+	server_stop(&server);
+
+	printf("Hosted %lu games, at most %lu at once (%lu turned away).\n",
+			server.stats.sessions, server.stats.peak_sessions, server.stats.rejected);
+	printf("Sent %llu bytes to players in %lu frames.\n", server.stats.bytes, server.stats.frames);
+	printf("Workers woke up %lu times in %.1f s (%.1f per second).\n", server.stats.wakeups,
+			(double)server.stats.usec / 1e6,
+			server.stats.usec ? (double)server.stats.wakeups * 1e6 / (double)server.stats.usec : 0);
+
+	return 0;
+}
+
+/*
+ * Add the result of the game to the shared high score table, and show the
+ * best results so far.
+ * */
+static int record_highscore(const char *path, int score, int level, int lines)
+{
+	struct highscores scores;
+	struct highscore entry, top[HIGHSCORE_SHOWN];
+
+	if (highscores_open(&scores, path)) {
+		fprintf(stderr, "%s: not a high score table\n", path);
+		return 1;
+	}
+
+	memset(&entry, 0, sizeof(entry));
+	struct passwd *user = getpwuid(getuid());
+	const char *name = user ? user->pw_name : getenv("USER");
+	strncpy(entry.name, name ? name : "unknown", HIGHSCORE_NAME_MAX - 1);
+	entry.time = (int64_t)time(NULL);
+	entry.score = score;
+	entry.level = level;
+	entry.lines = lines;
+
+	int ret = highscores_add(&scores, &entry);
+	if (ret)
+		fprintf(stderr, "%s: failed to record the result\n", path);
+
+	size_t count = highscores_top(&scores, top, HIGHSCORE_SHOWN);
+	if (count)
+		printf("\nHigh scores:\n");
+	for (size_t i = 0; i < count; i++)
+		printf("%2zu. %-16s %8d points, level %2d, %4d lines\n", i + 1, top[i].name,
+				top[i].score, top[i].level, top[i].lines);
+
+	highscores_close(&scores);
+	return ret;
+}
+
+static FILE *open_output(const char *path)
+{
+	FILE *file = fopen(path, "w");
+	if (!file)
+		perror(path);
+
+	return file;
+}
+
+static int parse_int(const char *arg, long min, long max, long *value)
+{
+	char *end;
+	long parsed = strtol(arg, &end, 10);
+	if (*arg == '\0' || *end != '\0' || parsed < min || parsed > max)
+		return 1;
+
+	*value = parsed;
+	return 0;
+}
+
+/*
+ * Play a game in the terminal, then report how it went. With `hints`, a hint
+ * engine runs alongside the game, looking positions up in `hint_book` first
+ * if non-NULL.
+ * */
+static int play_game(struct game_options *options, int backend, const char *highscores,
+		int hints, const char *hint_book)
 {
 	int level = 0, lines_cleared = 0;
+	struct game_stats stats;
+	struct search_options search;
+	struct opening_book book;
+	struct hint_engine engine;
+
+	if (hint_book && opening_book_open(&book, hint_book)) {
+		fprintf(stderr, "%s: not an opening book\n", hint_book);
+		return 1;
+	}
+
+	search_options_init(&search);
+	if (hints && hint_engine_start(&engine, &search, hint_book ? &book : NULL)) {
+		fprintf(stderr, "failed to start the hint engine\n");
+		if (hint_book)
+			opening_book_close(&book);
+		return 1;
+	}
+	options->hints = hints ? &engine : NULL;
+
+	if (initialize_display_engine(backend, options->width, options->height)) {
+		fprintf(stderr, "failed to initialize display\n");
+		if (hints)
+			hint_engine_stop(&engine);
+		if (hint_book)
+			opening_book_close(&book);
+		return 1;
+	}
 
-	initialize_display_engine();
-	int score = start_game(&level, &lines_cleared);
+	int score = start_game(options, &level, &lines_cleared, &stats);
 
 	stop_display_engine();
 
+	if (hints)
+		hint_engine_stop(&engine);
+	if (hint_book)
+		opening_book_close(&book);
+
+	if (options->replay)
+		fclose(options->replay);
+	if (options->asciicast)
+		fclose(options->asciicast);
+	if (options->telemetry)
+		fclose(options->telemetry);
+
 	printf("You reached level %d.\n", level);
 	printf("You scored %d points and cleared %d lines.\n", score, lines_cleared);
+	printf("Sent %llu bytes to the terminal in %lu frames (%lu frames merged).\n",
+			stats.bytes, stats.frames, stats.merged_frames);
+	printf("Woke up %lu times in %.1f s (%.1f per second).\n", stats.wakeups, (double)stats.usec / 1e6,
+			stats.usec ? (double)stats.wakeups * 1e6 / (double)stats.usec : 0);
+	if (options->telemetry)
+		printf("Wrote %lu telemetry events (%lu dropped).\n", stats.telemetry_events, stats.telemetry_dropped);
+	if (hints)
+		printf("Hints: %lu positions worked out, %lu ready in advance, %lu searches given up.\n",
+				engine.searched, engine.followed, engine.cancelled);
+
+	if (highscores && record_highscore(highscores, score, level, lines_cleared))
+		return 1;
 
 	return 0;
 }
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+			{ "width", required_argument, NULL, 'w' },
+			{ "height", required_argument, NULL, 'H' },
+			{ "display", required_argument, NULL, 'D' },
+			{ "fps", required_argument, NULL, 'f' },
+			{ "save-replay", required_argument, NULL, 'r' },
+			{ "asciicast", required_argument, NULL, 'c' },
+			{ "bandwidth", required_argument, NULL, 'b' },
+			{ "randomizer", required_argument, NULL, 'R' },
+			{ "telemetry", required_argument, NULL, 't' },
+			{ "highscores", required_argument, NULL, 's' },
+			{ "hints", no_argument, NULL, 'i' },
+			{ "hint-book", required_argument, NULL, 'k' },
+			{ "bot-protocol", required_argument, NULL, 'B' },
+			{ "bot-games", required_argument, NULL, 'g' },
+			{ "serve", required_argument, NULL, 'S' },
+			{ "workers", required_argument, NULL, 'W' },
+			{ "max-sessions", required_argument, NULL, 'M' },
+			{ "metrics-socket", required_argument, NULL, 'm' },
+			{ "metrics-file", required_argument, NULL, 'F' },
+			{ "help", no_argument, NULL, 'h' },
+			{ NULL, 0, NULL, 0 }
+	};
+
+	struct game_options options = { BOARD_WIDTH, BOARD_HEIGHT, GAME_DEFAULT_FPS, NULL, NULL, 0, RANDOMIZER_BAG, NULL, NULL };
+	int backend = DISPLAY_BACKEND_CURSES;
+	const char *bot = NULL;
+	const char *highscores = NULL;
+	int hints = 0;
+	const char *hint_book = NULL;
+	int bot_games = 1;
+	struct server_options server;
+	const char *metrics_socket = NULL;
+	const char *metrics_file = NULL;
+	struct well_metrics_server metrics;
+	long value;
+	int ret;
+
+	server_options_init(&server);
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+		switch (opt) {
+			case 'w':
+				if (parse_int(optarg, BOARD_MIN_WIDTH, BOARD_MAX_WIDTH, &value)) {
+					fprintf(stderr, "invalid well width '%s'\n", optarg);
+					return 1;
+				}
+				options.width = (size_t)value;
+				break;
+			case 'H':
+				if (parse_int(optarg, BOARD_MIN_HEIGHT, BOARD_MAX_HEIGHT, &value)) {
+					fprintf(stderr, "invalid well height '%s'\n", optarg);
+					return 1;
+				}
+				options.height = (size_t)value;
+				break;
+			case 'f':
+				if (parse_int(optarg, 0, 1000, &value)) {
+					fprintf(stderr, "invalid frame rate '%s'\n", optarg);
+					return 1;
+				}
+				options.max_fps = (int)value;
+				break;
+			case 'b':
+				if (parse_int(optarg, 0, 1L << 30, &value)) {
+					fprintf(stderr, "invalid bandwidth '%s'\n", optarg);
+					return 1;
+				}
+				options.max_bandwidth = (unsigned long)value;
+				break;
+			case 'R':
+				if ((options.randomizer = randomizer_parse(optarg)) < 0) {
+					fprintf(stderr, "unknown randomizer '%s'\n", optarg);
+					return 1;
+				}
+				break;
+			case 's':
+				highscores = optarg;
+				break;
+			case 'i':
+				hints = 1;
+				break;
+			case 'k':
+				hints = 1;
+				hint_book = optarg;
+				break;
+			case 'B':
+				bot = optarg;
+				break;
+			case 'g':
+				if (parse_int(optarg, 1, 4096, &value)) {
+					fprintf(stderr, "invalid number of bot games '%s'\n", optarg);
+					return 1;
+				}
+				bot_games = (int)value;
+				break;
+			case 'S':
+				server.address = optarg;
+				break;
+			case 'W':
+				if (parse_int(optarg, 1, 256, &value)) {
+					fprintf(stderr, "invalid number of workers '%s'\n", optarg);
+					return 1;
+				}
+				server.workers = (int)value;
+				break;
+			case 'M':
+				if (parse_int(optarg, 1, 1L << 20, &value)) {
+					fprintf(stderr, "invalid number of sessions '%s'\n", optarg);
+					return 1;
+				}
+				server.max_sessions = (unsigned long)value;
+				break;
+			case 'm':
+				metrics_socket = optarg;
+				break;
+			case 'F':
+				metrics_file = optarg;
+				break;
+			case 'r':
+				if (!options.replay && !(options.replay = open_output(optarg)))
+					return 1;
+				break;
+			case 't':
+				if (!options.telemetry && !(options.telemetry = open_output(optarg)))
+					return 1;
+				break;
+			case 'c':
+				if (!options.asciicast && !(options.asciicast = open_output(optarg)))
+					return 1;
+				break;
+			case 'D':
+				if (!strcmp(optarg, "curses")) {
+					backend = DISPLAY_BACKEND_CURSES;
+				} else if (!strcmp(optarg, "ansi")) {
+					backend = DISPLAY_BACKEND_ANSI;
+				} else {
+					fprintf(stderr, "unknown display backend '%s'\n", optarg);
+					return 1;
+				}
+				break;
+			case 'h':
+				print_usage(stdout, argv[0]);
+				return 0;
+			default:
+				print_usage(stderr, argv[0]);
+				return 1;
+		}
+	}
+
+	if (server.address && (bot || highscores || options.replay || options.asciicast || options.telemetry)) {
+		fprintf(stderr, "hosted games can't be played by bots, saved or recorded\n");
+		return 1;
+	}
+
+	if (bot && (options.replay || options.asciicast || options.telemetry)) {
+		fprintf(stderr, "bot games can't be saved as replays, recordings or telemetry\n");
+		return 1;
+	}
+
+	if ((server.address || bot) && hints) {
+		fprintf(stderr, "hints are only shown in games played in the terminal\n");
+		return 1;
+	}
+
+	if ((metrics_socket || metrics_file) && !well_metrics_enabled()) {
+		fprintf(stderr, "built without well metrics; configure with -DTETRIS_WELL_METRICS=ON\n");
+		return 1;
+	}
+
+	if (metrics_socket && well_metrics_serve(&metrics, metrics_socket)) {
+		fprintf(stderr, "failed to serve metrics at '%s'\n", metrics_socket);
+		return 1;
+	}
+
+	if (server.address) {
+		server.width = options.width;
+		server.height = options.height;
+		server.max_fps = options.max_fps;
+		server.randomizer = options.randomizer;
+		ret = serve_games(&server);
+	} else if (bot) {
+		ret = play_bot_games(bot, bot_games, options.width, options.height);
+	} else {
+		ret = play_game(&options, backend, highscores, hints, hint_book);
+	}
+
+	if (metrics_socket)
+		well_metrics_stop(&metrics);
+	if (metrics_file && well_metrics_save(metrics_file)) {
+		perror(metrics_file);
+		ret = 1;
+	}
+
+	return ret;
+}
@@ -0,0 +1,16 @@
+#include <time.h>
+
+#include "monotonic-clock.h"
+
+uint64_t monotonic_usec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+double monotonic_elapsed_sec(uint64_t start)
+{
+	return (double)(monotonic_usec() - start) / 1e6;
+}
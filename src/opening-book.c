@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "opening-book.h"
+#include "randomizer.h"
+
+/*
+ * Entries per bucket of the index, on average.
+ * */
+#define OPENING_BOOK_BUCKET 4
+#define OPENING_BOOK_MAX_INDEX_BITS 28
+
+#define FNV_OFFSET 0xCBF29CE484222325ULL
+#define FNV_PRIME 0x100000001B3ULL
+
+static size_t index_size(uint32_t index_bits);
+static size_t bucket_of(uint64_t hash, uint32_t index_bits);
+static int compare_entries(const void *a, const void *b);
+
+uint64_t opening_book_hash(const struct tetris_well *well)
+{
+	uint64_t hash = FNV_OFFSET;
+
+	for (size_t i = 0; i < well->height; i++) {
+		uint16_t row = 0;
+		for (size_t j = 0; j < well->width; j++) {
+			if (well->matrix[i][j] != CELL_TYPE_NONE)
+				row |= (uint16_t)(1u << j);
+		}
+
+		hash = (hash ^ (row & 0xFF)) * FNV_PRIME;
+		hash = (hash ^ (row >> 8)) * FNV_PRIME;
+	}
+
+	hash = (hash ^ well->tetrimino_type) * FNV_PRIME;
+	for (size_t i = well->tetrimino_bag_index; i > 0; i--)
+		hash = (hash ^ (uint64_t)(well->tetrimino_bag[i - 1] + 1)) * FNV_PRIME;
+
+	// the index relies on the top bits being uniform
+	return randomizer_mix(hash);
+}
+
+int opening_book_open(struct opening_book *book, const char *path)
+{
+	struct stat st;
+
+	memset(book, 0, sizeof(*book));
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return 1;
+
+	if (fstat(fd, &st) || (size_t)st.st_size < sizeof(struct opening_book_header)) {
+		close(fd);
+		return 1;
+	}
+
+	// the mapping outlives the descriptor
+	void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return 1;
+
+	const struct opening_book_header *header = map;
+	book->header = header;
+	book->size = (size_t)st.st_size;
+
+	if (memcmp(header->magic, OPENING_BOOK_MAGIC, sizeof(header->magic)) != 0 ||
+			header->version != OPENING_BOOK_VERSION ||
+			header->index_bits > OPENING_BOOK_MAX_INDEX_BITS ||
+			header->count > book->size / sizeof(struct opening_book_entry) ||
+			book->size != sizeof(*header) + index_size(header->index_bits) +
+					header->count * sizeof(struct opening_book_entry)) {
+		opening_book_close(book);
+		return 1;
+	}
+
+	book->index = (const uint32_t *)(header + 1);
+	book->entries = (const struct opening_book_entry *)((const char *)book->index + index_size(header->index_bits));
+
+	if (book->index[(size_t)1 << header->index_bits] != header->count) {
+		opening_book_close(book);
+		return 1;
+	}
+
+	return 0;
+}
+
+int opening_book_lookup(const struct opening_book *book, const struct tetris_well *well,
+		struct placement *placement)
+{
+	const struct opening_book_header *header = book->header;
+
+	if (well->width != header->width || well->height != header->height)
+		return 1;
+
+	uint64_t hash = opening_book_hash(well);
+	size_t bucket = bucket_of(hash, header->index_bits);
+
+	size_t end = book->index[bucket + 1];
+	if (end > header->count)
+		end = header->count;
+
+	for (size_t i = book->index[bucket]; i < end; i++) {
+		if (book->entries[i].hash == hash) {
+			*placement = book->entries[i].placement;
+			return 0;
+		}
+
+		if (book->entries[i].hash > hash)
+			break;
+	}
+
+	return 1;
+}
+
+void opening_book_close(struct opening_book *book)
+{
+	if (book->header)
+		munmap((void *)book->header, book->size);
+
+	memset(book, 0, sizeof(*book));
+}
+
+int opening_book_write(const char *path, struct opening_book_entry *entries, size_t count,
+		size_t width, size_t height, int depth, int beam)
+{
+	struct opening_book_header header;
+	char tmp_path[4096];
+
+	qsort(entries, count, sizeof(*entries), compare_entries);
+
+	size_t unique = 0;
+	for (size_t i = 0; i < count; i++) {
+		if (!unique || entries[unique - 1].hash != entries[i].hash)
+			entries[unique++] = entries[i];
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, OPENING_BOOK_MAGIC, sizeof(header.magic));
+	header.version = OPENING_BOOK_VERSION;
+	header.width = (uint32_t)width;
+	header.height = (uint32_t)height;
+	header.count = unique;
+	header.depth = (uint32_t)depth;
+	header.beam = (uint32_t)beam;
+	while (header.index_bits < OPENING_BOOK_MAX_INDEX_BITS &&
+			((size_t)OPENING_BOOK_BUCKET << header.index_bits) < unique)
+		header.index_bits++;
+
+	size_t buckets = (size_t)1 << header.index_bits;
+	uint32_t *index = calloc(index_size(header.index_bits), 1);
+	if (!index)
+		return 1;
+
+	// each bucket starts at the first entry in it, or where it would be
+	size_t entry = 0;
+	for (size_t bucket = 0; bucket <= buckets; bucket++) {
+		while (entry < unique && bucket_of(entries[entry].hash, header.index_bits) < bucket)
+			entry++;
+		index[bucket] = (uint32_t)entry;
+	}
+
+	/*
+	 * Write to a temporary file and rename it into place, so that processes
+	 * with the old book mapped keep a consistent copy.
+	 * */
+	if ((size_t)snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= sizeof(tmp_path)) {
+		free(index);
+		return 1;
+	}
+
+	FILE *out = fopen(tmp_path, "wb");
+	if (!out) {
+		free(index);
+		return 1;
+	}
+
+	int ret = fwrite(&header, sizeof(header), 1, out) != 1 ||
+			fwrite(index, index_size(header.index_bits), 1, out) != 1 ||
+			fwrite(entries, sizeof(*entries), unique, out) != unique;
+	ret |= fclose(out) != 0;
+	free(index);
+
+	if (ret || rename(tmp_path, path)) {
+		unlink(tmp_path);
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * The size of the index in bytes, padded to keep the entries after it aligned.
+ * */
+static size_t index_size(uint32_t index_bits)
+{
+	size_t size = (((size_t)1 << index_bits) + 1) * sizeof(uint32_t);
+	return (size + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+}
+
+static size_t bucket_of(uint64_t hash, uint32_t index_bits)
+{
+	return index_bits ? (size_t)(hash >> (64 - index_bits)) : 0;
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+	uint64_t x = ((const struct opening_book_entry *)a)->hash;
+	uint64_t y = ((const struct opening_book_entry *)b)->hash;
+
+	return (x > y) - (x < y);
+}
@@ -0,0 +1,644 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "perfect-clear.h"
+#include "randomizer.h"
+
+/*
+ * The search only looks at the rows to clear, and this many empty rows above
+ * them. A tetrimino fits in them in any orientation, and any position in
+ * them is reachable from the spawn, so tetriminos enter the board anywhere in
+ * those rows. Turning a tetrimino that sticks out above them can't bring it
+ * any lower than them, so the rows above don't matter.
+ * */
+#define PC_FREE_ROWS 4
+#define PC_MAX_BOARD (PERFECT_CLEAR_MAX_ROWS + PC_FREE_ROWS)
+
+#define PC_STATES (4 * PC_MAX_BOARD * BOARD_MAX_WIDTH)
+#define PC_STATE_WORDS ((PC_STATES + 63) / 64)
+
+/*
+ * A placement is kept only if its top cell is in the rows to clear, so in
+ * each orientation it has at most one position per column and row to clear.
+ * */
+#define PC_MAX_PLACEMENTS (4 * PERFECT_CLEAR_MAX_ROWS * BOARD_MAX_WIDTH)
+
+/*
+ * Dead ends are probed for this many slots past their hash before giving up.
+ * */
+#define PC_MEMO_PROBES 8
+
+struct pc_position {
+	uint8_t rotation;
+	int8_t x;
+	int8_t y;
+};
+
+/*
+ * A placement on the board being searched, with rows counted from the top of
+ * the board, and its cells packed into a key for sorting and comparing.
+ * */
+struct pc_placement {
+	uint8_t cells[4][2];
+	uint64_t key;
+};
+
+/*
+ * A tetrimino in one orientation: its cells relative to the pivot, their
+ * bounds, and the cells of each row it covers as a bitmask, starting from
+ * the top row and the leftmost column.
+ * */
+struct pc_shape {
+	int8_t cells[4][2];
+	int8_t min_x, max_x, min_y, max_y;
+	uint16_t rows[4];
+};
+
+struct pc_job {
+	pthread_mutex_t lock;
+	const struct perfect_clear_problem *problem;
+	const struct perfect_clear_options *options;
+
+	struct pc_shape shapes[7][4];
+	int board_rows;
+	int clear_rows;
+	uint16_t full_row;
+
+	uint16_t root_board[PC_MAX_BOARD];
+	struct pc_placement *roots;
+	size_t roots_nr;
+	size_t next_root;
+
+	uint64_t *memo;
+	size_t memo_mask;
+
+	unsigned long solutions;
+	size_t best_root;
+	struct perfect_clear_solution first;
+	unsigned long long nodes;
+};
+
+struct pc_worker {
+	struct pc_job *job;
+	pthread_t thread;
+	size_t root;
+	unsigned long found;
+	unsigned long long nodes;
+	struct perfect_clear_solution path;
+	struct pc_placement placements[PERFECT_CLEAR_MAX_PIECES][PC_MAX_PLACEMENTS];
+};
+
+static int choose_clear_rows(const struct perfect_clear_problem *problem);
+static void init_shapes(struct pc_job *job);
+static size_t find_placements(const struct pc_job *job, const uint16_t *board, int clear_rows,
+		uint8_t piece, struct pc_placement *placements);
+static struct pc_position rotate_position(const struct pc_job *job, uint8_t piece, struct pc_position position);
+static int fits(const struct pc_job *job, const uint16_t *board, uint8_t piece, struct pc_position position);
+static int apply_placement(const struct pc_job *job, const uint16_t *board, const struct pc_placement *placement,
+		uint16_t *next);
+static int groups_divisible(const struct pc_job *job, const uint16_t *board, int clear_rows);
+static void *pc_worker_main(void *data);
+static unsigned long pc_search(struct pc_worker *worker, const uint16_t *board, int clear_rows, size_t piece);
+static int should_stop(const struct pc_worker *worker);
+static void record_solution(struct pc_worker *worker, size_t nr);
+static void to_well_placement(const struct pc_job *job, const struct pc_placement *placement,
+		struct placement *out);
+static uint64_t memo_key(const struct pc_job *job, const uint16_t *board, int clear_rows, size_t piece);
+static int memo_contains(const struct pc_job *job, uint64_t key);
+static void memo_insert(struct pc_job *job, uint64_t key);
+
+void perfect_clear_options_init(struct perfect_clear_options *options)
+{
+	options->threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	options->max_solutions = 1;
+	options->memo_bits = 20;
+}
+
+int perfect_clear_from_well(struct perfect_clear_problem *problem, const struct tetris_well *well,
+		int clear_rows)
+{
+	memset(problem, 0, sizeof(*problem));
+	problem->width = well->width;
+	problem->height = well->height;
+	problem->clear_rows = clear_rows;
+
+	for (size_t i = 0; i < well->height; i++) {
+		size_t row = well->height - 1 - i;
+		uint16_t bits = 0;
+
+		for (size_t j = 0; j < well->width; j++) {
+			if (well->matrix[row][j] != CELL_TYPE_NONE)
+				bits |= (uint16_t)(1u << j);
+		}
+
+		if (bits && i >= PERFECT_CLEAR_MAX_ROWS)
+			return 1;
+		if (i < PERFECT_CLEAR_MAX_ROWS)
+			problem->rows[i] = bits;
+	}
+
+	for (uint8_t index = 0; index < 7; index++) {
+		if (well->tetrimino_type == (uint8_t)(1u << index))
+			problem->pieces[problem->pieces_nr++] = index;
+	}
+
+	for (size_t i = well->tetrimino_bag_index; i > 0 && problem->pieces_nr < PERFECT_CLEAR_MAX_PIECES; i--)
+		problem->pieces[problem->pieces_nr++] = (uint8_t)well->tetrimino_bag[i - 1];
+
+	return 0;
+}
+
+int perfect_clear_solve(const struct perfect_clear_problem *problem, const struct perfect_clear_options *options,
+		struct perfect_clear_result *result)
+{
+	struct pc_job job;
+	int threads = options->threads > 0 ? options->threads : 1;
+	int ret = 1;
+
+	memset(result, 0, sizeof(*result));
+
+	if (problem->width < BOARD_MIN_WIDTH || problem->width > BOARD_MAX_WIDTH ||
+			problem->pieces_nr > PERFECT_CLEAR_MAX_PIECES ||
+			options->memo_bits < 1 || options->memo_bits > 30)
+		return 1;
+
+	int clear_rows = choose_clear_rows(problem);
+	if (clear_rows <= 0)
+		return 1;
+
+	memset(&job, 0, sizeof(job));
+	job.problem = problem;
+	job.options = options;
+	job.clear_rows = clear_rows;
+	job.full_row = (uint16_t)((1u << problem->width) - 1);
+	job.board_rows = clear_rows + PC_FREE_ROWS;
+	if ((size_t)job.board_rows > problem->height)
+		return 1;
+
+	init_shapes(&job);
+	for (int i = 0; i < clear_rows; i++)
+		job.root_board[job.board_rows - 1 - i] = problem->rows[i];
+
+	job.memo_mask = ((size_t)1 << options->memo_bits) - 1;
+	job.memo = calloc(job.memo_mask + 1, sizeof(uint64_t));
+	job.roots = malloc(sizeof(struct pc_placement) * PC_MAX_PLACEMENTS);
+	struct pc_worker *workers = calloc((size_t)threads, sizeof(struct pc_worker));
+	if (!job.memo || !job.roots || !workers)
+		goto out;
+
+	pthread_mutex_init(&job.lock, NULL);
+	job.best_root = (size_t)-1;
+	job.roots_nr = groups_divisible(&job, job.root_board, clear_rows) ?
+			find_placements(&job, job.root_board, clear_rows, problem->pieces[0], job.roots) : 0;
+
+	int started = 0;
+	for (; started < threads; started++) {
+		workers[started].job = &job;
+		if (pthread_create(&workers[started].thread, NULL, pc_worker_main, &workers[started]))
+			break;
+	}
+
+	for (int i = 0; i < started; i++) {
+		pthread_join(workers[i].thread, NULL);
+		job.nodes += workers[i].nodes;
+	}
+
+	pthread_mutex_destroy(&job.lock);
+
+	if (started) {
+		result->solutions = job.solutions;
+		result->first = job.first;
+		result->clear_rows = clear_rows;
+		result->nodes = job.nodes + 1;
+		ret = 0;
+	}
+
+out:
+	free(workers);
+	free(job.roots);
+	free(job.memo);
+	return ret;
+}
+
+/*
+ * The number of rows to clear, checked against the stack and the tetriminos
+ * given, or zero if the problem can't be solved with any.
+ * */
+static int choose_clear_rows(const struct perfect_clear_problem *problem)
+{
+	int stack = 0;
+	size_t filled = 0;
+
+	for (int i = 0; i < PERFECT_CLEAR_MAX_ROWS; i++) {
+		if (problem->rows[i] & ~((1u << problem->width) - 1))
+			return 0;
+		if (problem->rows[i])
+			stack = i + 1;
+		filled += (size_t)__builtin_popcount(problem->rows[i]);
+	}
+
+	int first = problem->clear_rows ? problem->clear_rows : (stack ? stack : 1);
+	int last = problem->clear_rows ? problem->clear_rows : PERFECT_CLEAR_MAX_ROWS;
+	if (first < stack || last > PERFECT_CLEAR_MAX_ROWS)
+		return 0;
+
+	for (int rows = first; rows <= last; rows++) {
+		size_t empty = problem->width * (size_t)rows - filled;
+		if (empty % 4 == 0 && empty / 4 <= problem->pieces_nr)
+			return rows;
+	}
+
+	return 0;
+}
+
+/*
+ * Rotations turn the cells of a tetrimino about its pivot (the second cell),
+ * so the shape after any number of rotations follows from the shape it
+ * spawns with (see tetrimino_rotate()).
+ * */
+static void init_shapes(struct pc_job *job)
+{
+	for (size_t piece = 0; piece < 7; piece++) {
+		for (size_t i = 0; i < 4; i++) {
+			int dx = (int)cell_init_coords[piece][i][0] - (int)cell_init_coords[piece][1][0];
+			int dy = (int)cell_init_coords[piece][i][1] - (int)cell_init_coords[piece][1][1];
+
+			for (size_t rotation = 0; rotation < 4; rotation++) {
+				job->shapes[piece][rotation].cells[i][0] = (int8_t)dx;
+				job->shapes[piece][rotation].cells[i][1] = (int8_t)dy;
+
+				int turned = -dy;
+				dy = dx;
+				dx = turned;
+			}
+		}
+
+		for (size_t rotation = 0; rotation < 4; rotation++) {
+			struct pc_shape *shape = &job->shapes[piece][rotation];
+
+			shape->min_x = shape->max_x = shape->cells[0][0];
+			shape->min_y = shape->max_y = shape->cells[0][1];
+			for (size_t i = 1; i < 4; i++) {
+				shape->min_x = shape->cells[i][0] < shape->min_x ? shape->cells[i][0] : shape->min_x;
+				shape->max_x = shape->cells[i][0] > shape->max_x ? shape->cells[i][0] : shape->max_x;
+				shape->min_y = shape->cells[i][1] < shape->min_y ? shape->cells[i][1] : shape->min_y;
+				shape->max_y = shape->cells[i][1] > shape->max_y ? shape->cells[i][1] : shape->max_y;
+			}
+
+			for (size_t i = 0; i < 4; i++) {
+				shape->rows[shape->cells[i][1] - shape->min_y] |=
+						(uint16_t)(1u << (shape->cells[i][0] - shape->min_x));
+			}
+		}
+	}
+}
+
+/*
+ * Find every placement of the tetrimino within the rows to clear, sorted by
+ * the cells they cover. This is the search of tetrimino_placements(), except
+ * that it starts from every position above the stack at once.
+ * */
+static size_t find_placements(const struct pc_job *job, const uint16_t *board, int clear_rows,
+		uint8_t piece, struct pc_placement *placements)
+{
+	struct pc_position queue[PC_STATES];
+	uint64_t visited[PC_STATE_WORDS];
+	size_t head = 0, tail = 0, count = 0;
+	int width = (int)job->problem->width;
+	int top = job->board_rows - clear_rows;
+	int rotations = piece == 1 ? 1 : 4;
+
+	memset(visited, 0, sizeof(visited));
+
+#define VISIT(r, px, py) do { \
+		size_t index = ((size_t)(r) * PC_MAX_BOARD + (size_t)(py)) * BOARD_MAX_WIDTH + (size_t)(px); \
+		if (!(visited[index / 64] & ((uint64_t)1 << (index % 64)))) { \
+			visited[index / 64] |= (uint64_t)1 << (index % 64); \
+			queue[tail].rotation = (uint8_t)(r); \
+			queue[tail].x = (int8_t)(px); \
+			queue[tail++].y = (int8_t)(py); \
+		} \
+	} while (0)
+#define ABOVE(position) ((position).y + job->shapes[piece][(position).rotation].max_y < top)
+
+	/*
+	 * Every position entirely above the stack can be reached from the spawn,
+	 * so the search starts from the positions a move away from those, and
+	 * leaves them out from then on.
+	 * */
+	for (int rotation = 0; rotation < rotations; rotation++) {
+		for (int y = 0; y + job->shapes[piece][rotation].max_y < top; y++) {
+			for (int x = 0; x < width; x++) {
+				struct pc_position position = { (uint8_t)rotation, (int8_t)x, (int8_t)y };
+				if (!fits(job, board, piece, position))
+					continue;
+
+				struct pc_position down = { position.rotation, position.x, (int8_t)(position.y + 1) };
+				if (!ABOVE(down) && fits(job, board, piece, down))
+					VISIT(down.rotation, down.x, down.y);
+
+				struct pc_position rotated = rotate_position(job, piece, position);
+				if (rotations > 1 && !ABOVE(rotated) && fits(job, board, piece, rotated))
+					VISIT(rotated.rotation, rotated.x, rotated.y);
+			}
+		}
+	}
+
+	while (head < tail) {
+		struct pc_position position = queue[head++];
+		const struct pc_shape *shape = &job->shapes[piece][position.rotation];
+
+		struct pc_position left = { position.rotation, (int8_t)(position.x - 1), position.y };
+		if (fits(job, board, piece, left))
+			VISIT(left.rotation, left.x, left.y);
+
+		struct pc_position right = { position.rotation, (int8_t)(position.x + 1), position.y };
+		if (fits(job, board, piece, right))
+			VISIT(right.rotation, right.x, right.y);
+
+		struct pc_position down = { position.rotation, position.x, (int8_t)(position.y + 1) };
+		if (fits(job, board, piece, down)) {
+			VISIT(down.rotation, down.x, down.y);
+		} else {
+			// at rest; keep it if it's within the rows to clear
+			struct pc_placement placement;
+
+			if (position.y + shape->min_y >= top) {
+				for (size_t i = 0; i < 4; i++) {
+					placement.cells[i][0] = (uint8_t)(position.x + shape->cells[i][0]);
+					placement.cells[i][1] = (uint8_t)(position.y + shape->cells[i][1]);
+				}
+
+				uint64_t cells[4];
+				for (size_t i = 0; i < 4; i++)
+					cells[i] = (uint64_t)placement.cells[i][1] << 4 | placement.cells[i][0];
+				for (size_t i = 1; i < 4; i++) {
+					for (size_t j = i; j > 0 && cells[j - 1] > cells[j]; j--) {
+						uint64_t swap = cells[j];
+						cells[j] = cells[j - 1];
+						cells[j - 1] = swap;
+					}
+				}
+				placement.key = cells[0] << 27 | cells[1] << 18 | cells[2] << 9 | cells[3];
+
+				// insert in order, unless the same cells were reached in another orientation
+				size_t pos = count;
+				while (pos > 0 && placements[pos - 1].key > placement.key)
+					pos--;
+				if (!pos || placements[pos - 1].key != placement.key) {
+					memmove(&placements[pos + 1], &placements[pos], (count - pos) * sizeof(*placements));
+					placements[pos] = placement;
+					count++;
+				}
+			}
+		}
+
+		if (rotations == 1)
+			continue;
+
+		struct pc_position rotated = rotate_position(job, piece, position);
+		if (!ABOVE(rotated) && fits(job, board, piece, rotated))
+			VISIT(rotated.rotation, rotated.x, rotated.y);
+	}
+
+#undef ABOVE
+#undef VISIT
+
+	return count;
+}
+
+/*
+ * Rotate, pushed back within the walls and floor like tetrimino_rotate().
+ * */
+static struct pc_position rotate_position(const struct pc_job *job, uint8_t piece, struct pc_position position)
+{
+	int rotation = (position.rotation + 1) % 4;
+	const struct pc_shape *turned = &job->shapes[piece][rotation];
+	int width = (int)job->problem->width;
+	int min_x = position.x + turned->min_x, max_x = position.x + turned->max_x;
+	int min_y = position.y + turned->min_y, max_y = position.y + turned->max_y;
+
+	int off_x = min_x < 0 ? -min_x : (max_x >= width ? width - 1 - max_x : 0);
+	int off_y = min_y < 0 ? -min_y : (max_y >= job->board_rows ? job->board_rows - 1 - max_y : 0);
+	struct pc_position rotated = { (uint8_t)rotation, (int8_t)(position.x + off_x), (int8_t)(position.y + off_y) };
+
+	return rotated;
+}
+
+static int fits(const struct pc_job *job, const uint16_t *board, uint8_t piece, struct pc_position position)
+{
+	const struct pc_shape *shape = &job->shapes[piece][position.rotation];
+	int x = position.x + shape->min_x, y = position.y + shape->min_y;
+
+	if (x < 0 || position.x + shape->max_x >= (int)job->problem->width ||
+			y < 0 || position.y + shape->max_y >= job->board_rows)
+		return 0;
+
+	for (int i = 0; i <= shape->max_y - shape->min_y; i++) {
+		if (board[y + i] & (shape->rows[i] << x))
+			return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Lock the placement into a copy of the board, and clear any full rows.
+ * Returns the number of rows cleared.
+ * */
+static int apply_placement(const struct pc_job *job, const uint16_t *board, const struct pc_placement *placement,
+		uint16_t *next)
+{
+	uint16_t placed[PC_MAX_BOARD];
+	int cleared = 0;
+
+	memcpy(placed, board, sizeof(uint16_t) * (size_t)job->board_rows);
+	for (size_t i = 0; i < 4; i++)
+		placed[placement->cells[i][1]] |= (uint16_t)(1u << placement->cells[i][0]);
+
+	int to = job->board_rows - 1;
+	for (int from = job->board_rows - 1; from >= 0; from--) {
+		if (placed[from] == job->full_row)
+			cleared++;
+		else
+			next[to--] = placed[from];
+	}
+
+	for (; to >= 0; to--)
+		next[to] = 0;
+
+	return cleared;
+}
+
+/*
+ * A tetrimino can't cross a full column, so the empty cells on either side of
+ * one must be filled separately, four at a time. Line clears don't change
+ * that, since a cleared row takes the same number of empty cells (none) from
+ * every group.
+ * */
+static int groups_divisible(const struct pc_job *job, const uint16_t *board, int clear_rows)
+{
+	int empty = 0;
+
+	for (size_t j = 0; j < job->problem->width; j++) {
+		int column = 0;
+		for (int i = job->board_rows - clear_rows; i < job->board_rows; i++)
+			column += !(board[i] & (1u << j));
+
+		if (column) {
+			empty += column;
+			continue;
+		}
+
+		if (empty % 4)
+			return 0;
+		empty = 0;
+	}
+
+	return empty % 4 == 0;
+}
+
+static void *pc_worker_main(void *data)
+{
+	struct pc_worker *worker = data;
+	struct pc_job *job = worker->job;
+	uint16_t board[PC_MAX_BOARD];
+
+	while (1) {
+		size_t root = __atomic_fetch_add(&job->next_root, 1, __ATOMIC_RELAXED);
+		if (root >= job->roots_nr)
+			break;
+
+		worker->root = root;
+		worker->found = 0;
+		if (should_stop(worker))
+			break;
+
+		int rows = apply_placement(job, job->root_board, &job->roots[root], board);
+		to_well_placement(job, &job->roots[root], &worker->path.placements[0]);
+		worker->nodes++;
+
+		worker->found = pc_search(worker, board, job->clear_rows - rows, 1);
+	}
+
+	return NULL;
+}
+
+static unsigned long pc_search(struct pc_worker *worker, const uint16_t *board, int clear_rows, size_t piece)
+{
+	struct pc_job *job = worker->job;
+	uint16_t next[PC_MAX_BOARD];
+	unsigned long found = 0;
+
+	if (!clear_rows) {
+		record_solution(worker, piece);
+		return 1;
+	}
+
+	if (piece >= job->problem->pieces_nr || !groups_divisible(job, board, clear_rows))
+		return 0;
+
+	uint64_t key = memo_key(job, board, clear_rows, piece);
+	if (memo_contains(job, key))
+		return 0;
+
+	struct pc_placement *placements = worker->placements[piece];
+	size_t count = find_placements(job, board, clear_rows, job->problem->pieces[piece], placements);
+	worker->nodes++;
+
+	for (size_t i = 0; i < count && !should_stop(worker); i++) {
+		int rows = apply_placement(job, board, &placements[i], next);
+		to_well_placement(job, &placements[i], &worker->path.placements[piece]);
+
+		unsigned long solutions = pc_search(worker, next, clear_rows - rows, piece + 1);
+		found += solutions;
+		worker->found += solutions;
+	}
+
+	// a search cut short says nothing about whether this is a dead end
+	if (!found && !should_stop(worker))
+		memo_insert(job, key);
+
+	return found;
+}
+
+static int should_stop(const struct pc_worker *worker)
+{
+	const struct pc_job *job = worker->job;
+	unsigned long max = job->options->max_solutions;
+
+	// only a solution under an earlier first placement can come before this one
+	if (max == 1)
+		return worker->found || worker->root > __atomic_load_n(&job->best_root, __ATOMIC_RELAXED);
+
+	return max && __atomic_load_n(&job->solutions, __ATOMIC_RELAXED) >= max;
+}
+
+static void record_solution(struct pc_worker *worker, size_t nr)
+{
+	struct pc_job *job = worker->job;
+
+	pthread_mutex_lock(&job->lock);
+	__atomic_store_n(&job->solutions, job->solutions + 1, __ATOMIC_RELAXED);
+	if (worker->root < job->best_root) {
+		worker->path.nr = nr;
+		job->first = worker->path;
+		for (size_t i = 0; i < nr; i++)
+			placement_normalize(&job->first.placements[i]);
+		__atomic_store_n(&job->best_root, worker->root, __ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&job->lock);
+}
+
+static void to_well_placement(const struct pc_job *job, const struct pc_placement *placement,
+		struct placement *out)
+{
+	size_t offset = job->problem->height - (size_t)job->board_rows;
+
+	for (size_t i = 0; i < 4; i++) {
+		out->coords[i][0] = placement->cells[i][0];
+		out->coords[i][1] = (uint8_t)(placement->cells[i][1] + offset);
+	}
+}
+
+static uint64_t memo_key(const struct pc_job *job, const uint16_t *board, int clear_rows, size_t piece)
+{
+	uint64_t hash = (uint64_t)piece << 8 | (uint64_t)clear_rows;
+
+	for (int i = job->board_rows - clear_rows; i < job->board_rows; i++) {
+		hash = (hash ^ board[i]) * 0x9E3779B97F4A7C15ULL;
+		hash ^= hash >> 29;
+	}
+
+	hash = randomizer_mix(hash);
+
+	// zero marks an empty slot
+	return hash | 1;
+}
+
+static int memo_contains(const struct pc_job *job, uint64_t key)
+{
+	for (size_t i = 0; i < PC_MEMO_PROBES; i++) {
+		uint64_t entry = __atomic_load_n(&job->memo[(key + i) & job->memo_mask], __ATOMIC_RELAXED);
+		if (entry == key)
+			return 1;
+		if (!entry)
+			return 0;
+	}
+
+	return 0;
+}
+
+static void memo_insert(struct pc_job *job, uint64_t key)
+{
+	for (size_t i = 0; i < PC_MEMO_PROBES; i++) {
+		uint64_t *slot = &job->memo[(key + i) & job->memo_mask];
+		uint64_t expected = 0;
+
+		if (__atomic_compare_exchange_n(slot, &expected, key, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED) ||
+				expected == key)
+			return;
+	}
+}
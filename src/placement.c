@@ -0,0 +1,218 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "placement.h"
+
+/*
+ * Placements are found with a breadth-first search over the positions of the
+ * tetrimino, using the same shift and rotate operations as the game so that
+ * exactly the same moves are legal.
+ *
+ * Rotations always turn about tetrimino_coords[1], so the shape of the
+ * tetrimino relative to that pivot is determined by the number of rotations
+ * applied. A position is therefore identified by the rotation count (mod 4)
+ * and the cell of the pivot, which indexes a small bitset of visited states.
+ *
+ * The search needs no more room than the caller's placements: there are at
+ * most PLACEMENTS_MAX positions, each queued once as a placement with its
+ * rotation count in the spare high bits of its first column, and each
+ * position dequeued yields at most one resting place, whose key takes the
+ * slot of a position already dequeued.
+ * */
+#define STATE_INDEX(rotation, x, y) \
+	(((size_t)(rotation) * BOARD_MAX_HEIGHT + (size_t)(y)) * BOARD_MAX_WIDTH + (size_t)(x))
+#define STATE_WORDS (PLACEMENTS_MAX / 64)
+#define ROTATION_SHIFT 6
+
+static int visit(uint64_t visited[STATE_WORDS], size_t coords[4][2], unsigned rotation);
+static void enqueue(struct placement *position, size_t coords[4][2], unsigned rotation);
+static unsigned dequeue(struct placement *position, const struct placement *queued);
+static void load_coords(struct tetris_well *well, const struct placement *position);
+static void store_coords(struct placement *position, size_t coords[4][2]);
+static uint64_t placement_key(size_t coords[4][2]);
+static void placement_from_key(struct placement *placement, uint64_t key);
+static int compare_keys(const void *a, const void *b);
+
+size_t tetrimino_placements(struct tetris_well *well, struct placement *placements)
+{
+	uint64_t visited[STATE_WORDS];
+	size_t spawn[4][2];
+	size_t head = 0, tail = 0, count = 0;
+
+	memcpy(spawn, well->tetrimino_coords, sizeof(spawn));
+	memset(visited, 0, sizeof(visited));
+
+	for (size_t i = 0; i < 4; i++) {
+		if (well->matrix[spawn[i][1]][spawn[i][0]] != CELL_TYPE_NONE)
+			return 0;
+	}
+
+	enqueue(&placements[tail++], spawn, 0);
+	visit(visited, spawn, 0);
+
+	while (head < tail) {
+		struct placement position;
+		unsigned rotation = dequeue(&position, &placements[head++]);
+
+		static const int shifts[] = { SHIFT_LEFT, SHIFT_RIGHT, SHIFT_DOWN };
+		for (size_t i = 0; i < 3; i++) {
+			load_coords(well, &position);
+			if (tetrimino_shift(well, shifts[i])) {
+				// it can't shift down from here, so it can come to rest here
+				if (shifts[i] == SHIFT_DOWN) {
+					load_coords(well, &position);
+					uint64_t key = placement_key(well->tetrimino_coords);
+					memcpy(&placements[count++], &key, sizeof(key));
+				}
+
+				continue;
+			}
+
+			if (visit(visited, well->tetrimino_coords, rotation))
+				enqueue(&placements[tail++], well->tetrimino_coords, rotation);
+		}
+
+		// the O type turns in place, which isn't a new position
+		if (well->tetrimino_type == CELL_TYPE_O)
+			continue;
+
+		load_coords(well, &position);
+		if (tetrimino_rotate(well))
+			continue;
+
+		unsigned rotated = (rotation + 1) % 4;
+		if (visit(visited, well->tetrimino_coords, rotated))
+			enqueue(&placements[tail++], well->tetrimino_coords, rotated);
+	}
+
+	memcpy(well->tetrimino_coords, spawn, sizeof(spawn));
+
+	// the same cells can be reached in more than one orientation
+	qsort(placements, count, sizeof(*placements), compare_keys);
+
+	size_t unique = 0;
+	uint64_t previous = 0;
+	for (size_t i = 0; i < count; i++) {
+		uint64_t key;
+		memcpy(&key, &placements[i], sizeof(key));
+		if (i && key == previous)
+			continue;
+
+		placement_from_key(&placements[unique++], key);
+		previous = key;
+	}
+
+	return unique;
+}
+
+void placement_normalize(struct placement *placement)
+{
+	size_t coords[4][2];
+
+	for (size_t i = 0; i < 4; i++) {
+		coords[i][0] = placement->coords[i][0];
+		coords[i][1] = placement->coords[i][1];
+	}
+
+	placement_from_key(placement, placement_key(coords));
+}
+
+void tetrimino_place(struct tetris_well *well, const struct placement *placement)
+{
+	load_coords(well, placement);
+}
+
+/*
+ * Mark a position as visited, returning non-zero if it wasn't already.
+ * */
+static int visit(uint64_t visited[STATE_WORDS], size_t coords[4][2], unsigned rotation)
+{
+	size_t index = STATE_INDEX(rotation, coords[1][0], coords[1][1]);
+	uint64_t bit = (uint64_t)1 << (index % 64);
+
+	if (visited[index / 64] & bit)
+		return 0;
+
+	visited[index / 64] |= bit;
+	return 1;
+}
+
+/*
+ * Queue a position, with its rotation count packed into its first column,
+ * which only takes the low four bits.
+ * */
+static void enqueue(struct placement *position, size_t coords[4][2], unsigned rotation)
+{
+	store_coords(position, coords);
+	position->coords[0][0] |= (uint8_t)(rotation << ROTATION_SHIFT);
+}
+
+/*
+ * Copy a queued position out, before its slot is reused, returning its
+ * rotation count.
+ * */
+static unsigned dequeue(struct placement *position, const struct placement *queued)
+{
+	*position = *queued;
+	position->coords[0][0] &= (uint8_t)((1u << ROTATION_SHIFT) - 1);
+	return queued->coords[0][0] >> ROTATION_SHIFT;
+}
+
+static void load_coords(struct tetris_well *well, const struct placement *position)
+{
+	for (size_t i = 0; i < 4; i++) {
+		well->tetrimino_coords[i][0] = position->coords[i][0];
+		well->tetrimino_coords[i][1] = position->coords[i][1];
+	}
+}
+
+static void store_coords(struct placement *position, size_t coords[4][2])
+{
+	for (size_t i = 0; i < 4; i++) {
+		position->coords[i][0] = (uint8_t)coords[i][0];
+		position->coords[i][1] = (uint8_t)coords[i][1];
+	}
+}
+
+/*
+ * Pack the cells of a placement into an integer, in sorted order, so that
+ * placements covering the same cells have the same key regardless of the
+ * orientation they were reached in. Each cell takes 11 bits: 7 for the row
+ * and 4 for the column.
+ * */
+static uint64_t placement_key(size_t coords[4][2])
+{
+	uint64_t cells[4];
+
+	for (size_t i = 0; i < 4; i++)
+		cells[i] = (uint64_t)coords[i][1] << 4 | (uint64_t)coords[i][0];
+
+	// insertion sort; there are only four cells
+	for (size_t i = 1; i < 4; i++) {
+		uint64_t cell = cells[i];
+		size_t j = i;
+		for (; j > 0 && cells[j - 1] > cell; j--)
+			cells[j] = cells[j - 1];
+		cells[j] = cell;
+	}
+
+	return cells[0] << 33 | cells[1] << 22 | cells[2] << 11 | cells[3];
+}
+
+static void placement_from_key(struct placement *placement, uint64_t key)
+{
+	for (size_t i = 0; i < 4; i++) {
+		uint64_t cell = (key >> (33 - 11 * i)) & 0x7FF;
+		placement->coords[i][0] = (uint8_t)(cell & 0xF);
+		placement->coords[i][1] = (uint8_t)(cell >> 4);
+	}
+}
+
+static int compare_keys(const void *a, const void *b)
+{
+	uint64_t left, right;
+
+	memcpy(&left, a, sizeof(left));
+	memcpy(&right, b, sizeof(right));
+	return (left > right) - (left < right);
+}
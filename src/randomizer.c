@@ -0,0 +1,220 @@
+#include <string.h>
+
+#include "randomizer.h"
+
+#define PIECE_O 1
+#define PIECE_S 3
+#define PIECE_Z 4
+
+/*
+ * Pure random pieces need very few bits each, so every 64-bit draw is split
+ * into three 21-bit fields (leaving out the lowest bit), each scaled to a
+ * piece by a multiply and shift rather than a division. Pieces drawn but not
+ * yet asked for wait in the bag.
+ * */
+#define RANDOM_FIELD_BITS 21
+#define RANDOM_FIELD_MASK (((uint64_t)1 << RANDOM_FIELD_BITS) - 1)
+
+struct randomizer_impl {
+	const char *name;
+	void (*generate)(struct randomizer *, uint8_t *, size_t);
+};
+
+static void generate_bag(struct randomizer *randomizer, uint8_t *pieces, size_t count);
+static void generate_random(struct randomizer *randomizer, uint8_t *pieces, size_t count);
+static void generate_nes(struct randomizer *randomizer, uint8_t *pieces, size_t count);
+static void generate_tgm(struct randomizer *randomizer, uint8_t *pieces, size_t count);
+static uint64_t next_random(uint64_t *state);
+
+static const struct randomizer_impl randomizers[RANDOMIZER_COUNT] = {
+		{ "bag", generate_bag },
+		{ "random", generate_random },
+		{ "nes", generate_nes },
+		{ "tgm", generate_tgm },
+};
+
+void randomizer_init(struct randomizer *randomizer, int type, uint64_t seed)
+{
+	randomizer->type = type >= 0 && type < RANDOMIZER_COUNT ? type : RANDOMIZER_BAG;
+	randomizer->bag_left = 0;
+	randomizer->started = 0;
+	memset(randomizer->bag, 0, sizeof(randomizer->bag));
+
+	// TGM starts with a history of Z; the NES starts with no previous piece
+	memset(randomizer->history, PIECE_Z, sizeof(randomizer->history));
+	if (randomizer->type == RANDOMIZER_NES)
+		randomizer->history[0] = 7;
+
+	randomizer_seed(randomizer, seed);
+}
+
+void randomizer_seed(struct randomizer *randomizer, uint64_t seed)
+{
+	randomizer->rng = randomizer_state(seed);
+}
+
+void randomizer_generate(struct randomizer *randomizer, uint8_t *pieces, size_t count)
+{
+	randomizers[randomizer->type].generate(randomizer, pieces, count);
+}
+
+int randomizer_parse(const char *name)
+{
+	for (int i = 0; i < RANDOMIZER_COUNT; i++) {
+		if (!strcmp(name, randomizers[i].name))
+			return i;
+	}
+
+	return -1;
+}
+
+const char *randomizer_name(int type)
+{
+	if (type < 0 || type >= RANDOMIZER_COUNT)
+		return NULL;
+
+	return randomizers[type].name;
+}
+
+uint64_t randomizer_state(uint64_t seed)
+{
+	uint64_t state = randomizer_mix(seed + 0x9E3779B97F4A7C15ULL);
+
+	// xorshift state must never be zero
+	return state ? state : 0x9E3779B97F4A7C15ULL;
+}
+
+uint64_t randomizer_next(uint64_t *state)
+{
+	uint64_t x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+uint64_t randomizer_mix(uint64_t value)
+{
+	value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+	return value ^ (value >> 31);
+}
+
+/*
+ * Pieces are dealt from the end of a bag, and a new bag is shuffled once it
+ * runs out, so a bag can be split across calls.
+ * */
+static void generate_bag(struct randomizer *randomizer, uint8_t *pieces, size_t count)
+{
+	uint8_t *bag = randomizer->bag;
+
+	for (size_t n = 0; n < count; n++) {
+		if (!randomizer->bag_left) {
+			for (uint8_t i = 0; i < 7; i++)
+				bag[i] = i;
+
+			// perform Fisher-Yates shuffle of bag
+			for (size_t i = 7; i > 0; i--) {
+				size_t j = next_random(&randomizer->rng) % i;
+				uint8_t tmp = bag[j];
+				bag[j] = bag[i - 1];
+				bag[i - 1] = tmp;
+			}
+
+			randomizer->bag_left = 7;
+		}
+
+		pieces[n] = bag[--randomizer->bag_left];
+	}
+}
+
+static void generate_random(struct randomizer *randomizer, uint8_t *pieces, size_t count)
+{
+	size_t n = 0;
+
+	// leftovers first, so the sequence is the same however it is split up
+	while (n < count && randomizer->bag_left)
+		pieces[n++] = randomizer->bag[--randomizer->bag_left];
+
+	while (n < count) {
+		uint8_t drawn[3];
+
+		// the lowest bit of xorshift64* is its weakest
+		uint64_t x = randomizer_next(&randomizer->rng) >> 1;
+		for (size_t i = 0; i < 3; i++)
+			drawn[i] = (uint8_t)((((x >> (i * RANDOM_FIELD_BITS)) & RANDOM_FIELD_MASK) * 7) >> RANDOM_FIELD_BITS);
+
+		if (n + 3 <= count) {
+			memcpy(pieces + n, drawn, 3);
+			n += 3;
+			continue;
+		}
+
+		size_t used = count - n;
+		memcpy(pieces + n, drawn, used);
+		n += used;
+
+		for (size_t i = 3; i > used; i--)
+			randomizer->bag[randomizer->bag_left++] = drawn[i - 1];
+	}
+}
+
+/*
+ * The NES rolls one of eight values, where the eighth (or a repeat of the
+ * previous piece) asks for a second roll among the seven types, which is kept
+ * whatever it is.
+ * */
+static void generate_nes(struct randomizer *randomizer, uint8_t *pieces, size_t count)
+{
+	uint8_t previous = randomizer->history[0];
+
+	for (size_t n = 0; n < count; n++) {
+		uint8_t piece = (uint8_t)(next_random(&randomizer->rng) % 8);
+		if (piece == 7 || piece == previous)
+			piece = (uint8_t)(next_random(&randomizer->rng) % 7);
+
+		pieces[n] = previous = piece;
+	}
+
+	randomizer->history[0] = previous;
+}
+
+static void generate_tgm(struct randomizer *randomizer, uint8_t *pieces, size_t count)
+{
+	uint8_t *history = randomizer->history;
+
+	for (size_t n = 0; n < count; n++) {
+		uint8_t piece = 0;
+
+		if (!randomizer->started) {
+			do {
+				piece = (uint8_t)(next_random(&randomizer->rng) % 7);
+			} while (piece == PIECE_S || piece == PIECE_Z || piece == PIECE_O);
+
+			randomizer->started = 1;
+		} else {
+			for (int tries = 0; tries < 4; tries++) {
+				piece = (uint8_t)(next_random(&randomizer->rng) % 7);
+				if (piece != history[0] && piece != history[1] &&
+						piece != history[2] && piece != history[3])
+					break;
+			}
+		}
+
+		history[3] = history[2];
+		history[2] = history[1];
+		history[1] = history[0];
+		history[0] = pieces[n] = piece;
+	}
+}
+
+/*
+ * The high half of the generator's output; fast, and more than random enough
+ * for shuffling.
+ * */
+static uint64_t next_random(uint64_t *state)
+{
+	return randomizer_next(state) >> 32;
+}
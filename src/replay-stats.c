@@ -0,0 +1,177 @@
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "replay-stats.h"
+
+/*
+ * The state of a replay being added: the number of tetriminos locked and the
+ * holes and level before the latest lock.
+ * */
+struct playback {
+	struct replay_stats *stats;
+	unsigned long locked;
+	size_t holes;
+	int level;
+};
+
+static int playback_step(void *data, struct tetris_game *game, int step);
+static void add_lock(struct replay_stats *stats, const struct tetris_game *game, int level, size_t *holes);
+static size_t count_holes(const struct tetris_well *well);
+
+void replay_stats_init(struct replay_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+}
+
+int replay_stats_add(struct replay_stats *stats, const struct replay *replay)
+{
+	struct playback playback = { stats, 0, 0, 0 };
+	struct tetris_game game;
+
+	if (replay_play(replay, &game, playback_step, &playback)) {
+		stats->invalid++;
+		return 1;
+	}
+
+	stats->games++;
+	stats->ticks += game.ticks;
+
+	return 0;
+}
+
+int replay_stats_add_file(struct replay_stats *stats, const char *path)
+{
+	struct replay replay;
+	struct stat st;
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0 || fstat(fd, &st) || st.st_size <= 0) {
+		if (fd >= 0)
+			close(fd);
+		stats->invalid++;
+		return 1;
+	}
+
+	stats->bytes += (uint64_t)st.st_size;
+	void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		stats->invalid++;
+		return 1;
+	}
+
+	// the file is read once, front to back
+	madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+	int ret = replay_parse(&replay, data, (size_t)st.st_size);
+	munmap(data, (size_t)st.st_size);
+
+	if (ret) {
+		stats->invalid++;
+		return 1;
+	}
+
+	ret = replay_stats_add(stats, &replay);
+	replay_release(&replay);
+
+	return ret;
+}
+
+void replay_stats_merge(struct replay_stats *into, const struct replay_stats *from)
+{
+	into->games += from->games;
+	into->invalid += from->invalid;
+	into->bytes += from->bytes;
+	into->pieces += from->pieces;
+	into->ticks += from->ticks;
+
+	for (size_t y = 0; y < BOARD_MAX_HEIGHT; y++) {
+		for (size_t x = 0; x < BOARD_MAX_WIDTH; x++)
+			into->cells[y][x] += from->cells[y][x];
+	}
+
+	for (size_t type = 0; type < 7; type++) {
+		into->locks[type] += from->locks[type];
+		into->holes[type] += from->holes[type];
+		into->hole_locks[type] += from->hole_locks[type];
+		for (size_t x = 0; x < BOARD_MAX_WIDTH; x++)
+			into->columns[type][x] += from->columns[type][x];
+	}
+
+	for (size_t level = 0; level < REPLAY_STATS_LEVELS; level++) {
+		for (size_t lines = 0; lines < 5; lines++)
+			into->clears[level][lines] += from->clears[level][lines];
+	}
+}
+
+/*
+ * Check for a lock after every input and tick rather than every frame, since
+ * several inputs applied in the same tick may each lock a tetrimino.
+ * */
+static int playback_step(void *data, struct tetris_game *game, int step)
+{
+	struct playback *playback = data;
+
+	game->dirty = 0;
+	if (step != REPLAY_STEP_READY && game->pieces != playback->locked) {
+		add_lock(playback->stats, game, playback->level, &playback->holes);
+		playback->locked = game->pieces;
+		playback->level = game->level;
+	}
+
+	return 0;
+}
+
+/*
+ * Add the tetrimino that just locked, at the given level. `holes` is the
+ * number of holes in the well before the lock, and is updated to the number
+ * after it.
+ * */
+static void add_lock(struct replay_stats *stats, const struct tetris_game *game, int level, size_t *holes)
+{
+	const struct tetris_lock *lock = &game->last_lock;
+	size_t type = 0, left = BOARD_MAX_WIDTH;
+
+	while (type < 7 && lock->type != (1u << type))
+		type++;
+	if (type == 7)
+		return;
+
+	for (size_t i = 0; i < 4; i++) {
+		size_t x = lock->placement.coords[i][0], y = lock->placement.coords[i][1];
+
+		stats->cells[game->well.height - 1 - y][x]++;
+		if (x < left)
+			left = x;
+	}
+
+	size_t after = count_holes(&game->well);
+	if (after > *holes) {
+		stats->holes[type] += after - *holes;
+		stats->hole_locks[type]++;
+	}
+	*holes = after;
+
+	stats->pieces++;
+	stats->locks[type]++;
+	stats->columns[type][left]++;
+	stats->clears[level < REPLAY_STATS_LEVELS ? level : REPLAY_STATS_LEVELS - 1][lock->lines > 4 ? 4 : lock->lines]++;
+}
+
+static size_t count_holes(const struct tetris_well *well)
+{
+	size_t holes = 0;
+
+	for (size_t x = 0; x < well->width; x++) {
+		size_t y = 0;
+		while (y < well->height && well->matrix[y][x] == CELL_TYPE_NONE)
+			y++;
+
+		for (; y < well->height; y++)
+			holes += well->matrix[y][x] == CELL_TYPE_NONE;
+	}
+
+	return holes;
+}
@@ -0,0 +1,339 @@
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "replay.h"
+
+#define REPLAY_MAGIC "tetris-replay"
+#define REPLAY_VERSION 1
+#define REPLAY_LINE_MAX 128
+
+/*
+ * Ticks longer than this are left to sscanf(), so that they can't overflow.
+ * */
+#define REPLAY_TICK_DIGITS 18
+
+/*
+ * The frames drawn by replay_run(): the interval between frames, the time the
+ * next one is due, and where they go.
+ * */
+struct replay_frames {
+	uint64_t interval;
+	uint64_t next;
+	replay_frame_fn frame_fn;
+	void *data;
+};
+
+static int frame_step(void *data, struct tetris_game *game, int step);
+static int parse_header(const char *line, int index, struct replay *replay);
+static int parse_record(struct replay *replay, const char *line);
+static int append_event(struct replay *replay, unsigned long tick, int input);
+static const char *parse_event(const char *data, const char *end, unsigned long *tick, int *input);
+static int copy_line(const char **data, const char *end, char *line);
+
+void replay_init(struct replay *replay, uint64_t seed, size_t width, size_t height)
+{
+	replay->seed = seed;
+	replay->width = width;
+	replay->height = height;
+	replay->randomizer = RANDOMIZER_BAG;
+	replay->end_tick = 0;
+
+	replay->events = NULL;
+	replay->len = 0;
+	replay->alloc = 0;
+}
+
+int replay_append(struct replay *replay, unsigned long tick, int input)
+{
+	if (replay->len == replay->alloc) {
+		size_t alloc = replay->alloc ? replay->alloc * 2 : 256;
+		struct replay_event *events = realloc(replay->events, sizeof(*events) * alloc);
+		if (!events)
+			return 1;
+
+		replay->events = events;
+		replay->alloc = alloc;
+	}
+
+	replay->events[replay->len].tick = tick;
+	replay->events[replay->len].input = input;
+	replay->len++;
+
+	if (tick > replay->end_tick)
+		replay->end_tick = tick;
+
+	return 0;
+}
+
+int replay_write(const struct replay *replay, FILE *out)
+{
+	fprintf(out, "%s %d\n", REPLAY_MAGIC, REPLAY_VERSION);
+	fprintf(out, "seed %" PRIu64 "\n", replay->seed);
+	fprintf(out, "well %zu %zu\n", replay->width, replay->height);
+	if (replay->randomizer != RANDOMIZER_BAG)
+		fprintf(out, "randomizer %s\n", randomizer_name(replay->randomizer));
+
+	for (size_t i = 0; i < replay->len; i++)
+		fprintf(out, "%lu %d\n", replay->events[i].tick, replay->events[i].input);
+
+	fprintf(out, "end %lu\n", replay->end_tick);
+
+	return ferror(out) || fflush(out);
+}
+
+int replay_read(struct replay *replay, FILE *in)
+{
+	char line[REPLAY_LINE_MAX];
+	int ret;
+
+	if (!fgets(line, sizeof(line), in) || parse_header(line, 0, NULL))
+		return 1;
+	if (!fgets(line, sizeof(line), in) || parse_header(line, 1, replay))
+		return 1;
+	if (!fgets(line, sizeof(line), in) || parse_header(line, 2, replay))
+		return 1;
+
+	while (fgets(line, sizeof(line), in)) {
+		if ((ret = parse_record(replay, line)) < 0)
+			goto invalid;
+		if (ret)
+			break;
+	}
+
+	return 0;
+
+invalid:
+	replay_release(replay);
+	return 1;
+}
+
+int replay_parse(struct replay *replay, const char *data, size_t len)
+{
+	char line[REPLAY_LINE_MAX];
+	const char *end = data + len;
+	int ret = 0;
+
+	for (int i = 0; i < 3; i++) {
+		if (copy_line(&data, end, line) || parse_header(line, i, replay))
+			return 1;
+	}
+
+	while (data < end && !ret) {
+		unsigned long tick;
+		int input;
+
+		// input events make up nearly all of a replay, so parse them directly
+		const char *next = parse_event(data, end, &tick, &input);
+		if (next) {
+			if (append_event(replay, tick, input))
+				goto invalid;
+
+			data = next;
+			continue;
+		}
+
+		if (copy_line(&data, end, line) || (ret = parse_record(replay, line)) < 0)
+			goto invalid;
+	}
+
+	return 0;
+
+invalid:
+	replay_release(replay);
+	return 1;
+}
+
+int replay_play(const struct replay *replay, struct tetris_game *game, replay_step_fn step_fn, void *data)
+{
+	size_t event = 0;
+
+	if (tetris_game_init_randomizer(game, replay->width, replay->height, replay->seed, replay->randomizer))
+		return 1;
+
+	while (game->running) {
+		while (event < replay->len && replay->events[event].tick == game->ticks) {
+			tetris_game_input(game, replay->events[event++].input);
+			if (step_fn(data, game, REPLAY_STEP_INPUT))
+				return 1;
+		}
+
+		if (step_fn(data, game, REPLAY_STEP_READY))
+			return 1;
+
+		if (!game->running || (event == replay->len && game->ticks >= replay->end_tick))
+			break;
+
+		// jump through the ticks that change nothing, up to the next input or the end
+		unsigned long idle = game->dirty ? 0 : tetris_game_idle_ticks(game);
+		if (idle) {
+			unsigned long until = event < replay->len ? replay->events[event].tick : replay->end_tick;
+			tetris_game_skip_ticks(game, idle < until - game->ticks ? idle : until - game->ticks);
+			continue;
+		}
+
+		tetris_game_tick(game);
+		if (step_fn(data, game, REPLAY_STEP_TICK))
+			return 1;
+	}
+
+	return 0;
+}
+
+int replay_run(const struct replay *replay, struct tetris_game *game, int max_fps,
+		replay_frame_fn frame_fn, void *data)
+{
+	struct replay_frames frames = { max_fps > 0 ? 1000000 / (uint64_t)max_fps : 0, 0, frame_fn, data };
+
+	if (replay_play(replay, game, frame_step, &frames))
+		return 1;
+
+	// draw the final state of the game, if it changed since the last frame
+	if (frame_fn && game->dirty) {
+		if (frame_fn(data, (uint64_t)game->ticks * GAME_TICK_USEC, game))
+			return 1;
+
+		game->dirty = 0;
+	}
+
+	return 0;
+}
+
+void replay_release(struct replay *replay)
+{
+	free(replay->events);
+	replay->events = NULL;
+	replay->len = replay->alloc = 0;
+}
+
+/*
+ * Draw a frame once the inputs of a tick are applied, if the game changed and
+ * a frame is due. Until it is drawn, the game stays dirty, so that the
+ * playback doesn't skip past the tick at which it falls due.
+ * */
+static int frame_step(void *data, struct tetris_game *game, int step)
+{
+	struct replay_frames *frames = data;
+	uint64_t now = (uint64_t)game->ticks * GAME_TICK_USEC;
+
+	if (!frames->frame_fn) {
+		game->dirty = 0;
+		return 0;
+	}
+
+	if (step != REPLAY_STEP_READY || !game->dirty || now < frames->next)
+		return 0;
+
+	if (frames->frame_fn(frames->data, now, game))
+		return 1;
+
+	game->dirty = 0;
+	frames->next = now + frames->interval;
+	return 0;
+}
+
+/*
+ * Parse the header line at the given index: the magic and version, the seed,
+ * then the dimensions, which initialize the replay. Returns non-zero if the
+ * line isn't the expected header.
+ * */
+static int parse_header(const char *line, int index, struct replay *replay)
+{
+	int version;
+	size_t width, height;
+
+	switch (index) {
+		case 0:
+			return sscanf(line, REPLAY_MAGIC " %d", &version) != 1 || version != REPLAY_VERSION;
+		case 1:
+			return sscanf(line, "seed %" SCNu64, &replay->seed) != 1;
+		default:
+			if (sscanf(line, "well %zu %zu", &width, &height) != 2)
+				return 1;
+
+			replay_init(replay, replay->seed, width, height);
+			return 0;
+	}
+}
+
+/*
+ * Parse a line following the header. Returns 1 for the end record, 0 for any
+ * other valid record, and -1 if the line is invalid.
+ * */
+static int parse_record(struct replay *replay, const char *line)
+{
+	char name[16];
+	unsigned long tick;
+	int input;
+
+	if (!replay->len && sscanf(line, "randomizer %15s", name) == 1)
+		return (replay->randomizer = randomizer_parse(name)) < 0 ? -1 : 0;
+
+	if (sscanf(line, "end %lu", &tick) == 1) {
+		if (tick < replay->end_tick)
+			return -1;
+
+		replay->end_tick = tick;
+		return 1;
+	}
+
+	if (sscanf(line, "%lu %d", &tick, &input) != 2)
+		return -1;
+
+	return append_event(replay, tick, input) ? -1 : 0;
+}
+
+/*
+ * Append an input event, checking that it is valid and in order.
+ * */
+static int append_event(struct replay *replay, unsigned long tick, int input)
+{
+	if (input < INPUT_LEFT || input > INPUT_DROP)
+		return 1;
+
+	// events must be in the order they were applied
+	if (replay->len && tick < replay->events[replay->len - 1].tick)
+		return 1;
+
+	return replay_append(replay, tick, input);
+}
+
+/*
+ * Parse a line of the form "<tick> <input>\n" at `data`, returning the start
+ * of the next line, or NULL if the line is anything else.
+ * */
+static const char *parse_event(const char *data, const char *end, unsigned long *tick, int *input)
+{
+	unsigned long value = 0;
+	const char *p = data;
+
+	for (; p < end && *p >= '0' && *p <= '9' && p - data < REPLAY_TICK_DIGITS; p++)
+		value = value * 10 + (unsigned long)(*p - '0');
+
+	if (p == data || p + 2 >= end || *p != ' ' || p[1] < '0' || p[1] > '9' || p[2] != '\n')
+		return NULL;
+
+	*tick = value;
+	*input = p[1] - '0';
+	return p + 3;
+}
+
+/*
+ * Copy the line at `data` into `line`, NUL-terminated, and move `data` past
+ * it. Returns non-zero at the end of the data, or if the line is too long.
+ * */
+static int copy_line(const char **data, const char *end, char *line)
+{
+	const char *newline = memchr(*data, '\n', (size_t)(end - *data));
+	const char *line_end = newline ? newline : end;
+	size_t len = (size_t)(line_end - *data);
+
+	if (*data == end || len >= REPLAY_LINE_MAX)
+		return 1;
+
+	memcpy(line, *data, len);
+	line[len] = '\0';
+	*data = newline ? newline + 1 : end;
+
+	return 0;
+}
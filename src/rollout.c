@@ -0,0 +1,202 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "rollout.h"
+#include "placement.h"
+#include "evaluator.h"
+#include "randomizer.h"
+
+/*
+ * Threads claim rollouts ROLLOUT_CHUNK at a time, and only take the lock to
+ * claim a chunk and to add its results to the totals.
+ * */
+#define ROLLOUT_CHUNK 64
+
+/*
+ * z-score of a two-sided 95% confidence interval.
+ * */
+#define ROLLOUT_Z95 1.96
+
+struct rollout_sums {
+	unsigned long n;
+	double lines, lines_sq;
+	double score, score_sq;
+	double survived;
+};
+
+struct rollout_job {
+	pthread_mutex_t lock;
+	const struct tetris_game *game;
+	const struct rollout_options *options;
+	unsigned long next;
+	int stop;
+	struct rollout_sums sums;
+};
+
+static void *rollout_worker(void *data);
+static void rollout_play(struct rollout_job *job, unsigned long index,
+		struct placement *placements, struct rollout_sums *sums);
+static struct rollout_estimate estimate(unsigned long n, double sum, double sum_sq);
+
+void rollout_options_init(struct rollout_options *options)
+{
+	options->policy = ROLLOUT_POLICY_HEURISTIC;
+	options->depth = 10;
+	options->min_rollouts = 1000;
+	options->max_rollouts = 100000;
+	options->confidence = 0.05;
+	options->threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	options->seed = 1;
+}
+
+int rollout_evaluate(const struct tetris_game *game, const struct rollout_options *options,
+		struct rollout_result *result)
+{
+	struct rollout_job job;
+	int threads = options->threads > 0 ? options->threads : 1;
+	int ret = 0;
+
+	if (!game->running)
+		return 1;
+
+	pthread_t *workers = malloc(sizeof(pthread_t) * (size_t)threads);
+	if (!workers)
+		return 1;
+
+	memset(&job, 0, sizeof(job));
+	pthread_mutex_init(&job.lock, NULL);
+	job.game = game;
+	job.options = options;
+
+	int started = 0;
+	for (; started < threads; started++) {
+		if (pthread_create(&workers[started], NULL, rollout_worker, &job))
+			break;
+	}
+
+	for (int i = 0; i < started; i++)
+		pthread_join(workers[i], NULL);
+
+	if (!started || !job.sums.n)
+		ret = 1;
+
+	result->rollouts = job.sums.n;
+	result->lines = estimate(job.sums.n, job.sums.lines, job.sums.lines_sq);
+	result->score = estimate(job.sums.n, job.sums.score, job.sums.score_sq);
+	result->survival = estimate(job.sums.n, job.sums.survived, job.sums.survived);
+
+	pthread_mutex_destroy(&job.lock);
+	free(workers);
+
+	return ret;
+}
+
+static void *rollout_worker(void *data)
+{
+	struct rollout_job *job = data;
+	const struct rollout_options *options = job->options;
+
+	struct placement *placements = malloc(sizeof(struct placement) * PLACEMENTS_MAX);
+	if (!placements)
+		return NULL;
+
+	while (1) {
+		struct rollout_sums sums;
+		unsigned long first, last;
+
+		pthread_mutex_lock(&job->lock);
+		first = job->next;
+		last = first + ROLLOUT_CHUNK;
+		if (last > options->max_rollouts)
+			last = options->max_rollouts;
+		job->next = last;
+		int stop = job->stop || first >= last;
+		pthread_mutex_unlock(&job->lock);
+
+		if (stop)
+			break;
+
+		memset(&sums, 0, sizeof(sums));
+		for (unsigned long i = first; i < last; i++)
+			rollout_play(job, i, placements, &sums);
+
+		pthread_mutex_lock(&job->lock);
+		job->sums.n += sums.n;
+		job->sums.lines += sums.lines;
+		job->sums.lines_sq += sums.lines_sq;
+		job->sums.score += sums.score;
+		job->sums.score_sq += sums.score_sq;
+		job->sums.survived += sums.survived;
+
+		if (options->confidence > 0 && job->sums.n >= options->min_rollouts) {
+			struct rollout_estimate lines = estimate(job->sums.n, job->sums.lines, job->sums.lines_sq);
+			if (lines.interval <= options->confidence)
+				job->stop = 1;
+		}
+		pthread_mutex_unlock(&job->lock);
+	}
+
+	free(placements);
+	return NULL;
+}
+
+static void rollout_play(struct rollout_job *job, unsigned long index,
+		struct placement *placements, struct rollout_sums *sums)
+{
+	const struct rollout_options *options = job->options;
+	struct tetris_game game = *job->game;
+	// neighbouring rollouts get unrelated streams
+	uint64_t stream = randomizer_mix(options->seed + index * 0x9E3779B97F4A7C15ULL);
+
+	// the queued tetriminos are known; only those after them are up to chance
+	tetris_well_seed(&game.well, stream);
+	game.paused = 0;
+
+	uint64_t rng = randomizer_state(stream);
+
+	for (int depth = 0; depth < options->depth && game.running; depth++) {
+		size_t count = tetrimino_placements(&game.well, placements);
+		if (!count) {
+			game.running = 0;
+			break;
+		}
+
+		size_t choice;
+		if (options->policy == ROLLOUT_POLICY_RANDOM)
+			choice = (size_t)((randomizer_next(&rng) >> 32) % count);
+		else
+			choice = evaluator_best_placement(&game.well, placements, count, &evaluator_default_weights, NULL);
+
+		tetrimino_place(&game.well, &placements[choice]);
+		tetris_game_input(&game, INPUT_DROP);
+	}
+
+	double lines = game.lines - job->game->lines;
+	double score = game.score - job->game->score;
+
+	sums->n++;
+	sums->lines += lines;
+	sums->lines_sq += lines * lines;
+	sums->score += score;
+	sums->score_sq += score * score;
+	sums->survived += game.running ? 1 : 0;
+}
+
+static struct rollout_estimate estimate(unsigned long n, double sum, double sum_sq)
+{
+	struct rollout_estimate estimate = { 0, 0 };
+
+	if (!n)
+		return estimate;
+
+	estimate.mean = sum / (double)n;
+	if (n > 1) {
+		double variance = (sum_sq - sum * estimate.mean) / (double)(n - 1);
+		estimate.interval = ROLLOUT_Z95 * sqrt(variance > 0 ? variance / (double)n : 0);
+	}
+
+	return estimate;
+}
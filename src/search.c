@@ -0,0 +1,159 @@
+#include <stdlib.h>
+
+#include "search.h"
+
+struct search_candidate {
+	size_t index;
+	double value;
+};
+
+/*
+ * Scratch space for one level of the search. The search is depth first, so a
+ * single child well per level is enough.
+ * */
+struct search_level {
+	struct placement placements[PLACEMENTS_MAX];
+	struct search_candidate candidates[SEARCH_MAX_BEAM];
+	struct tetris_well child;
+};
+
+struct search_context {
+	const struct search_options *options;
+	struct search_level *levels;
+	int cancelled;
+};
+
+static double search_level(struct search_context *context, struct tetris_well *well, int level,
+		int lines, size_t *best);
+static size_t keep_candidate(struct search_candidate *candidates, size_t kept, size_t beam,
+		size_t index, double value);
+
+void search_options_init(struct search_options *options)
+{
+	options->depth = 4;
+	options->beam = 4;
+	options->weights = &evaluator_default_weights;
+	options->cancel = NULL;
+}
+
+int search_best_placement(const struct tetris_well *well, const struct search_options *options,
+		struct placement *best, double *value)
+{
+	struct search_context context;
+	size_t index;
+
+	if (options->depth < 1 || options->depth > SEARCH_MAX_DEPTH ||
+			options->beam < 1 || options->beam > SEARCH_MAX_BEAM)
+		return 1;
+
+	context.options = options;
+	context.cancelled = 0;
+	context.levels = malloc(sizeof(struct search_level) * (size_t)options->depth);
+	if (!context.levels)
+		return 1;
+
+	// the root is copied too, since finding placements needs a mutable well
+	context.levels[0].child = *well;
+	double result = search_level(&context, &context.levels[0].child, 0, 0, &index);
+	if (index != (size_t)-1) {
+		*best = context.levels[0].placements[index];
+		if (value)
+			*value = result;
+	}
+
+	free(context.levels);
+	return index == (size_t)-1 || context.cancelled;
+}
+
+/*
+ * Search from a well with its tetrimino spawned, returning the value of the
+ * best line of play, and the index of its first placement in `best` (or -1 if
+ * there are no placements), if non-NULL.
+ * */
+static double search_level(struct search_context *context, struct tetris_well *well, int level,
+		int lines, size_t *best)
+{
+	const struct search_options *options = context->options;
+	const struct evaluator_weights *weights = options->weights;
+	struct search_level *scratch = &context->levels[level];
+	struct tetris_well next;
+
+	if (best)
+		*best = (size_t)-1;
+
+	// checked once per board, which is as often as a search can be cut short cheaply
+	if (options->cancel && __atomic_load_n(options->cancel, __ATOMIC_RELAXED))
+		context->cancelled = 1;
+	if (context->cancelled)
+		return SEARCH_LOST;
+
+	size_t count = tetrimino_placements(well, scratch->placements);
+	if (!count)
+		return SEARCH_LOST;
+
+	// evaluate every placement on its own, keeping the most promising
+	size_t kept = 0;
+	for (size_t i = 0; i < count; i++) {
+		next = *well;
+		tetrimino_place(&next, &scratch->placements[i]);
+		int cleared = tetris_well_commit_tetrimino(&next);
+
+		double value = evaluator_evaluate(&next, cleared, weights) + weights->lines * lines;
+		kept = keep_candidate(scratch->candidates, kept, (size_t)options->beam, i, value);
+	}
+
+	// the end of the search, or of the tetriminos known in advance
+	if (level + 1 >= options->depth || !well->tetrimino_bag_index) {
+		if (best)
+			*best = scratch->candidates[0].index;
+		return scratch->candidates[0].value;
+	}
+
+	double best_value = 0;
+	for (size_t i = 0; i < kept; i++) {
+		struct tetris_well *child = &context->levels[level + 1].child;
+		size_t index = scratch->candidates[i].index;
+
+		*child = *well;
+		tetrimino_place(child, &scratch->placements[index]);
+		int cleared = tetris_well_commit_tetrimino(child);
+
+		double value = SEARCH_LOST;
+		if (!tetrimino_new(child))
+			value = search_level(context, child, level + 1, lines + cleared, NULL);
+
+		if (!i || value > best_value) {
+			best_value = value;
+			if (best)
+				*best = index;
+		}
+	}
+
+	return best_value;
+}
+
+/*
+ * Insert a candidate into the list of the best candidates so far, sorted by
+ * descending value, keeping at most `beam`. Earlier candidates win ties, so
+ * that the search is deterministic. Returns the new length of the list.
+ * */
+static size_t keep_candidate(struct search_candidate *candidates, size_t kept, size_t beam,
+		size_t index, double value)
+{
+	size_t pos = kept;
+	while (pos > 0 && candidates[pos - 1].value < value)
+		pos--;
+
+	if (pos >= beam)
+		return kept;
+
+	if (kept < beam)
+		kept++;
+	for (size_t i = kept - 1; i > pos; i--)
+		candidates[i] = candidates[i - 1];
+
+	candidates[pos].index = index;
+	candidates[pos].value = value;
+
+	return kept;
+}
@@ -0,0 +1,195 @@
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "submission.h"
+
+#define SUBMISSION_MAGIC "tetris-submission"
+#define SUBMISSION_VERSION 1
+#define SUBMISSION_LINE_MAX 64
+
+static const char *verdict_names[] = { "accepted", "invalid", "score", "lines", "level" };
+
+struct verification {
+	const struct submission *submission;
+	int verdict;
+};
+
+static int parse_header(const char **data, const char *end, const char *format, int *value);
+static unsigned long max_trailing_ticks(const struct replay *replay);
+static int verify_step(void *data, struct tetris_game *game, int step);
+static int diverged(const struct submission *submission, const struct tetris_game *game);
+
+int submission_parse(struct submission *submission, const char *data, size_t len)
+{
+	const char *end = data + len;
+	int version;
+
+	if (parse_header(&data, end, SUBMISSION_MAGIC " %d", &version) || version != SUBMISSION_VERSION)
+		return 1;
+	if (parse_header(&data, end, "score %d", &submission->score) || submission->score < 0)
+		return 1;
+	if (parse_header(&data, end, "lines %d", &submission->lines) || submission->lines < 0)
+		return 1;
+	if (parse_header(&data, end, "level %d", &submission->level) || submission->level < 0)
+		return 1;
+
+	return replay_parse(&submission->replay, data, (size_t)(end - data));
+}
+
+int submission_write(const struct submission *submission, FILE *out)
+{
+	fprintf(out, "%s %d\n", SUBMISSION_MAGIC, SUBMISSION_VERSION);
+	fprintf(out, "score %d\n", submission->score);
+	fprintf(out, "lines %d\n", submission->lines);
+	fprintf(out, "level %d\n", submission->level);
+
+	return replay_write(&submission->replay, out);
+}
+
+/*
+ * The result is checked against the claim after every input and tick, so that
+ * the first divergence is caught at the tick it happens.
+ * */
+int submission_verify(const struct submission *submission, struct submission_result *result)
+{
+	const struct replay *replay = &submission->replay;
+	struct verification verification = { submission, 0 };
+	struct tetris_game game;
+
+	memset(result, 0, sizeof(*result));
+
+	unsigned long last = replay->len ? replay->events[replay->len - 1].tick : 0;
+	if (replay->end_tick - last > max_trailing_ticks(replay))
+		return result->verdict = SUBMISSION_INVALID;
+
+	if (replay_play(replay, &game, verify_step, &verification) && !verification.verdict)
+		return result->verdict = SUBMISSION_INVALID;
+
+	// the game stopped short of the claim
+	result->verdict = verification.verdict;
+	if (!result->verdict) {
+		if (game.score != submission->score)
+			result->verdict = SUBMISSION_SCORE;
+		else if (game.lines != submission->lines)
+			result->verdict = SUBMISSION_LINES;
+		else if (game.level != submission->level)
+			result->verdict = SUBMISSION_LEVEL;
+	}
+
+	result->tick = result->verdict ? game.ticks : 0;
+	result->ticks = game.ticks;
+	result->score = game.score;
+	result->lines = game.lines;
+	result->level = game.level;
+
+	return result->verdict;
+}
+
+int submission_verify_file(const char *path, struct submission_result *result)
+{
+	struct submission submission;
+	struct stat st;
+
+	memset(result, 0, sizeof(*result));
+	result->verdict = SUBMISSION_INVALID;
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0 || fstat(fd, &st) || st.st_size <= 0) {
+		if (fd >= 0)
+			close(fd);
+		return result->verdict;
+	}
+
+	void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return result->verdict;
+
+	int ret = submission_parse(&submission, data, (size_t)st.st_size);
+	munmap(data, (size_t)st.st_size);
+	if (ret)
+		return result->verdict;
+
+	submission_verify(&submission, result);
+	submission_release(&submission);
+
+	return result->verdict;
+}
+
+const char *submission_verdict_name(int verdict)
+{
+	if (verdict < 0 || verdict > SUBMISSION_LEVEL)
+		return "unknown";
+
+	return verdict_names[verdict];
+}
+
+void submission_release(struct submission *submission)
+{
+	replay_release(&submission->replay);
+}
+
+/*
+ * Scan the header line at `data` with the given format, and move `data` past
+ * it. Returns non-zero if the line doesn't match.
+ * */
+static int parse_header(const char **data, const char *end, const char *format, int *value)
+{
+	char line[SUBMISSION_LINE_MAX];
+	const char *newline = memchr(*data, '\n', (size_t)(end - *data));
+	size_t len = newline ? (size_t)(newline - *data) : 0;
+
+	if (!newline || len >= sizeof(line))
+		return 1;
+
+	memcpy(line, *data, len);
+	line[len] = '\0';
+	*data = newline + 1;
+
+	return sscanf(line, format, value) != 1;
+}
+
+/*
+ * After its last input, a game can only go on until gravity fills the well:
+ * a few more tetriminos than the well holds, each falling its full height at
+ * the slowest speed. A recording always stops there at the latest, since a
+ * game in progress only stops on an input.
+ * */
+static unsigned long max_trailing_ticks(const struct replay *replay)
+{
+	unsigned long pieces = (unsigned long)(replay->width * replay->height) / 4 + 1;
+	unsigned long rows = (unsigned long)replay->height;
+
+	return pieces * rows * (unsigned long)(tetris_game_gravity(0) + 1);
+}
+
+static int verify_step(void *data, struct tetris_game *game, int step)
+{
+	struct verification *verification = data;
+
+	// nothing is drawn, so every change is dealt with at once
+	game->dirty = 0;
+	if (step == REPLAY_STEP_READY)
+		return 0;
+
+	return verification->verdict = diverged(verification->submission, game);
+}
+
+/*
+ * Since the score, lines and level only ever grow, the game has diverged from
+ * the claim as soon as any of them goes past it.
+ * */
+static int diverged(const struct submission *submission, const struct tetris_game *game)
+{
+	if (game->score > submission->score)
+		return SUBMISSION_SCORE;
+	if (game->lines > submission->lines)
+		return SUBMISSION_LINES;
+	if (game->level > submission->level)
+		return SUBMISSION_LEVEL;
+
+	return 0;
+}
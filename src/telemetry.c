@@ -0,0 +1,177 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include "telemetry.h"
+
+static void *telemetry_writer(void *data);
+static unsigned long telemetry_drain(struct telemetry *telemetry);
+
+int telemetry_open(struct telemetry *telemetry, FILE *out)
+{
+	telemetry->out = out;
+	telemetry->stop = 0;
+	telemetry->buffers = NULL;
+	telemetry->written = 0;
+	telemetry->dropped = 0;
+
+	pthread_mutex_init(&telemetry->lock, NULL);
+	pthread_cond_init(&telemetry->wake, NULL);
+
+	fprintf(out, "game,piece,usec,type,x0,y0,x1,y1,x2,y2,x3,y3,lines,lock_usec,score,level\n");
+
+	if (pthread_create(&telemetry->writer, NULL, telemetry_writer, telemetry)) {
+		pthread_cond_destroy(&telemetry->wake);
+		pthread_mutex_destroy(&telemetry->lock);
+		return 1;
+	}
+
+	return 0;
+}
+
+struct telemetry_buffer *telemetry_buffer_open(struct telemetry *telemetry)
+{
+	struct telemetry_buffer *buffer = malloc(sizeof(*buffer));
+	if (!buffer)
+		return NULL;
+
+	buffer->head = 0;
+	buffer->tail = 0;
+	buffer->dropped = 0;
+
+	pthread_mutex_lock(&telemetry->lock);
+	buffer->next = telemetry->buffers;
+	telemetry->buffers = buffer;
+	pthread_mutex_unlock(&telemetry->lock);
+
+	return buffer;
+}
+
+/*
+ * Only the recording thread writes `head`, and only the writer thread writes
+ * `tail`. The event is stored before `head` is published with release
+ * semantics, so the writer never sees an index before its event.
+ * */
+int telemetry_record(struct telemetry_buffer *buffer, const struct telemetry_event *event)
+{
+	uint64_t head = buffer->head;
+	uint64_t tail = __atomic_load_n(&buffer->tail, __ATOMIC_ACQUIRE);
+
+	if (head - tail >= TELEMETRY_BUFFER_EVENTS) {
+		buffer->dropped++;
+		return 1;
+	}
+
+	buffer->events[head % TELEMETRY_BUFFER_EVENTS] = *event;
+	__atomic_store_n(&buffer->head, head + 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+void telemetry_lock_event(struct telemetry_event *event, const struct tetris_game *game,
+		uint64_t seed, uint64_t usec)
+{
+	const struct tetris_lock *lock = &game->last_lock;
+
+	event->game = seed;
+	event->usec = usec;
+	event->piece = (uint32_t)(game->pieces - 1);
+	event->lock_usec = (uint32_t)((lock->tick - lock->spawn_tick) * GAME_TICK_USEC);
+	event->score = game->score;
+	event->level = (int16_t)game->level;
+	event->type = lock->type;
+	event->lines = (uint8_t)lock->lines;
+	memcpy(event->cells, lock->placement.coords, sizeof(event->cells));
+}
+
+int telemetry_close(struct telemetry *telemetry)
+{
+	pthread_mutex_lock(&telemetry->lock);
+	telemetry->stop = 1;
+	pthread_cond_signal(&telemetry->wake);
+	pthread_mutex_unlock(&telemetry->lock);
+
+	pthread_join(telemetry->writer, NULL);
+
+	struct telemetry_buffer *buffer = telemetry->buffers;
+	while (buffer) {
+		struct telemetry_buffer *next = buffer->next;
+		telemetry->dropped += buffer->dropped;
+		free(buffer);
+		buffer = next;
+	}
+	telemetry->buffers = NULL;
+
+	pthread_cond_destroy(&telemetry->wake);
+	pthread_mutex_destroy(&telemetry->lock);
+
+	return ferror(telemetry->out) || fflush(telemetry->out);
+}
+
+static void *telemetry_writer(void *data)
+{
+	struct telemetry *telemetry = data;
+
+	pthread_mutex_lock(&telemetry->lock);
+	while (1) {
+		int stop = telemetry->stop;
+
+		if (telemetry_drain(telemetry))
+			fflush(telemetry->out);
+
+		// everything recorded before the stream was closed is now written
+		if (stop)
+			break;
+
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_nsec += (long)TELEMETRY_FLUSH_USEC * 1000;
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+
+		while (!telemetry->stop) {
+			if (pthread_cond_timedwait(&telemetry->wake, &telemetry->lock, &deadline) == ETIMEDOUT)
+				break;
+		}
+	}
+	pthread_mutex_unlock(&telemetry->lock);
+
+	return NULL;
+}
+
+/*
+ * Write out the events waiting in every buffer, and hand their slots back to
+ * the recording threads. Called with the lock held, which only guards the
+ * list of buffers. Returns the number of events written.
+ * */
+static unsigned long telemetry_drain(struct telemetry *telemetry)
+{
+	unsigned long written = 0;
+
+	for (struct telemetry_buffer *buffer = telemetry->buffers; buffer; buffer = buffer->next) {
+		uint64_t head = __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+		uint64_t tail = buffer->tail;
+
+		for (; tail != head; tail++) {
+			const struct telemetry_event *event = &buffer->events[tail % TELEMETRY_BUFFER_EVENTS];
+
+			fprintf(telemetry->out, "%" PRIu64 ",%" PRIu32 ",%" PRIu64 ",%c", event->game, event->piece,
+					event->usec, tetrimino_name(event->type));
+			for (size_t i = 0; i < 4; i++)
+				fprintf(telemetry->out, ",%u,%u", event->cells[i][0], event->cells[i][1]);
+			fprintf(telemetry->out, ",%u,%" PRIu32 ",%" PRId32 ",%d\n", event->lines, event->lock_usec,
+					event->score, event->level);
+
+			written++;
+		}
+
+		__atomic_store_n(&buffer->tail, tail, __ATOMIC_RELEASE);
+	}
+
+	telemetry->written += written;
+	return written;
+}
@@ -0,0 +1,218 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "tetris-game.h"
+
+static const int score_chart[] = {0, 40, 100, 300, 1200};
+static const int level_gravity_speeds[] = {
+		48, 43, 38, 33, 28, 23, 18, 13, 8, 6, 5, 5, 5, 4, 4, 4, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1
+};
+
+#define update_score(score, level, lines_cleared) (score_chart[lines_cleared > 4 ? 4 : lines_cleared] * (level + 1) + score)
+#define update_level(level, lines_cleared, total_lines_cleared) (level + ((total_lines_cleared) > ((level + 1) * 10) ? 1 : 0))
+
+static void tetris_game_drop(struct tetris_game *game);
+static void tetris_game_commit(struct tetris_game *game);
+
+int tetris_game_init(struct tetris_game *game, size_t width, size_t height, uint64_t seed)
+{
+	return tetris_game_init_randomizer(game, width, height, seed, RANDOMIZER_BAG);
+}
+
+int tetris_game_init_randomizer(struct tetris_game *game, size_t width, size_t height,
+		uint64_t seed, int randomizer)
+{
+	if (tetris_well_init_dimensions(&game->well, width, height))
+		return 1;
+
+	tetris_well_randomizer(&game->well, randomizer, seed);
+
+	game->level = 0;
+	game->score = 0;
+	game->lines = 0;
+	game->ticks = 0;
+	game->frames = 0;
+	game->paused = 0;
+	game->running = !tetrimino_new(&game->well);
+	game->dirty = 1;
+	game->pieces = 0;
+	game->spawn_tick = 0;
+	memset(&game->last_lock, 0, sizeof(game->last_lock));
+
+	return 0;
+}
+
+void tetris_game_input(struct tetris_game *game, int input)
+{
+	if (!game->running)
+		return;
+
+	switch (input) {
+		case INPUT_RIGHT:
+			if (!game->paused && !tetrimino_shift(&game->well, SHIFT_RIGHT))
+				game->dirty = 1;
+			break;
+		case INPUT_LEFT:
+			if (!game->paused && !tetrimino_shift(&game->well, SHIFT_LEFT))
+				game->dirty = 1;
+			break;
+		case INPUT_DOWN:
+			if (!game->paused)
+				tetris_game_drop(game);
+			break;
+		case INPUT_ROTATE:
+			if (!game->paused && !tetrimino_rotate(&game->well))
+				game->dirty = 1;
+			break;
+		case INPUT_DROP:
+			if (!game->paused) {
+				while (!tetrimino_shift(&game->well, SHIFT_DOWN));
+				tetris_game_drop(game);
+			}
+			break;
+		case INPUT_PAUSE:
+			game->paused = !game->paused;
+			game->dirty = 1;
+			break;
+		case INPUT_STOP:
+			game->running = 0;
+			game->dirty = 1;
+	}
+}
+
+void tetris_game_tick(struct tetris_game *game)
+{
+	if (!game->running)
+		return;
+
+	game->ticks++;
+	if (game->paused)
+		return;
+
+	if (++game->frames > tetris_game_gravity(game->level)) {
+		game->frames = 0;
+		tetris_game_drop(game);
+	}
+}
+
+int tetris_game_step(struct tetris_game *game, const int *inputs, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		tetris_game_input(game, inputs[i]);
+
+	tetris_game_tick(game);
+	return game->running;
+}
+
+unsigned long tetris_game_idle_ticks(const struct tetris_game *game)
+{
+	if (!game->running || game->paused)
+		return ULONG_MAX;
+
+	// the tick that takes frames past the gravity of the level drops the tetrimino
+	int gravity = tetris_game_gravity(game->level);
+	return game->frames < gravity ? (unsigned long)(gravity - game->frames) : 0;
+}
+
+void tetris_game_skip_ticks(struct tetris_game *game, unsigned long count)
+{
+	if (!game->running)
+		return;
+
+	game->ticks += count;
+	if (!game->paused)
+		game->frames += (int)count;
+}
+
+int tetris_game_place(struct tetris_game *game, const struct placement *placement)
+{
+	struct placement target = *placement;
+	int ret = 1;
+
+	if (!game->running || game->paused)
+		return 1;
+
+	for (size_t i = 0; i < 4; i++) {
+		if (target.coords[i][0] >= game->well.width || target.coords[i][1] >= game->well.height)
+			return 1;
+	}
+
+	placement_normalize(&target);
+
+	// far too large for the stack of the threads that play games
+	struct placement *placements = malloc(sizeof(*placements) * PLACEMENTS_MAX);
+	if (!placements)
+		return 1;
+
+	size_t count = tetrimino_placements(&game->well, placements);
+	for (size_t i = 0; i < count; i++) {
+		if (!memcmp(&placements[i], &target, sizeof(target))) {
+			ret = tetris_game_place_trusted(game, &target);
+			break;
+		}
+	}
+
+	free(placements);
+	return ret;
+}
+
+int tetris_game_place_trusted(struct tetris_game *game, const struct placement *placement)
+{
+	if (!game->running || game->paused)
+		return 1;
+
+	tetrimino_place(&game->well, placement);
+	game->dirty = 1;
+	tetris_game_commit(game);
+	return 0;
+}
+
+int tetris_game_gravity(int level)
+{
+	return level_gravity_speeds[level > 29 ? 29 : level];
+}
+
+/*
+ * Shift the current tetrimino down a row, or if it cannot move any further,
+ * commit it to the well, update the score and spawn the next tetrimino.
+ * */
+static void tetris_game_drop(struct tetris_game *game)
+{
+	game->dirty = 1;
+
+	if (tetrimino_shift(&game->well, SHIFT_DOWN) >= 0)
+		return;
+
+	tetris_game_commit(game);
+}
+
+/*
+ * Commit the current tetrimino to the well, update the score and spawn the
+ * next tetrimino.
+ * */
+static void tetris_game_commit(struct tetris_game *game)
+{
+	struct tetris_lock *lock = &game->last_lock;
+
+	lock->type = game->well.tetrimino_type;
+	for (size_t i = 0; i < 4; i++) {
+		lock->placement.coords[i][0] = (uint8_t)game->well.tetrimino_coords[i][0];
+		lock->placement.coords[i][1] = (uint8_t)game->well.tetrimino_coords[i][1];
+	}
+	placement_normalize(&lock->placement);
+	lock->spawn_tick = game->spawn_tick;
+	lock->tick = game->ticks;
+
+	int lines = tetris_well_commit_tetrimino(&game->well);
+	game->lines = game->lines + lines;
+	game->score = update_score(game->score, game->level, lines);
+	game->level = update_level(game->level, lines, game->lines);
+
+	lock->lines = lines;
+	game->pieces++;
+	game->spawn_tick = game->ticks;
+
+	if (tetrimino_new(&game->well))
+		game->running = 0;
+}
@@ -6,6 +6,7 @@
 #include <assert.h>
 
 #include "tetris-well.h"
+#include "well-metrics.h"
 
 const size_t cell_init_coords[7][4][2] = {
 		{{4, 0}, /* pivot */ {4, 1}, {4, 2}, {4, 3}}, // type I
@@ -17,43 +18,92 @@ const size_t cell_init_coords[7][4][2] = {
 		{{4, 1}, /* pivot */ {5, 1}, {6, 1}, {6, 0}}, // type L
 };
 
+const char tetrimino_names[8] = "IOTSZJL";
+
 static int tetrimino_overlapping_on_board(struct tetris_well *, size_t [4][2]);
-static size_t fill_tetrimino_bag(size_t[7]);
+static void fill_tetrimino_queue(struct tetris_well *, size_t);
 
 void tetris_well_init(struct tetris_well *well)
 {
+	int ret = tetris_well_init_dimensions(well, BOARD_WIDTH, BOARD_HEIGHT);
+	assert(!ret /* standard well dimensions must always be supported */);
+	(void)ret;
+}
+
+int tetris_well_init_dimensions(struct tetris_well *well, size_t width, size_t height)
+{
+	if (width < BOARD_MIN_WIDTH || width > BOARD_MAX_WIDTH)
+		return 1;
+	if (height < BOARD_MIN_HEIGHT || height > BOARD_MAX_HEIGHT)
+		return 1;
+
 	struct timeval time;
 	int ret = gettimeofday(&time, NULL);
 	assert(!ret /* gettimeofday() failed; cannot seed RNG */);
+	(void)ret;
 
-	srandom((unsigned)time.tv_sec ^ (unsigned)time.tv_usec);
-
-	memset(well->matrix, 0, sizeof(uint8_t) * BOARD_HEIGHT * BOARD_WIDTH);
+	memset(well->matrix, 0, sizeof(uint8_t) * BOARD_MAX_HEIGHT * BOARD_MAX_WIDTH);
+	well->width = width;
+	well->height = height;
 	memset(well->tetrimino_coords, 0, sizeof(size_t) * 4 * 2);
 	well->tetrimino_type = CELL_TYPE_NONE;
 
-	memset(well->tetrimino_bag, 0, sizeof(size_t) * 7);
+	tetris_well_randomizer(well, RANDOMIZER_BAG, ((uint64_t)time.tv_sec << 20) ^ (uint64_t)time.tv_usec);
+
+	return 0;
+}
+
+void tetris_well_seed(struct tetris_well *well, uint64_t seed)
+{
+	randomizer_seed(&well->randomizer, seed);
+}
+
+void tetris_well_randomizer(struct tetris_well *well, int type, uint64_t seed)
+{
+	memset(well->tetrimino_bag, 0, sizeof(well->tetrimino_bag));
 	well->tetrimino_bag_index = 0;
+
+	randomizer_init(&well->randomizer, type, seed);
 }
 
 int tetrimino_new(struct tetris_well *well)
 {
 	if (!well->tetrimino_bag_index)
-		well->tetrimino_bag_index = fill_tetrimino_bag(well->tetrimino_bag);
+		fill_tetrimino_queue(well, 7);
 
 	size_t index = well->tetrimino_bag[well->tetrimino_bag_index - 1];
 	well->tetrimino_type = (uint8_t)((unsigned)1 << (index));
-	memcpy(well->tetrimino_coords, cell_init_coords[index], sizeof(size_t) * 4 * 2);
+
+	/* initial coordinates are laid out for the standard well; center them */
+	for (size_t i = 0; i < 4; i++) {
+		well->tetrimino_coords[i][0] = cell_init_coords[index][i][0] + well->width / 2 - BOARD_WIDTH / 2;
+		well->tetrimino_coords[i][1] = cell_init_coords[index][i][1];
+	}
 
 	well->tetrimino_bag_index--;
 
 	return tetrimino_overlapping_on_board(well, well->tetrimino_coords);
 }
 
+size_t tetrimino_preview(struct tetris_well *well, size_t *pieces, size_t count)
+{
+	if (count > TETRIMINO_QUEUE_MAX)
+		count = TETRIMINO_QUEUE_MAX;
+	if (well->tetrimino_bag_index < count)
+		fill_tetrimino_queue(well, count - well->tetrimino_bag_index);
+
+	for (size_t i = 0; i < count; i++)
+		pieces[i] = well->tetrimino_bag[well->tetrimino_bag_index - 1 - i];
+
+	return count;
+}
+
 int tetrimino_shift(struct tetris_well *well, int direction)
 {
 	size_t shifted_coordinates[4][2];
 
+	WELL_METRIC_ADD(WELL_METRIC_SHIFTS + direction, 1);
+
 	for (size_t i = 0; i < 4; i++) {
 		switch (direction) {
 			case SHIFT_LEFT:
@@ -66,7 +116,7 @@ int tetrimino_shift(struct tetris_well *well, int direction)
 				break;
 			case SHIFT_RIGHT:
 				// have we reached right board boundary
-				if (well->tetrimino_coords[i][0] == (BOARD_WIDTH - 1))
+				if (well->tetrimino_coords[i][0] == (well->width - 1))
 					return 1;
 
 				shifted_coordinates[i][0] = well->tetrimino_coords[i][0] + 1;
@@ -74,7 +124,7 @@ int tetrimino_shift(struct tetris_well *well, int direction)
 				break;
 			case SHIFT_DOWN:
 				// have we reached bottom board boundary
-				if (well->tetrimino_coords[i][1] == (BOARD_HEIGHT - 1))
+				if (well->tetrimino_coords[i][1] == (well->height - 1))
 					return -1;
 
 				shifted_coordinates[i][0] = well->tetrimino_coords[i][0];
@@ -102,6 +152,8 @@ int tetrimino_rotate(struct tetris_well *well)
 {
 	size_t rotated_coordinates[4][2];
 
+	WELL_METRIC_ADD(WELL_METRIC_ROTATIONS, 1);
+
 	/* game piece O does not rotate */
 	if (well->tetrimino_type == CELL_TYPE_O)
 		return 0;
@@ -122,8 +174,8 @@ int tetrimino_rotate(struct tetris_well *well)
 			off_x += -x;
 			i = 0;
 			continue;
-		} else if (x >= BOARD_WIDTH) {
-			off_x += -(x - BOARD_WIDTH + 1);
+		} else if (x >= (ssize_t)well->width) {
+			off_x += -(x - (ssize_t)well->width + 1);
 			i = 0;
 			continue;
 		}
@@ -132,22 +184,24 @@ int tetrimino_rotate(struct tetris_well *well)
 			off_y += -y;
 			i = 0;
 			continue;
-		} else if (y >= BOARD_HEIGHT) {
-			off_y += -(y - BOARD_HEIGHT + 1);
+		} else if (y >= (ssize_t)well->height) {
+			off_y += -(y - (ssize_t)well->height + 1);
 			i = 0;
 			continue;
 		}
 
-		assert(x >= 0 && x < BOARD_WIDTH);
-		assert(y >= 0 && y < BOARD_HEIGHT);
+		assert(x >= 0 && x < (ssize_t)well->width);
+		assert(y >= 0 && y < (ssize_t)well->height);
 		rotated_coordinates[i][0] = x;
 		rotated_coordinates[i][1] = y;
 		i++;
 	}
 
 	// determine if any coordinates overlap with other pieces on the board
-	if (tetrimino_overlapping_on_board(well, rotated_coordinates))
+	if (tetrimino_overlapping_on_board(well, rotated_coordinates)) {
+		WELL_METRIC_ADD(WELL_METRIC_ROTATIONS_BLOCKED, 1);
 		return 1;
+	}
 
 	// commit rotation
 	for (i = 0; i < 4; i++) {
@@ -172,21 +226,35 @@ int tetris_well_commit_tetrimino(struct tetris_well *well)
 	}
 
 	// from bottom to top, shift any rows that are full
-	for (size_t i = 0; i < BOARD_HEIGHT; i++) {
-		if (!memchr(well->matrix[i], CELL_TYPE_NONE, sizeof(uint8_t) * BOARD_WIDTH)) {
+	for (size_t i = 0; i < well->height; i++) {
+		if (!memchr(well->matrix[i], CELL_TYPE_NONE, sizeof(uint8_t) * well->width)) {
 			for (size_t j = i; j > 0; j--)
-				memcpy(well->matrix[j], well->matrix[j - 1], sizeof(uint8_t) * BOARD_WIDTH);
+				memcpy(well->matrix[j], well->matrix[j - 1], sizeof(uint8_t) * well->width);
 
-			memset(well->matrix[0], CELL_TYPE_NONE, sizeof(uint8_t) * BOARD_WIDTH);
+			memset(well->matrix[0], CELL_TYPE_NONE, sizeof(uint8_t) * well->width);
 			rows_collapsed++;
 		}
 	}
 
+	WELL_METRIC_ADD(WELL_METRIC_COMMITS, 1);
+	WELL_METRIC_ADD(WELL_METRIC_ROWS_CLEARED, rows_collapsed);
 	return rows_collapsed;
 }
 
+char tetrimino_name(uint8_t type)
+{
+	for (size_t i = 0; i < 7; i++) {
+		if (type == (uint8_t)((unsigned)1 << i))
+			return tetrimino_names[i];
+	}
+
+	return '-';
+}
+
 static int tetrimino_overlapping_on_board(struct tetris_well *well, size_t coords[4][2])
 {
+	WELL_METRIC_ADD(WELL_METRIC_OVERLAP_CHECKS, 1);
+
 	for (size_t i = 0; i < 4; i++) {
 		size_t x_coord = coords[i][0];
 		size_t y_coord = coords[i][1];
@@ -198,20 +266,22 @@ static int tetrimino_overlapping_on_board(struct tetris_well *well, size_t coord
 	return 0;
 }
 
-static size_t fill_tetrimino_bag(size_t bag[7])
+/*
+ * Generate `count` more tetriminos onto the end of the queue. The queue is
+ * read from the top, so the tetriminos already in it move up to make room,
+ * and the new ones go underneath, last generated at the bottom.
+ * */
+static void fill_tetrimino_queue(struct tetris_well *well, size_t count)
 {
-	size_t i = 0, j = 0, tmp;
+	uint8_t pieces[TETRIMINO_QUEUE_MAX];
+	size_t queued = well->tetrimino_bag_index;
 
-	for (i = 0; i < 7; i++)
-		bag[i] = i;
+	WELL_METRIC_ADD(WELL_METRIC_BAG_REFILLS, 1);
+	randomizer_generate(&well->randomizer, pieces, count);
 
-	// perform Fisher-Yates shuffle of bag
-	for (i = 7; i > 0; i--) {
-		j = random() % i;
-		tmp = bag[j];
-		bag[j] = bag[i - 1];
-		bag[i - 1] = tmp;
-	}
+	memmove(well->tetrimino_bag + count, well->tetrimino_bag, sizeof(size_t) * queued);
+	for (size_t i = 0; i < count; i++)
+		well->tetrimino_bag[count - 1 - i] = pieces[i];
 
-	return 7;
+	well->tetrimino_bag_index = queued + count;
 }
@@ -0,0 +1,116 @@
+#include <string.h>
+
+#include "timer-wheel.h"
+
+#define TICK_OF(usec) ((usec) / TIMER_WHEEL_TICK_USEC)
+
+static void slot_insert(struct timer **slot, struct timer *timer);
+
+void timer_wheel_init(struct timer_wheel *wheel, uint64_t now)
+{
+	wheel->tick = TICK_OF(now);
+	wheel->count = 0;
+	memset(wheel->slots, 0, sizeof(wheel->slots));
+}
+
+void timer_wheel_add(struct timer_wheel *wheel, struct timer *timer, uint64_t expires)
+{
+	uint64_t tick = TICK_OF(expires);
+
+	// overdue timers go in the current slot, to fire on the next advance
+	if (tick < wheel->tick)
+		tick = wheel->tick;
+
+	timer->expires = expires;
+	slot_insert(&wheel->slots[tick % TIMER_WHEEL_SLOTS], timer);
+	wheel->count++;
+}
+
+void timer_wheel_remove(struct timer_wheel *wheel, struct timer *timer)
+{
+	if (!timer->pprev)
+		return;
+
+	*timer->pprev = timer->next;
+	if (timer->next)
+		timer->next->pprev = timer->pprev;
+
+	timer->next = NULL;
+	timer->pprev = NULL;
+	wheel->count--;
+}
+
+void timer_wheel_advance(struct timer_wheel *wheel, uint64_t now, timer_fn fn, void *data)
+{
+	uint64_t now_tick = TICK_OF(now);
+	if (now_tick < wheel->tick)
+		now_tick = wheel->tick;
+
+	// a full turn visits every slot; turns after that would find nothing new
+	uint64_t last = now_tick;
+	if (last - wheel->tick >= TIMER_WHEEL_SLOTS)
+		last = wheel->tick + TIMER_WHEEL_SLOTS - 1;
+
+	for (uint64_t tick = wheel->tick; tick <= last; tick++) {
+		struct timer **slot = &wheel->slots[tick % TIMER_WHEEL_SLOTS];
+
+		// detach the slot first, since callbacks may add timers back to it
+		struct timer *pending = *slot;
+		if (pending)
+			pending->pprev = &pending;
+		*slot = NULL;
+
+		while (pending) {
+			struct timer *timer = pending;
+			timer_wheel_remove(wheel, timer);
+
+			if (timer->expires > now) {
+				slot_insert(slot, timer);
+				wheel->count++;
+				continue;
+			}
+
+			fn(data, timer);
+		}
+	}
+
+	/*
+	 * The slot of the current tick is visited again on the next advance,
+	 * since timers later in the same tick aren't due yet.
+	 * */
+	wheel->tick = now_tick;
+}
+
+uint64_t timer_wheel_next(const struct timer_wheel *wheel)
+{
+	if (!wheel->count)
+		return UINT64_MAX;
+
+	for (uint64_t tick = wheel->tick; tick < wheel->tick + TIMER_WHEEL_SLOTS; tick++) {
+		const struct timer *timer = wheel->slots[tick % TIMER_WHEEL_SLOTS];
+		if (!timer)
+			continue;
+
+		// due in this slot on this turn, or on a later turn
+		uint64_t earliest = timer->expires;
+		for (; timer; timer = timer->next) {
+			if (timer->expires < earliest)
+				earliest = timer->expires;
+		}
+
+		uint64_t start = tick * TIMER_WHEEL_TICK_USEC;
+		return earliest > start ? (earliest < start + TIMER_WHEEL_TICK_USEC ? earliest : start) : start;
+	}
+
+	return (wheel->tick + TIMER_WHEEL_SLOTS) * TIMER_WHEEL_TICK_USEC;
+}
+
+static void slot_insert(struct timer **slot, struct timer *timer)
+{
+	timer->next = *slot;
+	if (timer->next)
+		timer->next->pprev = &timer->next;
+
+	*slot = timer;
+	timer->pprev = slot;
+}
@@ -0,0 +1,325 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "training-data.h"
+
+/*
+ * Columns, in the order they are written.
+ * */
+#define COLUMN_GAME 0
+#define COLUMN_PIECE 1
+#define COLUMN_REWARD 2
+#define COLUMN_ROWS 3
+#define COLUMN_CANDIDATES_NR 4
+#define COLUMN_CHOSEN 5
+#define COLUMN_PIECES 6
+#define COLUMN_LINES 7
+#define COLUMN_DONE 8
+#define COLUMN_CANDIDATES 9
+
+#define TRAINING_DEFAULT_PIECES 8
+#define TRAINING_DEFAULT_CANDIDATES 64
+#define TRAINING_DEFAULT_CHUNK_RECORDS 4096
+
+static size_t pad(size_t bytes);
+static void *training_writer_main(void *data);
+static int hand_over(struct training_stream *stream);
+static int write_chunk(struct training_writer *writer, struct training_chunk *chunk);
+
+void training_options_init(struct training_options *options, size_t width, size_t height)
+{
+	options->width = width;
+	options->height = height;
+	options->pieces = TRAINING_DEFAULT_PIECES;
+	options->max_candidates = TRAINING_DEFAULT_CANDIDATES;
+	options->chunk_records = TRAINING_DEFAULT_CHUNK_RECORDS;
+	options->writer_thread = 1;
+}
+
+int training_writer_open(struct training_writer *writer, FILE *out, const struct training_options *options)
+{
+	struct training_data_header header;
+
+	memset(writer, 0, sizeof(*writer));
+	writer->out = out;
+	writer->options = *options;
+
+	if (options->width < BOARD_MIN_WIDTH || options->width > BOARD_MAX_WIDTH ||
+			options->height < BOARD_MIN_HEIGHT || options->height > BOARD_MAX_HEIGHT ||
+			options->pieces < 1 || options->pieces > TETRIMINO_QUEUE_MAX + 1 ||
+			options->max_candidates < 1 || options->max_candidates > TRAINING_MAX_CANDIDATES ||
+			options->chunk_records < 1)
+		return 1;
+
+	writer->column_size[COLUMN_GAME] = sizeof(uint64_t);
+	writer->column_size[COLUMN_PIECE] = sizeof(uint32_t);
+	writer->column_size[COLUMN_REWARD] = sizeof(int32_t);
+	writer->column_size[COLUMN_ROWS] = sizeof(uint16_t) * options->height;
+	writer->column_size[COLUMN_CANDIDATES_NR] = sizeof(uint16_t);
+	writer->column_size[COLUMN_CHOSEN] = sizeof(uint16_t);
+	writer->column_size[COLUMN_PIECES] = options->pieces;
+	writer->column_size[COLUMN_LINES] = sizeof(uint8_t);
+	writer->column_size[COLUMN_DONE] = sizeof(uint8_t);
+	writer->column_size[COLUMN_CANDIDATES] = sizeof(struct placement) * options->max_candidates;
+
+	// chunks are filled in place, with every column sized for a full chunk
+	size_t record_size = 0;
+	for (size_t i = 0; i < TRAINING_COLUMNS; i++) {
+		writer->column_offset[i] = sizeof(struct training_chunk_header) + options->chunk_records * record_size;
+		record_size += writer->column_size[i];
+	}
+
+	if (options->chunk_records > UINT32_MAX / record_size)
+		return 1;
+	writer->chunk_size = sizeof(struct training_chunk_header) + pad(options->chunk_records * record_size);
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TRAINING_DATA_MAGIC, sizeof(header.magic));
+	header.version = TRAINING_DATA_VERSION;
+	header.width = (uint32_t)options->width;
+	header.height = (uint32_t)options->height;
+	header.pieces = (uint32_t)options->pieces;
+	header.max_candidates = (uint32_t)options->max_candidates;
+	header.chunk_records = (uint32_t)options->chunk_records;
+
+	if (fwrite(&header, sizeof(header), 1, out) != 1)
+		return 1;
+	writer->bytes = sizeof(header);
+
+	pthread_mutex_init(&writer->lock, NULL);
+	pthread_cond_init(&writer->wake, NULL);
+	pthread_cond_init(&writer->written, NULL);
+
+	if (options->writer_thread && pthread_create(&writer->thread, NULL, training_writer_main, writer)) {
+		pthread_cond_destroy(&writer->written);
+		pthread_cond_destroy(&writer->wake);
+		pthread_mutex_destroy(&writer->lock);
+		return 1;
+	}
+
+	return 0;
+}
+
+struct training_stream *training_stream_open(struct training_writer *writer)
+{
+	struct training_stream *stream = calloc(1, sizeof(*stream));
+	if (!stream)
+		return NULL;
+
+	// a single chunk is enough without a writer thread to hand the other to
+	for (size_t i = 0; i < (writer->options.writer_thread ? 2 : 1); i++) {
+		stream->chunks[i].data = malloc(writer->chunk_size);
+		if (!stream->chunks[i].data) {
+			free(stream->chunks[0].data);
+			free(stream);
+			return NULL;
+		}
+	}
+
+	stream->writer = writer;
+	stream->filling = &stream->chunks[0];
+
+	pthread_mutex_lock(&writer->lock);
+	stream->next = writer->streams;
+	writer->streams = stream;
+	pthread_mutex_unlock(&writer->lock);
+
+	return stream;
+}
+
+int training_record(struct training_stream *stream, const struct training_record *record)
+{
+	struct training_writer *writer = stream->writer;
+	const struct tetris_well *well = record->well;
+	struct training_chunk *chunk = stream->filling;
+	size_t index = chunk->records;
+
+	if (!record->candidates_nr || record->chosen >= record->candidates_nr)
+		return 1;
+
+#define COLUMN(column) (chunk->data + writer->column_offset[column] + index * writer->column_size[column])
+
+	*(uint64_t *)COLUMN(COLUMN_GAME) = record->game;
+	*(uint32_t *)COLUMN(COLUMN_PIECE) = record->piece;
+	*(int32_t *)COLUMN(COLUMN_REWARD) = record->reward;
+	*(uint8_t *)COLUMN(COLUMN_LINES) = record->lines;
+	*(uint8_t *)COLUMN(COLUMN_DONE) = record->done;
+
+	uint16_t *rows = (uint16_t *)COLUMN(COLUMN_ROWS);
+	for (size_t i = 0; i < writer->options.height; i++) {
+		uint16_t bits = 0;
+		if (i < well->height) {
+			for (size_t j = 0; j < well->width; j++) {
+				if (well->matrix[i][j] != CELL_TYPE_NONE)
+					bits |= (uint16_t)(1u << j);
+			}
+		}
+		rows[i] = bits;
+	}
+
+	uint8_t *pieces = (uint8_t *)COLUMN(COLUMN_PIECES);
+	size_t pieces_nr = 0;
+	for (uint8_t type = 0; type < 7; type++) {
+		if (well->tetrimino_type == (uint8_t)(1u << type))
+			pieces[pieces_nr++] = type;
+	}
+	for (size_t i = well->tetrimino_bag_index; i > 0 && pieces_nr < writer->options.pieces; i--)
+		pieces[pieces_nr++] = (uint8_t)well->tetrimino_bag[i - 1];
+	memset(pieces + pieces_nr, TRAINING_NO_PIECE, writer->options.pieces - pieces_nr);
+
+	// keep the chosen placement, in the last slot if need be
+	struct placement *candidates = (struct placement *)COLUMN(COLUMN_CANDIDATES);
+	size_t max = writer->options.max_candidates;
+	size_t kept = record->candidates_nr < max ? record->candidates_nr : max;
+	size_t chosen = record->chosen;
+
+	memcpy(candidates, record->candidates, kept * sizeof(*candidates));
+	memset(candidates + kept, 0, (max - kept) * sizeof(*candidates));
+	if (chosen >= kept) {
+		chosen = kept - 1;
+		candidates[chosen] = record->candidates[record->chosen];
+	}
+
+	*(uint16_t *)COLUMN(COLUMN_CANDIDATES_NR) = (uint16_t)kept;
+	*(uint16_t *)COLUMN(COLUMN_CHOSEN) = (uint16_t)chosen;
+
+#undef COLUMN
+
+	if (++chunk->records < writer->options.chunk_records)
+		return __atomic_load_n(&writer->failed, __ATOMIC_RELAXED);
+
+	return hand_over(stream);
+}
+
+int training_writer_close(struct training_writer *writer)
+{
+	for (struct training_stream *stream = writer->streams; stream; stream = stream->next) {
+		if (stream->filling->records)
+			hand_over(stream);
+	}
+
+	pthread_mutex_lock(&writer->lock);
+	writer->stop = 1;
+	pthread_cond_signal(&writer->wake);
+	pthread_mutex_unlock(&writer->lock);
+
+	if (writer->options.writer_thread)
+		pthread_join(writer->thread, NULL);
+
+	struct training_stream *stream = writer->streams;
+	while (stream) {
+		struct training_stream *next = stream->next;
+		free(stream->chunks[0].data);
+		free(stream->chunks[1].data);
+		free(stream);
+		stream = next;
+	}
+	writer->streams = NULL;
+
+	pthread_cond_destroy(&writer->written);
+	pthread_cond_destroy(&writer->wake);
+	pthread_mutex_destroy(&writer->lock);
+
+	return writer->failed || ferror(writer->out) || fflush(writer->out);
+}
+
+static size_t pad(size_t bytes)
+{
+	return (bytes + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+}
+
+/*
+ * Give the stream's full chunk to the writer thread, once it's done with the
+ * previous one, and carry on with the other chunk; or write it out directly
+ * without a writer thread.
+ * */
+static int hand_over(struct training_stream *stream)
+{
+	struct training_writer *writer = stream->writer;
+	int failed;
+
+	pthread_mutex_lock(&writer->lock);
+	if (writer->options.writer_thread) {
+		while (stream->pending)
+			pthread_cond_wait(&writer->written, &writer->lock);
+
+		stream->pending = stream->filling;
+		stream->filling = stream->filling == &stream->chunks[0] ? &stream->chunks[1] : &stream->chunks[0];
+		pthread_cond_signal(&writer->wake);
+	} else {
+		writer->failed |= write_chunk(writer, stream->filling);
+	}
+
+	stream->filling->records = 0;
+	failed = writer->failed;
+	pthread_mutex_unlock(&writer->lock);
+
+	return failed;
+}
+
+static void *training_writer_main(void *data)
+{
+	struct training_writer *writer = data;
+
+	pthread_mutex_lock(&writer->lock);
+	while (1) {
+		struct training_stream *stream = writer->streams;
+		while (stream && !stream->pending)
+			stream = stream->next;
+
+		if (!stream) {
+			// every chunk handed over before the file was closed is now written
+			if (writer->stop)
+				break;
+
+			pthread_cond_wait(&writer->wake, &writer->lock);
+			continue;
+		}
+
+		// the stream carries on filling its other chunk in the meantime
+		pthread_mutex_unlock(&writer->lock);
+		int failed = write_chunk(writer, stream->pending);
+		pthread_mutex_lock(&writer->lock);
+
+		__atomic_store_n(&writer->failed, writer->failed | failed, __ATOMIC_RELAXED);
+		stream->pending = NULL;
+		pthread_cond_broadcast(&writer->written);
+	}
+	pthread_mutex_unlock(&writer->lock);
+
+	return NULL;
+}
+
+/*
+ * Write out a chunk in a single write. A chunk that isn't full has its
+ * columns moved down first, to where they belong for the records it holds.
+ * Only one chunk is ever written at a time.
+ * */
+static int write_chunk(struct training_writer *writer, struct training_chunk *chunk)
+{
+	struct training_chunk_header *header = (struct training_chunk_header *)chunk->data;
+	size_t bytes = 0;
+
+	if (__atomic_load_n(&writer->failed, __ATOMIC_RELAXED))
+		return 1;
+
+	for (size_t i = 0; i < TRAINING_COLUMNS; i++) {
+		size_t size = chunk->records * writer->column_size[i];
+		char *column = chunk->data + sizeof(*header) + bytes;
+
+		if (column != chunk->data + writer->column_offset[i])
+			memmove(column, chunk->data + writer->column_offset[i], size);
+		bytes += size;
+	}
+
+	memset(chunk->data + sizeof(*header) + bytes, 0, pad(bytes) - bytes);
+	header->records = (uint32_t)chunk->records;
+	header->bytes = (uint32_t)pad(bytes);
+
+	if (fwrite(chunk->data, sizeof(*header) + header->bytes, 1, writer->out) != 1)
+		return 1;
+
+	writer->records += chunk->records;
+	writer->bytes += sizeof(*header) + header->bytes;
+	return 0;
+}
@@ -0,0 +1,402 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <inttypes.h>
+
+#include "tuner.h"
+#include "tetris-game.h"
+#include "randomizer.h"
+
+#define TUNER_WEIGHTS 5
+#define TUNER_LINE_MAX 256
+
+/*
+ * Threads claim games TUNER_CHUNK at a time, across every candidate.
+ * */
+#define TUNER_CHUNK 4
+
+struct tuner_job {
+	const struct tuner *tuner;
+	unsigned long games;
+	unsigned long next;
+	unsigned long *lines;
+};
+
+static void *tuner_worker(void *data);
+static void to_vector(const struct evaluator_weights *weights, double *vector);
+static void from_vector(const double *vector, struct evaluator_weights *weights);
+static int normalize(double *vector);
+static size_t tournament(struct tuner *tuner);
+static double next_uniform(uint64_t *state);
+
+void tuner_options_init(struct tuner_options *options)
+{
+	options->population = 50;
+	options->games = 20;
+	options->pieces = 500;
+	options->threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	options->seed = 1;
+	options->mutation = 0.2;
+}
+
+int tuner_init(struct tuner *tuner, const struct tuner_options *options)
+{
+	double vector[TUNER_WEIGHTS];
+
+	memset(tuner, 0, sizeof(*tuner));
+	if (options->population < 2 || !options->games || !options->pieces || options->mutation < 0)
+		return 1;
+
+	tuner->options = *options;
+	tuner->random = randomizer_state(options->seed);
+	tuner->population = calloc(options->population, sizeof(*tuner->population));
+	tuner->fitness = calloc(options->population, sizeof(*tuner->fitness));
+	if (!tuner->population || !tuner->fitness) {
+		tuner_release(tuner);
+		return 1;
+	}
+
+	for (size_t i = 0; i < options->population; i++) {
+		do {
+			for (size_t j = 0; j < TUNER_WEIGHTS; j++)
+				vector[j] = next_uniform(&tuner->random) * 2 - 1;
+		} while (normalize(vector));
+
+		from_vector(vector, &tuner->population[i]);
+	}
+
+	return 0;
+}
+
+int tuner_evaluate(struct tuner *tuner)
+{
+	struct tuner_job job;
+	int threads = tuner->options.threads > 0 ? tuner->options.threads : 1;
+
+	job.tuner = tuner;
+	job.games = tuner->options.population * tuner->options.games;
+	job.next = 0;
+	job.lines = calloc(job.games, sizeof(*job.lines));
+
+	pthread_t *workers = malloc(sizeof(pthread_t) * (size_t)threads);
+	if (!job.lines || !workers) {
+		free(job.lines);
+		free(workers);
+		return 1;
+	}
+
+	int started = 0;
+	for (; started < threads; started++) {
+		if (pthread_create(&workers[started], NULL, tuner_worker, &job))
+			break;
+	}
+
+	for (int i = 0; i < started; i++)
+		pthread_join(workers[i], NULL);
+
+	// sum up in a fixed order, so the fitness doesn't depend on the threads
+	for (size_t i = 0; started && i < tuner->options.population; i++) {
+		double lines = 0;
+		for (unsigned long game = 0; game < tuner->options.games; game++)
+			lines += (double)job.lines[i * tuner->options.games + game];
+
+		tuner->fitness[i] = lines / (double)tuner->options.games;
+	}
+
+	free(workers);
+	free(job.lines);
+
+	return !started;
+}
+
+void tuner_evolve(struct tuner *tuner)
+{
+	size_t population = tuner->options.population;
+	size_t offspring = population * TUNER_OFFSPRING / 100;
+	double first[TUNER_WEIGHTS], second[TUNER_WEIGHTS], child[TUNER_WEIGHTS];
+
+	if (!offspring)
+		offspring = 1;
+
+	struct evaluator_weights *children = malloc(sizeof(*children) * offspring);
+	size_t *order = malloc(sizeof(*order) * population);
+	if (!children || !order) {
+		free(children);
+		free(order);
+		return;
+	}
+
+	for (size_t i = 0; i < offspring; i++) {
+		size_t a = tournament(tuner), b = tournament(tuner);
+		double fitness_a = tuner->fitness[a], fitness_b = tuner->fitness[b];
+
+		// parents that cleared nothing count the same
+		if (fitness_a + fitness_b <= 0)
+			fitness_a = fitness_b = 1;
+
+		to_vector(&tuner->population[a], first);
+		to_vector(&tuner->population[b], second);
+		for (size_t j = 0; j < TUNER_WEIGHTS; j++)
+			child[j] = fitness_a * first[j] + fitness_b * second[j];
+		if (normalize(child))
+			memcpy(child, first, sizeof(child));
+
+		if ((randomizer_next(&tuner->random) >> 32) % 100 < TUNER_MUTATION) {
+			size_t weight = (size_t)((randomizer_next(&tuner->random) >> 32) % TUNER_WEIGHTS);
+			child[weight] += (next_uniform(&tuner->random) * 2 - 1) * tuner->options.mutation;
+			if (normalize(child))
+				memcpy(child, first, sizeof(child));
+		}
+
+		from_vector(child, &children[i]);
+	}
+
+	// the least fit first, earlier candidates first on ties
+	for (size_t i = 0; i < population; i++) {
+		size_t j = i;
+		for (; j > 0 && tuner->fitness[order[j - 1]] > tuner->fitness[i]; j--)
+			order[j] = order[j - 1];
+		order[j] = i;
+	}
+
+	for (size_t i = 0; i < offspring; i++) {
+		tuner->population[order[i]] = children[i];
+		tuner->fitness[order[i]] = 0;
+	}
+
+	tuner->generation++;
+	free(children);
+	free(order);
+}
+
+size_t tuner_best(const struct tuner *tuner)
+{
+	size_t best = 0;
+
+	for (size_t i = 1; i < tuner->options.population; i++) {
+		if (tuner->fitness[i] > tuner->fitness[best])
+			best = i;
+	}
+
+	return best;
+}
+
+unsigned long tuner_play(const struct evaluator_weights *weights, uint64_t seed, unsigned long pieces)
+{
+	struct placement *placements = malloc(sizeof(struct placement) * PLACEMENTS_MAX);
+	struct tetris_game game;
+
+	if (!placements)
+		return 0;
+
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, seed);
+	for (unsigned long i = 0; i < pieces && game.running; i++) {
+		size_t count = tetrimino_placements(&game.well, placements);
+		size_t best = evaluator_best_placement(&game.well, placements, count, weights, NULL);
+
+		if (best == count || tetris_game_place_trusted(&game, &placements[best]))
+			break;
+	}
+
+	free(placements);
+	return (unsigned long)game.lines;
+}
+
+int tuner_save(const struct tuner *tuner, const char *path)
+{
+	char tmp_path[4096];
+	double vector[TUNER_WEIGHTS];
+
+	if ((size_t)snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= sizeof(tmp_path))
+		return 1;
+
+	FILE *out = fopen(tmp_path, "w");
+	if (!out)
+		return 1;
+
+	fprintf(out, "tetris-tune 1\n");
+	fprintf(out, "seed %" PRIu64 "\n", tuner->options.seed);
+	fprintf(out, "games %lu\n", tuner->options.games);
+	fprintf(out, "pieces %lu\n", tuner->options.pieces);
+	fprintf(out, "mutation %.17g\n", tuner->options.mutation);
+	fprintf(out, "generation %lu\n", tuner->generation);
+	fprintf(out, "random %" PRIu64 "\n", tuner->random);
+
+	for (size_t i = 0; i < tuner->options.population; i++) {
+		to_vector(&tuner->population[i], vector);
+		fprintf(out, "candidate");
+		for (size_t j = 0; j < TUNER_WEIGHTS; j++)
+			fprintf(out, " %.17g", vector[j]);
+		fprintf(out, "\n");
+	}
+
+	int ret = ferror(out);
+	ret |= fclose(out) != 0;
+
+	if (ret || rename(tmp_path, path)) {
+		unlink(tmp_path);
+		return 1;
+	}
+
+	return 0;
+}
+
+int tuner_load(struct tuner *tuner, const char *path, int threads)
+{
+	char line[TUNER_LINE_MAX];
+	double vector[TUNER_WEIGHTS];
+	size_t alloc = 0;
+	int version = 0;
+
+	memset(tuner, 0, sizeof(*tuner));
+	tuner->options.threads = threads;
+
+	FILE *in = fopen(path, "r");
+	if (!in)
+		return 1;
+
+	if (!fgets(line, sizeof(line), in) || sscanf(line, "tetris-tune %d", &version) != 1 || version != 1) {
+		fclose(in);
+		return 1;
+	}
+
+	while (fgets(line, sizeof(line), in)) {
+		struct tuner_options *options = &tuner->options;
+
+		if (sscanf(line, "seed %" SCNu64, &options->seed) == 1 ||
+				sscanf(line, "games %lu", &options->games) == 1 ||
+				sscanf(line, "pieces %lu", &options->pieces) == 1 ||
+				sscanf(line, "mutation %lf", &options->mutation) == 1 ||
+				sscanf(line, "generation %lu", &tuner->generation) == 1 ||
+				sscanf(line, "random %" SCNu64, &tuner->random) == 1)
+			continue;
+
+		if (sscanf(line, "candidate %lf %lf %lf %lf %lf", &vector[0], &vector[1], &vector[2],
+				&vector[3], &vector[4]) != TUNER_WEIGHTS)
+			goto fail;
+
+		if (options->population == alloc) {
+			alloc = alloc ? alloc * 2 : 64;
+			struct evaluator_weights *grown = realloc(tuner->population, alloc * sizeof(*grown));
+			if (!grown)
+				goto fail;
+			tuner->population = grown;
+		}
+
+		from_vector(vector, &tuner->population[options->population++]);
+	}
+
+	fclose(in);
+
+	tuner->fitness = calloc(tuner->options.population ? tuner->options.population : 1, sizeof(*tuner->fitness));
+	if (!tuner->fitness || tuner->options.population < 2 || !tuner->options.games || !tuner->options.pieces ||
+			!tuner->random) {
+		tuner_release(tuner);
+		return 1;
+	}
+
+	return 0;
+
+fail:
+	fclose(in);
+	tuner_release(tuner);
+	return 1;
+}
+
+void tuner_release(struct tuner *tuner)
+{
+	free(tuner->population);
+	free(tuner->fitness);
+	tuner->population = NULL;
+	tuner->fitness = NULL;
+}
+
+static void *tuner_worker(void *data)
+{
+	struct tuner_job *job = data;
+	const struct tuner *tuner = job->tuner;
+
+	while (1) {
+		unsigned long start = __atomic_fetch_add(&job->next, TUNER_CHUNK, __ATOMIC_RELAXED);
+		if (start >= job->games)
+			break;
+
+		for (unsigned long i = start; i < start + TUNER_CHUNK && i < job->games; i++) {
+			size_t candidate = i / tuner->options.games;
+			unsigned long game = i % tuner->options.games;
+
+			// every candidate plays the same games, new ones every generation
+			uint64_t seed = tuner->options.seed + tuner->generation * tuner->options.games + game;
+			job->lines[i] = tuner_play(&tuner->population[candidate], seed, tuner->options.pieces);
+		}
+	}
+
+	return NULL;
+}
+
+static void to_vector(const struct evaluator_weights *weights, double *vector)
+{
+	vector[0] = weights->aggregate_height;
+	vector[1] = weights->holes;
+	vector[2] = weights->bumpiness;
+	vector[3] = weights->transitions;
+	vector[4] = weights->lines;
+}
+
+static void from_vector(const double *vector, struct evaluator_weights *weights)
+{
+	weights->aggregate_height = vector[0];
+	weights->holes = vector[1];
+	weights->bumpiness = vector[2];
+	weights->transitions = vector[3];
+	weights->lines = vector[4];
+}
+
+/*
+ * Scale the vector to unit length. Returns non-zero if it has no length.
+ * */
+static int normalize(double *vector)
+{
+	double norm = 0;
+
+	for (size_t i = 0; i < TUNER_WEIGHTS; i++)
+		norm += vector[i] * vector[i];
+
+	norm = sqrt(norm);
+	if (norm < 1e-12)
+		return 1;
+
+	for (size_t i = 0; i < TUNER_WEIGHTS; i++)
+		vector[i] /= norm;
+
+	return 0;
+}
+
+/*
+ * The fittest of a random tenth of the population, or of two candidates in a
+ * small one.
+ * */
+static size_t tournament(struct tuner *tuner)
+{
+	size_t size = tuner->options.population / 10;
+	size_t best = tuner->options.population;
+
+	if (size < 2)
+		size = 2;
+
+	for (size_t i = 0; i < size; i++) {
+		size_t candidate = (size_t)((randomizer_next(&tuner->random) >> 32) % tuner->options.population);
+		if (best == tuner->options.population || tuner->fitness[candidate] > tuner->fitness[best])
+			best = candidate;
+	}
+
+	return best;
+}
+
+static double next_uniform(uint64_t *state)
+{
+	return (double)(randomizer_next(state) >> 11) / 9007199254740992.0;
+}
@@ -0,0 +1,296 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+
+#include "well-metrics.h"
+
+#define WELL_METRICS_BACKLOG 16
+#define WELL_METRICS_REQUEST_MSEC 100
+#define WELL_METRICS_REQUEST_MAX 1024
+
+struct well_metric_info {
+	const char *name;
+	const char *help;
+	const char *label;
+};
+
+/*
+ * Metrics sharing a name are consecutive, and only the first of them carries
+ * the help text.
+ * */
+static const struct well_metric_info well_metric_info[WELL_METRICS_NR] = {
+		{ "tetris_well_shifts_total", "Calls to tetrimino_shift(), by direction.", "direction=\"left\"" },
+		{ "tetris_well_shifts_total", NULL, "direction=\"right\"" },
+		{ "tetris_well_shifts_total", NULL, "direction=\"down\"" },
+		{ "tetris_well_rotations_total", "Calls to tetrimino_rotate().", NULL },
+		{ "tetris_well_rotations_blocked_total", "Rotations blocked by the stack.", NULL },
+		{ "tetris_well_overlap_checks_total", "Checks of tetrimino cells against the stack.", NULL },
+		{ "tetris_well_commits_total", "Tetriminos committed to the well.", NULL },
+		{ "tetris_well_rows_cleared_total", "Rows cleared by committed tetriminos.", NULL },
+		{ "tetris_well_bag_refills_total", "Refills of the tetrimino queue from the randomizer.", NULL },
+};
+
+static void *server_main(void *data);
+static void server_answer(int fd);
+
+#ifdef TETRIS_WELL_METRICS
+
+__thread struct well_metrics_block well_metrics_local;
+
+static pthread_mutex_t metrics_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t metrics_once = PTHREAD_ONCE_INIT;
+static pthread_key_t metrics_key;
+static struct well_metrics_block *metrics_blocks;
+static uint64_t metrics_retired[WELL_METRICS_NR];
+
+static void metrics_key_create(void);
+static void metrics_retire(void *data);
+
+void well_metrics_register(void)
+{
+	struct well_metrics_block *block = &well_metrics_local;
+
+	pthread_once(&metrics_once, metrics_key_create);
+	pthread_setspecific(metrics_key, block);
+
+	pthread_mutex_lock(&metrics_lock);
+	block->prev = NULL;
+	block->next = metrics_blocks;
+	if (metrics_blocks)
+		metrics_blocks->prev = block;
+	metrics_blocks = block;
+	block->registered = 1;
+	pthread_mutex_unlock(&metrics_lock);
+}
+
+int well_metrics_enabled(void)
+{
+	return 1;
+}
+
+void well_metrics_gather(uint64_t counters[WELL_METRICS_NR])
+{
+	pthread_mutex_lock(&metrics_lock);
+	memcpy(counters, metrics_retired, sizeof(metrics_retired));
+	for (struct well_metrics_block *block = metrics_blocks; block; block = block->next) {
+		for (size_t i = 0; i < WELL_METRICS_NR; i++)
+			counters[i] += __atomic_load_n(&block->counters[i], __ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&metrics_lock);
+}
+
+static void metrics_key_create(void)
+{
+	pthread_key_create(&metrics_key, metrics_retire);
+}
+
+/*
+ * Called as a thread exits, before its block goes away.
+ * */
+static void metrics_retire(void *data)
+{
+	struct well_metrics_block *block = data;
+
+	pthread_mutex_lock(&metrics_lock);
+	for (size_t i = 0; i < WELL_METRICS_NR; i++)
+		metrics_retired[i] += block->counters[i];
+
+	if (block->prev)
+		block->prev->next = block->next;
+	else
+		metrics_blocks = block->next;
+	if (block->next)
+		block->next->prev = block->prev;
+	pthread_mutex_unlock(&metrics_lock);
+}
+
+#else
+
+int well_metrics_enabled(void)
+{
+	return 0;
+}
+
+void well_metrics_gather(uint64_t counters[WELL_METRICS_NR])
+{
+	memset(counters, 0, sizeof(uint64_t) * WELL_METRICS_NR);
+}
+
+#endif //TETRIS_WELL_METRICS
+
+int well_metrics_write(FILE *out)
+{
+	uint64_t counters[WELL_METRICS_NR];
+
+	if (!well_metrics_enabled()) {
+		fprintf(out, "# tetris was built without well metrics\n");
+		return ferror(out);
+	}
+
+	well_metrics_gather(counters);
+	for (size_t i = 0; i < WELL_METRICS_NR; i++) {
+		const struct well_metric_info *info = &well_metric_info[i];
+
+		if (info->help) {
+			fprintf(out, "# HELP %s %s\n", info->name, info->help);
+			fprintf(out, "# TYPE %s counter\n", info->name);
+		}
+
+		if (info->label)
+			fprintf(out, "%s{%s} %llu\n", info->name, info->label, (unsigned long long)counters[i]);
+		else
+			fprintf(out, "%s %llu\n", info->name, (unsigned long long)counters[i]);
+	}
+
+	return ferror(out);
+}
+
+int well_metrics_save(const char *path)
+{
+	char tmp_path[4096];
+
+	if ((size_t)snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= sizeof(tmp_path))
+		return 1;
+
+	FILE *out = fopen(tmp_path, "w");
+	if (!out)
+		return 1;
+
+	int ret = well_metrics_write(out);
+	ret |= fclose(out) != 0;
+
+	if (ret || rename(tmp_path, path)) {
+		unlink(tmp_path);
+		return 1;
+	}
+
+	return 0;
+}
+
+int well_metrics_serve(struct well_metrics_server *server, const char *path)
+{
+	struct sockaddr_un addr;
+
+	server->listen_fd = server->stop_fd = -1;
+	server->path[0] = '\0';
+	if (!*path || strlen(path) >= sizeof(addr.sun_path) || strlen(path) >= sizeof(server->path))
+		return 1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	server->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (server->listen_fd < 0)
+		return 1;
+
+	if (bind(server->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(server->listen_fd);
+		server->listen_fd = -1;
+		return 1;
+	}
+	strcpy(server->path, path);
+
+	if (listen(server->listen_fd, WELL_METRICS_BACKLOG) < 0 ||
+			(server->stop_fd = eventfd(0, EFD_CLOEXEC)) < 0 ||
+			pthread_create(&server->thread, NULL, server_main, server)) {
+		if (server->stop_fd >= 0)
+			close(server->stop_fd);
+		close(server->listen_fd);
+		unlink(server->path);
+		server->listen_fd = server->stop_fd = -1;
+		server->path[0] = '\0';
+		return 1;
+	}
+
+	return 0;
+}
+
+void well_metrics_stop(struct well_metrics_server *server)
+{
+	uint64_t one = 1;
+
+	if (server->listen_fd < 0)
+		return;
+
+	if (write(server->stop_fd, &one, sizeof(one)) < 0)
+		perror("eventfd");
+	pthread_join(server->thread, NULL);
+
+	close(server->stop_fd);
+	close(server->listen_fd);
+	unlink(server->path);
+	server->listen_fd = server->stop_fd = -1;
+	server->path[0] = '\0';
+}
+
+static void *server_main(void *data)
+{
+	struct well_metrics_server *server = data;
+	struct pollfd fds[2] = {
+			{ server->listen_fd, POLLIN, 0 },
+			{ server->stop_fd, POLLIN, 0 },
+	};
+
+	while (1) {
+		if (poll(fds, 2, -1) < 0)
+			continue;
+		if (fds[1].revents)
+			break;
+		if (!fds[0].revents)
+			continue;
+
+		int fd = accept(server->listen_fd, NULL, NULL);
+		if (fd < 0)
+			continue;
+
+		server_answer(fd);
+		close(fd);
+	}
+
+	return NULL;
+}
+
+/*
+ * Answer a single connection. Clients that send nothing are answered with the
+ * bare metrics once WELL_METRICS_REQUEST_MSEC passes.
+ * */
+static void server_answer(int fd)
+{
+	char request[WELL_METRICS_REQUEST_MAX];
+	struct pollfd pfd = { fd, POLLIN, 0 };
+	char *body = NULL, header[128];
+	size_t body_len = 0;
+	ssize_t received = 0;
+
+	if (poll(&pfd, 1, WELL_METRICS_REQUEST_MSEC) > 0)
+		received = recv(fd, request, sizeof(request), MSG_DONTWAIT);
+
+	FILE *out = open_memstream(&body, &body_len);
+	if (!out)
+		return;
+	int failed = well_metrics_write(out);
+	failed |= fclose(out) != 0;
+
+	if (!failed) {
+		int http = received >= 4 && !memcmp(request, "GET ", 4);
+		int header_len = snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\n"
+				"Content-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\n\r\n", body_len);
+
+		if (!http || send(fd, header, (size_t)header_len, MSG_NOSIGNAL) == header_len) {
+			for (size_t sent = 0; sent < body_len;) {
+				ssize_t n = send(fd, body + sent, body_len - sent, MSG_NOSIGNAL);
+				if (n <= 0)
+					break;
+				sent += (size_t)n;
+			}
+		}
+	}
+
+	free(body);
+}
@@ -56,6 +56,54 @@
  * }
  * ```
  *
+ * Running Tests in Parallel:
+ * By default, every test runs one after the other in the runner process. If
+ * `jobs` is set in the test options, each unit test is instead run in its own
+ * forked process, with up to `jobs` processes at once. A test that crashes, or
+ * runs longer than `timeout` seconds, fails on its own without stopping the
+ * rest of the suite. Output from a forked test is only shown if the test fails
+ * or the runner is verbose.
+ *
+ * In either mode, each test is timed, and the suite summary lists the slowest
+ * tests.
+ *
+ * Benchmarks:
+ * Benchmarks live alongside unit tests, and are defined in much the same way:
+ * ```
+ * BENCH_DEFINE(bench_name)
+ * {
+ * 		//setup benchmark here
+ *
+ * 		BENCH_START() {
+ * 			bench_keep(operation());
+ * 		}
+ *
+ * 		//teardown benchmark here
+ * 		BENCH_END();
+ * }
+ * ```
+ *
+ * The body of BENCH_START() is run in batches. The batch size is doubled until
+ * a batch takes long enough to time accurately, and then a number of batches
+ * of that size are timed. Results are reported in ns/op, with the minimum,
+ * median and maximum over the timed batches. Pass the result of the work
+ * being measured to bench_keep() so that the compiler can't optimize it away.
+ *
+ * Benchmarks are registered in their own array and run with
+ * execute_benchmarks(), after the unit tests:
+ * ```
+ * 		struct unit_bench benchmarks[] = {
+ * 			{ "operation", bench_name },
+ * 			{ NULL, NULL }
+ * 		};
+ *
+ * 		return execute_tests(instance, tests) | execute_benchmarks(instance, benchmarks);
+ * ```
+ *
+ * Benchmarks only run when requested through the `benchmarks` test option.
+ * They run one at a time in the runner process once every unit test has
+ * completed, even if tests are forked.
+ *
  * Adding New Tests:
  * To add a new test to the suite:
  * - first, add a function prototype declaration in `test-suite.h` pointing to
@@ -107,6 +155,23 @@
 #define TEST_START() int __ret = 0; __test_end:; for (int __i = 1; __i-- && !__ret;)
 #define TEST_END() return __ret
 
+#define BENCH_DEFINE(__bench_name) static void __bench_name (struct bench_state *__bench)
+#define BENCH_START() \
+	for (size_t __n; (__n = bench_next_batch(__bench)) > 0; bench_end_batch(__bench)) \
+		for (; __n > 0; __n--)
+#define BENCH_END() return
+
+/*
+ * Make the compiler assume that `value` is used, and that any memory may have
+ * been read or written, so that benchmarked work is neither removed nor hoisted
+ * out of the loop.
+ * */
+#define bench_keep(value) \
+	do { \
+		__typeof__(value) __kept = (value); \
+		__asm__ __volatile__("" : : "g"(&__kept) : "memory"); \
+	} while (0)
+
 #define assert_string_eq(a, b) \
 	do { \
 		if ((a) && !(b)) { \
@@ -334,6 +399,7 @@
 	} while (0)
 
 struct test_runner_instance;
+struct bench_state;
 
 struct suite_test {
 	const char *test_name;
@@ -345,8 +411,34 @@ struct unit_test {
 	int (*fn)();
 };
 
-int execute_suite(struct suite_test tests[], int verbose, int immediate);
+struct unit_bench {
+	const char *bench_name;
+	void (*fn)(struct bench_state *);
+};
+
+/**
+ * Options for execute_suite():
+ * - verbose: print a line for each unit test, rather than each suite.
+ * - immediate: stop at the first failing test.
+ * - jobs: if greater than zero, run each test in a forked process, with up to
+ *   this many processes at once.
+ * - timeout: when tests are forked, the number of seconds after which a test is
+ *   killed and marked as failed. Zero disables the timeout.
+ * - benchmarks: run benchmarks after the unit tests.
+ * */
+struct test_options {
+	int verbose;
+	int immediate;
+	int jobs;
+	unsigned int timeout;
+	int benchmarks;
+};
+
+int execute_suite(struct suite_test tests[], const struct test_options *options);
 int execute_tests(struct test_runner_instance *instance, struct unit_test *tests);
+int execute_benchmarks(struct test_runner_instance *instance, struct unit_bench *benchmarks);
+size_t bench_next_batch(struct bench_state *state);
+void bench_end_batch(struct bench_state *state);
 void print_assertion_failure_message(const char *file_path, int line_number,
 		const char *func_name, const char *fmt, ...);
 
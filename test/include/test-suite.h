@@ -2,5 +2,26 @@
 #define TETRIS_SUITE_H
 
 extern int tetris_well_test(struct test_runner_instance *);
+extern int tetris_game_test(struct test_runner_instance *);
+extern int ansi_renderer_test(struct test_runner_instance *);
+extern int replay_test(struct test_runner_instance *);
+extern int placement_test(struct test_runner_instance *);
+extern int bot_protocol_test(struct test_runner_instance *);
+extern int evaluator_test(struct test_runner_instance *);
+extern int rollout_test(struct test_runner_instance *);
+extern int randomizer_test(struct test_runner_instance *);
+extern int telemetry_test(struct test_runner_instance *);
+extern int highscores_test(struct test_runner_instance *);
+extern int timer_wheel_test(struct test_runner_instance *);
+extern int game_server_test(struct test_runner_instance *);
+extern int search_test(struct test_runner_instance *);
+extern int opening_book_test(struct test_runner_instance *);
+extern int perfect_clear_test(struct test_runner_instance *);
+extern int training_data_test(struct test_runner_instance *);
+extern int tuner_test(struct test_runner_instance *);
+extern int well_metrics_test(struct test_runner_instance *);
+extern int replay_stats_test(struct test_runner_instance *);
+extern int submission_test(struct test_runner_instance *);
+extern int hint_engine_test(struct test_runner_instance *);
 
 #endif //TETRIS_SUITE_H
@@ -1,24 +1,74 @@
 #include <stdio.h>
+#include <unistd.h>
 
 #include "test-lib.h"
 #include "test-suite.h"
 
 static struct suite_test tests[] = {
 		{ "tetris-well", tetris_well_test },
+		{ "tetris-game", tetris_game_test },
+		{ "ansi-renderer", ansi_renderer_test },
+		{ "replay", replay_test },
+		{ "placement", placement_test },
+		{ "bot-protocol", bot_protocol_test },
+		{ "evaluator", evaluator_test },
+		{ "rollout", rollout_test },
+		{ "randomizer", randomizer_test },
+		{ "telemetry", telemetry_test },
+		{ "highscores", highscores_test },
+		{ "timer-wheel", timer_wheel_test },
+		{ "game-server", game_server_test },
+		{ "search", search_test },
+		{ "opening-book", opening_book_test },
+		{ "perfect-clear", perfect_clear_test },
+		{ "training-data", training_data_test },
+		{ "tuner", tuner_test },
+		{ "well-metrics", well_metrics_test },
+		{ "replay-stats", replay_stats_test },
+		{ "submission", submission_test },
+		{ "hint-engine", hint_engine_test },
 		{ NULL, NULL }
 };
 
+/*
+ * Tests that take longer than this when forked are killed, unless overridden
+ * by TETRIS_TEST_TIMEOUT.
+ * */
+#define DEFAULT_TEST_TIMEOUT 60
+
+static int env_enabled(const char *name)
+{
+	char *env = getenv(name);
+	return env && strcmp(env, "") != 0 && strcmp(env, "0") != 0;
+}
+
 int main(void)
 {
-	int verbose = 1, immediate = 0;
+	struct test_options options = { 1, 0, 0, DEFAULT_TEST_TIMEOUT, 0 };
+
+	if (env_enabled("TETRIS_TEST_VERBOSE"))
+		options.verbose = 1;
+
+	if (env_enabled("TETRIS_TEST_IMMEDIATE"))
+		options.immediate = 1;
+
+	if (env_enabled("TETRIS_TEST_BENCH"))
+		options.benchmarks = 1;
+
+	// fork one worker per core, or as many as TETRIS_TEST_JOBS asks for
+	if (env_enabled("TETRIS_TEST_PARALLEL"))
+		options.jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+	char *env = getenv("TETRIS_TEST_JOBS");
+	if (env && *env)
+		options.jobs = atoi(env);
 
-	char *env = getenv("TETRIS_TEST_VERBOSE");
-	if (env && strcmp(env, "") != 0 && strcmp(env, "0") != 0)
-		verbose = 1;
+	env = getenv("TETRIS_TEST_TIMEOUT");
+	if (env && *env)
+		options.timeout = (unsigned int)strtoul(env, NULL, 10);
 
-	env = getenv("TETRIS_TEST_IMMEDIATE");
-	if (env && strcmp(env, "") != 0 && strcmp(env, "0") != 0)
-		immediate = 1;
+	if (options.jobs < 0)
+		options.jobs = 1;
 
-	return execute_suite(tests, verbose, immediate);
+	return execute_suite(tests, &options);
 }
@@ -1,8 +1,13 @@
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
 
 #include "test-lib.h"
+#include "monotonic-clock.h"
 
 #define ANSI_COLOR_RED     "\x1b[31m"
 #define ANSI_COLOR_GREEN   "\x1b[32m"
@@ -12,29 +17,152 @@
 #define ANSI_COLOR_CYAN    "\x1b[36m"
 #define ANSI_COLOR_RESET   "\x1b[0m"
 
+/*
+ * The number of tests listed by their duration in the suite summary.
+ * */
+#define SLOWEST_TESTS_NR 5
+
+/*
+ * Benchmark batches are grown until one takes at least BENCH_BATCH_USEC, and
+ * then BENCH_SAMPLES_NR batches of that size are timed.
+ * */
+#define BENCH_BATCH_USEC 10000
+#define BENCH_SAMPLES_NR 15
+
+struct bench_state {
+	size_t batch;
+	int calibrated;
+	size_t samples_nr;
+	double samples[BENCH_SAMPLES_NR];
+	uint64_t start;
+};
+
+struct bench_record {
+	const char *suite_name;
+	const char *bench_name;
+	void (*fn)(struct bench_state *);
+};
+
+/*
+ * Every unit test executed is recorded along with its duration, so that the
+ * slowest tests can be listed once the suite completes. When tests are forked,
+ * the suite is first walked without running anything to collect the records,
+ * which are then handed out to the workers.
+ * */
+struct test_record {
+	const char *suite_name;
+	const char *test_name;
+	int (*fn)();
+	double elapsed_ms;
+};
+
 struct test_runner_instance {
 	int verbose;
 	int immediate;
+	int jobs;
+	unsigned int timeout;
+	int collecting;
+	const char *suite_name;
 	unsigned int executed;
 	unsigned int passed;
 	unsigned int failed;
+	struct test_record *records;
+	size_t records_nr;
+	size_t records_alloc;
+	int benchmarks;
+	struct bench_record *benches;
+	size_t benches_nr;
+	size_t benches_alloc;
+};
+
+struct test_worker {
+	pid_t pid;
+	size_t record;
+	FILE *output;
+	uint64_t start;
 };
 
+static struct test_record *add_test_record(struct test_runner_instance *instance,
+		const char *test_name, int (*fn)())
+{
+	if (instance->records_nr == instance->records_alloc) {
+		size_t alloc = instance->records_alloc ? instance->records_alloc * 2 : 64;
+		struct test_record *records = realloc(instance->records, sizeof(*records) * alloc);
+		if (!records) {
+			fprintf(stderr, "out of memory\n");
+			exit(1);
+		}
+
+		instance->records = records;
+		instance->records_alloc = alloc;
+	}
+
+	struct test_record *record = &instance->records[instance->records_nr++];
+	record->suite_name = instance->suite_name;
+	record->test_name = test_name;
+	record->fn = fn;
+	record->elapsed_ms = 0;
+
+	return record;
+}
+
+static void add_bench_record(struct test_runner_instance *instance,
+		const char *bench_name, void (*fn)(struct bench_state *))
+{
+	if (instance->benches_nr == instance->benches_alloc) {
+		size_t alloc = instance->benches_alloc ? instance->benches_alloc * 2 : 16;
+		struct bench_record *benches = realloc(instance->benches, sizeof(*benches) * alloc);
+		if (!benches) {
+			fprintf(stderr, "out of memory\n");
+			exit(1);
+		}
+
+		instance->benches = benches;
+		instance->benches_alloc = alloc;
+	}
+
+	struct bench_record *record = &instance->benches[instance->benches_nr++];
+	record->suite_name = instance->suite_name;
+	record->bench_name = bench_name;
+	record->fn = fn;
+}
+
 static void print_test_heading(const char *test_name)
 {
 	fprintf(stderr, "*** %s ***\n", test_name);
 }
 
-static void print_test_suite_summary(int passed, int failed)
+static int compare_elapsed(const void *a, const void *b)
+{
+	const struct test_record *left = a, *right = b;
+	if (left->elapsed_ms != right->elapsed_ms)
+		return left->elapsed_ms < right->elapsed_ms ? 1 : -1;
+
+	return 0;
+}
+
+static void print_test_suite_summary(struct test_runner_instance *instance, double elapsed_ms)
 {
 	fprintf(stderr, "\n\nTest Execution Summary:\n");
-	fprintf(stderr, "Executed: %d\n", passed + failed);
-	fprintf(stderr, "Passed: %d\n", passed);
-	fprintf(stderr, (failed ? ANSI_COLOR_RED : ANSI_COLOR_GREEN));
-	fprintf(stderr, "Failed: %d\n" ANSI_COLOR_RESET, failed);
+	fprintf(stderr, "Executed: %u\n", instance->passed + instance->failed);
+	fprintf(stderr, "Passed: %u\n", instance->passed);
+	fprintf(stderr, (instance->failed ? ANSI_COLOR_RED : ANSI_COLOR_GREEN));
+	fprintf(stderr, "Failed: %u\n" ANSI_COLOR_RESET, instance->failed);
+	fprintf(stderr, "Elapsed: %.2f ms\n", elapsed_ms);
+
+	if (!instance->records_nr)
+		return;
+
+	qsort(instance->records, instance->records_nr, sizeof(*instance->records), compare_elapsed);
+
+	fprintf(stderr, "\nSlowest Tests:\n");
+	for (size_t i = 0; i < instance->records_nr && i < SLOWEST_TESTS_NR; i++) {
+		struct test_record *record = &instance->records[i];
+		fprintf(stderr, "%10.2f ms  %s: %s\n", record->elapsed_ms, record->suite_name, record->test_name);
+	}
 }
 
-static void print_test_summary(const char *test_name, int ret)
+static void print_test_summary(const char *test_name, const char *result, int ret, double elapsed_ms)
 {
 	time_t rawtime;
 	struct tm *timeinfo;
@@ -52,34 +180,248 @@ static void print_test_summary(const char *test_name, int ret)
 	int len = 96 - (int)strlen(test_name);
 	for (int i = 0; len > 0 && i < len; i++)
 		fprintf(stderr, ".");
-	fprintf(stderr, " %s\n" ANSI_COLOR_RESET, ret ? "fail" : "ok");
+	fprintf(stderr, " %s (%.2f ms)\n" ANSI_COLOR_RESET, result, elapsed_ms);
+}
+
+static void start_test_worker(struct test_runner_instance *instance,
+		struct test_worker *worker, size_t record)
+{
+	worker->record = record;
+	worker->output = tmpfile();
+	if (!worker->output) {
+		perror("unable to create test output file");
+		exit(1);
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+
+	worker->start = monotonic_usec();
+	worker->pid = fork();
+	if (worker->pid < 0) {
+		perror("unable to fork test worker");
+		exit(1);
+	}
+
+	if (!worker->pid) {
+		dup2(fileno(worker->output), STDOUT_FILENO);
+		dup2(fileno(worker->output), STDERR_FILENO);
+
+		// a test that outlives its timeout is killed by the default SIGALRM action
+		signal(SIGALRM, SIG_DFL);
+		alarm(instance->timeout);
+
+		int ret = instance->records[record].fn();
+		fflush(stdout);
+		fflush(stderr);
+		_exit(ret ? 1 : 0);
+	}
+}
+
+static int finish_test_worker(struct test_runner_instance *instance,
+		struct test_worker *worker, int status)
+{
+	struct test_record *record = &instance->records[worker->record];
+	const char *result = "ok";
+	char name[256];
+	int ret = 0;
+
+	record->elapsed_ms = (double)(monotonic_usec() - worker->start) / 1000;
+
+	if (WIFSIGNALED(status)) {
+		result = WTERMSIG(status) == SIGALRM ? "timeout" : "crash";
+		ret = 1;
+	} else if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+		result = "fail";
+		ret = 1;
+	}
+
+	// only show what the test printed if it's wanted or needed
+	if (ret || instance->verbose) {
+		char buffer[4096];
+		size_t len;
+
+		rewind(worker->output);
+		while ((len = fread(buffer, 1, sizeof(buffer), worker->output)) > 0)
+			fwrite(buffer, 1, len, stderr);
+	}
+	fclose(worker->output);
+	worker->pid = 0;
+
+	snprintf(name, sizeof(name), "%s: %s", record->suite_name, record->test_name);
+	print_test_summary(name, result, ret, record->elapsed_ms);
+
+	instance->executed++;
+	if (ret)
+		instance->failed++;
+	else
+		instance->passed++;
+
+	return ret;
+}
+
+/*
+ * Run every collected test in its own process, with up to `jobs` running at a
+ * time. A test that crashes or outlives the timeout fails without taking the
+ * rest of the suite down with it.
+ * */
+static int execute_forked_tests(struct test_runner_instance *instance)
+{
+	struct test_worker *workers = calloc((size_t)instance->jobs, sizeof(*workers));
+	size_t next = 0;
+	int running = 0, failed = 0, stop = 0;
+
+	if (!workers) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	while (running || (!stop && next < instance->records_nr)) {
+		for (int i = 0; i < instance->jobs && !stop && next < instance->records_nr; i++) {
+			if (workers[i].pid)
+				continue;
+
+			start_test_worker(instance, &workers[i], next++);
+			running++;
+		}
+
+		int status;
+		pid_t pid = waitpid(-1, &status, 0);
+		if (pid < 0) {
+			if (errno == EINTR)
+				continue;
+
+			perror("unable to wait for test worker");
+			failed = 1;
+			break;
+		}
+
+		for (int i = 0; i < instance->jobs; i++) {
+			if (workers[i].pid != pid)
+				continue;
+
+			int ret = finish_test_worker(instance, &workers[i], status);
+			failed |= ret;
+			if (ret && instance->immediate)
+				stop = 1;
+
+			running--;
+			break;
+		}
+	}
+
+	free(workers);
+	return failed;
+}
+
+static int compare_samples(const void *a, const void *b)
+{
+	double left = *(const double *)a, right = *(const double *)b;
+	return (left > right) - (left < right);
+}
+
+static void run_bench(struct bench_record *record)
+{
+	struct bench_state state = { 1, 0, 0, { 0 }, 0 };
+
+	record->fn(&state);
+
+	if (!state.samples_nr) {
+		fprintf(stderr, ANSI_COLOR_RED "%s: %s: benchmark did not run\n" ANSI_COLOR_RESET,
+				record->suite_name, record->bench_name);
+		return;
+	}
+
+	qsort(state.samples, state.samples_nr, sizeof(double), compare_samples);
+	fprintf(stderr, ANSI_COLOR_CYAN "%s: %s\n" ANSI_COLOR_RESET, record->suite_name, record->bench_name);
+	fprintf(stderr, "\tmin %.2f ns/op, median %.2f ns/op, max %.2f ns/op (%zu x %zu ops)\n",
+			state.samples[0], state.samples[state.samples_nr / 2], state.samples[state.samples_nr - 1],
+			state.samples_nr, state.batch);
+}
+
+size_t bench_next_batch(struct bench_state *state)
+{
+	if (state->samples_nr == BENCH_SAMPLES_NR)
+		return 0;
+
+	state->start = monotonic_usec();
+	return state->batch;
+}
+
+void bench_end_batch(struct bench_state *state)
+{
+	uint64_t elapsed = monotonic_usec() - state->start;
+
+	if (!state->calibrated) {
+		if (elapsed < BENCH_BATCH_USEC) {
+			state->batch *= 2;
+			return;
+		}
+
+		state->calibrated = 1;
+	}
+
+	state->samples[state->samples_nr++] = (double)elapsed * 1000 / (double)state->batch;
 }
 
-int execute_suite(struct suite_test tests[], int verbose, int immediate)
+int execute_suite(struct suite_test tests[], const struct test_options *options)
 {
-	struct test_runner_instance instance = { 0, 0, 0, 0 };
+	struct test_runner_instance instance;
 	struct suite_test *test = tests;
 	int ret = 0, failed = 0;
 
-	instance.verbose = verbose;
-	instance.immediate = immediate;
+	memset(&instance, 0, sizeof(instance));
+	instance.verbose = options->verbose;
+	instance.immediate = options->immediate;
+	instance.jobs = options->jobs;
+	instance.timeout = options->timeout;
+	instance.benchmarks = options->benchmarks;
 
-	while (test->test_name) {
-		if (instance.verbose)
-			print_test_heading(test->test_name);
+	uint64_t start = monotonic_usec();
 
-		ret = test->fn(&instance);
-		failed |= ret;
-		if (!instance.verbose)
-			print_test_summary(test->test_name, ret);
+	if (instance.jobs > 0) {
+		instance.collecting = 1;
+		for (; test->test_name; test++) {
+			instance.suite_name = test->test_name;
+			test->fn(&instance);
+		}
+		instance.collecting = 0;
 
-		if (ret && instance.immediate)
-			break;
+		failed = execute_forked_tests(&instance);
+	} else {
+		while (test->test_name) {
+			size_t first = instance.records_nr;
+			double elapsed_ms = 0;
 
-		test++;
+			if (instance.verbose)
+				print_test_heading(test->test_name);
+
+			instance.suite_name = test->test_name;
+			ret = test->fn(&instance);
+			failed |= ret;
+
+			for (size_t i = first; i < instance.records_nr; i++)
+				elapsed_ms += instance.records[i].elapsed_ms;
+			if (!instance.verbose)
+				print_test_summary(test->test_name, ret ? "fail" : "ok", ret, elapsed_ms);
+
+			if (ret && instance.immediate)
+				break;
+
+			test++;
+		}
 	}
 
-	print_test_suite_summary(instance.passed, instance.failed);
+	print_test_suite_summary(&instance, (double)(monotonic_usec() - start) / 1000);
+
+	if (instance.benches_nr) {
+		fprintf(stderr, "\nBenchmarks:\n");
+		for (size_t i = 0; i < instance.benches_nr; i++)
+			run_bench(&instance.benches[i]);
+	}
+
+	free(instance.records);
+	free(instance.benches);
 	return failed;
 }
 
@@ -88,10 +430,21 @@ int execute_tests(struct test_runner_instance *instance, struct unit_test *tests
 	int ret = 0, failed = 0;
 	struct unit_test *test = tests;
 
+	if (instance->collecting) {
+		for (; test->test_name; test++)
+			add_test_record(instance, test->test_name, test->fn);
+
+		return 0;
+	}
+
 	while (test->test_name) {
+		struct test_record *record = add_test_record(instance, test->test_name, test->fn);
+		uint64_t start = monotonic_usec();
+
 		ret = test->fn();
+		record->elapsed_ms = (double)(monotonic_usec() - start) / 1000;
 		if (instance->verbose)
-			print_test_summary(test->test_name, ret);
+			print_test_summary(test->test_name, ret ? "fail" : "ok", ret, record->elapsed_ms);
 
 		instance->executed++;
 		if (ret)
@@ -109,6 +462,17 @@ int execute_tests(struct test_runner_instance *instance, struct unit_test *tests
 	return failed;
 }
 
+int execute_benchmarks(struct test_runner_instance *instance, struct unit_bench *benchmarks)
+{
+	if (!instance->benchmarks)
+		return 0;
+
+	for (struct unit_bench *bench = benchmarks; bench->bench_name; bench++)
+		add_bench_record(instance, bench->bench_name, bench->fn);
+
+	return 0;
+}
+
 void print_assertion_failure_message(const char *file_path, int line_number,
 		const char *func_name, const char *fmt, ...)
 {
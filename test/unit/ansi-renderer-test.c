@@ -0,0 +1,188 @@
+#include "test-lib.h"
+#include "ansi-renderer.h"
+#include "display-engine.h"
+#include "tetris-well.h"
+
+TEST_DEFINE(ansi_renderer_first_frame_redraw_test)
+{
+	struct tetris_well well;
+	struct ansi_renderer renderer;
+
+	tetris_well_init(&well);
+	int ret = ansi_renderer_init(&renderer, well.width, well.height);
+
+	TEST_START() {
+		assert_zero_msg(ret, "expected ansi_renderer_init() to succeed, but returned %d", ret);
+
+		size_t len = ansi_renderer_draw(&renderer, &well, NULL, 0, 0, 0, 0);
+		assert_nonzero_msg(len, "expected the first frame to be non-empty");
+		renderer.buffer[len] = 0;
+		assert_nonnull_msg(strstr(renderer.buffer, "\x1b[2J"),
+				"expected the first frame to clear the screen");
+
+		len = ansi_renderer_draw(&renderer, &well, NULL, 0, 0, 0, 0);
+		assert_zero_msg(len, "expected an unchanged frame to render nothing, but rendered %zu bytes", len);
+
+		ansi_renderer_invalidate(&renderer);
+		len = ansi_renderer_draw(&renderer, &well, NULL, 0, 0, 0, 0);
+		assert_nonzero_msg(len, "expected an invalidated renderer to redraw the frame");
+	}
+
+	ansi_renderer_release(&renderer);
+	TEST_END();
+}
+
+TEST_DEFINE(ansi_renderer_draw_changed_cells_test)
+{
+	struct tetris_well well;
+	struct ansi_renderer renderer;
+
+	tetris_well_init(&well);
+	int ret = ansi_renderer_init(&renderer, well.width, well.height);
+
+	TEST_START() {
+		assert_zero_msg(ret, "expected ansi_renderer_init() to succeed, but returned %d", ret);
+		ansi_renderer_draw(&renderer, &well, NULL, 0, 0, 0, 0);
+
+		well.matrix[0][0] = CELL_TYPE_I;
+		well.matrix[0][1] = CELL_TYPE_I;
+		size_t len = ansi_renderer_draw(&renderer, &well, NULL, 0, 0, 0, 0);
+
+		/* one cursor move to the first cell, one color change and two cells */
+		const char *expected = "\x1b[3;3H\x1b[0;7;36;40m    ";
+		assert_eq_msg(strlen(expected), len, "expected %zu bytes to be rendered, but rendered %zu", strlen(expected), len);
+		assert_zero_msg(memcmp(expected, renderer.buffer, len), "rendered frame did not match expected escape sequences");
+
+		/* the score panel labels are drawn once; only values are rewritten */
+		len = ansi_renderer_draw(&renderer, &well, NULL, 0, 40, 1, 0);
+		renderer.buffer[len] = 0;
+		assert_nonnull_msg(strstr(renderer.buffer, "\x1b[30;10H40"), "expected the score value to be redrawn");
+		assert_nonnull_msg(strstr(renderer.buffer, "\x1b[31;10H1"), "expected the lines value to be redrawn");
+		assert_null_msg(strstr(renderer.buffer, "\x1b[29;10H"), "expected the unchanged level value to be skipped");
+		assert_null_msg(strstr(renderer.buffer, "Score: "), "expected the score label not to be redrawn");
+
+		/* cells further along the same row are reached with a relative move */
+		well.matrix[0][4] = CELL_TYPE_I;
+		well.matrix[0][7] = CELL_TYPE_I;
+		len = ansi_renderer_draw(&renderer, &well, NULL, 0, 40, 1, 0);
+		expected = "\x1b[3;11H\x1b[0;7;36;40m  \x1b[4C  ";
+		assert_eq_msg(strlen(expected), len, "expected %zu bytes to be rendered, but rendered %zu", strlen(expected), len);
+		assert_zero_msg(memcmp(expected, renderer.buffer, len), "rendered frame did not use minimal cursor moves");
+	}
+
+	ansi_renderer_release(&renderer);
+	TEST_END();
+}
+
+TEST_DEFINE(ansi_renderer_defer_score_test)
+{
+	struct tetris_well well;
+	struct ansi_renderer renderer;
+
+	tetris_well_init(&well);
+	int ret = ansi_renderer_init(&renderer, well.width, well.height);
+
+	TEST_START() {
+		assert_zero_msg(ret, "expected ansi_renderer_init() to succeed, but returned %d", ret);
+		ansi_renderer_draw(&renderer, &well, NULL, 0, 0, 0, 0);
+
+		size_t len = ansi_renderer_draw(&renderer, &well, NULL, 1, 100, 10, DRAW_DEFER_SCORE);
+		assert_zero_msg(len, "expected a deferred score panel to render nothing, but rendered %zu bytes", len);
+
+		len = ansi_renderer_draw(&renderer, &well, NULL, 1, 100, 10, 0);
+		renderer.buffer[len] = 0;
+		assert_nonnull_msg(strstr(renderer.buffer, "100"), "expected the deferred score to be drawn by the next frame");
+	}
+
+	ansi_renderer_release(&renderer);
+	TEST_END();
+}
+
+TEST_DEFINE(ansi_renderer_draw_hint_test)
+{
+	struct tetris_well well;
+	struct ansi_renderer renderer;
+	struct placement hint;
+
+	tetris_well_init(&well);
+	well.tetrimino_type = CELL_TYPE_I;
+	for (size_t i = 0; i < 4; i++) {
+		well.tetrimino_coords[i][0] = 3 + i;
+		well.tetrimino_coords[i][1] = 0;
+		hint.coords[i][0] = (uint8_t)i;
+		hint.coords[i][1] = BOARD_HEIGHT - 1;
+	}
+	int ret = ansi_renderer_init(&renderer, well.width, well.height);
+
+	TEST_START() {
+		assert_zero_msg(ret, "expected ansi_renderer_init() to succeed, but returned %d", ret);
+		ansi_renderer_draw(&renderer, &well, NULL, 0, 0, 0, 0);
+
+		/* the hint is outlined in the color of the tetrimino */
+		size_t len = ansi_renderer_draw(&renderer, &well, &hint, 0, 0, 0, 0);
+		const char *expected = "\x1b[26;3H\x1b[0;36m[][][][]";
+		assert_eq_msg(strlen(expected), len, "expected %zu bytes to be rendered, but rendered %zu", strlen(expected), len);
+		assert_zero_msg(memcmp(expected, renderer.buffer, len), "rendered hint did not match expected escape sequences");
+
+		/* blocks are never covered by the hint */
+		well.matrix[BOARD_HEIGHT - 1][0] = CELL_TYPE_L;
+		len = ansi_renderer_draw(&renderer, &well, &hint, 0, 0, 0, 0);
+		expected = "\x1b[26;3H\x1b[0;7;31;40m  ";
+		assert_eq_msg(strlen(expected), len, "expected %zu bytes to be rendered, but rendered %zu", strlen(expected), len);
+		assert_zero_msg(memcmp(expected, renderer.buffer, len), "expected the block to be drawn over the hint");
+
+		/* without a hint, its cells are cleared; the cursor is already in place */
+		len = ansi_renderer_draw(&renderer, &well, NULL, 0, 0, 0, 0);
+		expected = "\x1b[0m      ";
+		assert_eq_msg(strlen(expected), len, "expected %zu bytes to be rendered, but rendered %zu", strlen(expected), len);
+		assert_zero_msg(memcmp(expected, renderer.buffer, len), "expected the hint to be cleared");
+	}
+
+	ansi_renderer_release(&renderer);
+	TEST_END();
+}
+
+BENCH_DEFINE(ansi_renderer_draw_bench)
+{
+	struct tetris_well well;
+	struct ansi_renderer renderer;
+	size_t i = 0;
+
+	tetris_well_init(&well);
+	tetris_well_seed(&well, 1);
+	tetrimino_new(&well);
+	ansi_renderer_init(&renderer, well.width, well.height);
+
+	BENCH_START() {
+		if (tetrimino_shift(&well, SHIFT_DOWN) < 0) {
+			tetris_well_commit_tetrimino(&well);
+			if (tetrimino_new(&well)) {
+				tetris_well_init(&well);
+				tetrimino_new(&well);
+			}
+		}
+
+		bench_keep(ansi_renderer_draw(&renderer, &well, NULL, 0, (int)i++, 0, 0));
+	}
+
+	ansi_renderer_release(&renderer);
+	BENCH_END();
+}
+
+int ansi_renderer_test(struct test_runner_instance *instance)
+{
+	struct unit_test tests[] = {
+			{ "ansi_renderer_draw should redraw everything on the first frame only", ansi_renderer_first_frame_redraw_test },
+			{ "ansi_renderer_draw should only render cells and score lines that changed", ansi_renderer_draw_changed_cells_test },
+			{ "ansi_renderer_draw should leave the score panel for later when deferred", ansi_renderer_defer_score_test },
+			{ "ansi_renderer_draw should outline the hint in empty cells only", ansi_renderer_draw_hint_test },
+			{ NULL, NULL }
+	};
+
+	struct unit_bench benchmarks[] = {
+			{ "ansi_renderer_draw with a falling tetrimino", ansi_renderer_draw_bench },
+			{ NULL, NULL }
+	};
+
+	return execute_tests(instance, tests) | execute_benchmarks(instance, benchmarks);
+}
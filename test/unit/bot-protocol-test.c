@@ -0,0 +1,144 @@
+#include "test-lib.h"
+#include "bot-protocol.h"
+
+TEST_DEFINE(bot_write_position_test)
+{
+	struct tetris_game game;
+	char line[BOT_LINE_MAX];
+	FILE *file = tmpfile();
+
+	tetris_game_init(&game, 4, 4, 1);
+	game.score = 120;
+	game.lines = 3;
+	game.well.matrix[3][0] = CELL_TYPE_I;
+	game.well.matrix[3][3] = CELL_TYPE_O;
+	game.well.matrix[2][1] = CELL_TYPE_T;
+
+	/* pretend that the current tetrimino is a T, with Z and L in the queue, L first */
+	game.well.tetrimino_type = CELL_TYPE_T;
+	game.well.tetrimino_bag[0] = 4;
+	game.well.tetrimino_bag[1] = 6;
+	game.well.tetrimino_bag_index = 2;
+
+	TEST_START() {
+		assert_nonnull(file);
+
+		bot_write_position(file, 7, &game);
+		rewind(file);
+		assert_nonnull(fgets(line, sizeof(line), file));
+
+		assert_zero_msg(strcmp("position 7 T LZ 0 120 3 0 0 2 9\n", line),
+				"unexpected position line '%s'", line);
+	}
+
+	if (file)
+		fclose(file);
+
+	TEST_END();
+}
+
+TEST_DEFINE(bot_parse_place_test)
+{
+	struct tetris_game game;
+	struct placement placement;
+
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 1);
+
+	TEST_START() {
+		int ret = bot_parse_reply("place 1 23 2 23 3 23 4 23\n", &game, &placement);
+		assert_eq_msg(BOT_REPLY_PLACE, ret, "expected a placement, but got %d", ret);
+		assert_eq(4, placement.coords[3][0]);
+		assert_eq(23, placement.coords[3][1]);
+
+		ret = bot_parse_reply("place 1 23 2 23 3 23\n", &game, &placement);
+		assert_eq_msg(BOT_REPLY_INVALID, ret, "expected a short placement to be invalid");
+
+		ret = bot_parse_reply("place 1 23 2 23 3 23 4 24\n", &game, &placement);
+		assert_eq_msg(BOT_REPLY_INVALID, ret, "expected a placement outside the well to be invalid");
+
+		ret = bot_parse_reply("quit\n", &game, &placement);
+		assert_eq(BOT_REPLY_QUIT, ret);
+
+		ret = bot_parse_reply("hello\n", &game, &placement);
+		assert_eq(BOT_REPLY_INVALID, ret);
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(bot_parse_moves_test)
+{
+	struct tetris_game game;
+	struct placement placement, expected;
+
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 1);
+
+	TEST_START() {
+		struct tetris_well well = game.well;
+		for (int i = 0; i < 20; i++)
+			tetrimino_shift(&well, SHIFT_LEFT);
+		tetrimino_rotate(&well);
+		while (!tetrimino_shift(&well, SHIFT_DOWN));
+		for (size_t i = 0; i < 4; i++) {
+			expected.coords[i][0] = (uint8_t)well.tetrimino_coords[i][0];
+			expected.coords[i][1] = (uint8_t)well.tetrimino_coords[i][1];
+		}
+
+		/* moves against the wall are skipped */
+		int ret = bot_parse_reply("moves llllllllllllllllllllx\n", &game, &placement);
+		assert_eq_msg(BOT_REPLY_PLACE, ret, "expected a placement, but got %d", ret);
+		assert_zero_msg(memcmp(&expected, &placement, sizeof(placement)),
+				"expected the moves to lead to the same placement as the equivalent shifts");
+		assert_zero_msg(tetris_game_place(&game, &placement), "expected the placement to be legal");
+
+		ret = bot_parse_reply("moves lq\n", &game, &placement);
+		assert_eq_msg(BOT_REPLY_INVALID, ret, "expected an unknown move to be invalid");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(bot_read_reply_test)
+{
+	struct bot_connection bot;
+	char line[16];
+
+	bot.in = tmpfile();
+	bot.out = NULL;
+
+	TEST_START() {
+		assert_nonnull(bot.in);
+
+		fputs("quit\nmoves lllllllllllllllllllll\nmoves -\nquit", bot.in);
+		rewind(bot.in);
+
+		assert_zero(bot_read_reply(&bot, line, sizeof(line)));
+		assert_zero_msg(strcmp("quit\n", line), "unexpected reply '%s'", line);
+
+		assert_eq_msg(1, bot_read_reply(&bot, line, sizeof(line)), "expected a long reply to be cut off");
+
+		assert_zero(bot_read_reply(&bot, line, sizeof(line)));
+		assert_zero_msg(strcmp("moves -\n", line), "expected the next reply on its own line, got '%s'", line);
+
+		assert_eq_msg(1, bot_read_reply(&bot, line, sizeof(line)), "expected an unfinished reply to be cut off");
+		assert_eq_msg(-1, bot_read_reply(&bot, line, sizeof(line)), "expected the end of the replies");
+	}
+
+	if (bot.in)
+		fclose(bot.in);
+
+	TEST_END();
+}
+
+int bot_protocol_test(struct test_runner_instance *instance)
+{
+	struct unit_test tests[] = {
+			{ "bot_write_position should describe the piece, queue, score and well", bot_write_position_test },
+			{ "bot_parse_reply should parse placements and reject malformed ones", bot_parse_place_test },
+			{ "bot_parse_reply should steer the tetrimino with moves and drop it", bot_parse_moves_test },
+			{ "bot_read_reply should discard replies that don't fit or end without a newline", bot_read_reply_test },
+			{ NULL, NULL }
+	};
+
+	return execute_tests(instance, tests);
+}
@@ -0,0 +1,78 @@
+#include "test-lib.h"
+#include "evaluator.h"
+
+TEST_DEFINE(evaluator_features_test)
+{
+	struct tetris_well well;
+	struct board_features features;
+
+	tetris_well_init(&well);
+
+	/* a column of two with a hole underneath, next to a column of one */
+	well.matrix[BOARD_HEIGHT - 2][0] = CELL_TYPE_I;
+	well.matrix[BOARD_HEIGHT - 1][1] = CELL_TYPE_I;
+
+	TEST_START() {
+		evaluator_features(&well, &features);
+
+		assert_eq_msg(features.aggregate_height, 3, "unexpected aggregate height %d", features.aggregate_height);
+		assert_eq_msg(features.holes, 1, "unexpected number of holes %d", features.holes);
+		assert_eq_msg(features.bumpiness, 2, "unexpected bumpiness %d", features.bumpiness);
+		assert_eq_msg(features.transitions, 8, "unexpected transitions %d", features.transitions);
+		assert_eq_msg(features.max_height, 2, "unexpected max height %d", features.max_height);
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(evaluator_best_placement_test)
+{
+	static struct placement placements[PLACEMENTS_MAX];
+	struct tetris_well well;
+	double evaluation;
+
+	tetris_well_init(&well);
+	for (size_t i = BOARD_HEIGHT - 4; i < BOARD_HEIGHT; i++) {
+		for (size_t j = 0; j < BOARD_WIDTH - 1; j++)
+			well.matrix[i][j] = CELL_TYPE_O;
+	}
+
+	well.tetrimino_type = CELL_TYPE_I;
+	for (size_t i = 0; i < 4; i++) {
+		well.tetrimino_coords[i][0] = cell_init_coords[0][i][0];
+		well.tetrimino_coords[i][1] = cell_init_coords[0][i][1];
+	}
+
+	TEST_START() {
+		size_t count = tetrimino_placements(&well, placements);
+		assert_nonzero_msg(count, "expected placements for the I tetrimino");
+
+		size_t best = evaluator_best_placement(&well, placements, count, &evaluator_default_weights, &evaluation);
+		assert_true_msg(best < count, "expected a best placement");
+
+		/* standing up in the gap clears all four lines, leaving an empty well */
+		for (size_t i = 0; i < 4; i++)
+			assert_eq_msg(placements[best].coords[i][0], BOARD_WIDTH - 1,
+					"expected the I tetrimino to fill the gap in the last column");
+
+		double expected = 4 * evaluator_default_weights.lines;
+		assert_true_msg(evaluation > expected - 1e-9 && evaluation < expected + 1e-9,
+				"expected an evaluation of %f, but got %f", expected, evaluation);
+
+		assert_eq_msg(evaluator_best_placement(&well, placements, 0, &evaluator_default_weights, NULL), 0,
+				"expected no best placement without placements");
+	}
+
+	TEST_END();
+}
+
+int evaluator_test(struct test_runner_instance *instance)
+{
+	struct unit_test tests[] = {
+			{ "evaluator_features should measure heights, holes and bumpiness", evaluator_features_test },
+			{ "evaluator_best_placement should prefer clearing lines", evaluator_best_placement_test },
+			{ NULL, NULL }
+	};
+
+	return execute_tests(instance, tests);
+}
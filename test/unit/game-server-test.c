@@ -0,0 +1,216 @@
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "test-lib.h"
+#include "game-server.h"
+#include "tetris-game.h"
+
+#define TEST_TIMEOUT_MS 2000
+#define TEST_PAUSE_USEC 400000
+
+static void socket_address(char *address, size_t len)
+{
+	snprintf(address, len, "unix:/tmp/tetris-server-test-%ld.sock", (long)getpid());
+}
+
+static int connect_client(const char *address)
+{
+	struct sockaddr_un addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, address + 5, sizeof(addr.sun_path) - 1);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/*
+ * Read from the client until the server closes the connection, keeping the
+ * last bytes read (NUL terminated). Returns the total number of bytes read,
+ * or -1 if the server didn't close the connection in time.
+ * */
+static long read_until_closed(int fd, char *tail, size_t len)
+{
+	char buffer[4096];
+	long total = 0;
+
+	tail[0] = '\0';
+	while (1) {
+		struct pollfd pfd = { fd, POLLIN, 0 };
+		if (poll(&pfd, 1, TEST_TIMEOUT_MS) <= 0)
+			return -1;
+
+		ssize_t ret = read(fd, buffer, sizeof(buffer));
+		if (ret < 0)
+			return -1;
+		if (ret == 0)
+			return total;
+
+		total += ret;
+		size_t keep = (size_t)ret < len - 1 ? (size_t)ret : len - 1;
+		memcpy(tail, buffer + ret - keep, keep);
+		tail[keep] = '\0';
+	}
+}
+
+TEST_DEFINE(server_play_session_test)
+{
+	struct game_server server, other;
+	struct server_options options;
+	char address[64], tail[256];
+	int fd = -1, opened;
+
+	socket_address(address, sizeof(address));
+	server_options_init(&options);
+	options.address = address;
+	options.workers = 2;
+	opened = !server_open(&server, &options);
+
+	TEST_START() {
+		assert_true_msg(opened, "expected the server to listen at '%s'", address);
+		assert_nonzero_msg(server_open(&other, &options), "expected the address to be in use");
+
+		fd = connect_client(address);
+		assert_true_msg(fd >= 0, "expected to connect to the server");
+
+		char greeting[3];
+		assert_eq_msg(3, read(fd, greeting, sizeof(greeting)), "expected a greeting");
+		assert_zero_msg(memcmp(greeting, "\xff\xfb\x01", 3), "expected the server to offer to echo");
+
+		// a dropped tetrimino, a telnet negotiation in the middle, then quit
+		assert_eq_msg(8, write(fd, "\r\n\xff\xfd\x03 q", 8), "failed to send keys");
+
+		long total = read_until_closed(fd, tail, sizeof(tail));
+		assert_true_msg(total > 0, "expected the server to draw the game and close the connection");
+		assert_nonnull_msg(strstr(tail, "You scored"), "expected the final score, but got '%s'", tail);
+
+		server_stop(&server);
+		opened = 0;
+		assert_eq_msg(1, server.stats.sessions, "expected one session, but was %lu", server.stats.sessions);
+		assert_nonzero_msg(access(address + 5, F_OK), "expected the socket to be removed");
+	}
+
+	if (fd >= 0)
+		close(fd);
+	if (opened)
+		server_stop(&server);
+	TEST_END();
+}
+
+TEST_DEFINE(server_full_test)
+{
+	struct game_server server;
+	struct server_options options;
+	char address[64], tail[256];
+	int first = -1, second = -1, opened;
+
+	socket_address(address, sizeof(address));
+	server_options_init(&options);
+	options.address = address;
+	options.workers = 1;
+	options.max_sessions = 1;
+	opened = !server_open(&server, &options);
+
+	TEST_START() {
+		assert_true_msg(opened, "expected the server to listen at '%s'", address);
+
+		first = connect_client(address);
+		second = connect_client(address);
+		assert_true_msg(first >= 0 && second >= 0, "expected to connect to the server");
+
+		assert_true_msg(read_until_closed(second, tail, sizeof(tail)) > 0, "expected the second client to be turned away");
+		assert_nonnull_msg(strstr(tail, "full"), "expected to be told the server is full, but got '%s'", tail);
+
+		server_stop(&server);
+		opened = 0;
+		assert_eq_msg(1, server.stats.rejected, "expected one connection to be turned away");
+		assert_eq_msg(1, server.stats.peak_sessions, "expected at most one session at once");
+	}
+
+	if (first >= 0)
+		close(first);
+	if (second >= 0)
+		close(second);
+	if (opened)
+		server_stop(&server);
+	TEST_END();
+}
+
+TEST_DEFINE(server_paused_session_idle_test)
+{
+	struct game_server server;
+	struct server_options options;
+	char address[64], tail[256];
+	int fd = -1, opened;
+
+	socket_address(address, sizeof(address));
+	server_options_init(&options);
+	options.address = address;
+	options.workers = 1;
+	opened = !server_open(&server, &options);
+
+	TEST_START() {
+		assert_true_msg(opened, "expected the server to listen at '%s'", address);
+
+		fd = connect_client(address);
+		assert_true_msg(fd >= 0, "expected to connect to the server");
+		assert_eq_msg(1, write(fd, "p", 1), "failed to send keys");
+
+		// without ticking while paused, the worker only wakes up for the keys
+		usleep(TEST_PAUSE_USEC);
+		assert_eq_msg(1, write(fd, "q", 1), "failed to send keys");
+		assert_true_msg(read_until_closed(fd, tail, sizeof(tail)) > 0, "expected the server to close the connection");
+
+		server_stop(&server);
+		opened = 0;
+		assert_true_msg(server.stats.wakeups < TEST_PAUSE_USEC / GAME_TICK_USEC / 2,
+				"expected the worker to sleep while the game was paused, but woke up %lu times", server.stats.wakeups);
+		assert_true_msg(server.stats.usec >= TEST_PAUSE_USEC, "expected the server to report how long it ran");
+	}
+
+	if (fd >= 0)
+		close(fd);
+	if (opened)
+		server_stop(&server);
+	TEST_END();
+}
+
+TEST_DEFINE(server_invalid_address_test)
+{
+	struct game_server server;
+	struct server_options options;
+
+	server_options_init(&options);
+
+	TEST_START() {
+		options.address = "udp:1234";
+		assert_nonzero_msg(server_open(&server, &options), "expected an unknown address type to fail");
+		options.address = "unix:";
+		assert_nonzero_msg(server_open(&server, &options), "expected an empty path to fail");
+		options.address = "tcp:localhost:";
+		assert_nonzero_msg(server_open(&server, &options), "expected a missing port to fail");
+	}
+
+	TEST_END();
+}
+
+int game_server_test(struct test_runner_instance *instance)
+{
+	struct unit_test tests[] = {
+			{ "server should stream a game and close it once the player quits", server_play_session_test },
+			{ "server should turn connections away once full", server_full_test },
+			{ "server should not wake up for paused sessions", server_paused_session_idle_test },
+			{ "server_open should reject invalid addresses", server_invalid_address_test },
+			{ NULL, NULL }
+	};
+
+	return execute_tests(instance, tests);
+}
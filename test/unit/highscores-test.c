@@ -0,0 +1,240 @@
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "test-lib.h"
+#include "highscores.h"
+
+static int open_temporary(struct highscores *scores, char *path)
+{
+	strcpy(path, "/tmp/tetris-highscores-XXXXXX");
+	int fd = mkstemp(path);
+	if (fd < 0)
+		return 1;
+
+	close(fd);
+	return highscores_open(scores, path);
+}
+
+static int add_score(struct highscores *scores, const char *name, int score)
+{
+	struct highscore entry;
+
+	memset(&entry, 0, sizeof(entry));
+	strncpy(entry.name, name, HIGHSCORE_NAME_MAX - 1);
+	entry.score = score;
+	entry.level = score / 1000;
+
+	return highscores_add(scores, &entry);
+}
+
+/*
+ * Write `size` bytes to a new temporary file, and return its descriptor, or -1.
+ * */
+static int write_temporary(char *path, const char *data, size_t size)
+{
+	strcpy(path, "/tmp/tetris-highscores-XXXXXX");
+	int fd = mkstemp(path);
+	if (fd >= 0 && write(fd, data, size) != (ssize_t)size) {
+		close(fd);
+		unlink(path);
+		return -1;
+	}
+
+	return fd;
+}
+
+/*
+ * Whether the file holds exactly the given bytes.
+ * */
+static int unchanged(int fd, const char *data, size_t size)
+{
+	static char read_back[1 << 20];
+	struct stat st;
+
+	return !fstat(fd, &st) && st.st_size == (off_t)size && size <= sizeof(read_back) &&
+			pread(fd, read_back, size, 0) == (ssize_t)size && !memcmp(read_back, data, size);
+}
+
+TEST_DEFINE(highscores_foreign_file_test)
+{
+	static const char text[] = "width 10\nheight 24\n";
+	static char zero_prefix[1 << 20];
+	struct highscores scores;
+	char short_path[64], long_path[64];
+
+	// a file that starts with zeros, but is longer than a table and holds data further on
+	memset(zero_prefix + 64, 'x', sizeof(zero_prefix) - 64);
+
+	int short_fd = write_temporary(short_path, text, sizeof(text) - 1);
+	int long_fd = write_temporary(long_path, zero_prefix, sizeof(zero_prefix));
+
+	TEST_START() {
+		assert_true_msg(short_fd >= 0 && long_fd >= 0, "failed to create temporary files");
+
+		assert_nonzero_msg(highscores_open(&scores, short_path), "expected a short foreign file to be rejected");
+		assert_true_msg(unchanged(short_fd, text, sizeof(text) - 1), "expected a short foreign file to be left as is");
+
+		assert_nonzero_msg(highscores_open(&scores, long_path), "expected a file of zeros and data to be rejected");
+		assert_true_msg(unchanged(long_fd, zero_prefix, sizeof(zero_prefix)),
+				"expected a file of zeros and data to be left as is");
+	}
+
+	if (short_fd >= 0) {
+		close(short_fd);
+		unlink(short_path);
+	}
+	if (long_fd >= 0) {
+		close(long_fd);
+		unlink(long_path);
+	}
+	TEST_END();
+}
+
+TEST_DEFINE(highscores_top_order_test)
+{
+	struct highscores scores;
+	struct highscore top[HIGHSCORE_TOP];
+	char path[64];
+
+	TEST_START() {
+		assert_zero_msg(open_temporary(&scores, path), "failed to open a temporary high score table");
+		assert_zero_msg(highscores_top(&scores, top, 10), "expected a new table to be empty");
+
+		assert_zero_msg(add_score(&scores, "alice", 300), "failed to add a score");
+		assert_zero_msg(add_score(&scores, "bob", 1200), "failed to add a score");
+		assert_zero_msg(add_score(&scores, "carol", 300), "failed to add a score");
+		assert_zero_msg(add_score(&scores, "dave", 40), "failed to add a score");
+
+		size_t count = highscores_top(&scores, top, 3);
+		assert_eq_msg(3, count, "expected the 3 best scores, but got %zu", count);
+		assert_zero_msg(strcmp(top[0].name, "bob"), "expected bob first, but was %s", top[0].name);
+		assert_zero_msg(strcmp(top[1].name, "alice"), "expected alice to win the tie, but was %s", top[1].name);
+		assert_zero_msg(strcmp(top[2].name, "carol"), "expected carol third, but was %s", top[2].name);
+
+		/* the scores are still there once the table is opened again */
+		highscores_close(&scores);
+		assert_zero_msg(highscores_open(&scores, path), "failed to reopen the high score table");
+		assert_eq_msg(4, highscores_top(&scores, top, 10), "expected every score to be kept");
+		assert_eq_msg(1200, top[0].score, "expected the best score to be kept, but was %d", top[0].score);
+
+		highscores_close(&scores);
+	}
+
+	unlink(path);
+	TEST_END();
+}
+
+TEST_DEFINE(highscores_compaction_test)
+{
+	struct highscores scores;
+	struct highscore top[HIGHSCORE_TOP];
+	char path[64];
+
+	TEST_START() {
+		assert_zero_msg(open_temporary(&scores, path), "failed to open a temporary high score table");
+
+		/* enough results to fill the log twice over */
+		for (int i = 0; i < 2 * HIGHSCORE_LOG_MAX + 100; i++)
+			assert_zero_msg(add_score(&scores, "player", (i * 7919) % 10007), "failed to add score %d", i);
+
+		size_t count = highscores_top(&scores, top, HIGHSCORE_TOP);
+		assert_eq_msg(HIGHSCORE_TOP, count, "expected a full table, but got %zu", count);
+		assert_eq_msg(10006, top[0].score, "expected the best score to survive compaction, but was %d", top[0].score);
+
+		for (size_t i = 1; i < count; i++)
+			assert_true_msg(top[i - 1].score >= top[i].score, "expected the scores in order at %zu", i);
+
+		highscores_close(&scores);
+	}
+
+	unlink(path);
+	TEST_END();
+}
+
+TEST_DEFINE(highscores_concurrent_processes_test)
+{
+	struct highscores scores;
+	struct highscore top[HIGHSCORE_TOP];
+	char path[64];
+
+	/* each process records scores no other process has, crossing a compaction between them */
+	const int processes = 8, per_process = HIGHSCORE_LOG_MAX / 8 + 100;
+
+	TEST_START() {
+		assert_zero_msg(open_temporary(&scores, path), "failed to open a temporary high score table");
+
+		for (int p = 0; p < processes; p++) {
+			pid_t pid = fork();
+			assert_true_msg(pid >= 0, "failed to fork");
+
+			if (!pid) {
+				struct highscores child;
+				int ret = highscores_open(&child, path);
+				for (int i = 0; !ret && i < per_process; i++)
+					ret = add_score(&child, "child", i * processes + p);
+
+				_exit(ret);
+			}
+		}
+
+		int failed = 0;
+		for (int p = 0; p < processes; p++) {
+			int status;
+			wait(&status);
+			failed |= !WIFEXITED(status) || WEXITSTATUS(status);
+		}
+		assert_zero_msg(failed, "expected every process to record its scores");
+
+		size_t count = highscores_top(&scores, top, HIGHSCORE_TOP);
+		assert_eq_msg(HIGHSCORE_TOP, count, "expected a full table, but got %zu", count);
+
+		int best = processes * per_process - 1;
+		for (size_t i = 0; i < count; i++)
+			assert_eq_msg(best - (int)i, top[i].score, "expected score %d at rank %zu, but was %d",
+					best - (int)i, i, top[i].score);
+
+		highscores_close(&scores);
+	}
+
+	unlink(path);
+	TEST_END();
+}
+
+BENCH_DEFINE(highscores_add_bench)
+{
+	struct highscores scores;
+	char path[64];
+	int i = 0;
+
+	if (open_temporary(&scores, path)) {
+		unlink(path);
+		return;
+	}
+
+	BENCH_START() {
+		bench_keep(add_score(&scores, "player", i++ % 100000));
+	}
+
+	highscores_close(&scores);
+	unlink(path);
+	BENCH_END();
+}
+
+int highscores_test(struct test_runner_instance *instance)
+{
+	struct unit_test tests[] = {
+			{ "highscores_top should return the best scores in order", highscores_top_order_test },
+			{ "highscores_add should keep the best scores when the log is compacted", highscores_compaction_test },
+			{ "highscores_add should be safe from many processes at once", highscores_concurrent_processes_test },
+			{ "highscores_open should reject other files and leave them untouched", highscores_foreign_file_test },
+			{ NULL, NULL }
+	};
+
+	struct unit_bench benchmarks[] = {
+			{ "highscores_add of a single result", highscores_add_bench },
+			{ NULL, NULL }
+	};
+
+	return execute_tests(instance, tests) | execute_benchmarks(instance, benchmarks);
+}
@@ -0,0 +1,226 @@
+#include <unistd.h>
+#include <poll.h>
+
+#include "test-lib.h"
+#include "hint-engine.h"
+#include "opening-book.h"
+#include "tetris-game.h"
+
+/*
+ * Searches take a few milliseconds, but leave plenty of room for a loaded
+ * machine before giving up on a hint.
+ * */
+#define TEST_POLL_USEC 1000
+#define TEST_POLL_MAX 5000
+
+/*
+ * Wait until the engine publishes a hint for the given tetrimino, with the
+ * next tetrimino worked out too if `next` is set. Returns non-zero if it never
+ * does.
+ * */
+static int wait_for_hint(struct hint_engine *engine, unsigned long piece, int next, struct hint *hint)
+{
+	for (int i = 0; i < TEST_POLL_MAX; i++) {
+		if (!hint_engine_read(engine, hint) && hint->piece == piece && (!next || hint->has_next))
+			return 0;
+		usleep(TEST_POLL_USEC);
+	}
+
+	return 1;
+}
+
+TEST_DEFINE(hint_engine_best_placement_test)
+{
+	struct search_options options;
+	struct hint_engine engine;
+	struct tetris_game game;
+	struct placement best;
+	struct hint hint;
+
+	search_options_init(&options);
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 1);
+	int ret = hint_engine_start(&engine, &options, NULL);
+
+	TEST_START() {
+		assert_zero_msg(ret, "expected hint_engine_start() to succeed");
+		assert_nonzero_msg(hint_engine_read(&engine, &hint), "expected no hint before any position is posted");
+
+		hint_engine_post(&engine, &game.well, game.pieces);
+		assert_zero_msg(wait_for_hint(&engine, game.pieces, 0, &hint), "expected a hint for the posted position");
+		assert_true_msg(hint.has_current, "expected the first tetrimino to have a placement");
+
+		assert_zero_msg(search_best_placement(&game.well, &options, &best, NULL), "expected a placement");
+		assert_zero_msg(memcmp(&best, &hint.current, sizeof(best)), "expected the hint to be the best placement");
+	}
+
+	if (!ret)
+		hint_engine_stop(&engine);
+	TEST_END();
+}
+
+TEST_DEFINE(hint_engine_followed_hint_test)
+{
+	struct search_options options;
+	struct hint_engine engine;
+	struct tetris_game game;
+	struct hint hint;
+
+	search_options_init(&options);
+	int stopped = 0;
+
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 2);
+	int ret = hint_engine_start(&engine, &options, NULL);
+
+	TEST_START() {
+		assert_zero_msg(ret, "expected hint_engine_start() to succeed");
+
+		hint_engine_post(&engine, &game.well, game.pieces);
+		assert_zero_msg(wait_for_hint(&engine, game.pieces, 1, &hint), "expected hints for two tetriminos");
+		assert_zero_msg(tetris_game_place(&game, &hint.current), "expected the hint to be reachable");
+
+		struct placement next = hint.next;
+		hint_engine_post(&engine, &game.well, game.pieces);
+		assert_zero_msg(wait_for_hint(&engine, game.pieces, 0, &hint), "expected a hint for the next tetrimino");
+		assert_zero_msg(memcmp(&next, &hint.current, sizeof(next)),
+				"expected the hint worked out in advance to be published");
+
+		// the counters are only up to date once the worker is stopped
+		hint_engine_stop(&engine);
+		stopped = 1;
+		assert_eq_msg(1UL, engine.followed, "expected one hint to be ready in advance, but counted %lu",
+				engine.followed);
+	}
+
+	if (!ret && !stopped)
+		hint_engine_stop(&engine);
+	TEST_END();
+}
+
+TEST_DEFINE(hint_engine_latest_position_test)
+{
+	struct search_options options;
+	struct hint_engine engine;
+	struct tetris_game game;
+	struct hint hint;
+
+	search_options_init(&options);
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 3);
+	int ret = hint_engine_start(&engine, &options, NULL);
+
+	TEST_START() {
+		assert_zero_msg(ret, "expected hint_engine_start() to succeed");
+
+		// positions posted in a burst give up on all but the last
+		for (unsigned long i = 0; i < 8; i++)
+			hint_engine_post(&engine, &game.well, i);
+		assert_zero_msg(wait_for_hint(&engine, 7, 0, &hint), "expected a hint for the last position posted");
+		assert_true_msg(hint.has_current, "expected the last position to have a placement");
+	}
+
+	if (!ret)
+		hint_engine_stop(&engine);
+	TEST_END();
+}
+
+/*
+ * Give the engine a book holding `entry` for the first position of a game,
+ * and check that the hint for it is the placement found by searching
+ * instead. Returns non-zero if it isn't.
+ * */
+static int hint_with_bad_entry(const struct placement *entry)
+{
+	struct search_options options;
+	struct opening_book_entry entries[1];
+	struct opening_book book;
+	struct hint_engine engine;
+	struct tetris_game game;
+	struct placement best;
+	struct hint hint;
+	char path[64];
+	int ret = 1;
+
+	snprintf(path, sizeof(path), "/tmp/tetris-hint-test-%ld.book", (long)getpid());
+	search_options_init(&options);
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 5);
+
+	entries[0].hash = opening_book_hash(&game.well);
+	entries[0].placement = *entry;
+	if (opening_book_write(path, entries, 1, BOARD_WIDTH, BOARD_HEIGHT, 1, 1) || opening_book_open(&book, path)) {
+		unlink(path);
+		return 1;
+	}
+
+	if (!hint_engine_start(&engine, &options, &book)) {
+		hint_engine_post(&engine, &game.well, game.pieces);
+		ret = wait_for_hint(&engine, game.pieces, 1, &hint) || !hint.has_current ||
+				search_best_placement(&game.well, &options, &best, NULL) ||
+				memcmp(&best, &hint.current, sizeof(best)) != 0 ||
+				tetris_game_place(&game, &hint.current);
+		hint_engine_stop(&engine);
+	}
+
+	opening_book_close(&book);
+	unlink(path);
+	return ret;
+}
+
+TEST_DEFINE(hint_engine_bad_book_entry_test)
+{
+	struct placement outside = { { { 255, 0 }, { 255, 1 }, { 255, 2 }, { 255, 255 } } };
+	struct placement overlapping = { { { 0, BOARD_HEIGHT - 1 }, { 0, BOARD_HEIGHT - 1 },
+			{ 1, BOARD_HEIGHT - 1 }, { 2, BOARD_HEIGHT - 1 } } };
+
+	TEST_START() {
+		assert_zero_msg(hint_with_bad_entry(&outside), "expected cells outside the well to be searched instead");
+		assert_zero_msg(hint_with_bad_entry(&overlapping), "expected overlapping cells to be searched instead");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(hint_engine_published_fd_test)
+{
+	struct search_options options;
+	struct hint_engine engine;
+	struct tetris_game game;
+	struct hint hint;
+	struct pollfd pfd;
+
+	search_options_init(&options);
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 4);
+	int ret = hint_engine_start(&engine, &options, NULL);
+
+	TEST_START() {
+		assert_zero_msg(ret, "expected hint_engine_start() to succeed");
+
+		pfd.fd = engine.published_fd;
+		pfd.events = POLLIN;
+		assert_zero_msg(poll(&pfd, 1, 0), "expected nothing to be signalled before any position is posted");
+
+		hint_engine_post(&engine, &game.well, game.pieces);
+		assert_eq_msg(1, poll(&pfd, 1, TEST_POLL_MAX), "expected the hint to be signalled");
+
+		// once both hints are published, the engine is idle and reading drains the signal
+		assert_zero_msg(wait_for_hint(&engine, game.pieces, 1, &hint), "expected hints for two tetriminos");
+		assert_zero(hint_engine_read(&engine, &hint));
+		assert_zero_msg(poll(&pfd, 1, 0), "expected reading the hint to drain the signal");
+	}
+
+	if (!ret)
+		hint_engine_stop(&engine);
+	TEST_END();
+}
+
+int hint_engine_test(struct test_runner_instance *instance)
+{
+	struct unit_test tests[] = {
+			{ "hint_engine should publish the best placement of a posted position", hint_engine_best_placement_test },
+			{ "hint_engine should have the next hint ready when the player follows one", hint_engine_followed_hint_test },
+			{ "hint_engine should give up on positions posted before the latest one", hint_engine_latest_position_test },
+			{ "hint_engine should signal published hints until they are read", hint_engine_published_fd_test },
+			{ "hint_engine should search positions whose book entry can't be reached", hint_engine_bad_book_entry_test },
+			{ NULL, NULL }
+	};
+
+	return execute_tests(instance, tests);
+}
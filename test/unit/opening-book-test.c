@@ -0,0 +1,148 @@
+#include <unistd.h>
+
+#include "test-lib.h"
+#include "opening-book.h"
+#include "tetris-game.h"
+
+#define TEST_POSITIONS 64
+
+static void book_path(char *path, size_t len)
+{
+	snprintf(path, len, "/tmp/tetris-book-test-%ld.book", (long)getpid());
+}
+
+/*
+ * The positions of the first tetriminos of a game, each with the placement
+ * that was taken from it.
+ * */
+static size_t game_positions(struct tetris_well *wells, struct opening_book_entry *entries, size_t count)
+{
+	static struct placement placements[PLACEMENTS_MAX];
+	struct tetris_game game;
+	size_t nr = 0;
+
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 3);
+	for (; nr < count && game.running; nr++) {
+		size_t placed = tetrimino_placements(&game.well, placements);
+		if (!placed)
+			break;
+
+		wells[nr] = game.well;
+		entries[nr].hash = opening_book_hash(&game.well);
+		entries[nr].placement = placements[nr % placed];
+		tetris_game_place(&game, &entries[nr].placement);
+	}
+
+	return nr;
+}
+
+TEST_DEFINE(opening_book_lookup_test)
+{
+	static struct tetris_well wells[TEST_POSITIONS];
+	static struct opening_book_entry entries[TEST_POSITIONS], expected[TEST_POSITIONS];
+	struct opening_book book;
+	struct placement placement;
+	char path[64];
+	int opened = 0;
+
+	book_path(path, sizeof(path));
+	size_t count = game_positions(wells, entries, TEST_POSITIONS);
+	memcpy(expected, entries, sizeof(entries));
+
+	TEST_START() {
+		assert_true_msg(count > 16, "expected the game to last longer than %zu tetriminos", count);
+		assert_zero_msg(opening_book_write(path, entries, count, BOARD_WIDTH, BOARD_HEIGHT, 4, 4),
+				"expected the book to be written");
+		assert_zero_msg(opening_book_open(&book, path), "expected the book to be valid");
+		opened = 1;
+		assert_eq_msg(count, book.header->count, "expected every position in the book");
+
+		for (size_t i = 0; i < count; i++) {
+			assert_zero_msg(opening_book_lookup(&book, &wells[i], &placement), "expected position %zu in the book", i);
+			assert_zero_msg(memcmp(&placement, &expected[i].placement, sizeof(placement)),
+					"expected the placement recorded for position %zu", i);
+		}
+
+		/* the same board with another tetrimino queued is another position */
+		struct tetris_well other = wells[0];
+		other.tetrimino_bag[0] = (other.tetrimino_bag[0] + 1) % 7;
+		assert_nonzero_msg(opening_book_lookup(&book, &other, &placement), "expected the queue to be part of the position");
+
+		/* cells are compared by whether they are occupied, not by what */
+		other = wells[count - 1];
+		for (size_t j = 0; j < BOARD_WIDTH; j++) {
+			if (other.matrix[BOARD_HEIGHT - 1][j] != CELL_TYPE_NONE)
+				other.matrix[BOARD_HEIGHT - 1][j] = CELL_TYPE_O;
+		}
+		assert_zero_msg(opening_book_lookup(&book, &other, &placement), "expected the colors of cells to be ignored");
+	}
+
+	if (opened)
+		opening_book_close(&book);
+	unlink(path);
+	TEST_END();
+}
+
+TEST_DEFINE(opening_book_invalid_file_test)
+{
+	struct opening_book book;
+	char path[64];
+
+	book_path(path, sizeof(path));
+	FILE *file = fopen(path, "w");
+
+	TEST_START() {
+		assert_nonnull_msg(file, "failed to create %s", path);
+		fputs("tetrisOB but not much else", file);
+		fclose(file);
+		file = NULL;
+
+		assert_nonzero_msg(opening_book_open(&book, path), "expected a truncated book to be rejected");
+		assert_nonzero_msg(opening_book_open(&book, "/nonexistent/tetris.book"), "expected a missing book to fail");
+	}
+
+	if (file)
+		fclose(file);
+	unlink(path);
+	TEST_END();
+}
+
+BENCH_DEFINE(opening_book_lookup_bench)
+{
+	static struct tetris_well wells[TEST_POSITIONS];
+	static struct opening_book_entry entries[TEST_POSITIONS];
+	struct opening_book book;
+	struct placement placement;
+	char path[64];
+	size_t i = 0;
+
+	book_path(path, sizeof(path));
+	size_t count = game_positions(wells, entries, TEST_POSITIONS);
+	if (opening_book_write(path, entries, count, BOARD_WIDTH, BOARD_HEIGHT, 4, 4) ||
+			opening_book_open(&book, path))
+		return;
+
+	BENCH_START() {
+		bench_keep(opening_book_lookup(&book, &wells[i++ % count], &placement));
+	}
+
+	opening_book_close(&book);
+	unlink(path);
+	BENCH_END();
+}
+
+int opening_book_test(struct test_runner_instance *instance)
+{
+	struct unit_test tests[] = {
+			{ "opening_book_lookup should find every position written", opening_book_lookup_test },
+			{ "opening_book_open should reject invalid books", opening_book_invalid_file_test },
+			{ NULL, NULL }
+	};
+
+	struct unit_bench benchmarks[] = {
+			{ "opening_book_lookup of a position in the book", opening_book_lookup_bench },
+			{ NULL, NULL }
+	};
+
+	return execute_tests(instance, tests) | execute_benchmarks(instance, benchmarks);
+}
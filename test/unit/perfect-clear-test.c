@@ -0,0 +1,233 @@
+#include <string.h>
+
+#include "test-lib.h"
+#include "perfect-clear.h"
+
+/*
+ * A standard well with the given tetriminos to place, and the bottom rows
+ * given as bitmasks.
+ * */
+static void puzzle(struct perfect_clear_problem *problem, const char *pieces, const uint16_t *rows,
+		size_t rows_nr, int clear_rows)
+{
+	memset(problem, 0, sizeof(*problem));
+	problem->width = BOARD_WIDTH;
+	problem->height = BOARD_HEIGHT;
+	problem->clear_rows = clear_rows;
+
+	for (size_t i = 0; i < rows_nr; i++)
+		problem->rows[i] = rows[i];
+	for (; *pieces; pieces++)
+		problem->pieces[problem->pieces_nr++] = (uint8_t)(strchr(tetrimino_names, *pieces) - tetrimino_names);
+}
+
+/*
+ * An O tetrimino in the bottom left corner, to be cleared with the rest of a
+ * perfect clear opening.
+ * */
+static void opening_puzzle(struct perfect_clear_problem *problem)
+{
+	static const uint16_t rows[] = { 0x3, 0x3 };
+	puzzle(problem, "ILJSZTOIL", rows, 2, 4);
+}
+
+/*
+ * Play the solution out in a well: every placement must be reachable when
+ * its tetrimino spawns, and the well must end up empty.
+ * */
+static int replay_solution(const struct perfect_clear_problem *problem, const struct perfect_clear_solution *solution)
+{
+	static struct placement placements[PLACEMENTS_MAX];
+	struct tetris_well well;
+
+	tetris_well_init(&well);
+	for (size_t i = 0; i < PERFECT_CLEAR_MAX_ROWS; i++) {
+		for (size_t j = 0; j < problem->width; j++) {
+			if (problem->rows[i] & (1u << j))
+				well.matrix[problem->height - 1 - i][j] = CELL_TYPE_L;
+		}
+	}
+
+	for (size_t i = 0; i < solution->nr; i++) {
+		well.tetrimino_bag[0] = problem->pieces[i];
+		well.tetrimino_bag_index = 1;
+		if (tetrimino_new(&well))
+			return 1;
+
+		size_t count = tetrimino_placements(&well, placements), found = count;
+		for (size_t j = 0; j < count; j++) {
+			if (!memcmp(&placements[j], &solution->placements[i], sizeof(struct placement)))
+				found = j;
+		}
+
+		if (found == count)
+			return 1;
+
+		tetrimino_place(&well, &placements[found]);
+		tetris_well_commit_tetrimino(&well);
+	}
+
+	for (size_t i = 0; i < problem->height; i++) {
+		for (size_t j = 0; j < problem->width; j++) {
+			if (well.matrix[i][j] != CELL_TYPE_NONE)
+				return 1;
+		}
+	}
+
+	return 0;
+}
+
+TEST_DEFINE(perfect_clear_solve_test)
+{
+	struct perfect_clear_problem problem;
+	struct perfect_clear_options options;
+	struct perfect_clear_result result;
+
+	opening_puzzle(&problem);
+	perfect_clear_options_init(&options);
+
+	TEST_START() {
+		assert_zero_msg(perfect_clear_solve(&problem, &options, &result), "expected the puzzle to be valid");
+		assert_eq_msg(1, result.solutions, "expected to stop at the first solution, not %lu", result.solutions);
+		assert_eq_msg(4, result.clear_rows, "expected four rows cleared, not %d", result.clear_rows);
+		assert_eq_msg(problem.pieces_nr, result.first.nr, "expected every tetrimino to be placed");
+		assert_zero_msg(replay_solution(&problem, &result.first),
+				"expected the solution to clear the well when played out");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(perfect_clear_threads_test)
+{
+	struct perfect_clear_problem problem;
+	struct perfect_clear_options options;
+	struct perfect_clear_result single, threaded, all, all_threaded;
+
+	opening_puzzle(&problem);
+	perfect_clear_options_init(&options);
+
+	TEST_START() {
+		options.threads = 1;
+		assert_zero(perfect_clear_solve(&problem, &options, &single));
+		options.max_solutions = 0;
+		assert_zero(perfect_clear_solve(&problem, &options, &all));
+
+		options.threads = 4;
+		assert_zero(perfect_clear_solve(&problem, &options, &all_threaded));
+		options.max_solutions = 1;
+		assert_zero(perfect_clear_solve(&problem, &options, &threaded));
+
+		assert_zero_msg(memcmp(&single.first, &threaded.first, sizeof(single.first)),
+				"expected the same first solution with any number of threads");
+		assert_zero_msg(memcmp(&single.first, &all.first, sizeof(single.first)),
+				"expected the same first solution when counting them all");
+		assert_true_msg(all.solutions > 1, "expected several solutions, not %lu", all.solutions);
+		assert_eq_msg(all.solutions, all_threaded.solutions, "expected %lu solutions with threads, not %lu",
+				all.solutions, all_threaded.solutions);
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(perfect_clear_unsolvable_test)
+{
+	static const uint16_t tall[] = { 0x3, 0x3, 0x3 };
+	struct perfect_clear_problem problem;
+	struct perfect_clear_options options;
+	struct perfect_clear_result result;
+
+	perfect_clear_options_init(&options);
+
+	TEST_START() {
+		// S tetriminos always leave a hole in an empty well
+		puzzle(&problem, "SSSSS", NULL, 0, 2);
+		assert_zero(perfect_clear_solve(&problem, &options, &result));
+		assert_zero_msg(result.solutions, "expected no solutions, not %lu", result.solutions);
+
+		puzzle(&problem, "OOOO", NULL, 0, 2);
+		assert_nonzero_msg(perfect_clear_solve(&problem, &options, &result),
+				"expected too few tetriminos to be rejected");
+
+		puzzle(&problem, "IIIIIIIIII", tall, 3, 2);
+		assert_nonzero_msg(perfect_clear_solve(&problem, &options, &result),
+				"expected a stack taller than the rows to clear to be rejected");
+
+		// the fewest rows that can be cleared
+		puzzle(&problem, "IIIIIIIIII", tall, 3, 0);
+		assert_zero(perfect_clear_solve(&problem, &options, &result));
+		assert_eq_msg(3, result.clear_rows, "expected three rows cleared, not %d", result.clear_rows);
+		assert_eq(1, result.solutions);
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(perfect_clear_from_well_test)
+{
+	struct perfect_clear_problem problem;
+	struct tetris_well well;
+
+	tetris_well_init(&well);
+	well.matrix[BOARD_HEIGHT - 1][0] = CELL_TYPE_I;
+	well.matrix[BOARD_HEIGHT - 2][3] = CELL_TYPE_I;
+	well.tetrimino_bag[0] = 5;
+	well.tetrimino_bag[1] = 1;
+	well.tetrimino_bag[2] = 2;
+	well.tetrimino_bag_index = 3;
+	tetrimino_new(&well);
+
+	TEST_START() {
+		assert_zero(perfect_clear_from_well(&problem, &well, 0));
+		assert_eq(0x1, problem.rows[0]);
+		assert_eq(0x8, problem.rows[1]);
+		assert_eq(0, problem.rows[2]);
+		assert_eq_msg(3, problem.pieces_nr, "expected the current and queued tetriminos, not %zu", problem.pieces_nr);
+		assert_eq(2, problem.pieces[0]);
+		assert_eq(1, problem.pieces[1]);
+		assert_eq(5, problem.pieces[2]);
+
+		well.matrix[BOARD_HEIGHT - 1 - PERFECT_CLEAR_MAX_ROWS][0] = CELL_TYPE_I;
+		assert_nonzero_msg(perfect_clear_from_well(&problem, &well, 0), "expected a tall stack to be rejected");
+	}
+
+	TEST_END();
+}
+
+BENCH_DEFINE(perfect_clear_count_bench)
+{
+	struct perfect_clear_problem problem;
+	struct perfect_clear_options options;
+	struct perfect_clear_result result;
+
+	opening_puzzle(&problem);
+	perfect_clear_options_init(&options);
+	options.threads = 1;
+	options.max_solutions = 0;
+
+	BENCH_START() {
+		bench_keep(perfect_clear_solve(&problem, &options, &result));
+	}
+
+	BENCH_END();
+}
+
+int perfect_clear_test(struct test_runner_instance *instance)
+{
+	struct unit_test tests[] = {
+			{ "perfect_clear_solve should find a solution that plays out in a well", perfect_clear_solve_test },
+			{ "perfect_clear_solve should find the same solutions with any number of threads",
+					perfect_clear_threads_test },
+			{ "perfect_clear_solve should reject invalid problems and find no solution to others",
+					perfect_clear_unsolvable_test },
+			{ "perfect_clear_from_well should take the stack and tetriminos of a well", perfect_clear_from_well_test },
+			{ NULL, NULL }
+	};
+
+	struct unit_bench benchmarks[] = {
+			{ "perfect_clear_solve counting every solution of an opening, one thread", perfect_clear_count_bench },
+			{ NULL, NULL }
+	};
+
+	return execute_tests(instance, tests) | execute_benchmarks(instance, benchmarks);
+}
@@ -0,0 +1,162 @@
+#include "test-lib.h"
+#include "placement.h"
+#include "tetris-well.h"
+
+/*
+ * Put a tetrimino of the given type (an index into cell_init_coords) at its
+ * spawn position.
+ * */
+static void spawn_tetrimino(struct tetris_well *well, size_t index)
+{
+	well->tetrimino_type = (uint8_t)((unsigned)1 << index);
+	for (size_t i = 0; i < 4; i++) {
+		well->tetrimino_coords[i][0] = cell_init_coords[index][i][0];
+		well->tetrimino_coords[i][1] = cell_init_coords[index][i][1];
+	}
+}
+
+static int has_placement(struct placement *placements, size_t count, const uint8_t cells[4][2])
+{
+	for (size_t i = 0; i < count; i++) {
+		if (!memcmp(placements[i].coords, cells, sizeof(placements[i].coords)))
+			return 1;
+	}
+
+	return 0;
+}
+
+TEST_DEFINE(placements_empty_well_test)
+{
+	static struct placement placements[PLACEMENTS_MAX];
+	struct tetris_well well;
+
+	/* one per column and distinct orientation, for types I, O, T, S, Z, J, L */
+	static const size_t expected[7] = { 17, 9, 34, 17, 17, 34, 34 };
+
+	TEST_START() {
+		for (size_t i = 0; i < 7; i++) {
+			tetris_well_init(&well);
+			spawn_tetrimino(&well, i);
+
+			size_t count = tetrimino_placements(&well, placements);
+			assert_eq_msg(count, expected[i], "expected %zu placements for type %zu, but found %zu",
+					expected[i], i, count);
+
+			for (size_t j = 0; j < count; j++) {
+				size_t bottom = 0;
+				for (size_t k = 0; k < 4; k++) {
+					if (placements[j].coords[k][1] > bottom)
+						bottom = placements[j].coords[k][1];
+				}
+
+				assert_eq_msg(bottom, BOARD_HEIGHT - 1,
+						"placement %zu for type %zu isn't resting on the floor", j, i);
+			}
+		}
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(placements_leave_tetrimino_test)
+{
+	static struct placement placements[PLACEMENTS_MAX];
+	struct tetris_well well;
+	size_t coords[4][2];
+
+	tetris_well_init(&well);
+	spawn_tetrimino(&well, 2);
+	memcpy(coords, well.tetrimino_coords, sizeof(coords));
+
+	size_t count = tetrimino_placements(&well, placements);
+
+	TEST_START() {
+		assert_nonzero(count);
+		assert_zero_msg(memcmp(coords, well.tetrimino_coords, sizeof(coords)),
+				"expected tetrimino_placements to leave the tetrimino where it was");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(placements_under_overhang_test)
+{
+	static struct placement placements[PLACEMENTS_MAX];
+	struct tetris_well well;
+
+	/* an O tetrimino sliding under the roof, into the bottom left corner */
+	static const uint8_t tucked[4][2] = { { 0, 22 }, { 1, 22 }, { 0, 23 }, { 1, 23 } };
+
+	tetris_well_init(&well);
+	for (size_t i = 0; i < 4; i++)
+		well.matrix[BOARD_HEIGHT - 3][i] = CELL_TYPE_I;
+	spawn_tetrimino(&well, 1);
+
+	size_t count = tetrimino_placements(&well, placements);
+
+	TEST_START() {
+		assert_true_msg(has_placement(placements, count, tucked),
+				"expected a placement underneath the overhang");
+
+		for (size_t i = 0; i < count; i++) {
+			struct tetris_well next = well;
+			tetrimino_place(&next, &placements[i]);
+			assert_neq_msg(tetrimino_shift(&next, SHIFT_DOWN), 0,
+					"expected placement %zu to be resting on something", i);
+		}
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(placements_blocked_spawn_test)
+{
+	static struct placement placements[PLACEMENTS_MAX];
+	struct tetris_well well;
+
+	tetris_well_init(&well);
+	spawn_tetrimino(&well, 0);
+	well.matrix[well.tetrimino_coords[0][1]][well.tetrimino_coords[0][0]] = CELL_TYPE_O;
+
+	TEST_START() {
+		assert_zero(tetrimino_placements(&well, placements));
+	}
+
+	TEST_END();
+}
+
+BENCH_DEFINE(placements_bench)
+{
+	static struct placement placements[PLACEMENTS_MAX];
+	struct tetris_well well;
+	size_t i = 0;
+
+	tetris_well_init(&well);
+	for (size_t j = 0; j < BOARD_WIDTH; j += 3)
+		well.matrix[BOARD_HEIGHT - 1][j] = CELL_TYPE_I;
+
+	BENCH_START() {
+		spawn_tetrimino(&well, i++ % 7);
+		bench_keep(tetrimino_placements(&well, placements));
+	}
+
+	BENCH_END();
+}
+
+int placement_test(struct test_runner_instance *instance)
+{
+	struct unit_test tests[] = {
+			{ "tetrimino_placements should find every resting place in an empty well", placements_empty_well_test },
+			{ "tetrimino_placements should leave the tetrimino where it is", placements_leave_tetrimino_test },
+			{ "tetrimino_placements should find placements underneath overhangs", placements_under_overhang_test },
+			{ "tetrimino_placements should find nothing if the tetrimino is blocked", placements_blocked_spawn_test },
+			{ NULL, NULL }
+	};
+
+	struct unit_bench benchmarks[] = {
+			{ "tetrimino_placements for each tetrimino type", placements_bench },
+			{ NULL, NULL }
+	};
+
+	return execute_tests(instance, tests) | execute_benchmarks(instance, benchmarks);
+}
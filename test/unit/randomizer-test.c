@@ -0,0 +1,234 @@
+#include "test-lib.h"
+#include "randomizer.h"
+#include "tetris-well.h"
+
+#define SEQUENCE_LEN 7000
+
+/*
+ * The fraction of pieces in the sequence that repeat the piece before them.
+ * */
+static double repeat_rate(const uint8_t *pieces, size_t len)
+{
+	size_t repeats = 0;
+
+	for (size_t i = 1; i < len; i++)
+		repeats += pieces[i] == pieces[i - 1];
+
+	return (double)repeats / (double)(len - 1);
+}
+
+TEST_DEFINE(randomizer_bag_deals_every_type_test)
+{
+	static uint8_t pieces[SEQUENCE_LEN];
+	struct randomizer randomizer;
+
+	randomizer_init(&randomizer, RANDOMIZER_BAG, 1);
+
+	TEST_START() {
+		randomizer_generate(&randomizer, pieces, SEQUENCE_LEN);
+
+		for (size_t i = 0; i < SEQUENCE_LEN; i += 7) {
+			unsigned seen = 0;
+			for (size_t j = i; j < i + 7; j++)
+				seen |= 1u << pieces[j];
+
+			assert_eq_msg(seen, 0x7fu, "expected bag %zu to hold every type once", i / 7);
+		}
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(randomizer_split_generation_test)
+{
+	static uint8_t whole[SEQUENCE_LEN], split[SEQUENCE_LEN];
+	struct randomizer a, b;
+
+	TEST_START() {
+		for (int type = 0; type < RANDOMIZER_COUNT; type++) {
+			randomizer_init(&a, type, 42);
+			randomizer_init(&b, type, 42);
+
+			randomizer_generate(&a, whole, SEQUENCE_LEN);
+
+			/* uneven chunks must give the same sequence as one large one */
+			for (size_t n = 0, chunk = 1; n < SEQUENCE_LEN; n += chunk, chunk = chunk % 11 + 1) {
+				if (n + chunk > SEQUENCE_LEN)
+					chunk = SEQUENCE_LEN - n;
+				randomizer_generate(&b, split + n, chunk);
+			}
+
+			assert_zero_msg(memcmp(whole, split, SEQUENCE_LEN),
+					"expected the %s randomizer to generate the same sequence in chunks", randomizer_name(type));
+
+			for (size_t i = 0; i < SEQUENCE_LEN; i++)
+				assert_true_msg(whole[i] < 7, "the %s randomizer generated an invalid piece %u",
+						randomizer_name(type), whole[i]);
+		}
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(randomizer_repeats_test)
+{
+	static uint8_t pieces[SEQUENCE_LEN];
+	struct randomizer randomizer;
+
+	TEST_START() {
+		/* a repeat is 1 in 7 for pure random pieces, and 1 in 28 for the NES */
+		randomizer_init(&randomizer, RANDOMIZER_RANDOM, 3);
+		randomizer_generate(&randomizer, pieces, SEQUENCE_LEN);
+		double random_rate = repeat_rate(pieces, SEQUENCE_LEN);
+		assert_true_msg(random_rate > 0.11 && random_rate < 0.18,
+				"expected random pieces to repeat about 1 in 7 times, but was %f", random_rate);
+
+		randomizer_init(&randomizer, RANDOMIZER_NES, 3);
+		randomizer_generate(&randomizer, pieces, SEQUENCE_LEN);
+		double nes_rate = repeat_rate(pieces, SEQUENCE_LEN);
+		assert_true_msg(nes_rate < 0.06,
+				"expected NES pieces to repeat about 1 in 28 times, but was %f", nes_rate);
+
+		randomizer_init(&randomizer, RANDOMIZER_TGM, 3);
+		randomizer_generate(&randomizer, pieces, SEQUENCE_LEN);
+		double tgm_rate = repeat_rate(pieces, SEQUENCE_LEN);
+		assert_true_msg(tgm_rate < nes_rate,
+				"expected TGM pieces to repeat less often than NES pieces, but was %f", tgm_rate);
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(randomizer_tgm_first_piece_test)
+{
+	struct randomizer randomizer;
+	uint8_t piece;
+
+	TEST_START() {
+		for (uint64_t seed = 0; seed < 1000; seed++) {
+			randomizer_init(&randomizer, RANDOMIZER_TGM, seed);
+			randomizer_generate(&randomizer, &piece, 1);
+
+			/* types S, Z and O */
+			assert_true_msg(piece != 3 && piece != 4 && piece != 1,
+					"expected the first TGM piece never to be S, Z or O, but was %u", piece);
+		}
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(randomizer_parse_test)
+{
+	TEST_START() {
+		for (int type = 0; type < RANDOMIZER_COUNT; type++)
+			assert_eq_msg(randomizer_parse(randomizer_name(type)), type,
+					"expected the name of randomizer %d to parse back", type);
+
+		assert_eq_msg(randomizer_parse("shuffle"), -1, "expected an unknown name to be rejected");
+		assert_null_msg(randomizer_name(RANDOMIZER_COUNT), "expected no name for an unknown type");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(randomizer_next_test)
+{
+	uint64_t state = randomizer_state(42), again = randomizer_state(42), other = randomizer_state(43);
+
+	TEST_START() {
+		assert_nonzero_msg(randomizer_state(0), "expected the state of a zero seed to be usable");
+		assert_true_msg(randomizer_mix(1) != randomizer_mix(2) && randomizer_mix(1) >> 32,
+				"expected neighbouring values to be scrambled into unrelated ones");
+
+		int differ = 0;
+		for (int i = 0; i < 1000; i++) {
+			uint64_t value = randomizer_next(&state);
+			assert_eq_msg(value, randomizer_next(&again), "expected the same seed to give the same numbers");
+			differ |= value != randomizer_next(&other);
+		}
+		assert_true_msg(differ, "expected neighbouring seeds to give different numbers");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(tetrimino_preview_test)
+{
+	struct tetris_well previewed, plain;
+	size_t preview[20];
+
+	tetris_well_init(&previewed);
+	tetris_well_randomizer(&previewed, RANDOMIZER_BAG, 7);
+	tetris_well_init(&plain);
+	tetris_well_randomizer(&plain, RANDOMIZER_BAG, 7);
+
+	TEST_START() {
+		tetrimino_new(&previewed);
+		tetrimino_new(&plain);
+
+		size_t count = tetrimino_preview(&previewed, preview, 20);
+		assert_eq_msg(count, 20, "expected 20 tetriminos in the preview, but was %zu", count);
+
+		/* previewing must not change the tetriminos that follow */
+		for (size_t i = 0; i < 20; i++) {
+			tetrimino_new(&previewed);
+			tetrimino_new(&plain);
+
+			assert_eq_msg(previewed.tetrimino_type, (uint8_t)(1u << preview[i]),
+					"expected tetrimino %zu to be the one previewed", i);
+			assert_eq_msg(previewed.tetrimino_type, plain.tetrimino_type,
+					"expected tetrimino %zu to be the same with or without a preview", i);
+		}
+
+		count = tetrimino_preview(&previewed, preview, TETRIMINO_QUEUE_MAX + 1);
+		assert_eq_msg(count, TETRIMINO_QUEUE_MAX, "expected the preview to be capped, but was %zu", count);
+	}
+
+	TEST_END();
+}
+
+#define RANDOMIZER_BENCH(__bench_name, __type) \
+	BENCH_DEFINE(__bench_name) \
+	{ \
+		static uint8_t pieces[4096]; \
+		struct randomizer randomizer; \
+		\
+		randomizer_init(&randomizer, (__type), 1); \
+		\
+		BENCH_START() { \
+			randomizer_generate(&randomizer, pieces, sizeof(pieces)); \
+			bench_keep(pieces[0]); \
+		} \
+		\
+		BENCH_END(); \
+	}
+
+RANDOMIZER_BENCH(randomizer_bag_bench, RANDOMIZER_BAG)
+RANDOMIZER_BENCH(randomizer_random_bench, RANDOMIZER_RANDOM)
+RANDOMIZER_BENCH(randomizer_nes_bench, RANDOMIZER_NES)
+RANDOMIZER_BENCH(randomizer_tgm_bench, RANDOMIZER_TGM)
+
+int randomizer_test(struct test_runner_instance *instance)
+{
+	struct unit_test tests[] = {
+			{ "the bag randomizer should deal every type once per bag", randomizer_bag_deals_every_type_test },
+			{ "randomizer_generate should give the same sequence however it is split up", randomizer_split_generation_test },
+			{ "the NES and TGM randomizers should repeat pieces less often", randomizer_repeats_test },
+			{ "the TGM randomizer should never start with an S, Z or O", randomizer_tgm_first_piece_test },
+			{ "randomizer_parse should accept the name of every randomizer", randomizer_parse_test },
+			{ "randomizer_next should be reproducible from its seed", randomizer_next_test },
+			{ "tetrimino_preview should show the tetriminos that follow", tetrimino_preview_test },
+			{ NULL, NULL }
+	};
+
+	struct unit_bench benchmarks[] = {
+			{ "randomizer_generate of 4096 pieces from the bag", randomizer_bag_bench },
+			{ "randomizer_generate of 4096 pure random pieces", randomizer_random_bench },
+			{ "randomizer_generate of 4096 NES pieces", randomizer_nes_bench },
+			{ "randomizer_generate of 4096 TGM pieces", randomizer_tgm_bench },
+			{ NULL, NULL }
+	};
+
+	return execute_tests(instance, tests) | execute_benchmarks(instance, benchmarks);
+}
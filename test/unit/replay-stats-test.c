@@ -0,0 +1,193 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "test-lib.h"
+#include "replay-stats.h"
+
+/*
+ * Play a deterministic game from the given seed, recording its inputs into
+ * `replay` and leaving the final state in `live`.
+ * */
+static void record_game(struct replay *replay, struct tetris_game *live, uint64_t seed)
+{
+	tetris_game_init(live, BOARD_WIDTH, BOARD_HEIGHT, seed);
+	replay_init(replay, seed, BOARD_WIDTH, BOARD_HEIGHT);
+
+	for (unsigned long i = 0; live->running && i < 20000; i++) {
+		if (i % 7 == 0) {
+			int input = (int)(i / 7 % 4) == 3 ? INPUT_DROP : (int)(i / 7 % 4) + 1;
+			replay_append(replay, live->ticks, input);
+			tetris_game_input(live, input);
+		}
+
+		tetris_game_tick(live);
+	}
+	replay->end_tick = live->ticks;
+}
+
+TEST_DEFINE(replay_stats_add_count_locks_test)
+{
+	struct replay replay;
+	struct tetris_game live;
+	struct replay_stats *stats = malloc(sizeof(*stats));
+
+	record_game(&replay, &live, 99);
+
+	TEST_START() {
+		assert_nonnull(stats);
+		replay_stats_init(stats);
+		assert_zero_msg(replay_stats_add(stats, &replay), "expected replay_stats_add() to succeed");
+
+		assert_eq_msg(1, stats->games, "expected 1 game, but was %llu", (unsigned long long)stats->games);
+		assert_zero_msg(stats->invalid, "expected no invalid replays");
+		assert_eq_msg(live.ticks, stats->ticks, "expected %lu ticks, but was %llu", live.ticks,
+				(unsigned long long)stats->ticks);
+		assert_eq_msg(live.pieces, stats->pieces, "expected %lu pieces, but was %llu", live.pieces,
+				(unsigned long long)stats->pieces);
+
+		uint64_t cells = 0, locks = 0, columns = 0, clears = 0, lines = 0;
+		for (size_t y = 0; y < BOARD_MAX_HEIGHT; y++) {
+			for (size_t x = 0; x < BOARD_MAX_WIDTH; x++)
+				cells += stats->cells[y][x];
+		}
+		for (size_t type = 0; type < 7; type++) {
+			locks += stats->locks[type];
+			for (size_t x = 0; x < BOARD_MAX_WIDTH; x++)
+				columns += stats->columns[type][x];
+			assert_true_msg(stats->hole_locks[type] <= stats->locks[type],
+					"expected no more locks creating holes than locks");
+			assert_true_msg(stats->hole_locks[type] <= stats->holes[type],
+					"expected every lock creating holes to create at least one");
+		}
+		for (size_t level = 0; level < REPLAY_STATS_LEVELS; level++) {
+			for (size_t n = 0; n < 5; n++) {
+				clears += stats->clears[level][n];
+				lines += n * stats->clears[level][n];
+			}
+		}
+
+		assert_eq_msg(4 * stats->pieces, cells, "expected every lock to cover 4 cells");
+		assert_eq_msg(stats->pieces, locks, "expected every lock to be counted by type");
+		assert_eq_msg(stats->pieces, columns, "expected every lock to be counted by column");
+		assert_eq_msg(stats->pieces, clears, "expected every lock to be counted by level");
+		assert_eq_msg((uint64_t)live.lines, lines, "expected %d lines, but was %llu", live.lines,
+				(unsigned long long)lines);
+	}
+
+	replay_release(&replay);
+	free(stats);
+	TEST_END();
+}
+
+TEST_DEFINE(replay_stats_merge_test)
+{
+	struct replay first, second;
+	struct tetris_game live;
+	struct replay_stats *stats = malloc(3 * sizeof(*stats));
+
+	record_game(&first, &live, 5);
+	record_game(&second, &live, 6);
+
+	TEST_START() {
+		assert_nonnull(stats);
+		replay_stats_init(&stats[0]);
+		replay_stats_init(&stats[1]);
+		replay_stats_init(&stats[2]);
+
+		// both games into one, and each into its own before merging
+		assert_zero(replay_stats_add(&stats[0], &first));
+		assert_zero(replay_stats_add(&stats[0], &second));
+		assert_zero(replay_stats_add(&stats[1], &first));
+		assert_zero(replay_stats_add(&stats[2], &second));
+		replay_stats_merge(&stats[2], &stats[1]);
+
+		assert_eq_msg(2, stats[2].games, "expected 2 games, but was %llu", (unsigned long long)stats[2].games);
+		assert_zero_msg(memcmp(&stats[0], &stats[2], sizeof(*stats)),
+				"expected merged statistics to match those accumulated together");
+	}
+
+	replay_release(&first);
+	replay_release(&second);
+	free(stats);
+	TEST_END();
+}
+
+TEST_DEFINE(replay_stats_add_file_test)
+{
+	char path[] = "/tmp/tetris-replay-stats-XXXXXX";
+	struct replay replay;
+	struct tetris_game live;
+	struct replay_stats *stats = malloc(2 * sizeof(*stats));
+	int fd = mkstemp(path);
+	FILE *file = fd >= 0 ? fdopen(fd, "w") : NULL;
+
+	record_game(&replay, &live, 42);
+
+	TEST_START() {
+		assert_nonnull(stats);
+		assert_nonnull_msg(file, "failed to create temporary file");
+		assert_zero(replay_write(&replay, file));
+		assert_zero(fflush(file));
+
+		replay_stats_init(&stats[0]);
+		replay_stats_init(&stats[1]);
+		assert_zero_msg(replay_stats_add_file(&stats[0], path), "expected replay_stats_add_file() to succeed");
+		assert_zero(replay_stats_add(&stats[1], &replay));
+
+		assert_eq_msg((uint64_t)ftell(file), stats[0].bytes, "expected the size of the file to be counted");
+		stats[0].bytes = 0;
+		assert_zero_msg(memcmp(&stats[0], &stats[1], sizeof(*stats)),
+				"expected a replay file to add up like the replay itself");
+
+		assert_nonzero_msg(replay_stats_add_file(&stats[0], "/nonexistent/replay"),
+				"expected a missing file to be rejected");
+		assert_eq_msg(1, stats[0].invalid, "expected the missing file to be counted as invalid");
+	}
+
+	if (file) {
+		fclose(file);
+		unlink(path);
+	} else if (fd >= 0) {
+		close(fd);
+		unlink(path);
+	}
+	replay_release(&replay);
+	free(stats);
+	TEST_END();
+}
+
+TEST_DEFINE(replay_stats_add_paused_test)
+{
+	static const char paused[] = "tetris-replay 1\nseed 1\nwell 10 24\n0 5\nend 18446744073709551615\n";
+	struct replay_stats stats;
+	struct replay replay;
+
+	replay_stats_init(&stats);
+
+	TEST_START() {
+		// the ticks of a paused game are skipped, not played one by one
+		assert_zero(replay_parse(&replay, paused, strlen(paused)));
+		int ret = replay_stats_add(&stats, &replay);
+		replay_release(&replay);
+		assert_zero(ret);
+		assert_eq((uint64_t)1, stats.games);
+		assert_eq((uint64_t)0, stats.pieces);
+		assert_eq(UINT64_MAX, stats.ticks);
+	}
+
+	TEST_END();
+}
+
+int replay_stats_test(struct test_runner_instance *instance)
+{
+	struct unit_test tests[] = {
+			{ "replay_stats_add should count every lock of a replay", replay_stats_add_count_locks_test },
+			{ "replay_stats_merge should add up to the statistics of all replays", replay_stats_merge_test },
+			{ "replay_stats_add_file should map and add a replay file", replay_stats_add_file_test },
+			{ "replay_stats_add should skip the ticks of a paused game", replay_stats_add_paused_test },
+			{ NULL, NULL }
+	};
+
+	return execute_tests(instance, tests);
+}
@@ -0,0 +1,183 @@
+#include "test-lib.h"
+#include "replay.h"
+
+TEST_DEFINE(replay_write_read_round_trip_test)
+{
+	struct replay replay, loaded;
+	FILE *file = tmpfile();
+	int ret;
+
+	replay_init(&replay, 1234567890123ULL, 16, 40);
+	replay_append(&replay, 0, INPUT_LEFT);
+	replay_append(&replay, 0, INPUT_ROTATE);
+	replay_append(&replay, 17, INPUT_DROP);
+	replay.end_tick = 42;
+	replay.randomizer = RANDOMIZER_TGM;
+
+	TEST_START() {
+		assert_nonnull_msg(file, "failed to create temporary file");
+
+		ret = replay_write(&replay, file);
+		assert_zero_msg(ret, "expected replay_write() to succeed, but returned %d", ret);
+
+		rewind(file);
+		ret = replay_read(&loaded, file);
+		assert_zero_msg(ret, "expected replay_read() to succeed, but returned %d", ret);
+
+		assert_true_msg(loaded.seed == replay.seed, "expected the seed to be read back");
+		assert_eq_msg(16, loaded.width, "expected width 16, but was %zu", loaded.width);
+		assert_eq_msg(40, loaded.height, "expected height 40, but was %zu", loaded.height);
+		assert_eq_msg(RANDOMIZER_TGM, loaded.randomizer, "expected the randomizer to be read back");
+		assert_eq_msg(42, loaded.end_tick, "expected end tick 42, but was %lu", loaded.end_tick);
+		assert_eq_msg(3, loaded.len, "expected 3 events, but was %zu", loaded.len);
+
+		for (size_t i = 0; i < 3; i++) {
+			assert_eq_msg(replay.events[i].tick, loaded.events[i].tick, "event %zu has the wrong tick", i);
+			assert_eq_msg(replay.events[i].input, loaded.events[i].input, "event %zu has the wrong input", i);
+		}
+
+		replay_release(&loaded);
+	}
+
+	if (file)
+		fclose(file);
+	replay_release(&replay);
+	TEST_END();
+}
+
+TEST_DEFINE(replay_read_reject_invalid_test)
+{
+	const char *invalid[] = {
+			"not-a-replay 1\nseed 1\nwell 10 24\n",
+			"tetris-replay 1\nwell 10 24\n",
+			"tetris-replay 1\nseed 1\nwell 10 24\n5 1\n4 1\n",
+			"tetris-replay 1\nseed 1\nwell 10 24\n5 99\n",
+			"tetris-replay 1\nseed 1\nwell 10 24\nrandomizer none\n",
+	};
+
+	TEST_START() {
+		for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+			struct replay replay;
+			FILE *file = tmpfile();
+			assert_nonnull_msg(file, "failed to create temporary file");
+
+			fputs(invalid[i], file);
+			rewind(file);
+			int ret = replay_read(&replay, file);
+			fclose(file);
+
+			assert_nonzero_msg(ret, "expected replay_read() to reject invalid replay %zu", i);
+		}
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(replay_parse_test)
+{
+	static const char data[] = "tetris-replay 1\nseed 7\nwell 12 30\nrandomizer nes\n0 1\n0 4\n"
+			"123456789012345678901 7\n123456789012345678902 2\nend 123456789012345678903";
+	const char *invalid[] = {
+			"not-a-replay 1\nseed 1\nwell 10 24\n",
+			"tetris-replay 1\nwell 10 24\n",
+			"tetris-replay 1\nseed 1\nwell 10 24\n5 1\n4 1\n",
+			"tetris-replay 1\nseed 1\nwell 10 24\n5 9\n",
+			"tetris-replay 1\nseed 1\nwell 10 24\n5 1\n\n",
+			"tetris-replay 1\nseed 1\nwell 10 24\nrandomizer none\n",
+			"tetris-replay 1\nseed 1\nwel",
+	};
+	struct replay parsed, read;
+	FILE *file = tmpfile();
+
+	TEST_START() {
+		assert_nonnull_msg(file, "failed to create temporary file");
+		fputs(data, file);
+		rewind(file);
+
+		assert_zero_msg(replay_read(&read, file), "expected replay_read() to succeed");
+		assert_zero_msg(replay_parse(&parsed, data, sizeof(data) - 1), "expected replay_parse() to succeed");
+
+		assert_true_msg(parsed.seed == 7, "expected the seed to be parsed");
+		assert_eq_msg(12, parsed.width, "expected width 12, but was %zu", parsed.width);
+		assert_eq_msg(30, parsed.height, "expected height 30, but was %zu", parsed.height);
+		assert_eq_msg(RANDOMIZER_NES, parsed.randomizer, "expected the randomizer to be parsed");
+		assert_eq_msg(read.end_tick, parsed.end_tick, "expected the end tick of replay_read()");
+		assert_eq_msg(4, parsed.len, "expected 4 events, but was %zu", parsed.len);
+
+		for (size_t i = 0; i < 4; i++) {
+			assert_eq_msg(read.events[i].tick, parsed.events[i].tick, "event %zu has the wrong tick", i);
+			assert_eq_msg(read.events[i].input, parsed.events[i].input, "event %zu has the wrong input", i);
+		}
+
+		replay_release(&parsed);
+		replay_release(&read);
+
+		for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+			assert_nonzero_msg(replay_parse(&parsed, invalid[i], strlen(invalid[i])),
+					"expected replay_parse() to reject invalid replay %zu", i);
+	}
+
+	if (file)
+		fclose(file);
+	TEST_END();
+}
+
+static int count_frames(void *data, uint64_t usec, struct tetris_game *game)
+{
+	(void)usec;
+	(void)game;
+
+	(*(size_t *)data)++;
+	return 0;
+}
+
+TEST_DEFINE(replay_run_reproduce_game_test)
+{
+	struct replay replay;
+	struct tetris_game live, replayed;
+	size_t frames = 0;
+
+	tetris_game_init(&live, BOARD_WIDTH, BOARD_HEIGHT, 99);
+	replay_init(&replay, 99, BOARD_WIDTH, BOARD_HEIGHT);
+
+	TEST_START() {
+		// play a deterministic game, recording the inputs
+		for (unsigned long i = 0; live.running && i < 20000; i++) {
+			if (i % 7 == 0) {
+				int input = (int)(i / 7 % 4) == 3 ? INPUT_DROP : (int)(i / 7 % 4) + 1;
+				replay_append(&replay, live.ticks, input);
+				tetris_game_input(&live, input);
+			}
+
+			tetris_game_tick(&live);
+		}
+		replay.end_tick = live.ticks;
+
+		int ret = replay_run(&replay, &replayed, 0, count_frames, &frames);
+		assert_zero_msg(ret, "expected replay_run() to succeed, but returned %d", ret);
+		assert_nonzero_msg(frames, "expected frames to be produced by replay_run()");
+
+		assert_eq_msg(live.score, replayed.score, "expected score %d, but was %d", live.score, replayed.score);
+		assert_eq_msg(live.lines, replayed.lines, "expected lines %d, but was %d", live.lines, replayed.lines);
+		assert_eq_msg(live.level, replayed.level, "expected level %d, but was %d", live.level, replayed.level);
+		assert_eq_msg(live.ticks, replayed.ticks, "expected %lu ticks, but was %lu", live.ticks, replayed.ticks);
+		assert_zero_msg(memcmp(live.well.matrix, replayed.well.matrix, sizeof(live.well.matrix)),
+				"expected the replayed well to match the live well");
+	}
+
+	replay_release(&replay);
+	TEST_END();
+}
+
+int replay_test(struct test_runner_instance *instance)
+{
+	struct unit_test tests[] = {
+			{ "replay_read should read back a replay written by replay_write", replay_write_read_round_trip_test },
+			{ "replay_read should reject invalid replays", replay_read_reject_invalid_test },
+			{ "replay_parse should parse replays in memory like replay_read", replay_parse_test },
+			{ "replay_run should reproduce the recorded game exactly", replay_run_reproduce_game_test },
+			{ NULL, NULL }
+	};
+
+	return execute_tests(instance, tests);
+}
@@ -0,0 +1,135 @@
+#include "test-lib.h"
+#include "rollout.h"
+
+static void small_rollout_options(struct rollout_options *options)
+{
+	rollout_options_init(options);
+	options->threads = 2;
+	options->min_rollouts = 0;
+	options->max_rollouts = 256;
+	options->confidence = 0;
+}
+
+TEST_DEFINE(rollout_fixed_count_test)
+{
+	struct rollout_options options;
+	struct rollout_result first, second;
+	struct tetris_game game;
+
+	small_rollout_options(&options);
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 1);
+
+	TEST_START() {
+		assert_zero_msg(rollout_evaluate(&game, &options, &first), "expected rollouts to run");
+		assert_eq_msg(first.rollouts, 256, "expected every rollout to run, but ran %lu", first.rollouts);
+
+		/* without an early stop, the results only depend on the seed */
+		options.threads = 3;
+		assert_zero_msg(rollout_evaluate(&game, &options, &second), "expected rollouts to run");
+		assert_true_msg(first.lines.mean == second.lines.mean && first.score.mean == second.score.mean,
+				"expected the same estimates with a different number of threads");
+
+		assert_eq_msg(game.ticks, 0, "expected the game to be left untouched");
+		assert_zero_msg(game.lines, "expected the game to be left untouched");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(rollout_heuristic_survives_test)
+{
+	struct rollout_options options;
+	struct rollout_result result;
+	struct tetris_game game;
+
+	small_rollout_options(&options);
+	options.policy = ROLLOUT_POLICY_HEURISTIC;
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 1);
+
+	TEST_START() {
+		assert_zero_msg(rollout_evaluate(&game, &options, &result), "expected rollouts to run");
+		assert_true_msg(result.survival.mean == 1.0,
+				"expected every rollout to survive from an empty well, but survival was %f", result.survival.mean);
+		assert_true_msg(result.lines.mean > 0, "expected the heuristic policy to clear lines");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(rollout_early_stop_test)
+{
+	struct rollout_options options;
+	struct rollout_result result;
+	struct tetris_game game;
+
+	rollout_options_init(&options);
+	options.threads = 2;
+	options.min_rollouts = 128;
+	options.max_rollouts = 100000;
+	options.confidence = 100;
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 1);
+
+	TEST_START() {
+		assert_zero_msg(rollout_evaluate(&game, &options, &result), "expected rollouts to run");
+		assert_true_msg(result.rollouts >= 128 && result.rollouts < 100000,
+				"expected an early stop after at least 128 rollouts, but ran %lu", result.rollouts);
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(rollout_game_over_test)
+{
+	struct rollout_options options;
+	struct rollout_result result;
+	struct tetris_game game;
+
+	small_rollout_options(&options);
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 1);
+	game.running = 0;
+
+	TEST_START() {
+		assert_nonzero_msg(rollout_evaluate(&game, &options, &result),
+				"expected no rollouts from a game that is over");
+	}
+
+	TEST_END();
+}
+
+BENCH_DEFINE(rollout_bench)
+{
+	struct rollout_options options;
+	struct rollout_result result;
+	struct tetris_game game;
+
+	small_rollout_options(&options);
+	options.threads = 1;
+	options.max_rollouts = 1;
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 1);
+
+	BENCH_START() {
+		options.seed++;
+		rollout_evaluate(&game, &options, &result);
+		bench_keep(result.rollouts);
+	}
+
+	BENCH_END();
+}
+
+int rollout_test(struct test_runner_instance *instance)
+{
+	struct unit_test tests[] = {
+			{ "rollout_evaluate should run every rollout without an early stop", rollout_fixed_count_test },
+			{ "rollout_evaluate should survive an empty well with the heuristic policy", rollout_heuristic_survives_test },
+			{ "rollout_evaluate should stop early once the estimate is confident", rollout_early_stop_test },
+			{ "rollout_evaluate should refuse a game that is over", rollout_game_over_test },
+			{ NULL, NULL }
+	};
+
+	struct unit_bench benchmarks[] = {
+			{ "rollout_evaluate of a single heuristic rollout, 10 deep", rollout_bench },
+			{ NULL, NULL }
+	};
+
+	return execute_tests(instance, tests) | execute_benchmarks(instance, benchmarks);
+}
@@ -0,0 +1,147 @@
+#include "test-lib.h"
+#include "search.h"
+#include "tetris-game.h"
+
+/*
+ * Four rows filled but for the last column, an O tetrimino to place, and an I
+ * tetrimino queued after it.
+ * */
+static void well_with_gap(struct tetris_well *well, size_t queued)
+{
+	tetris_well_init(well);
+	for (size_t i = BOARD_HEIGHT - 4; i < BOARD_HEIGHT; i++) {
+		for (size_t j = 0; j < BOARD_WIDTH - 1; j++)
+			well->matrix[i][j] = CELL_TYPE_L;
+	}
+
+	well->tetrimino_bag[0] = 0;
+	well->tetrimino_bag[1] = 1;
+	well->tetrimino_bag_index = 2;
+	tetrimino_new(well);
+	well->tetrimino_bag_index = queued;
+}
+
+TEST_DEFINE(search_depth_one_test)
+{
+	static struct placement placements[PLACEMENTS_MAX];
+	struct search_options options;
+	struct tetris_well well;
+	struct placement best;
+	double value, evaluation;
+
+	well_with_gap(&well, 1);
+	search_options_init(&options);
+	options.depth = 1;
+
+	TEST_START() {
+		assert_zero_msg(search_best_placement(&well, &options, &best, &value), "expected a placement");
+
+		size_t count = tetrimino_placements(&well, placements);
+		size_t index = evaluator_best_placement(&well, placements, count, options.weights, &evaluation);
+		assert_zero_msg(memcmp(&best, &placements[index], sizeof(best)),
+				"expected a search one deep to pick the best evaluated placement");
+		assert_true_msg(value == evaluation, "expected the value of the evaluation, not %f", value);
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(search_queued_tetrimino_test)
+{
+	struct search_options options;
+	struct tetris_well well, alone;
+	struct placement best;
+	double value, alone_value;
+
+	well_with_gap(&well, 1);
+	well_with_gap(&alone, 0);
+	search_options_init(&options);
+
+	TEST_START() {
+		assert_zero_msg(search_best_placement(&well, &options, &best, &value), "expected a placement");
+		for (size_t i = 0; i < 4; i++)
+			assert_neq_msg(BOARD_WIDTH - 1, best.coords[i][0], "expected the gap to be left for the I tetrimino");
+
+		/* the tetris from the queued I tetrimino counts towards the value */
+		assert_zero_msg(search_best_placement(&alone, &options, &best, &alone_value), "expected a placement");
+		assert_true_msg(value > alone_value + 3 * options.weights->lines,
+				"expected the queued tetrimino to clear four lines, but %f is not enough over %f",
+				value, alone_value);
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(search_invalid_options_test)
+{
+	struct search_options options;
+	struct tetris_well well;
+	struct placement best;
+
+	well_with_gap(&well, 1);
+	search_options_init(&options);
+
+	TEST_START() {
+		options.depth = SEARCH_MAX_DEPTH + 1;
+		assert_nonzero_msg(search_best_placement(&well, &options, &best, NULL), "expected the depth to be rejected");
+		options.depth = 1;
+		options.beam = 0;
+		assert_nonzero_msg(search_best_placement(&well, &options, &best, NULL), "expected the beam to be rejected");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(search_cancel_test)
+{
+	struct search_options options;
+	struct tetris_well well;
+	struct placement best;
+	int cancel = 1;
+
+	well_with_gap(&well, 1);
+	search_options_init(&options);
+	options.cancel = &cancel;
+
+	TEST_START() {
+		assert_nonzero_msg(search_best_placement(&well, &options, &best, NULL), "expected the search to give up");
+		cancel = 0;
+		assert_zero_msg(search_best_placement(&well, &options, &best, NULL), "expected a placement once not cancelled");
+	}
+
+	TEST_END();
+}
+
+BENCH_DEFINE(search_best_placement_bench)
+{
+	struct search_options options;
+	struct tetris_game game;
+	struct placement best;
+
+	search_options_init(&options);
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 1);
+
+	BENCH_START() {
+		bench_keep(search_best_placement(&game.well, &options, &best, NULL));
+	}
+
+	BENCH_END();
+}
+
+int search_test(struct test_runner_instance *instance)
+{
+	struct unit_test tests[] = {
+			{ "search_best_placement one deep should match the evaluator", search_depth_one_test },
+			{ "search_best_placement should look ahead to queued tetriminos", search_queued_tetrimino_test },
+			{ "search_best_placement should reject options out of range", search_invalid_options_test },
+			{ "search_best_placement should give up once cancelled", search_cancel_test },
+			{ NULL, NULL }
+	};
+
+	struct unit_bench benchmarks[] = {
+			{ "search_best_placement of a new game, 4 deep with a beam of 4", search_best_placement_bench },
+			{ NULL, NULL }
+	};
+
+	return execute_tests(instance, tests) | execute_benchmarks(instance, benchmarks);
+}
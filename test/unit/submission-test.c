@@ -0,0 +1,255 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "test-lib.h"
+#include "submission.h"
+#include "evaluator.h"
+
+/*
+ * Apply the inputs that rotate the current tetrimino `rotations` times, shift
+ * it `shifts` columns (left if negative) and drop it, recording them in the
+ * replay if one is given.
+ * */
+static void move_tetrimino(struct tetris_game *game, struct replay *replay, int rotations, int shifts)
+{
+	int inputs[16];
+	size_t count = 0;
+
+	for (int i = 0; i < rotations; i++)
+		inputs[count++] = INPUT_ROTATE;
+	for (int i = 0; i < abs(shifts); i++)
+		inputs[count++] = shifts < 0 ? INPUT_LEFT : INPUT_RIGHT;
+	inputs[count++] = INPUT_DROP;
+
+	for (size_t i = 0; i < count; i++) {
+		if (replay)
+			replay_append(replay, game->ticks, inputs[i]);
+		tetris_game_input(game, inputs[i]);
+	}
+}
+
+/*
+ * Play a deterministic game from the given seed that clears lines, dropping
+ * each tetrimino where the default evaluator likes it best, and claim exactly
+ * the result it reached.
+ * */
+static void record_submission(struct submission *submission, struct tetris_game *live, uint64_t seed)
+{
+	tetris_game_init(live, BOARD_WIDTH, BOARD_HEIGHT, seed);
+	replay_init(&submission->replay, seed, BOARD_WIDTH, BOARD_HEIGHT);
+
+	while (live->running && live->pieces < 200) {
+		double best = 0;
+		int best_rotations = -1, best_shifts = 0;
+
+		for (int rotations = 0; rotations < 4; rotations++) {
+			for (int shifts = -5; shifts <= 5; shifts++) {
+				struct tetris_game game = *live;
+
+				move_tetrimino(&game, NULL, rotations, shifts);
+				double evaluation = evaluator_evaluate(&game.well, game.lines - live->lines,
+						&evaluator_default_weights);
+				if (best_rotations < 0 || evaluation > best) {
+					best = evaluation;
+					best_rotations = rotations;
+					best_shifts = shifts;
+				}
+			}
+		}
+
+		move_tetrimino(live, &submission->replay, best_rotations, best_shifts);
+		for (int i = 0; i < 10; i++)
+			tetris_game_tick(live);
+	}
+	submission->replay.end_tick = live->ticks;
+
+	submission->score = live->score;
+	submission->lines = live->lines;
+	submission->level = live->level;
+}
+
+TEST_DEFINE(submission_verify_accept_test)
+{
+	struct submission submission;
+	struct submission_result result;
+	struct tetris_game live;
+
+	record_submission(&submission, &live, 99);
+
+	TEST_START() {
+		assert_true_msg(live.lines > 1, "expected the recorded game to clear lines");
+
+		int verdict = submission_verify(&submission, &result);
+		assert_eq_msg(SUBMISSION_ACCEPTED, verdict, "expected the submission to be accepted, but was %s",
+				submission_verdict_name(verdict));
+		assert_eq(live.ticks, result.ticks);
+		assert_eq(live.score, result.score);
+		assert_eq(live.lines, result.lines);
+		assert_eq(live.level, result.level);
+		assert_zero(result.tick);
+	}
+
+	submission_release(&submission);
+	TEST_END();
+}
+
+TEST_DEFINE(submission_verify_first_divergence_test)
+{
+	struct submission submission;
+	struct submission_result result, first;
+	struct tetris_game live;
+
+	record_submission(&submission, &live, 99);
+
+	TEST_START() {
+		// claiming more than the game reached diverges where the game stopped
+		submission.score = live.score + 1;
+		assert_eq(SUBMISSION_SCORE, submission_verify(&submission, &result));
+		assert_eq(live.ticks, result.tick);
+		assert_eq(live.score, result.score);
+
+		submission.score = live.score;
+		submission.level = live.level + 1;
+		assert_eq(SUBMISSION_LEVEL, submission_verify(&submission, &result));
+		assert_eq(live.ticks, result.tick);
+
+		// claiming less diverges as soon as the game goes past the claim
+		submission.level = live.level;
+		submission.score = 0;
+		assert_eq(SUBMISSION_SCORE, submission_verify(&submission, &first));
+		assert_true_msg(first.tick < live.ticks, "expected the game to diverge before it stopped");
+		assert_eq(first.tick, first.ticks);
+		assert_nonzero(first.score);
+
+		// the first line cleared scores, so a claim of that score diverges on lines
+		submission.score = first.score;
+		submission.lines = 0;
+		assert_eq(SUBMISSION_LINES, submission_verify(&submission, &result));
+		assert_eq(first.tick, result.tick);
+		assert_eq(first.lines, result.lines);
+	}
+
+	submission_release(&submission);
+	TEST_END();
+}
+
+TEST_DEFINE(submission_verify_file_test)
+{
+	char path[] = "/tmp/tetris-submission-XXXXXX";
+	static const char *invalid[] = {
+			"tetris-submission 2\nscore 0\nlines 0\nlevel 0\ntetris-replay 1\nseed 1\nwell 10 24\n",
+			"tetris-submission 1\nscore -1\nlines 0\nlevel 0\ntetris-replay 1\nseed 1\nwell 10 24\n",
+			"tetris-submission 1\nscore 0\nlevel 0\ntetris-replay 1\nseed 1\nwell 10 24\n",
+			"tetris-submission 1\nscore 0\nlines 0\nlevel 0\ntetris-replay 1\nwell 10 24\n",
+			"tetris-submission 1\nscore 0\nlines 0\nlevel 0\ntetris-replay 1\nseed 1\nwell 99 24\n",
+	};
+	struct submission submission, parsed;
+	struct submission_result result;
+	struct tetris_game live;
+	int fd = mkstemp(path);
+	FILE *file = fd >= 0 ? fdopen(fd, "w+") : NULL;
+
+	record_submission(&submission, &live, 7);
+
+	TEST_START() {
+		assert_nonnull_msg(file, "failed to create temporary file");
+		assert_zero(submission_write(&submission, file));
+
+		assert_eq(SUBMISSION_ACCEPTED, submission_verify_file(path, &result));
+		assert_eq(live.score, result.score);
+
+		for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+			int ret = submission_parse(&parsed, invalid[i], strlen(invalid[i]));
+			if (!ret) {
+				// parses, but can't be played back
+				assert_eq_msg(SUBMISSION_INVALID, submission_verify(&parsed, &result),
+						"expected submission %zu to be invalid", i);
+				submission_release(&parsed);
+			}
+
+			assert_zero(ftruncate(fileno(file), 0));
+			rewind(file);
+			fputs(invalid[i], file);
+			assert_zero(fflush(file));
+			assert_eq_msg(SUBMISSION_INVALID, submission_verify_file(path, &result),
+					"expected submission file %zu to be invalid", i);
+		}
+
+		assert_eq(SUBMISSION_INVALID, submission_verify_file("/nonexistent/game.submission", &result));
+	}
+
+	if (file) {
+		fclose(file);
+		unlink(path);
+	} else if (fd >= 0) {
+		close(fd);
+		unlink(path);
+	}
+	submission_release(&submission);
+	TEST_END();
+}
+
+TEST_DEFINE(submission_verify_paused_test)
+{
+	static const char paused[] = "tetris-submission 1\nscore 0\nlines 0\nlevel 0\n"
+			"tetris-replay 1\nseed 1\nwell 10 24\n0 5\n4000000000000 6\nend 4000000000000\n";
+	static const char endless[] = "tetris-submission 1\nscore 0\nlines 0\nlevel 0\n"
+			"tetris-replay 1\nseed 1\nwell 10 24\n0 5\nend 18446744073709551615\n";
+	struct submission submission;
+	struct submission_result result;
+
+	TEST_START() {
+		// a game paused for trillions of ticks plays back at once
+		assert_zero(submission_parse(&submission, paused, strlen(paused)));
+		int verdict = submission_verify(&submission, &result);
+		submission_release(&submission);
+		assert_eq_msg(SUBMISSION_ACCEPTED, verdict, "expected the paused game to be accepted, but was %s",
+				submission_verdict_name(verdict));
+		assert_eq(4000000000000UL, result.ticks);
+
+		// a game can't go on long after its last input
+		assert_zero(submission_parse(&submission, endless, strlen(endless)));
+		verdict = submission_verify(&submission, &result);
+		submission_release(&submission);
+		assert_eq_msg(SUBMISSION_INVALID, verdict, "expected the endless game to be invalid, but was %s",
+				submission_verdict_name(verdict));
+	}
+
+	TEST_END();
+}
+
+BENCH_DEFINE(submission_verify_bench)
+{
+	struct submission submission;
+	struct submission_result result;
+	struct tetris_game live;
+
+	record_submission(&submission, &live, 99);
+
+	BENCH_START() {
+		bench_keep(submission_verify(&submission, &result));
+	}
+
+	submission_release(&submission);
+	BENCH_END();
+}
+
+int submission_test(struct test_runner_instance *instance)
+{
+	struct unit_test tests[] = {
+			{ "submission_verify should accept the result the replay reaches", submission_verify_accept_test },
+			{ "submission_verify should report the first tick diverging from the claim",
+					submission_verify_first_divergence_test },
+			{ "submission_verify_file should map and verify a submission file", submission_verify_file_test },
+			{ "submission_verify should skip the ticks of a paused game", submission_verify_paused_test },
+			{ NULL, NULL }
+	};
+
+	struct unit_bench benchmarks[] = {
+			{ "submission_verify of a whole game", submission_verify_bench },
+			{ NULL, NULL }
+	};
+
+	return execute_tests(instance, tests) | execute_benchmarks(instance, benchmarks);
+}
@@ -0,0 +1,107 @@
+#include "test-lib.h"
+#include "telemetry.h"
+
+TEST_DEFINE(telemetry_write_events_test)
+{
+	struct telemetry telemetry;
+	struct telemetry_event event;
+	struct tetris_game game;
+	char line[256];
+	FILE *file = tmpfile();
+
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 5);
+
+	TEST_START() {
+		assert_nonnull_msg(file, "failed to create temporary file");
+		assert_zero_msg(telemetry_open(&telemetry, file), "expected the writer to start");
+
+		struct telemetry_buffer *buffer = telemetry_buffer_open(&telemetry);
+		assert_nonnull_msg(buffer, "expected a buffer to be allocated");
+
+		for (size_t i = 0; i < 3; i++) {
+			tetris_game_input(&game, INPUT_DROP);
+			telemetry_lock_event(&event, &game, 5, 1000 * (i + 1));
+			assert_zero_msg(telemetry_record(buffer, &event), "expected event %zu to be recorded", i);
+		}
+
+		assert_zero_msg(telemetry_close(&telemetry), "expected every write to succeed");
+		assert_eq_msg(3, telemetry.written, "expected 3 events to be written, but was %lu", telemetry.written);
+		assert_zero_msg(telemetry.dropped, "expected no events to be dropped");
+
+		rewind(file);
+		assert_nonnull_msg(fgets(line, sizeof(line), file), "expected a header line");
+		assert_zero_msg(strncmp(line, "game,piece,usec,type,", 21), "unexpected header '%s'", line);
+
+		for (unsigned i = 0; i < 3; i++) {
+			unsigned long long seed, usec;
+			unsigned piece;
+
+			assert_nonnull_msg(fgets(line, sizeof(line), file), "expected a line for event %u", i);
+			assert_eq_msg(3, sscanf(line, "%llu,%u,%llu,", &seed, &piece, &usec), "malformed event '%s'", line);
+			assert_eq_msg(5, seed, "expected the game to be identified by its seed");
+			assert_eq_msg(i, piece, "expected events in the order they were recorded");
+			assert_eq_msg(1000 * (i + 1), usec, "expected the time of event %u to be written", i);
+		}
+
+		assert_null_msg(fgets(line, sizeof(line), file), "expected no more events");
+	}
+
+	if (file)
+		fclose(file);
+	TEST_END();
+}
+
+TEST_DEFINE(telemetry_drop_when_full_test)
+{
+	struct telemetry_buffer *buffer = calloc(1, sizeof(*buffer));
+	struct telemetry_event event;
+
+	memset(&event, 0, sizeof(event));
+
+	TEST_START() {
+		assert_nonnull_msg(buffer, "failed to allocate buffer");
+
+		/* without a writer to drain it, the buffer fills up */
+		for (size_t i = 0; i < TELEMETRY_BUFFER_EVENTS; i++)
+			assert_zero_msg(telemetry_record(buffer, &event), "expected event %zu to fit in the buffer", i);
+
+		assert_nonzero_msg(telemetry_record(buffer, &event), "expected an event to be dropped once full");
+		assert_eq_msg(1, buffer->dropped, "expected the dropped event to be counted");
+	}
+
+	free(buffer);
+	TEST_END();
+}
+
+BENCH_DEFINE(telemetry_record_bench)
+{
+	struct telemetry_buffer *buffer = calloc(1, sizeof(*buffer));
+	struct telemetry_event event;
+
+	memset(&event, 0, sizeof(event));
+
+	BENCH_START() {
+		// stand in for the writer, so the buffer never fills up
+		buffer->tail = buffer->head;
+		bench_keep(telemetry_record(buffer, &event));
+	}
+
+	free(buffer);
+	BENCH_END();
+}
+
+int telemetry_test(struct test_runner_instance *instance)
+{
+	struct unit_test tests[] = {
+			{ "telemetry_close should write every recorded event", telemetry_write_events_test },
+			{ "telemetry_record should drop events once the buffer is full", telemetry_drop_when_full_test },
+			{ NULL, NULL }
+	};
+
+	struct unit_bench benchmarks[] = {
+			{ "telemetry_record of a single event", telemetry_record_bench },
+			{ NULL, NULL }
+	};
+
+	return execute_tests(instance, tests) | execute_benchmarks(instance, benchmarks);
+}
@@ -0,0 +1,338 @@
+#include <limits.h>
+
+#include "test-lib.h"
+#include "tetris-game.h"
+
+static void set_tetrimino(struct tetris_game *game, size_t index)
+{
+	game->well.tetrimino_type = (uint8_t)((unsigned)1 << index);
+	memcpy(game->well.tetrimino_coords, cell_init_coords[index], sizeof(size_t) * 4 * 2);
+}
+
+TEST_DEFINE(tetris_game_init_test)
+{
+	struct tetris_game game;
+
+	TEST_START() {
+		int ret = tetris_game_init(&game, BOARD_MAX_WIDTH + 1, BOARD_HEIGHT, 1);
+		assert_nonzero_msg(ret, "expected tetris_game_init() to reject unsupported dimensions");
+
+		ret = tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 1);
+		assert_zero_msg(ret, "expected tetris_game_init() to succeed, but returned %d", ret);
+		assert_true_msg(game.running, "expected a new game to be running");
+		assert_false_msg(game.paused, "expected a new game not to be paused");
+		assert_true_msg(game.dirty, "expected a new game to need drawing");
+		assert_neq_msg(CELL_TYPE_NONE, game.well.tetrimino_type, "expected the first tetrimino to be spawned");
+		assert_zero_msg(game.score, "expected the score to start at zero, but was %d", game.score);
+		assert_zero_msg(game.level, "expected the level to start at zero, but was %d", game.level);
+		assert_zero_msg(game.lines, "expected the lines to start at zero, but was %d", game.lines);
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(tetris_game_tick_apply_gravity_test)
+{
+	struct tetris_game game;
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 1);
+	set_tetrimino(&game, 2); // type T
+
+	TEST_START() {
+		int gravity = tetris_game_gravity(0);
+		game.dirty = 0;
+
+		for (int i = 0; i < gravity; i++)
+			tetris_game_tick(&game);
+
+		assert_zero_msg(game.well.tetrimino_coords[0][1],
+				"expected tetrimino not to fall before %d ticks", gravity + 1);
+		assert_false_msg(game.dirty, "expected the game to be unchanged before gravity applies");
+
+		tetris_game_tick(&game);
+		assert_eq_msg(1, game.well.tetrimino_coords[0][1],
+				"expected tetrimino to fall one row after %d ticks, but was at row %zu",
+				gravity + 1, game.well.tetrimino_coords[0][1]);
+		assert_true_msg(game.dirty, "expected gravity to mark the game as changed");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(tetris_game_pause_stop_gravity_test)
+{
+	struct tetris_game game;
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 1);
+	set_tetrimino(&game, 2); // type T
+
+	TEST_START() {
+		tetris_game_input(&game, INPUT_PAUSE);
+		assert_true_msg(game.paused, "expected INPUT_PAUSE to pause the game");
+
+		for (int i = 0; i < 1000; i++)
+			tetris_game_tick(&game);
+
+		tetris_game_input(&game, INPUT_LEFT);
+		tetris_game_input(&game, INPUT_DROP);
+		assert_zero_msg(memcmp(game.well.tetrimino_coords, cell_init_coords[2], sizeof(size_t) * 4 * 2),
+				"expected the tetrimino not to move while paused");
+
+		tetris_game_input(&game, INPUT_PAUSE);
+		assert_false_msg(game.paused, "expected INPUT_PAUSE to resume the game");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(tetris_game_idle_ticks_test)
+{
+	struct tetris_game game;
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 1);
+	set_tetrimino(&game, 2); // type T
+
+	TEST_START() {
+		for (int i = 0; i < 3; i++)
+			tetris_game_tick(&game);
+
+		unsigned long idle = tetris_game_idle_ticks(&game);
+		assert_eq_msg((unsigned long)tetris_game_gravity(0) - 3, idle, "expected %d idle ticks, but was %lu",
+				tetris_game_gravity(0) - 3, idle);
+
+		game.dirty = 0;
+		for (unsigned long i = 0; i < idle; i++)
+			tetris_game_tick(&game);
+		assert_false_msg(game.dirty, "expected the idle ticks to change nothing");
+		assert_zero(tetris_game_idle_ticks(&game));
+
+		tetris_game_tick(&game);
+		assert_true_msg(game.dirty, "expected the tick after the idle ones to drop the tetrimino");
+
+		tetris_game_input(&game, INPUT_PAUSE);
+		assert_eq_msg(ULONG_MAX, tetris_game_idle_ticks(&game), "expected a paused game to be idle until resumed");
+		tetris_game_input(&game, INPUT_PAUSE);
+		tetris_game_input(&game, INPUT_STOP);
+		assert_eq_msg(ULONG_MAX, tetris_game_idle_ticks(&game), "expected a game over to be idle");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(tetris_game_drop_commit_and_score_test)
+{
+	struct tetris_game game;
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 1);
+	set_tetrimino(&game, 0); // type I, vertical in column 4
+
+	TEST_START() {
+		for (size_t i = 0; i < BOARD_WIDTH; i++)
+			if (i != 4)
+				game.well.matrix[BOARD_HEIGHT - 1][i] = CELL_TYPE_O;
+
+		tetris_game_input(&game, INPUT_DROP);
+		assert_eq_msg(1, game.lines, "expected a single line to be cleared, but was %d", game.lines);
+		assert_eq_msg(40, game.score, "expected a score of 40 for a single line, but was %d", game.score);
+		assert_true_msg(game.running, "expected the game to continue");
+
+		for (size_t i = BOARD_HEIGHT - 3; i < BOARD_HEIGHT; i++)
+			assert_eq_msg(CELL_TYPE_I, game.well.matrix[i][4], "expected cell [4, %zu] to be type I", i);
+		assert_eq_msg(CELL_TYPE_NONE, game.well.matrix[BOARD_HEIGHT - 1][0], "expected the bottom row to be cleared");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(tetris_game_stop_test)
+{
+	struct tetris_game game;
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 1);
+
+	TEST_START() {
+		tetris_game_input(&game, INPUT_STOP);
+		assert_false_msg(game.running, "expected INPUT_STOP to end the game");
+
+		size_t coords[4][2];
+		memcpy(coords, game.well.tetrimino_coords, sizeof(coords));
+		tetris_game_input(&game, INPUT_DOWN);
+		for (int i = 0; i < 1000; i++)
+			tetris_game_tick(&game);
+
+		assert_zero_msg(memcmp(coords, game.well.tetrimino_coords, sizeof(coords)),
+				"expected a stopped game to ignore inputs and ticks");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(tetris_game_place_test)
+{
+	struct tetris_game game;
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 1);
+	set_tetrimino(&game, 0); // type I, vertical in column 4
+
+	/* the I tetrimino lying flat in the bottom right corner, cells out of order */
+	struct placement flat = { { { 9, 23 }, { 6, 23 }, { 8, 23 }, { 7, 23 } } };
+	/* floating above the floor */
+	struct placement floating = { { { 0, 10 }, { 1, 10 }, { 2, 10 }, { 3, 10 } } };
+
+	TEST_START() {
+		assert_nonzero_msg(tetris_game_place(&game, &floating),
+				"expected a placement that isn't resting on anything to be rejected");
+
+		for (size_t i = 0; i < 6; i++)
+			game.well.matrix[BOARD_HEIGHT - 1][i] = CELL_TYPE_O;
+
+		assert_zero_msg(tetris_game_place(&game, &flat), "expected a reachable placement to be accepted");
+		assert_eq_msg(1, game.lines, "expected a single line to be cleared, but was %d", game.lines);
+		assert_eq_msg(40, game.score, "expected a score of 40 for a single line, but was %d", game.score);
+		assert_true_msg(game.running, "expected the game to continue");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(tetris_game_place_trusted_test)
+{
+	static struct placement placements[PLACEMENTS_MAX];
+	struct tetris_game checked, trusted;
+	tetris_game_init(&checked, BOARD_WIDTH, BOARD_HEIGHT, 3);
+
+	TEST_START() {
+		trusted = checked;
+		for (int piece = 0; piece < 20; piece++) {
+			size_t count = tetrimino_placements(&checked.well, placements);
+			assert_nonzero(count);
+
+			assert_zero(tetris_game_place(&checked, &placements[count / 2]));
+			assert_zero(tetris_game_place_trusted(&trusted, &placements[count / 2]));
+			assert_zero_msg(memcmp(&checked.well, &trusted.well, sizeof(checked.well)),
+					"expected both placements to leave the same well after %d pieces", piece);
+			assert_eq(checked.score, trusted.score);
+			assert_eq(checked.lines, trusted.lines);
+		}
+
+		tetris_game_input(&trusted, INPUT_PAUSE);
+		tetrimino_placements(&trusted.well, placements);
+		assert_nonzero_msg(tetris_game_place_trusted(&trusted, &placements[0]),
+				"expected a placement to be rejected while paused");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(tetris_game_last_lock_test)
+{
+	struct tetris_game game;
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 1);
+	set_tetrimino(&game, 0); // type I, vertical in column 4
+
+	/* the I tetrimino standing up at the bottom of column 4 */
+	struct placement expected = { { { 4, 20 }, { 4, 21 }, { 4, 22 }, { 4, 23 } } };
+	placement_normalize(&expected);
+
+	TEST_START() {
+		assert_zero_msg(game.pieces, "expected no tetriminos to be locked yet");
+
+		for (size_t i = 0; i < 10; i++)
+			tetris_game_tick(&game);
+		tetris_game_input(&game, INPUT_DROP);
+
+		assert_eq_msg(1, game.pieces, "expected one tetrimino to be locked, but was %lu", game.pieces);
+		assert_eq_msg(CELL_TYPE_I, game.last_lock.type, "expected the I tetrimino to be locked");
+		assert_zero_msg(memcmp(&expected, &game.last_lock.placement, sizeof(expected)),
+				"expected the locked cells to be recorded");
+		assert_zero_msg(game.last_lock.lines, "expected no lines to be cleared");
+		assert_zero_msg(game.last_lock.spawn_tick, "expected the tetrimino to have spawned at tick 0");
+		assert_eq_msg(10, game.last_lock.tick, "expected the tetrimino to lock at tick 10");
+		assert_eq_msg(10, game.spawn_tick, "expected the next tetrimino to spawn at tick 10");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(tetris_game_step_test)
+{
+	static const int inputs[] = { INPUT_LEFT, INPUT_DROP };
+	struct tetris_game game;
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 1);
+	set_tetrimino(&game, 0); // type I, vertical in column 4
+
+	struct placement expected = { { { 3, 20 }, { 3, 21 }, { 3, 22 }, { 3, 23 } } };
+	placement_normalize(&expected);
+
+	TEST_START() {
+		assert_true_msg(tetris_game_step(&game, NULL, 0), "expected the game to carry on");
+		assert_eq_msg(1, game.ticks, "expected a step to advance a single tick");
+
+		assert_true_msg(tetris_game_step(&game, inputs, 2), "expected the game to carry on");
+		assert_eq_msg(2, game.ticks, "expected a step to advance a single tick");
+		assert_eq_msg(1, game.pieces, "expected the inputs to drop the tetrimino");
+		assert_zero_msg(memcmp(&expected, &game.last_lock.placement, sizeof(expected)),
+				"expected the inputs to be applied in order");
+		assert_eq_msg(1, game.last_lock.tick, "expected the inputs to be applied before the tick");
+	}
+
+	TEST_END();
+}
+
+/*
+ * Games share nothing, so games stepped in turns must end up exactly where
+ * the same games played one after the other do.
+ * */
+TEST_DEFINE(tetris_game_interleaved_test)
+{
+	static const int pattern[] = { INPUT_LEFT, INPUT_ROTATE, 0, INPUT_RIGHT, INPUT_RIGHT, INPUT_DROP, 0, INPUT_DOWN };
+	struct tetris_game alone[2], interleaved[2];
+
+	for (size_t i = 0; i < 2; i++) {
+		tetris_game_init(&alone[i], BOARD_WIDTH, BOARD_HEIGHT, 7 + i);
+		tetris_game_init(&interleaved[i], BOARD_WIDTH, BOARD_HEIGHT, 7 + i);
+	}
+
+	TEST_START() {
+		for (size_t i = 0; i < 2; i++) {
+			for (size_t tick = 0; tick < 2000; tick++) {
+				int input = pattern[(tick + i) % 8];
+				tetris_game_step(&alone[i], &input, input != 0);
+			}
+		}
+
+		for (size_t tick = 0; tick < 2000; tick++) {
+			for (size_t i = 0; i < 2; i++) {
+				int input = pattern[(tick + i) % 8];
+				tetris_game_step(&interleaved[i], &input, input != 0);
+			}
+		}
+
+		for (size_t i = 0; i < 2; i++) {
+			assert_true_msg(alone[i].pieces > 10, "expected the games to lock tetriminos");
+			assert_eq_msg(alone[i].pieces, interleaved[i].pieces, "expected the same number of tetriminos");
+			assert_eq_msg(alone[i].score, interleaved[i].score, "expected the same score");
+			assert_eq_msg(alone[i].running, interleaved[i].running, "expected the games to end alike");
+			assert_zero_msg(memcmp(alone[i].well.matrix, interleaved[i].well.matrix, sizeof(alone[i].well.matrix)),
+					"expected interleaved games to match games played alone");
+			assert_zero_msg(memcmp(alone[i].well.tetrimino_coords, interleaved[i].well.tetrimino_coords,
+					sizeof(alone[i].well.tetrimino_coords)), "expected the same current tetrimino");
+		}
+	}
+
+	TEST_END();
+}
+
+int tetris_game_test(struct test_runner_instance *instance)
+{
+	struct unit_test tests[] = {
+			{ "tetris_game_init should start a new game", tetris_game_init_test },
+			{ "tetris_game_tick should shift the tetrimino down once gravity elapses", tetris_game_tick_apply_gravity_test },
+			{ "tetris_game_input should not move the tetrimino while paused", tetris_game_pause_stop_gravity_test },
+			{ "tetris_game_idle_ticks should count the ticks that change nothing", tetris_game_idle_ticks_test },
+			{ "tetris_game_input with INPUT_DROP should commit the tetrimino and update the score", tetris_game_drop_commit_and_score_test },
+			{ "tetris_game_input with INPUT_STOP should end the game", tetris_game_stop_test },
+			{ "tetris_game_place should only commit reachable placements", tetris_game_place_test },
+			{ "tetris_game_place_trusted should commit like tetris_game_place", tetris_game_place_trusted_test },
+			{ "tetris_game should remember the last locked tetrimino", tetris_game_last_lock_test },
+			{ "tetris_game_step should apply the inputs, then tick", tetris_game_step_test },
+			{ "tetris_game should play interleaved games independently", tetris_game_interleaved_test },
+			{ NULL, NULL }
+	};
+
+	return execute_tests(instance, tests);
+}
@@ -605,6 +605,206 @@ TEST_DEFINE(tetrimino_commit_collapse_rows_test)
 	TEST_END();
 }
 
+TEST_DEFINE(tetris_well_init_dimensions_test)
+{
+	struct tetris_well well;
+	tetris_well_init(&well);
+
+	TEST_START() {
+		int ret = tetris_well_init_dimensions(&well, BOARD_MIN_WIDTH - 1, BOARD_HEIGHT);
+		assert_nonzero_msg(ret, "expected tetris_well_init_dimensions() to reject a well that is too narrow");
+		ret = tetris_well_init_dimensions(&well, BOARD_MAX_WIDTH + 1, BOARD_HEIGHT);
+		assert_nonzero_msg(ret, "expected tetris_well_init_dimensions() to reject a well that is too wide");
+		ret = tetris_well_init_dimensions(&well, BOARD_WIDTH, BOARD_MIN_HEIGHT - 1);
+		assert_nonzero_msg(ret, "expected tetris_well_init_dimensions() to reject a well that is too short");
+		ret = tetris_well_init_dimensions(&well, BOARD_WIDTH, BOARD_MAX_HEIGHT + 1);
+		assert_nonzero_msg(ret, "expected tetris_well_init_dimensions() to reject a well that is too tall");
+
+		assert_eq_msg(BOARD_WIDTH, well.width, "rejected dimensions should leave the well untouched, but width was %zu", well.width);
+		assert_eq_msg(BOARD_HEIGHT, well.height, "rejected dimensions should leave the well untouched, but height was %zu", well.height);
+
+		ret = tetris_well_init_dimensions(&well, 16, 40);
+		assert_zero_msg(ret, "expected tetris_well_init_dimensions() to accept a 16x40 well, but returned %d", ret);
+		assert_eq_msg(16, well.width, "expected well width 16, but was %zu", well.width);
+		assert_eq_msg(40, well.height, "expected well height 40, but was %zu", well.height);
+		assert_eq_msg(CELL_TYPE_NONE, well.tetrimino_type,
+				"expected the tetrimino type to be initialized to CELL_TYPE_NONE");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(tetrimino_shift_respect_custom_dimensions_test)
+{
+	struct tetris_well well;
+	tetris_well_init_dimensions(&well, 16, 40);
+
+	well.tetrimino_bag_index = 7;
+	well.tetrimino_bag[6] = 1; // type O
+
+	TEST_START() {
+		int ret = tetrimino_new(&well);
+		assert_zero_msg(ret, "expected return value of zero from tetrimino_new() but was %d", ret);
+		assert_eq_msg(7, well.tetrimino_coords[0][0],
+				"expected tetrimino to be centered in the well, but x coordinate was %zu",
+				well.tetrimino_coords[0][0]);
+
+		size_t shifts = 0;
+		while (!tetrimino_shift(&well, SHIFT_RIGHT))
+			shifts++;
+		assert_eq_msg(7, shifts, "expected tetrimino to shift right 7 times, but shifted %zu times", shifts);
+		assert_eq_msg(15, well.tetrimino_coords[1][0],
+				"expected tetrimino to reach the right boundary, but x coordinate was %zu",
+				well.tetrimino_coords[1][0]);
+
+		shifts = 0;
+		while (!tetrimino_shift(&well, SHIFT_DOWN))
+			shifts++;
+		assert_eq_msg(38, shifts, "expected tetrimino to shift down 38 times, but shifted %zu times", shifts);
+		assert_eq_msg(39, well.tetrimino_coords[3][1],
+				"expected tetrimino to reach the bottom boundary, but y coordinate was %zu",
+				well.tetrimino_coords[3][1]);
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(tetrimino_commit_respect_custom_dimensions_test)
+{
+	struct tetris_well well;
+	tetris_well_init_dimensions(&well, BOARD_WIDTH, 100);
+
+	well.tetrimino_bag_index = 7;
+	well.tetrimino_bag[6] = 0; // type I
+
+	TEST_START() {
+		int ret = tetrimino_new(&well);
+		assert_zero_msg(ret, "expected return value of zero from tetrimino_new() but was %d", ret);
+
+		while (!tetrimino_shift(&well, SHIFT_DOWN));
+
+		for (size_t i = 0; i < BOARD_WIDTH; i++)
+			if (i != well.tetrimino_coords[0][0])
+				well.matrix[99][i] = CELL_TYPE_O;
+
+		ret = tetris_well_commit_tetrimino(&well);
+		assert_eq_msg(1, ret, "expected tetris_well_commit_tetrimino() to clear the bottom row, but returned %d", ret);
+
+		assert_eq_msg(CELL_TYPE_NONE, well.matrix[96][well.tetrimino_coords[0][0]],
+				"expected cell [%zu, %zu] to be empty", well.tetrimino_coords[0][0], 96);
+		for (size_t i = 97; i < 100; i++) {
+			assert_eq_msg(CELL_TYPE_I, well.matrix[i][well.tetrimino_coords[0][0]],
+					"expected cell [%zu, %zu] to have cell type I", well.tetrimino_coords[0][0], i);
+		}
+	}
+
+	TEST_END();
+}
+
+/*
+ * Spawn a tetrimino, rotate it, walk it to a column, drop it to the bottom of
+ * the well and commit it, resetting the well once it overflows. `i` varies the
+ * rotations and column from one piece to the next.
+ * */
+static int play_piece(struct tetris_well *well, size_t i)
+{
+	int acc = 0;
+
+	if (tetrimino_new(well)) {
+		tetris_well_init_dimensions(well, well->width, well->height);
+		tetris_well_seed(well, i);
+		return 0;
+	}
+
+	for (size_t r = 0; r < i % 4; r++)
+		acc += tetrimino_rotate(well);
+
+	int direction = (i / 4) % 2 ? SHIFT_LEFT : SHIFT_RIGHT;
+	for (size_t s = 0; s < (i / 8) % (well->width / 2); s++)
+		acc += tetrimino_shift(well, direction);
+
+	while (!tetrimino_shift(well, SHIFT_DOWN));
+	return acc + tetris_well_commit_tetrimino(well);
+}
+
+BENCH_DEFINE(tetrimino_shift_bench)
+{
+	struct tetris_well well;
+	size_t i = 0;
+
+	tetris_well_init(&well);
+	tetris_well_seed(&well, 1);
+	tetrimino_new(&well);
+
+	BENCH_START() {
+		bench_keep(tetrimino_shift(&well, i++ % 2 ? SHIFT_LEFT : SHIFT_RIGHT));
+	}
+
+	BENCH_END();
+}
+
+BENCH_DEFINE(tetrimino_rotate_bench)
+{
+	struct tetris_well well;
+
+	tetris_well_init(&well);
+	tetris_well_seed(&well, 1);
+	tetrimino_new(&well);
+	tetrimino_shift(&well, SHIFT_DOWN);
+	tetrimino_shift(&well, SHIFT_DOWN);
+
+	BENCH_START() {
+		bench_keep(tetrimino_rotate(&well));
+	}
+
+	BENCH_END();
+}
+
+/*
+ * Every well runs through the same code; the work per piece only grows with
+ * the rows cleared and the distance dropped.
+ * */
+#define PLAY_PIECE_BENCH(__bench_name, __width, __height) \
+	BENCH_DEFINE(__bench_name) \
+	{ \
+		struct tetris_well well; \
+		size_t i = 0; \
+		\
+		tetris_well_init_dimensions(&well, (__width), (__height)); \
+		tetris_well_seed(&well, 1); \
+		\
+		BENCH_START() { \
+			bench_keep(play_piece(&well, i++)); \
+		} \
+		\
+		BENCH_END(); \
+	}
+
+PLAY_PIECE_BENCH(play_piece_standard_bench, BOARD_WIDTH, BOARD_HEIGHT)
+PLAY_PIECE_BENCH(play_piece_wide_bench, 16, 40)
+PLAY_PIECE_BENCH(play_piece_tall_bench, BOARD_WIDTH, 100)
+
+/*
+ * Searches, rollouts and perft copy a well for every position they try, and
+ * a well is the same size whatever its dimensions, so this is what the
+ * matrix sized for the largest well costs them.
+ * */
+BENCH_DEFINE(tetris_well_copy_bench)
+{
+	struct tetris_well well, copy;
+
+	tetris_well_init(&well);
+	tetris_well_seed(&well, 1);
+	tetrimino_new(&well);
+
+	BENCH_START() {
+		copy = well;
+		bench_keep(&copy);
+	}
+
+	BENCH_END();
+}
+
 int tetris_well_test(struct test_runner_instance *instance)
 {
 	struct unit_test tests[] = {
@@ -622,8 +822,21 @@ int tetris_well_test(struct test_runner_instance *instance)
 			{ "tetrimino_rotate should correctly rotate all tetrimino types", tetrimino_rotate_correctly_rotate_tetrimino_test },
 			{ "tetrimino_rotate should return nonzero and not update coords if rotation not possible", tetrimino_rotate_return_nonzero_if_not_legal_test },
 			{ "tetrimino_commit should collapse and shift rows that have been filled", tetrimino_commit_collapse_rows_test },
+			{ "tetris_well_init_dimensions should only accept supported dimensions", tetris_well_init_dimensions_test },
+			{ "tetrimino_shift should respect the boundaries of a non-standard well", tetrimino_shift_respect_custom_dimensions_test },
+			{ "tetrimino_commit should collapse rows in a non-standard well", tetrimino_commit_respect_custom_dimensions_test },
+			{ NULL, NULL }
+	};
+
+	struct unit_bench benchmarks[] = {
+			{ "tetrimino_shift left and right", tetrimino_shift_bench },
+			{ "tetrimino_rotate", tetrimino_rotate_bench },
+			{ "play a piece in a 10x24 well", play_piece_standard_bench },
+			{ "play a piece in a 16x40 well", play_piece_wide_bench },
+			{ "play a piece in a 10x100 well", play_piece_tall_bench },
+			{ "copy a well", tetris_well_copy_bench },
 			{ NULL, NULL }
 	};
 
-	return execute_tests(instance, tests);
+	return execute_tests(instance, tests) | execute_benchmarks(instance, benchmarks);
 }
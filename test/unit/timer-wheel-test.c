@@ -0,0 +1,178 @@
+#include "test-lib.h"
+#include "timer-wheel.h"
+
+#define TEST_TIMERS 8
+
+struct fired {
+	struct timer *timers[TEST_TIMERS];
+	size_t count;
+};
+
+static void record_timer(void *data, struct timer *timer)
+{
+	struct fired *fired = data;
+
+	if (fired->count < TEST_TIMERS)
+		fired->timers[fired->count] = timer;
+	fired->count++;
+}
+
+static void rearm_timer(void *data, struct timer *timer)
+{
+	struct timer_wheel *wheel = data;
+
+	timer_wheel_add(wheel, timer, timer->expires + 20000);
+}
+
+TEST_DEFINE(timer_wheel_fire_when_due_test)
+{
+	struct timer_wheel wheel;
+	struct timer timers[3];
+	struct fired fired;
+
+	memset(timers, 0, sizeof(timers));
+	memset(&fired, 0, sizeof(fired));
+	timer_wheel_init(&wheel, 1000000);
+
+	TEST_START() {
+		timer_wheel_add(&wheel, &timers[0], 1005000);
+		timer_wheel_add(&wheel, &timers[1], 1005500);
+		timer_wheel_add(&wheel, &timers[2], 1020000);
+		assert_eq_msg(1005000, timer_wheel_next(&wheel), "expected the nearest deadline to be next");
+
+		timer_wheel_advance(&wheel, 1004999, record_timer, &fired);
+		assert_zero_msg(fired.count, "expected no timer to fire before its deadline");
+
+		/* the second timer is due later in the same tick, and must wait for it */
+		timer_wheel_advance(&wheel, 1005200, record_timer, &fired);
+		assert_eq_msg(1, fired.count, "expected exactly one timer to fire, but %zu did", fired.count);
+		assert_true_msg(fired.timers[0] == &timers[0], "expected the first timer to fire");
+
+		timer_wheel_advance(&wheel, 1006000, record_timer, &fired);
+		assert_eq_msg(2, fired.count, "expected the second timer to fire within its tick");
+		assert_true_msg(fired.timers[1] == &timers[1], "expected the second timer to fire");
+
+		timer_wheel_advance(&wheel, 1030000, record_timer, &fired);
+		assert_eq_msg(3, fired.count, "expected the last timer to fire");
+		assert_eq_msg(UINT64_MAX, timer_wheel_next(&wheel), "expected the wheel to be empty");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(timer_wheel_remove_test)
+{
+	struct timer_wheel wheel;
+	struct timer timers[3];
+	struct fired fired;
+
+	memset(timers, 0, sizeof(timers));
+	memset(&fired, 0, sizeof(fired));
+	timer_wheel_init(&wheel, 0);
+
+	TEST_START() {
+		/* every timer in the same slot, so that removal unlinks from the middle */
+		for (size_t i = 0; i < 3; i++)
+			timer_wheel_add(&wheel, &timers[i], 2000 + i);
+
+		timer_wheel_remove(&wheel, &timers[1]);
+		timer_wheel_remove(&wheel, &timers[1]);
+		assert_eq_msg(2, wheel.count, "expected a timer to be removed only once");
+
+		timer_wheel_advance(&wheel, 3000, record_timer, &fired);
+		assert_eq_msg(2, fired.count, "expected the removed timer not to fire");
+		assert_true_msg(fired.timers[0] != &timers[1] && fired.timers[1] != &timers[1],
+				"expected the removed timer not to fire");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(timer_wheel_far_future_test)
+{
+	struct timer_wheel wheel;
+	struct timer timer;
+	struct fired fired;
+	uint64_t turn = (uint64_t)TIMER_WHEEL_SLOTS * TIMER_WHEEL_TICK_USEC;
+
+	memset(&timer, 0, sizeof(timer));
+	memset(&fired, 0, sizeof(fired));
+	timer_wheel_init(&wheel, 0);
+
+	TEST_START() {
+		timer_wheel_add(&wheel, &timer, 3 * turn + 500);
+
+		/* the timer shares its slot with earlier turns, but must not fire on them */
+		for (uint64_t now = 0; now < 3 * turn; now += 700)
+			timer_wheel_advance(&wheel, now, record_timer, &fired);
+		assert_zero_msg(fired.count, "expected the timer not to fire a turn early");
+		assert_true_msg(timer_wheel_next(&wheel) <= 3 * turn + 500, "expected the deadline not to be missed");
+
+		timer_wheel_advance(&wheel, 3 * turn + 1000, record_timer, &fired);
+		assert_eq_msg(1, fired.count, "expected the timer to fire on its turn");
+
+		/* a long stall fires everything overdue in one go */
+		timer_wheel_add(&wheel, &timer, 4 * turn);
+		timer_wheel_advance(&wheel, 100 * turn, record_timer, &fired);
+		assert_eq_msg(2, fired.count, "expected the overdue timer to fire after a stall");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(timer_wheel_rearm_from_callback_test)
+{
+	struct timer_wheel wheel;
+	struct timer timer;
+
+	memset(&timer, 0, sizeof(timer));
+	timer_wheel_init(&wheel, 0);
+
+	TEST_START() {
+		timer_wheel_add(&wheel, &timer, 1000);
+		timer_wheel_advance(&wheel, 1000, rearm_timer, &wheel);
+
+		assert_eq_msg(1, wheel.count, "expected the timer to be armed again");
+		assert_eq_msg(21000, timer.expires, "expected the timer to fire only once per advance");
+	}
+
+	TEST_END();
+}
+
+BENCH_DEFINE(timer_wheel_advance_bench)
+{
+	struct timer_wheel wheel;
+	struct timer *timers = calloc(4096, sizeof(struct timer));
+	uint64_t now = 0;
+
+	timer_wheel_init(&wheel, now);
+	for (size_t i = 0; timers && i < 4096; i++)
+		timer_wheel_add(&wheel, &timers[i], (i * 7919) % 20000);
+
+	/* 4096 sessions with a 20 ms gravity tick, advanced every millisecond */
+	BENCH_START() {
+		now += TIMER_WHEEL_TICK_USEC;
+		timer_wheel_advance(&wheel, now, rearm_timer, &wheel);
+	}
+
+	free(timers);
+	BENCH_END();
+}
+
+int timer_wheel_test(struct test_runner_instance *instance)
+{
+	struct unit_test tests[] = {
+			{ "timer_wheel_advance should fire timers once they are due", timer_wheel_fire_when_due_test },
+			{ "timer_wheel_remove should disarm a timer", timer_wheel_remove_test },
+			{ "timer_wheel_advance should keep timers more than a turn away", timer_wheel_far_future_test },
+			{ "timer_wheel_advance should let callbacks arm timers again", timer_wheel_rearm_from_callback_test },
+			{ NULL, NULL }
+	};
+
+	struct unit_bench benchmarks[] = {
+			{ "timer_wheel_advance of 4096 timers by one tick", timer_wheel_advance_bench },
+			{ NULL, NULL }
+	};
+
+	return execute_tests(instance, tests) | execute_benchmarks(instance, benchmarks);
+}
@@ -0,0 +1,299 @@
+#include "test-lib.h"
+#include "training-data.h"
+#include "tetris-game.h"
+
+#define TEST_RECORDS 7
+#define TEST_CHUNK_RECORDS 3
+
+/*
+ * Play the first tetriminos of a game, keeping the well before each
+ * placement along with the placements it had.
+ * */
+static size_t game_positions(struct tetris_well *wells, struct placement (*placements)[PLACEMENTS_MAX],
+		size_t *counts, size_t nr)
+{
+	struct tetris_game game;
+	size_t i = 0;
+
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 9);
+	for (; i < nr && game.running; i++) {
+		wells[i] = game.well;
+		counts[i] = tetrimino_placements(&game.well, placements[i]);
+		if (!counts[i] || tetris_game_place(&game, &placements[i][i % counts[i]]))
+			break;
+	}
+
+	return i;
+}
+
+/*
+ * Write the positions to a file with the given options, then read every
+ * chunk back and check each column of each record.
+ * */
+static int write_and_check(const struct training_options *options)
+{
+	static struct placement placements[TEST_RECORDS][PLACEMENTS_MAX];
+	struct tetris_well wells[TEST_RECORDS];
+	size_t counts[TEST_RECORDS];
+	struct training_writer writer;
+	struct training_record record;
+	struct training_data_header header;
+	struct training_chunk_header chunk;
+	static char data[1 << 20];
+	int ret = 1;
+
+	FILE *file = tmpfile();
+	if (!file || game_positions(wells, placements, counts, TEST_RECORDS) != TEST_RECORDS)
+		goto out;
+
+	if (training_writer_open(&writer, file, options))
+		goto out;
+
+	struct training_stream *stream = training_stream_open(&writer);
+	for (size_t i = 0; stream && i < TEST_RECORDS; i++) {
+		record.game = 9;
+		record.piece = (uint32_t)i;
+		record.reward = (int32_t)i * 10;
+		record.lines = (uint8_t)i;
+		record.done = i == TEST_RECORDS - 1;
+		record.well = &wells[i];
+		record.candidates = placements[i];
+		record.candidates_nr = counts[i];
+		record.chosen = i % counts[i];
+		if (training_record(stream, &record))
+			stream = NULL;
+	}
+
+	if (training_writer_close(&writer) || !stream || writer.records != TEST_RECORDS)
+		goto out;
+
+	rewind(file);
+	if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, TRAINING_DATA_MAGIC, 8) != 0 ||
+			header.height != BOARD_HEIGHT || header.chunk_records != TEST_CHUNK_RECORDS)
+		goto out;
+
+	size_t index = 0;
+	while (fread(&chunk, sizeof(chunk), 1, file) == 1) {
+		size_t n = chunk.records;
+		if (n > TEST_CHUNK_RECORDS || chunk.bytes % 8 || chunk.bytes > sizeof(data) ||
+				fread(data, chunk.bytes, 1, file) != 1)
+			goto out;
+
+		const uint64_t *game = (const uint64_t *)data;
+		const uint32_t *piece = (const uint32_t *)(game + n);
+		const int32_t *reward = (const int32_t *)(piece + n);
+		const uint16_t *rows = (const uint16_t *)(reward + n);
+		const uint16_t *candidates_nr = rows + n * header.height;
+		const uint16_t *chosen = candidates_nr + n;
+		const uint8_t *pieces = (const uint8_t *)(chosen + n);
+		const uint8_t *lines = pieces + n * header.pieces;
+		const uint8_t *done = lines + n;
+		const struct placement *candidates = (const struct placement *)(done + n);
+
+		for (size_t i = 0; i < n; i++, index++) {
+			const struct tetris_well *well = &wells[index];
+			size_t kept = counts[index] < header.max_candidates ? counts[index] : header.max_candidates;
+			size_t expected = index % counts[index] < kept ? index % counts[index] : kept - 1;
+
+			if (game[i] != 9 || piece[i] != index || reward[i] != (int32_t)index * 10 || lines[i] != index ||
+					done[i] != (index == TEST_RECORDS - 1) || candidates_nr[i] != kept || chosen[i] != expected)
+				goto out;
+
+			if (memcmp(&candidates[i * header.max_candidates + chosen[i]], &placements[index][index % counts[index]],
+					sizeof(struct placement)) != 0)
+				goto out;
+
+			if (pieces[i * header.pieces] > 6 || (uint8_t)(1u << pieces[i * header.pieces]) != well->tetrimino_type ||
+					pieces[i * header.pieces + 1] != (well->tetrimino_bag_index ?
+							well->tetrimino_bag[well->tetrimino_bag_index - 1] : TRAINING_NO_PIECE))
+				goto out;
+
+			for (size_t y = 0; y < header.height; y++) {
+				for (size_t x = 0; x < header.width; x++) {
+					if (!(rows[i * header.height + y] & (1u << x)) != (well->matrix[y][x] == CELL_TYPE_NONE))
+						goto out;
+				}
+			}
+		}
+	}
+
+	ret = index != TEST_RECORDS;
+
+out:
+	if (file)
+		fclose(file);
+	return ret;
+}
+
+TEST_DEFINE(training_data_writer_thread_test)
+{
+	struct training_options options;
+
+	training_options_init(&options, BOARD_WIDTH, BOARD_HEIGHT);
+	options.chunk_records = TEST_CHUNK_RECORDS;
+
+	TEST_START() {
+		assert_zero_msg(write_and_check(&options), "expected every record to be read back as written");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(training_data_no_writer_thread_test)
+{
+	struct training_options options;
+
+	training_options_init(&options, BOARD_WIDTH, BOARD_HEIGHT);
+	options.chunk_records = TEST_CHUNK_RECORDS;
+	options.writer_thread = 0;
+	options.pieces = 3;
+
+	TEST_START() {
+		assert_zero_msg(write_and_check(&options), "expected every record to be read back as written");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(training_data_few_candidates_test)
+{
+	struct training_options options;
+
+	training_options_init(&options, BOARD_WIDTH, BOARD_HEIGHT);
+	options.chunk_records = TEST_CHUNK_RECORDS;
+	options.max_candidates = 2;
+
+	TEST_START() {
+		assert_zero_msg(write_and_check(&options), "expected the chosen placement to be kept among the candidates");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(training_data_invalid_record_test)
+{
+	static struct placement placements[1][PLACEMENTS_MAX];
+	struct tetris_well well;
+	size_t count;
+	struct training_options options;
+	struct training_writer writer;
+	struct training_record record;
+	int opened = 0;
+	FILE *file = tmpfile();
+
+	training_options_init(&options, BOARD_WIDTH, BOARD_HEIGHT);
+	options.writer_thread = 0;
+
+	memset(&record, 0, sizeof(record));
+	record.well = &well;
+	record.candidates = placements[0];
+
+	TEST_START() {
+		assert_nonnull_msg(file, "failed to create temporary file");
+		assert_eq(1, game_positions(&well, placements, &count, 1));
+
+		assert_zero(training_writer_open(&writer, file, &options));
+		opened = 1;
+
+		struct training_stream *stream = training_stream_open(&writer);
+		assert_nonnull(stream);
+
+		record.candidates_nr = 0;
+		record.chosen = 0;
+		assert_nonzero_msg(training_record(stream, &record), "expected a record without candidates to be rejected");
+
+		record.candidates_nr = count;
+		record.chosen = count;
+		assert_nonzero_msg(training_record(stream, &record), "expected a chosen index out of range to be rejected");
+
+		record.chosen = count - 1;
+		assert_zero_msg(training_record(stream, &record), "expected a valid record to be appended");
+
+		opened = 0;
+		assert_zero(training_writer_close(&writer));
+		assert_eq_msg(1ULL, writer.records, "expected only the valid record to be written");
+	}
+
+	if (opened)
+		training_writer_close(&writer);
+	if (file)
+		fclose(file);
+	TEST_END();
+}
+
+TEST_DEFINE(training_data_invalid_options_test)
+{
+	struct training_options options;
+	struct training_writer writer;
+	FILE *file = tmpfile();
+
+	TEST_START() {
+		assert_nonnull_msg(file, "failed to create temporary file");
+
+		training_options_init(&options, BOARD_WIDTH, BOARD_HEIGHT);
+		options.max_candidates = 0;
+		assert_nonzero_msg(training_writer_open(&writer, file, &options), "expected no candidates to be rejected");
+
+		training_options_init(&options, BOARD_WIDTH, BOARD_HEIGHT);
+		options.pieces = TETRIMINO_QUEUE_MAX + 2;
+		assert_nonzero_msg(training_writer_open(&writer, file, &options), "expected a long queue to be rejected");
+
+		training_options_init(&options, BOARD_MAX_WIDTH + 1, BOARD_HEIGHT);
+		assert_nonzero_msg(training_writer_open(&writer, file, &options), "expected a wide well to be rejected");
+	}
+
+	if (file)
+		fclose(file);
+	TEST_END();
+}
+
+BENCH_DEFINE(training_record_bench)
+{
+	static struct placement placements[PLACEMENTS_MAX];
+	struct training_options options;
+	struct training_writer writer;
+	struct training_record record;
+	struct tetris_game game;
+	FILE *file = fopen("/dev/null", "wb");
+
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, 1);
+	training_options_init(&options, BOARD_WIDTH, BOARD_HEIGHT);
+	training_writer_open(&writer, file, &options);
+	struct training_stream *stream = training_stream_open(&writer);
+
+	memset(&record, 0, sizeof(record));
+	record.well = &game.well;
+	record.candidates = placements;
+	record.candidates_nr = tetrimino_placements(&game.well, placements);
+
+	BENCH_START() {
+		bench_keep(training_record(stream, &record));
+	}
+
+	training_writer_close(&writer);
+	fclose(file);
+	BENCH_END();
+}
+
+int training_data_test(struct test_runner_instance *instance)
+{
+	struct unit_test tests[] = {
+			{ "training_record should write columns that read back with a writer thread",
+					training_data_writer_thread_test },
+			{ "training_record should write columns that read back without a writer thread",
+					training_data_no_writer_thread_test },
+			{ "training_record should keep the chosen placement when dropping candidates",
+					training_data_few_candidates_test },
+			{ "training_record should reject records without candidates or a valid choice",
+					training_data_invalid_record_test },
+			{ "training_writer_open should reject options out of range", training_data_invalid_options_test },
+			{ NULL, NULL }
+	};
+
+	struct unit_bench benchmarks[] = {
+			{ "training_record of a new game, to /dev/null", training_record_bench },
+			{ NULL, NULL }
+	};
+
+	return execute_tests(instance, tests) | execute_benchmarks(instance, benchmarks);
+}
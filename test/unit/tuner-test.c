@@ -0,0 +1,170 @@
+#include <math.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "test-lib.h"
+#include "tuner.h"
+
+#define TEST_GENERATIONS 2
+
+static void small_options(struct tuner_options *options, int threads)
+{
+	tuner_options_init(options);
+	options->population = 6;
+	options->games = 2;
+	options->pieces = 60;
+	options->threads = threads;
+	options->seed = 5;
+}
+
+/*
+ * Run a few generations, returning non-zero on failure.
+ * */
+static int run(struct tuner *tuner, int generations)
+{
+	for (int i = 0; i < generations; i++) {
+		if (tuner_evaluate(tuner))
+			return 1;
+		tuner_evolve(tuner);
+	}
+
+	return 0;
+}
+
+static int same_population(const struct tuner *a, const struct tuner *b)
+{
+	return a->generation == b->generation && a->random == b->random &&
+			a->options.population == b->options.population &&
+			!memcmp(a->population, b->population, sizeof(*a->population) * a->options.population);
+}
+
+TEST_DEFINE(tuner_threads_test)
+{
+	struct tuner_options options;
+	struct tuner one, many;
+
+	small_options(&options, 1);
+	int failed = tuner_init(&one, &options);
+	options.threads = 3;
+	failed |= tuner_init(&many, &options);
+
+	TEST_START() {
+		assert_zero_msg(failed, "failed to start tuning");
+		assert_zero_msg(run(&one, TEST_GENERATIONS) | run(&many, TEST_GENERATIONS), "failed to tune");
+		assert_true_msg(same_population(&one, &many), "expected the same population whatever the threads");
+		assert_zero_msg(memcmp(one.fitness, many.fitness, sizeof(double) * options.population),
+				"expected the same fitness whatever the threads");
+	}
+
+	tuner_release(&one);
+	tuner_release(&many);
+	TEST_END();
+}
+
+TEST_DEFINE(tuner_checkpoint_test)
+{
+	struct tuner_options options;
+	struct tuner straight, saved, resumed;
+	char path[] = "/tmp/tetris-tune-XXXXXX";
+	int fd = mkstemp(path);
+
+	small_options(&options, 2);
+	int failed = tuner_init(&straight, &options) | tuner_init(&saved, &options);
+	resumed.population = NULL;
+	resumed.fitness = NULL;
+
+	TEST_START() {
+		assert_true_msg(fd >= 0, "failed to create temporary file");
+		assert_zero_msg(failed, "failed to start tuning");
+
+		assert_zero_msg(run(&straight, TEST_GENERATIONS * 2), "failed to tune");
+		assert_zero_msg(run(&saved, TEST_GENERATIONS), "failed to tune");
+		assert_zero_msg(tuner_save(&saved, path), "failed to save tuner");
+		assert_zero_msg(tuner_load(&resumed, path, 1), "failed to load tuner");
+		assert_true_msg(same_population(&saved, &resumed), "expected the saved population to be loaded back");
+
+		assert_zero_msg(run(&resumed, TEST_GENERATIONS), "failed to tune");
+		assert_true_msg(same_population(&straight, &resumed), "expected a resumed tuner to carry on identically");
+	}
+
+	if (fd >= 0) {
+		close(fd);
+		unlink(path);
+	}
+	tuner_release(&straight);
+	tuner_release(&saved);
+	tuner_release(&resumed);
+	TEST_END();
+}
+
+TEST_DEFINE(tuner_unit_weights_test)
+{
+	struct tuner_options options;
+	struct tuner tuner;
+
+	small_options(&options, 1);
+	options.mutation = 5;
+	int failed = tuner_init(&tuner, &options);
+
+	TEST_START() {
+		assert_zero_msg(failed, "failed to start tuning");
+		assert_zero_msg(run(&tuner, TEST_GENERATIONS), "failed to tune");
+
+		for (size_t i = 0; i < options.population; i++) {
+			const struct evaluator_weights *w = &tuner.population[i];
+			double norm = w->aggregate_height * w->aggregate_height + w->holes * w->holes +
+					w->bumpiness * w->bumpiness + w->transitions * w->transitions + w->lines * w->lines;
+			assert_true_msg(fabs(norm - 1) < 1e-9, "expected weights of unit length, got %f", norm);
+		}
+	}
+
+	tuner_release(&tuner);
+	TEST_END();
+}
+
+TEST_DEFINE(tuner_play_test)
+{
+	TEST_START() {
+		unsigned long lines = tuner_play(&evaluator_default_weights, 1, 200);
+		assert_true_msg(lines >= 50, "expected the default weights to clear lines, got %lu", lines);
+		assert_true_msg(lines == tuner_play(&evaluator_default_weights, 1, 200),
+				"expected the same game from the same seed");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(tuner_invalid_options_test)
+{
+	struct tuner_options options;
+	struct tuner tuner;
+
+	TEST_START() {
+		small_options(&options, 1);
+		options.population = 1;
+		assert_nonzero_msg(tuner_init(&tuner, &options), "expected a population of one to be rejected");
+
+		small_options(&options, 1);
+		options.games = 0;
+		assert_nonzero_msg(tuner_init(&tuner, &options), "expected no games to be rejected");
+
+		assert_nonzero_msg(tuner_load(&tuner, "/nonexistent/tetris-tune", 1),
+				"expected a missing checkpoint to be rejected");
+	}
+
+	TEST_END();
+}
+
+int tuner_test(struct test_runner_instance *instance)
+{
+	struct unit_test tests[] = {
+			{ "tuner should evolve the same way whatever the threads", tuner_threads_test },
+			{ "tuner should carry on from a checkpoint as if it never stopped", tuner_checkpoint_test },
+			{ "tuner should keep weights of unit length", tuner_unit_weights_test },
+			{ "tuner_play should clear lines deterministically", tuner_play_test },
+			{ "tuner_init should reject options out of range", tuner_invalid_options_test },
+			{ NULL, NULL }
+	};
+
+	return execute_tests(instance, tests);
+}
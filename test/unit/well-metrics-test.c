@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "test-lib.h"
+#include "well-metrics.h"
+#include "tetris-well.h"
+
+#define TEST_THREAD_SHIFTS 1000
+
+/*
+ * The counts of each metric since `before`.
+ * */
+static void gather_since(const uint64_t *before, uint64_t *counts)
+{
+	well_metrics_gather(counts);
+	for (size_t i = 0; i < WELL_METRICS_NR; i++)
+		counts[i] -= before[i];
+}
+
+static void *shift_down(void *data)
+{
+	struct tetris_well well;
+
+	(void)data;
+	tetris_well_init(&well);
+	tetris_well_seed(&well, 1);
+	tetrimino_new(&well);
+	for (int i = 0; i < TEST_THREAD_SHIFTS; i++)
+		tetrimino_shift(&well, SHIFT_DOWN);
+
+	return NULL;
+}
+
+TEST_DEFINE(well_metrics_count_test)
+{
+	uint64_t before[WELL_METRICS_NR], counts[WELL_METRICS_NR];
+	struct tetris_well well;
+
+	tetris_well_init(&well);
+	tetris_well_seed(&well, 3);
+
+	TEST_START() {
+		well_metrics_gather(before);
+
+		tetrimino_new(&well);
+		tetrimino_shift(&well, SHIFT_LEFT);
+		tetrimino_shift(&well, SHIFT_LEFT);
+		tetrimino_shift(&well, SHIFT_RIGHT);
+		tetrimino_rotate(&well);
+		while (!tetrimino_shift(&well, SHIFT_DOWN));
+		tetris_well_commit_tetrimino(&well);
+
+		gather_since(before, counts);
+		if (!well_metrics_enabled()) {
+			for (size_t i = 0; i < WELL_METRICS_NR; i++)
+				assert_zero_msg(counts[i], "expected no counts without well metrics");
+		} else {
+			assert_eq_msg(counts[WELL_METRIC_SHIFTS + SHIFT_LEFT], 2, "expected two shifts left");
+			assert_eq_msg(counts[WELL_METRIC_SHIFTS + SHIFT_RIGHT], 1, "expected one shift right");
+			assert_true_msg(counts[WELL_METRIC_SHIFTS + SHIFT_DOWN] > 1, "expected the tetrimino to be dropped");
+			assert_eq_msg(counts[WELL_METRIC_ROTATIONS], 1, "expected one rotation");
+			assert_zero_msg(counts[WELL_METRIC_ROTATIONS_BLOCKED], "expected the rotation to succeed");
+			assert_true_msg(counts[WELL_METRIC_OVERLAP_CHECKS] >= 5, "expected every move to check for overlaps");
+			assert_eq_msg(counts[WELL_METRIC_COMMITS], 1, "expected one commit");
+			assert_zero_msg(counts[WELL_METRIC_ROWS_CLEARED], "expected no rows cleared");
+			assert_eq_msg(counts[WELL_METRIC_BAG_REFILLS], 1, "expected one refill of the queue");
+		}
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(well_metrics_threads_test)
+{
+	uint64_t before[WELL_METRICS_NR], counts[WELL_METRICS_NR];
+	pthread_t threads[2];
+
+	TEST_START() {
+		well_metrics_gather(before);
+		for (size_t i = 0; i < 2; i++)
+			assert_zero_msg(pthread_create(&threads[i], NULL, shift_down, NULL), "failed to start thread");
+		for (size_t i = 0; i < 2; i++)
+			pthread_join(threads[i], NULL);
+
+		gather_since(before, counts);
+		if (well_metrics_enabled())
+			assert_eq_msg(counts[WELL_METRIC_SHIFTS + SHIFT_DOWN], 2 * TEST_THREAD_SHIFTS,
+					"expected the counts of exited threads to be kept");
+		else
+			assert_zero_msg(counts[WELL_METRIC_SHIFTS + SHIFT_DOWN], "expected no counts without well metrics");
+	}
+
+	TEST_END();
+}
+
+TEST_DEFINE(well_metrics_serve_test)
+{
+	static const char request[] = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+	struct well_metrics_server server;
+	struct sockaddr_un addr;
+	char path[64], response[4096];
+	size_t len = 0;
+	ssize_t n;
+	int fd = -1;
+
+	snprintf(path, sizeof(path), "/tmp/tetris-metrics-%ld.sock", (long)getpid());
+	unlink(path);
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	int failed = well_metrics_serve(&server, path);
+
+	TEST_START() {
+		assert_zero_msg(failed, "failed to serve metrics");
+
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		assert_true_msg(fd >= 0, "failed to create socket");
+		assert_zero_msg(connect(fd, (struct sockaddr *)&addr, sizeof(addr)), "failed to connect");
+		assert_eq_msg(send(fd, request, sizeof(request) - 1, 0), (ssize_t)sizeof(request) - 1,
+				"failed to send request");
+
+		while (len < sizeof(response) - 1 && (n = recv(fd, response + len, sizeof(response) - 1 - len, 0)) > 0)
+			len += (size_t)n;
+		response[len] = '\0';
+
+		assert_zero_msg(strncmp(response, "HTTP/1.0 200 OK\r\n", 17), "expected an HTTP response");
+		if (well_metrics_enabled())
+			assert_nonnull_msg(strstr(response, "\r\n\r\n# HELP tetris_well_shifts_total "),
+					"expected the metrics in the body");
+		else
+			assert_nonnull_msg(strstr(response, "without well metrics"), "expected a note in the body");
+	}
+
+	if (fd >= 0)
+		close(fd);
+	if (!failed)
+		well_metrics_stop(&server);
+	TEST_END();
+}
+
+int well_metrics_test(struct test_runner_instance *instance)
+{
+	struct unit_test tests[] = {
+			{ "well metrics should count the operations of the well", well_metrics_count_test },
+			{ "well metrics should keep the counts of exited threads", well_metrics_threads_test },
+			{ "well_metrics_serve should answer HTTP requests with the metrics", well_metrics_serve_test },
+			{ NULL, NULL }
+	};
+
+	return execute_tests(instance, tests);
+}
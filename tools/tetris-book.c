@@ -0,0 +1,389 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+
+#include "tetris-game.h"
+#include "search.h"
+#include "opening-book.h"
+#include "randomizer.h"
+#include "monotonic-clock.h"
+#include "tool-options.h"
+
+/*
+ * tetris-book:
+ * Build and use opening books (see opening-book.h).
+ *
+ * `build` plays the given number of games with a deep search (see search.h),
+ * and records the placement it chose for each of the first few tetriminos of
+ * every game. Game i is played with seed + i, and games are spread across
+ * threads.
+ *
+ * `play` plays games the way a bot would: the placement of each tetrimino is
+ * looked up in the book, and only searched for if it isn't there. It reports
+ * how often the book was used, and the time spent on lookups and searches, so
+ * that the savings of a book can be measured. Without a book, every placement
+ * is searched for.
+ * */
+
+#define BOOK_DEFAULT_PIECES 12
+#define BOOK_DEFAULT_GAMES 1000
+#define PLAY_DEFAULT_PIECES 100
+#define PLAY_DEFAULT_GAMES 100
+
+struct build_job {
+	pthread_mutex_t lock;
+	unsigned long next;
+	unsigned long games;
+	int pieces;
+	int randomizer;
+	uint64_t seed;
+	const struct search_options *search;
+	int failed;
+
+	struct opening_book_entry *entries;
+	size_t nr;
+	size_t alloc;
+};
+
+struct play_stats {
+	unsigned long pieces;
+	unsigned long hits;
+	unsigned long searches;
+	unsigned long games_over;
+	unsigned long long lines;
+	double lookup_sec;
+	double search_sec;
+};
+
+static void print_usage(FILE *stream, const char *prog)
+{
+	fprintf(stream, "usage: %s build [options] <book>\n", prog);
+	fprintf(stream, "   or: %s play [options] [<book>]\n", prog);
+	fprintf(stream, "\n");
+	fprintf(stream, "    --games <n>     number of games (default %d to build, %d to play)\n",
+			BOOK_DEFAULT_GAMES, PLAY_DEFAULT_GAMES);
+	fprintf(stream, "    --pieces <n>    tetriminos per game recorded in the book (default %d), or\n",
+			BOOK_DEFAULT_PIECES);
+	fprintf(stream, "                    played (default %d)\n", PLAY_DEFAULT_PIECES);
+	fprintf(stream, "    --depth <n>     tetriminos the search looks ahead, at most %d (default 4)\n", SEARCH_MAX_DEPTH);
+	fprintf(stream, "    --beam <n>      placements the search expands at each level, at most %d (default 4)\n",
+			SEARCH_MAX_BEAM);
+	fprintf(stream, "    --threads <n>   number of threads to build with (default: one per core)\n");
+	fprintf(stream, "    --seed <n>      seed of the first game (default 1)\n");
+	fprintf(stream, "    --randomizer <name>\n");
+	fprintf(stream, "                    randomizer of every game (default 'bag')\n");
+}
+
+static int add_entries(struct build_job *job, const struct opening_book_entry *entries, size_t nr)
+{
+	if (job->nr + nr > job->alloc) {
+		size_t alloc = job->alloc ? job->alloc : 1024;
+		while (alloc < job->nr + nr)
+			alloc *= 2;
+
+		struct opening_book_entry *grown = realloc(job->entries, alloc * sizeof(*grown));
+		if (!grown)
+			return 1;
+
+		job->entries = grown;
+		job->alloc = alloc;
+	}
+
+	memcpy(job->entries + job->nr, entries, nr * sizeof(*entries));
+	job->nr += nr;
+
+	return 0;
+}
+
+static void *build_worker(void *data)
+{
+	struct build_job *job = data;
+	struct opening_book_entry *entries = calloc((size_t)job->pieces, sizeof(*entries));
+	struct tetris_game game;
+
+	if (!entries) {
+		job->failed = 1;
+		return NULL;
+	}
+
+	while (1) {
+		pthread_mutex_lock(&job->lock);
+		unsigned long index = job->next++;
+		int stop = index >= job->games || job->failed;
+		pthread_mutex_unlock(&job->lock);
+
+		if (stop)
+			break;
+
+		tetris_game_init_randomizer(&game, BOARD_WIDTH, BOARD_HEIGHT, job->seed + index, job->randomizer);
+
+		size_t nr = 0;
+		for (int piece = 0; piece < job->pieces && game.running; piece++) {
+			struct opening_book_entry *entry = &entries[nr];
+			if (search_best_placement(&game.well, job->search, &entry->placement, NULL))
+				break;
+
+			entry->hash = opening_book_hash(&game.well);
+			placement_normalize(&entry->placement);
+			nr++;
+
+			if (tetris_game_place_trusted(&game, &entry->placement))
+				break;
+		}
+
+		pthread_mutex_lock(&job->lock);
+		if (add_entries(job, entries, nr))
+			job->failed = 1;
+		pthread_mutex_unlock(&job->lock);
+	}
+
+	free(entries);
+	return NULL;
+}
+
+static int build_book(const char *path, struct build_job *job, int threads)
+{
+	pthread_t *workers = malloc(sizeof(pthread_t) * (size_t)threads);
+	uint64_t start;
+
+	if (!workers)
+		return 1;
+
+	start = monotonic_usec();
+
+	int started = 0;
+	for (; started < threads; started++) {
+		if (pthread_create(&workers[started], NULL, build_worker, job))
+			break;
+	}
+
+	for (int i = 0; i < started; i++)
+		pthread_join(workers[i], NULL);
+	free(workers);
+
+	if (!started || job->failed) {
+		fprintf(stderr, "failed to search every game\n");
+		return 1;
+	}
+
+	double sec = monotonic_elapsed_sec(start);
+	if (opening_book_write(path, job->entries, job->nr, BOARD_WIDTH, BOARD_HEIGHT,
+			job->search->depth, job->search->beam)) {
+		perror(path);
+		return 1;
+	}
+
+	// positions that came up in several games are only written once
+	struct opening_book book;
+	if (opening_book_open(&book, path)) {
+		fprintf(stderr, "%s: failed to read back the book\n", path);
+		return 1;
+	}
+
+	printf("Searched %zu positions in %lu games (%.1f s), wrote %llu to %s.\n",
+			job->nr, job->games, sec, (unsigned long long)book.header->count, path);
+	opening_book_close(&book);
+
+	return 0;
+}
+
+static void play_games(const struct opening_book *book, unsigned long games, int pieces,
+		uint64_t seed, int randomizer, const struct search_options *search, struct play_stats *stats)
+{
+	struct tetris_game game;
+	uint64_t start;
+
+	for (unsigned long i = 0; i < games; i++) {
+		tetris_game_init_randomizer(&game, BOARD_WIDTH, BOARD_HEIGHT, seed + i, randomizer);
+
+		for (int piece = 0; piece < pieces && game.running; piece++) {
+			struct placement placement;
+			int found = 0;
+
+			if (book) {
+				start = monotonic_usec();
+				found = !opening_book_lookup(book, &game.well, &placement);
+				stats->lookup_sec += monotonic_elapsed_sec(start);
+			}
+
+			// a placement from the book must still be reachable
+			if (found && !tetris_game_place(&game, &placement)) {
+				stats->hits++;
+				stats->pieces++;
+				continue;
+			}
+
+			start = monotonic_usec();
+			int failed = search_best_placement(&game.well, search, &placement, NULL);
+			stats->search_sec += monotonic_elapsed_sec(start);
+			stats->searches++;
+
+			if (failed || tetris_game_place_trusted(&game, &placement))
+				break;
+			stats->pieces++;
+		}
+
+		stats->lines += (unsigned long long)game.lines;
+		stats->games_over += game.running ? 0 : 1;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+			{ "games", required_argument, NULL, 'g' },
+			{ "pieces", required_argument, NULL, 'p' },
+			{ "depth", required_argument, NULL, 'd' },
+			{ "beam", required_argument, NULL, 'b' },
+			{ "threads", required_argument, NULL, 't' },
+			{ "seed", required_argument, NULL, 's' },
+			{ "randomizer", required_argument, NULL, 'R' },
+			{ "help", no_argument, NULL, 'h' },
+			{ NULL, 0, NULL, 0 }
+	};
+
+	struct search_options search;
+	long games = 0, pieces = 0;
+	int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	int randomizer = RANDOMIZER_BAG;
+	uint64_t seed = 1;
+	long value;
+
+	search_options_init(&search);
+
+	if (argc == 2 && (!strcmp(argv[1], "--help") || !strcmp(argv[1], "-h"))) {
+		print_usage(stdout, argv[0]);
+		return 0;
+	}
+
+	if (argc < 2 || (strcmp(argv[1], "build") != 0 && strcmp(argv[1], "play") != 0)) {
+		print_usage(stderr, argv[0]);
+		return 1;
+	}
+
+	// parse the options after the command as if it were the program
+	const char *prog = argv[0];
+	int build = !strcmp(argv[1], "build");
+	argv++;
+	argc--;
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+		switch (opt) {
+			case 'g':
+				if (parse_int(optarg, 0, LONG_MAX, &value)) {
+					fprintf(stderr, "invalid number of games '%s'\n", optarg);
+					return 1;
+				}
+				games = value;
+				break;
+			case 'p':
+				if (parse_int(optarg, 0, 1000000, &value)) {
+					fprintf(stderr, "invalid number of pieces '%s'\n", optarg);
+					return 1;
+				}
+				pieces = value;
+				break;
+			case 'd':
+				if (parse_int(optarg, 1, SEARCH_MAX_DEPTH, &value)) {
+					fprintf(stderr, "invalid search depth '%s'\n", optarg);
+					return 1;
+				}
+				search.depth = (int)value;
+				break;
+			case 'b':
+				if (parse_int(optarg, 1, SEARCH_MAX_BEAM, &value)) {
+					fprintf(stderr, "invalid search beam '%s'\n", optarg);
+					return 1;
+				}
+				search.beam = (int)value;
+				break;
+			case 't':
+				if (parse_int(optarg, 1, TOOL_MAX_THREADS, &value)) {
+					fprintf(stderr, "invalid number of threads '%s'\n", optarg);
+					return 1;
+				}
+				threads = (int)value;
+				break;
+			case 's':
+				if (parse_u64(optarg, &seed)) {
+					fprintf(stderr, "invalid seed '%s'\n", optarg);
+					return 1;
+				}
+				break;
+			case 'R':
+				if ((randomizer = randomizer_parse(optarg)) < 0) {
+					fprintf(stderr, "unknown randomizer '%s'\n", optarg);
+					return 1;
+				}
+				break;
+			case 'h':
+				print_usage(stdout, prog);
+				return 0;
+			default:
+				print_usage(stderr, prog);
+				return 1;
+		}
+	}
+
+	if (search.depth < 1 || search.depth > SEARCH_MAX_DEPTH || search.beam < 1 || search.beam > SEARCH_MAX_BEAM) {
+		fprintf(stderr, "depth must be between 1 and %d, and beam between 1 and %d\n",
+				SEARCH_MAX_DEPTH, SEARCH_MAX_BEAM);
+		return 1;
+	}
+
+	if (build) {
+		struct build_job job;
+
+		if (argc - optind != 1) {
+			print_usage(stderr, prog);
+			return 1;
+		}
+
+		memset(&job, 0, sizeof(job));
+		pthread_mutex_init(&job.lock, NULL);
+		job.games = games ? (unsigned long)games : BOOK_DEFAULT_GAMES;
+		job.pieces = pieces ? (int)pieces : BOOK_DEFAULT_PIECES;
+		job.randomizer = randomizer;
+		job.seed = seed;
+		job.search = &search;
+
+		int ret = build_book(argv[optind], &job, threads > 0 ? threads : 1);
+		pthread_mutex_destroy(&job.lock);
+		free(job.entries);
+		return ret;
+	}
+
+	struct opening_book book;
+	struct play_stats stats;
+
+	if (argc - optind > 1) {
+		print_usage(stderr, prog);
+		return 1;
+	}
+
+	if (argc - optind == 1 && opening_book_open(&book, argv[optind])) {
+		fprintf(stderr, "%s: not an opening book\n", argv[optind]);
+		return 1;
+	}
+
+	memset(&stats, 0, sizeof(stats));
+	play_games(argc - optind == 1 ? &book : NULL, games ? (unsigned long)games : PLAY_DEFAULT_GAMES,
+			pieces ? (int)pieces : PLAY_DEFAULT_PIECES, seed, randomizer, &search, &stats);
+
+	printf("Placed %lu tetriminos, cleared %llu lines, %lu games over.\n",
+			stats.pieces, stats.lines, stats.games_over);
+	printf("%lu from the book (%.0f ns per lookup), %lu searched (%.0f us per search), %.2f s searching.\n",
+			stats.hits, stats.pieces ? stats.lookup_sec * 1e9 / (double)(stats.hits + stats.searches) : 0,
+			stats.searches, stats.searches ? stats.search_sec * 1e6 / (double)stats.searches : 0,
+			stats.search_sec);
+
+	if (argc - optind == 1)
+		opening_book_close(&book);
+
+	return 0;
+}
@@ -0,0 +1,287 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+
+#include "replay-stats.h"
+#include "monotonic-clock.h"
+#include "tool-options.h"
+
+/*
+ * tetris-heatmap:
+ * Play back any number of replays and summarize how their tetriminos were
+ * placed (see replay-stats.h): how often each cell is covered by a lock, how
+ * often each type of tetrimino creates holes and where it goes, and how many
+ * lines locks clear at each level.
+ *
+ * Replays are spread across threads, each mapping its own files and
+ * counting into its own statistics, which are only added up once every
+ * thread is done.
+ * */
+
+struct heatmap_job {
+	char **paths;
+	size_t paths_nr;
+	size_t next;
+};
+
+struct heatmap_worker {
+	pthread_t thread;
+	struct heatmap_job *job;
+	struct replay_stats stats;
+};
+
+static void print_usage(FILE *stream, const char *prog)
+{
+	fprintf(stream, "usage: %s [options] <replay>...\n", prog);
+	fprintf(stream, "   or: %s [options] --list <file>\n", prog);
+	fprintf(stream, "\n");
+	fprintf(stream, "    --list <file>   read the paths of the replays from a file, one per line, or '-' for\n");
+	fprintf(stream, "                    standard input\n");
+	fprintf(stream, "    --threads <n>   number of threads (default: one per core)\n");
+}
+
+static double percent(uint64_t count, uint64_t total)
+{
+	return total ? 100.0 * (double)count / (double)total : 0;
+}
+
+/*
+ * Read the paths listed in the given file. Returns the number of paths, or
+ * zero if the file could not be read.
+ * */
+static size_t read_list(const char *list, char ***paths)
+{
+	FILE *in = strcmp(list, "-") ? fopen(list, "r") : stdin;
+	char *line = NULL;
+	size_t line_alloc = 0, count = 0, alloc = 0;
+	ssize_t len;
+
+	*paths = NULL;
+	if (!in) {
+		perror(list);
+		return 0;
+	}
+
+	while ((len = getline(&line, &line_alloc, in)) > 0) {
+		if (line[len - 1] == '\n')
+			line[--len] = '\0';
+		if (!len)
+			continue;
+
+		if (count == alloc) {
+			alloc = alloc ? alloc * 2 : 1024;
+			char **grown = realloc(*paths, alloc * sizeof(*grown));
+			if (!grown)
+				break;
+			*paths = grown;
+		}
+
+		if (!((*paths)[count] = strdup(line)))
+			break;
+		count++;
+	}
+
+	free(line);
+	if (in != stdin)
+		fclose(in);
+
+	return count;
+}
+
+static void *heatmap_worker(void *data)
+{
+	struct heatmap_worker *worker = data;
+	struct heatmap_job *job = worker->job;
+
+	while (1) {
+		size_t index = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+		if (index >= job->paths_nr)
+			break;
+
+		replay_stats_add_file(&worker->stats, job->paths[index]);
+	}
+
+	return NULL;
+}
+
+/*
+ * The share of locks covering each cell, from the highest row any lock
+ * reached down to the floor.
+ * */
+static void print_cells(const struct replay_stats *stats, size_t width)
+{
+	size_t top = 0;
+
+	for (size_t y = 0; y < BOARD_MAX_HEIGHT; y++) {
+		for (size_t x = 0; x < width; x++) {
+			if (stats->cells[y][x])
+				top = y + 1;
+		}
+	}
+
+	printf("\nCells covered, %% of locks (rows from the floor):\n");
+	printf(" row");
+	for (size_t x = 0; x < width; x++)
+		printf(" %5zu", x);
+	printf("\n");
+
+	for (size_t y = top; y-- > 0;) {
+		printf("%4zu", y);
+		for (size_t x = 0; x < width; x++)
+			printf(" %5.1f", percent(stats->cells[y][x], stats->pieces));
+		printf("\n");
+	}
+}
+
+static void print_pieces(const struct replay_stats *stats, size_t width)
+{
+	printf("\nTetriminos: share of locks, holes created per lock, %% of locks creating holes,\n");
+	printf("and %% of locks by leftmost column:\n");
+	printf("piece  share holes  holey");
+	for (size_t x = 0; x < width; x++)
+		printf(" %5zu", x);
+	printf("\n");
+
+	for (size_t type = 0; type < 7; type++) {
+		uint64_t locks = stats->locks[type];
+
+		printf("%5c %5.1f%% %5.2f %5.1f%%", tetrimino_names[type], percent(locks, stats->pieces),
+				locks ? (double)stats->holes[type] / (double)locks : 0, percent(stats->hole_locks[type], locks));
+		for (size_t x = 0; x < width; x++)
+			printf(" %5.1f", percent(stats->columns[type][x], locks));
+		printf("\n");
+	}
+}
+
+static void print_clears(const struct replay_stats *stats)
+{
+	printf("\nLine clears by level, %% of locks:\n");
+	printf("level      locks   none single double triple tetris lines/lock\n");
+
+	for (size_t level = 0; level < REPLAY_STATS_LEVELS; level++) {
+		uint64_t locks = 0, lines = 0;
+		for (size_t n = 0; n < 5; n++) {
+			locks += stats->clears[level][n];
+			lines += n * stats->clears[level][n];
+		}
+		if (!locks)
+			continue;
+
+		printf("%4zu%s %10llu", level, level == REPLAY_STATS_LEVELS - 1 ? "+" : " ", (unsigned long long)locks);
+		for (size_t n = 0; n < 5; n++)
+			printf(" %6.1f", percent(stats->clears[level][n], locks));
+		printf(" %10.3f\n", (double)lines / (double)locks);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+			{ "list", required_argument, NULL, 'l' },
+			{ "threads", required_argument, NULL, 't' },
+			{ "help", no_argument, NULL, 'h' },
+			{ NULL, 0, NULL, 0 }
+	};
+
+	struct heatmap_job job;
+	const char *list = NULL;
+	int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	uint64_t start;
+	long value;
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+		switch (opt) {
+			case 'l':
+				list = optarg;
+				break;
+			case 't':
+				if (parse_int(optarg, 1, TOOL_MAX_THREADS, &value)) {
+					fprintf(stderr, "invalid number of threads '%s'\n", optarg);
+					return 1;
+				}
+				threads = (int)value;
+				break;
+			case 'h':
+				print_usage(stdout, argv[0]);
+				return 0;
+			default:
+				print_usage(stderr, argv[0]);
+				return 1;
+		}
+	}
+
+	if (list ? optind != argc : optind == argc) {
+		print_usage(stderr, argv[0]);
+		return 1;
+	}
+
+	memset(&job, 0, sizeof(job));
+	if (list) {
+		if (!(job.paths_nr = read_list(list, &job.paths))) {
+			fprintf(stderr, "%s: no replays listed\n", list);
+			return 1;
+		}
+	} else {
+		job.paths = argv + optind;
+		job.paths_nr = (size_t)(argc - optind);
+	}
+
+	threads = threads > 0 ? threads : 1;
+	struct heatmap_worker *workers = calloc((size_t)threads, sizeof(*workers));
+	struct replay_stats *total = malloc(sizeof(*total));
+	if (!workers || !total)
+		return 1;
+
+	start = monotonic_usec();
+
+	int started = 0;
+	for (; started < threads; started++) {
+		workers[started].job = &job;
+		replay_stats_init(&workers[started].stats);
+		if (pthread_create(&workers[started].thread, NULL, heatmap_worker, &workers[started]))
+			break;
+	}
+
+	// the reduction: add up the statistics of every thread
+	replay_stats_init(total);
+	for (int i = 0; i < started; i++) {
+		pthread_join(workers[i].thread, NULL);
+		replay_stats_merge(total, &workers[i].stats);
+	}
+	double sec = monotonic_elapsed_sec(start);
+
+	// tables are as wide as the widest column any lock covered
+	size_t width = 0;
+	for (size_t y = 0; y < BOARD_MAX_HEIGHT; y++) {
+		for (size_t x = width; x < BOARD_MAX_WIDTH; x++) {
+			if (total->cells[y][x])
+				width = x + 1;
+		}
+	}
+
+	printf("Played back %llu games (%llu invalid): %llu tetriminos locked over %llu ticks.\n",
+			(unsigned long long)total->games, (unsigned long long)total->invalid,
+			(unsigned long long)total->pieces, (unsigned long long)total->ticks);
+	fprintf(stderr, "Read %.1f MB in %.2f s (%.1f MB/s, %.0f games/s).\n", (double)total->bytes / 1e6, sec,
+			sec > 0 ? (double)total->bytes / 1e6 / sec : 0, sec > 0 ? (double)total->games / sec : 0);
+
+	if (total->pieces) {
+		print_cells(total, width);
+		print_pieces(total, width);
+		print_clears(total);
+	}
+
+	if (list) {
+		for (size_t i = 0; i < job.paths_nr; i++)
+			free(job.paths[i]);
+		free(job.paths);
+	}
+	free(workers);
+	free(total);
+
+	return !started;
+}
@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "perfect-clear.h"
+#include "monotonic-clock.h"
+#include "tool-options.h"
+
+/*
+ * tetris-pc:
+ * Solve perfect clear puzzles (see perfect-clear.h).
+ *
+ * A puzzle file holds one or more puzzles, separated by blank lines. Lines
+ * starting with '#' are comments. A puzzle is:
+ * - a `pieces` line with the tetriminos to place, in order, as letters among
+ *   IOTSZJL.
+ * - an optional `rows` line with the number of rows to clear.
+ * - the board, from its top row down to the bottom of the well, one line per
+ *   row, with '.' for an empty cell and any other character for an occupied
+ *   one, such as 'X'. Every line must have the same width, which is the width
+ *   of the well.
+ *
+ * For example, the rest of a perfect clear opening after an O tetrimino:
+ *
+ *     pieces ILJSZTOIL
+ *     rows 4
+ *     ..........
+ *     ..........
+ *     XX........
+ *     XX........
+ *
+ * The solution is printed as the cells covered by each tetrimino, with rows
+ * counted from the bottom of the well at the time the tetrimino is placed.
+ * */
+
+#define PUZZLE_LINE_MAX 256
+
+struct puzzle {
+	struct perfect_clear_problem problem;
+	char board[PERFECT_CLEAR_MAX_ROWS][BOARD_MAX_WIDTH + 1];
+	size_t board_rows;
+	int line;
+};
+
+static void print_usage(FILE *stream, const char *prog)
+{
+	fprintf(stream, "usage: %s [options] <puzzle file>...\n", prog);
+	fprintf(stream, "\n");
+	fprintf(stream, "    --threads <n>     number of threads (default: one per core)\n");
+	fprintf(stream, "    --all             count every solution, rather than stopping at the first\n");
+	fprintf(stream, "    --memo-bits <n>   the dead end table holds 2^n entries (default 20)\n");
+}
+
+/*
+ * Parse the next puzzle of the file. Returns 1 when there are no more, and -1
+ * (after printing why) if the puzzle is malformed.
+ * */
+static int read_puzzle(FILE *file, const char *path, int *line, struct puzzle *puzzle)
+{
+	char buf[PUZZLE_LINE_MAX];
+	int started = 0;
+
+	memset(puzzle, 0, sizeof(*puzzle));
+	puzzle->problem.height = BOARD_HEIGHT;
+
+	while (fgets(buf, sizeof(buf), file)) {
+		(*line)++;
+		buf[strcspn(buf, "\r\n")] = '\0';
+
+		if (buf[0] == '#')
+			continue;
+
+		if (!buf[0]) {
+			if (started)
+				break;
+			continue;
+		}
+
+		if (!started) {
+			started = 1;
+			puzzle->line = *line;
+		}
+
+		if (!strncmp(buf, "pieces ", 7)) {
+			for (const char *c = buf + 7; *c; c++) {
+				const char *letter = strchr(tetrimino_names, *c);
+				if (*c == ' ')
+					continue;
+				if (!letter || puzzle->problem.pieces_nr == PERFECT_CLEAR_MAX_PIECES) {
+					fprintf(stderr, "%s:%d: expected at most %d tetriminos among %s\n",
+							path, *line, PERFECT_CLEAR_MAX_PIECES, tetrimino_names);
+					return -1;
+				}
+				puzzle->problem.pieces[puzzle->problem.pieces_nr++] = (uint8_t)(letter - tetrimino_names);
+			}
+		} else if (!strncmp(buf, "rows ", 5)) {
+			long rows;
+			if (parse_int(buf + 5, 0, PERFECT_CLEAR_MAX_ROWS, &rows)) {
+				fprintf(stderr, "%s:%d: expected at most %d rows to clear\n", path, *line, PERFECT_CLEAR_MAX_ROWS);
+				return -1;
+			}
+			puzzle->problem.clear_rows = (int)rows;
+		} else {
+			size_t width = strlen(buf);
+			if (width < BOARD_MIN_WIDTH || width > BOARD_MAX_WIDTH ||
+					(puzzle->board_rows && width != puzzle->problem.width)) {
+				fprintf(stderr, "%s:%d: expected rows of the same width, between %d and %d\n",
+						path, *line, BOARD_MIN_WIDTH, BOARD_MAX_WIDTH);
+				return -1;
+			}
+
+			// only the bottom rows are kept; anything above them must be empty
+			if (puzzle->board_rows == PERFECT_CLEAR_MAX_ROWS) {
+				if (strspn(puzzle->board[0], ".") != puzzle->problem.width) {
+					fprintf(stderr, "%s:%d: expected at most %d rows under the top empty row\n",
+							path, *line, PERFECT_CLEAR_MAX_ROWS);
+					return -1;
+				}
+				memmove(puzzle->board[0], puzzle->board[1], sizeof(puzzle->board[0]) * (PERFECT_CLEAR_MAX_ROWS - 1));
+				puzzle->board_rows--;
+			}
+
+			puzzle->problem.width = width;
+			memcpy(puzzle->board[puzzle->board_rows++], buf, width + 1);
+		}
+	}
+
+	if (!started)
+		return 1;
+
+	if (!puzzle->board_rows || !puzzle->problem.pieces_nr) {
+		fprintf(stderr, "%s:%d: expected a board and a pieces line\n", path, puzzle->line);
+		return -1;
+	}
+
+	for (size_t i = 0; i < puzzle->board_rows; i++) {
+		const char *row = puzzle->board[puzzle->board_rows - 1 - i];
+		for (size_t j = 0; j < puzzle->problem.width; j++) {
+			if (row[j] != '.')
+				puzzle->problem.rows[i] |= (uint16_t)(1u << j);
+		}
+	}
+
+	return 0;
+}
+
+static void print_solution(const struct perfect_clear_problem *problem, const struct perfect_clear_solution *solution)
+{
+	for (size_t i = 0; i < solution->nr; i++) {
+		printf("  %c", tetrimino_names[problem->pieces[i]]);
+		for (size_t j = 0; j < 4; j++) {
+			printf(" (%u,%zu)", (unsigned)solution->placements[i].coords[j][0],
+					problem->height - 1 - solution->placements[i].coords[j][1]);
+		}
+		printf("\n");
+	}
+}
+
+static int solve_file(const char *path, const struct perfect_clear_options *options)
+{
+	struct perfect_clear_result result;
+	struct puzzle puzzle;
+	uint64_t start;
+	int line = 0, ret = 0, status;
+
+	FILE *file = fopen(path, "r");
+	if (!file) {
+		perror(path);
+		return 1;
+	}
+
+	while ((status = read_puzzle(file, path, &line, &puzzle)) != 1) {
+		if (status < 0) {
+			ret = 1;
+			break;
+		}
+
+		start = monotonic_usec();
+		if (perfect_clear_solve(&puzzle.problem, options, &result)) {
+			fprintf(stderr, "%s:%d: the board can't be cleared with these tetriminos\n", path, puzzle.line);
+			ret = 1;
+			continue;
+		}
+
+		printf("%s:%d: %lu solution%s clearing %d rows, %llu boards searched in %.3f s\n",
+				path, puzzle.line, result.solutions, result.solutions == 1 ? "" : "s",
+				result.clear_rows, result.nodes, monotonic_elapsed_sec(start));
+		if (result.solutions)
+			print_solution(&puzzle.problem, &result.first);
+	}
+
+	fclose(file);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+			{ "threads", required_argument, NULL, 't' },
+			{ "all", no_argument, NULL, 'a' },
+			{ "memo-bits", required_argument, NULL, 'm' },
+			{ "help", no_argument, NULL, 'h' },
+			{ NULL, 0, NULL, 0 }
+	};
+
+	struct perfect_clear_options options;
+	int ret = 0;
+	long value;
+
+	perfect_clear_options_init(&options);
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+		switch (opt) {
+			case 't':
+				if (parse_int(optarg, 1, TOOL_MAX_THREADS, &value)) {
+					fprintf(stderr, "invalid number of threads '%s'\n", optarg);
+					return 1;
+				}
+				options.threads = (int)value;
+				break;
+			case 'a':
+				options.max_solutions = 0;
+				break;
+			case 'm':
+				if (parse_int(optarg, 1, 30, &value)) {
+					fprintf(stderr, "invalid memo size '%s'\n", optarg);
+					return 1;
+				}
+				options.memo_bits = (int)value;
+				break;
+			case 'h':
+				print_usage(stdout, argv[0]);
+				return 0;
+			default:
+				print_usage(stderr, argv[0]);
+				return 1;
+		}
+	}
+
+	if (optind == argc) {
+		print_usage(stderr, argv[0]);
+		return 1;
+	}
+
+	for (int i = optind; i < argc; i++)
+		ret |= solve_file(argv[i], &options);
+
+	return ret;
+}
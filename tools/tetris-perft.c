@@ -0,0 +1,458 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+
+#include "tetris-well.h"
+#include "placement.h"
+#include "monotonic-clock.h"
+#include "tool-options.h"
+
+/*
+ * tetris-perft:
+ * Count the boards reachable by placing tetriminos, to a given depth.
+ *
+ * Like perft in chess engines, this is both a correctness check and a
+ * throughput benchmark for the well operations. The seed fixes the sequence
+ * of tetriminos, so for a given seed, well size and depth the counts must
+ * never change; if an optimization of tetrimino_shift(), tetrimino_rotate() or
+ * tetris_well_commit_tetrimino() changes them, it is broken.
+ *
+ * By default, every path through the tree is counted, so the same board is
+ * counted once for each order of placements that produces it. With --unique,
+ * the tree is explored one depth at a time and boards (compared by which cells
+ * are occupied) are only counted, and expanded, once.
+ *
+ * The work is split across threads at the root: each thread takes the next
+ * unexplored root placement (or, with --unique, the next board of the current
+ * depth) until there are none left.
+ * */
+
+#define PERFT_MAX_DEPTH 16
+#define PERFT_DEFAULT_SEED 1
+
+/*
+ * Boards are stored for deduplication as one bitmask of occupied cells per
+ * row. Rebuilt boards use this cell type for every occupied cell.
+ * */
+#define PERFT_CELL CELL_TYPE_I
+
+struct board_list {
+	uint16_t *rows;
+	size_t nr;
+	size_t alloc;
+};
+
+struct board_set {
+	struct board_list boards;
+	size_t *table;
+	size_t table_size;
+};
+
+struct perft_job {
+	pthread_mutex_t lock;
+	size_t next;
+	int depth;
+	size_t height;
+
+	/* the well before the root tetrimino spawns, and its root placements */
+	struct tetris_well root;
+	struct placement *roots;
+	size_t roots_nr;
+
+	/* with --unique, the boards being expanded at the current depth */
+	const struct board_list *frontier;
+};
+
+struct perft_worker {
+	pthread_t thread;
+	struct perft_job *job;
+	unsigned long long nodes[PERFT_MAX_DEPTH + 1];
+	struct placement *placements;
+	struct board_list children;
+};
+
+static void print_usage(FILE *stream, const char *prog)
+{
+	fprintf(stream, "usage: %s [--seed <n>] [--width <n>] [--height <n>] [--unique] [--jobs <n>] <depth>\n", prog);
+	fprintf(stream, "\n");
+	fprintf(stream, "    --seed <n>      seed for the tetrimino sequence (default %d)\n", PERFT_DEFAULT_SEED);
+	fprintf(stream, "    --width <n>     width of the well (default %d)\n", BOARD_WIDTH);
+	fprintf(stream, "    --height <n>    height of the well (default %d)\n", BOARD_HEIGHT);
+	fprintf(stream, "    --unique        count each distinct board only once\n");
+	fprintf(stream, "    --jobs <n>      number of threads (default: one per core)\n");
+}
+
+static void *xrealloc(void *ptr, size_t size)
+{
+	void *ret = realloc(ptr, size);
+	if (!ret) {
+		perror("realloc");
+		exit(1);
+	}
+
+	return ret;
+}
+
+/*
+ * Hand out the next unit of work (a root placement or a frontier board),
+ * returning non-zero if there is none left.
+ * */
+static int next_work(struct perft_job *job, size_t limit, size_t *index)
+{
+	pthread_mutex_lock(&job->lock);
+	*index = job->next;
+	if (job->next < limit)
+		job->next++;
+	pthread_mutex_unlock(&job->lock);
+
+	return *index >= limit;
+}
+
+static void perft(struct perft_worker *worker, struct tetris_well *well, int ply)
+{
+	worker->nodes[ply]++;
+	if (ply == worker->job->depth)
+		return;
+
+	struct placement *placements = worker->placements + (size_t)ply * PLACEMENTS_MAX;
+	struct tetris_well next;
+
+	tetrimino_new(well);
+	size_t count = tetrimino_placements(well, placements);
+	for (size_t i = 0; i < count; i++) {
+		next = *well;
+		tetrimino_place(&next, &placements[i]);
+		tetris_well_commit_tetrimino(&next);
+		perft(worker, &next, ply + 1);
+	}
+}
+
+static void *perft_worker_run(void *data)
+{
+	struct perft_worker *worker = data;
+	struct perft_job *job = worker->job;
+	struct tetris_well well;
+	size_t index;
+
+	while (!next_work(job, job->roots_nr, &index)) {
+		well = job->root;
+		tetrimino_place(&well, &job->roots[index]);
+		tetris_well_commit_tetrimino(&well);
+		perft(worker, &well, 1);
+	}
+
+	return NULL;
+}
+
+static void board_list_append(struct board_list *list, struct tetris_well *well)
+{
+	if (list->nr == list->alloc) {
+		list->alloc = list->alloc ? list->alloc * 2 : 1024;
+		list->rows = xrealloc(list->rows, sizeof(uint16_t) * well->height * list->alloc);
+	}
+
+	uint16_t *rows = list->rows + list->nr++ * well->height;
+	for (size_t i = 0; i < well->height; i++) {
+		rows[i] = 0;
+		for (size_t j = 0; j < well->width; j++) {
+			if (well->matrix[i][j] != CELL_TYPE_NONE)
+				rows[i] |= (uint16_t)(1u << j);
+		}
+	}
+}
+
+static void board_load(struct tetris_well *well, const uint16_t *rows)
+{
+	for (size_t i = 0; i < well->height; i++) {
+		for (size_t j = 0; j < well->width; j++)
+			well->matrix[i][j] = (rows[i] >> j) & 1u ? PERFT_CELL : CELL_TYPE_NONE;
+	}
+}
+
+static size_t board_hash(const uint16_t *rows, size_t height)
+{
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	for (size_t i = 0; i < height; i++) {
+		hash ^= rows[i];
+		hash *= 0x100000001B3ULL;
+	}
+
+	return (size_t)(hash ^ (hash >> 32));
+}
+
+/*
+ * Add a board to the set if it isn't already there. The table holds the index
+ * of each board plus one, with zero marking an empty slot, and is kept at most
+ * half full.
+ * */
+static void board_set_insert(struct board_set *set, const uint16_t *rows, size_t height)
+{
+	if ((set->boards.nr + 1) * 2 > set->table_size) {
+		size_t table_size = set->table_size ? set->table_size * 2 : 4096;
+		size_t *table = calloc(table_size, sizeof(size_t));
+		if (!table) {
+			perror("calloc");
+			exit(1);
+		}
+
+		for (size_t i = 0; i < set->boards.nr; i++) {
+			size_t slot = board_hash(set->boards.rows + i * height, height) & (table_size - 1);
+			while (table[slot])
+				slot = (slot + 1) & (table_size - 1);
+			table[slot] = i + 1;
+		}
+
+		free(set->table);
+		set->table = table;
+		set->table_size = table_size;
+	}
+
+	size_t slot = board_hash(rows, height) & (set->table_size - 1);
+	while (set->table[slot]) {
+		if (!memcmp(set->boards.rows + (set->table[slot] - 1) * height, rows, sizeof(uint16_t) * height))
+			return;
+		slot = (slot + 1) & (set->table_size - 1);
+	}
+
+	struct board_list *boards = &set->boards;
+	if (boards->nr == boards->alloc) {
+		boards->alloc = boards->alloc ? boards->alloc * 2 : 1024;
+		boards->rows = xrealloc(boards->rows, sizeof(uint16_t) * height * boards->alloc);
+	}
+
+	memcpy(boards->rows + boards->nr * height, rows, sizeof(uint16_t) * height);
+	set->table[slot] = ++boards->nr;
+}
+
+static void *unique_worker_run(void *data)
+{
+	struct perft_worker *worker = data;
+	struct perft_job *job = worker->job;
+	struct tetris_well well, next;
+	size_t index;
+
+	while (!next_work(job, job->frontier->nr, &index)) {
+		well = job->root;
+		board_load(&well, job->frontier->rows + index * job->height);
+
+		tetrimino_new(&well);
+		size_t count = tetrimino_placements(&well, worker->placements);
+		for (size_t i = 0; i < count; i++) {
+			next = well;
+			tetrimino_place(&next, &worker->placements[i]);
+			tetris_well_commit_tetrimino(&next);
+			board_list_append(&worker->children, &next);
+		}
+	}
+
+	return NULL;
+}
+
+static int run_workers(struct perft_worker *workers, int jobs, void *(*fn)(void *))
+{
+	for (int i = 0; i < jobs; i++) {
+		if (pthread_create(&workers[i].thread, NULL, fn, &workers[i])) {
+			fprintf(stderr, "failed to start worker thread\n");
+			return 1;
+		}
+	}
+
+	for (int i = 0; i < jobs; i++)
+		pthread_join(workers[i].thread, NULL);
+
+	return 0;
+}
+
+static int perft_all(struct perft_job *job, struct perft_worker *workers, int jobs,
+		unsigned long long nodes[PERFT_MAX_DEPTH + 1])
+{
+	struct tetris_well well = job->root;
+
+	tetrimino_new(&well);
+	job->roots_nr = tetrimino_placements(&well, job->roots);
+	job->root = well;
+
+	if (run_workers(workers, jobs, perft_worker_run))
+		return 1;
+
+	for (int i = 0; i < jobs; i++) {
+		for (int d = 1; d <= job->depth; d++)
+			nodes[d] += workers[i].nodes[d];
+	}
+
+	return 0;
+}
+
+static int perft_unique(struct perft_job *job, struct perft_worker *workers, int jobs,
+		unsigned long long nodes[PERFT_MAX_DEPTH + 1])
+{
+	struct board_set set;
+	struct board_list frontier = { NULL, 0, 0 };
+	int ret = 0;
+
+	// the empty well is the only board at the root
+	board_list_append(&frontier, &job->root);
+
+	for (int d = 1; d <= job->depth; d++) {
+		job->frontier = &frontier;
+		job->next = 0;
+
+		if (run_workers(workers, jobs, unique_worker_run)) {
+			ret = 1;
+			break;
+		}
+
+		memset(&set, 0, sizeof(set));
+		for (int i = 0; i < jobs; i++) {
+			struct board_list *children = &workers[i].children;
+			for (size_t j = 0; j < children->nr; j++)
+				board_set_insert(&set, children->rows + j * job->height, job->height);
+			children->nr = 0;
+		}
+
+		free(frontier.rows);
+		free(set.table);
+		frontier = set.boards;
+		nodes[d] = frontier.nr;
+
+		// every board at the next depth gets the next tetrimino in the sequence
+		tetrimino_new(&job->root);
+	}
+
+	free(frontier.rows);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+			{ "seed", required_argument, NULL, 's' },
+			{ "width", required_argument, NULL, 'w' },
+			{ "height", required_argument, NULL, 'H' },
+			{ "unique", no_argument, NULL, 'u' },
+			{ "jobs", required_argument, NULL, 'j' },
+			{ "help", no_argument, NULL, 'h' },
+			{ NULL, 0, NULL, 0 }
+	};
+
+	struct perft_job job;
+	unsigned long long nodes[PERFT_MAX_DEPTH + 1] = { 0 };
+	uint64_t seed = PERFT_DEFAULT_SEED;
+	size_t width = BOARD_WIDTH, height = BOARD_HEIGHT;
+	int unique = 0, jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	uint64_t start;
+	long value;
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+		switch (opt) {
+			case 's':
+				if (parse_u64(optarg, &seed)) {
+					fprintf(stderr, "invalid seed '%s'\n", optarg);
+					return 1;
+				}
+				break;
+			case 'w':
+				if (parse_int(optarg, BOARD_MIN_WIDTH, BOARD_MAX_WIDTH, &value)) {
+					fprintf(stderr, "invalid well width '%s'\n", optarg);
+					return 1;
+				}
+				width = (size_t)value;
+				break;
+			case 'H':
+				if (parse_int(optarg, BOARD_MIN_HEIGHT, BOARD_MAX_HEIGHT, &value)) {
+					fprintf(stderr, "invalid well height '%s'\n", optarg);
+					return 1;
+				}
+				height = (size_t)value;
+				break;
+			case 'u':
+				unique = 1;
+				break;
+			case 'j':
+				if (parse_int(optarg, 1, TOOL_MAX_THREADS, &value)) {
+					fprintf(stderr, "invalid number of jobs '%s'\n", optarg);
+					return 1;
+				}
+				jobs = (int)value;
+				break;
+			case 'h':
+				print_usage(stdout, argv[0]);
+				return 0;
+			default:
+				print_usage(stderr, argv[0]);
+				return 1;
+		}
+	}
+
+	if (argc - optind != 1) {
+		print_usage(stderr, argv[0]);
+		return 1;
+	}
+
+	if (parse_int(argv[optind], 1, PERFT_MAX_DEPTH, &value)) {
+		fprintf(stderr, "depth must be between 1 and %d\n", PERFT_MAX_DEPTH);
+		return 1;
+	}
+	int depth = (int)value;
+
+	if (jobs < 1)
+		jobs = 1;
+
+	memset(&job, 0, sizeof(job));
+	if (tetris_well_init_dimensions(&job.root, width, height)) {
+		fprintf(stderr, "well dimensions must be between %dx%d and %dx%d\n",
+				BOARD_MIN_WIDTH, BOARD_MIN_HEIGHT, BOARD_MAX_WIDTH, BOARD_MAX_HEIGHT);
+		return 1;
+	}
+	tetris_well_seed(&job.root, seed);
+
+	pthread_mutex_init(&job.lock, NULL);
+	job.depth = depth;
+	job.height = height;
+	job.roots = malloc(sizeof(struct placement) * PLACEMENTS_MAX);
+
+	struct perft_worker *workers = calloc((size_t)jobs, sizeof(*workers));
+	if (!job.roots || !workers) {
+		perror("malloc");
+		return 1;
+	}
+
+	for (int i = 0; i < jobs; i++) {
+		workers[i].job = &job;
+		workers[i].placements = malloc(sizeof(struct placement) * PLACEMENTS_MAX * (size_t)depth);
+		if (!workers[i].placements) {
+			perror("malloc");
+			return 1;
+		}
+	}
+
+	start = monotonic_usec();
+
+	int ret = unique ? perft_unique(&job, workers, jobs, nodes) : perft_all(&job, workers, jobs, nodes);
+	double sec = monotonic_elapsed_sec(start);
+
+	if (!ret) {
+		unsigned long long total = 0;
+		for (int d = 1; d <= depth; d++) {
+			printf("depth %d: %llu\n", d, nodes[d]);
+			total += nodes[d];
+		}
+
+		printf("%llu %s in %.3fs (%.0f nodes/s, %d threads)\n", total,
+				unique ? "unique boards" : "nodes", sec, sec > 0 ? (double)total / sec : 0, jobs);
+	}
+
+	for (int i = 0; i < jobs; i++) {
+		free(workers[i].placements);
+		free(workers[i].children.rows);
+	}
+	free(workers);
+	free(job.roots);
+	pthread_mutex_destroy(&job.lock);
+
+	return ret;
+}
@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "replay.h"
+#include "asciicast.h"
+#include "monotonic-clock.h"
+#include "tool-options.h"
+
+/*
+ * tetris-record:
+ * Render replays into asciicast v2 files, without a terminal and as fast as
+ * the game logic allows. Frame timestamps are derived from the logic ticks of
+ * the replay, so the recording plays back at the speed of the original game.
+ * */
+
+#define RECORD_DEFAULT_FPS 30
+
+static void print_usage(FILE *stream, const char *prog)
+{
+	fprintf(stream, "usage: %s [--fps <n>] <replay> <asciicast>\n", prog);
+	fprintf(stream, "   or: %s [--fps <n>] --batch <replay>...\n", prog);
+	fprintf(stream, "\n");
+	fprintf(stream, "    --fps <n>       record at most n frames per second, or 0 for every change (default %d)\n",
+			RECORD_DEFAULT_FPS);
+	fprintf(stream, "    --batch         record each replay to a file of the same name with a .cast suffix\n");
+}
+
+static int record_frame(void *data, uint64_t usec, struct tetris_game *game)
+{
+	struct asciicast_recorder *recorder = data;
+
+	return asciicast_recorder_frame(recorder, usec, &game->well, game->level, game->score, game->lines);
+}
+
+static int record(const char *replay_path, const char *cast_path, int fps)
+{
+	struct replay replay;
+	struct tetris_game game;
+	struct asciicast_recorder recorder;
+	uint64_t start;
+	int ret = 1;
+
+	start = monotonic_usec();
+
+	FILE *in = fopen(replay_path, "r");
+	if (!in) {
+		perror(replay_path);
+		return 1;
+	}
+
+	if (replay_read(&replay, in)) {
+		fprintf(stderr, "%s: not a valid replay\n", replay_path);
+		fclose(in);
+		return 1;
+	}
+	fclose(in);
+
+	FILE *out = fopen(cast_path, "w");
+	if (!out) {
+		perror(cast_path);
+		goto release_replay;
+	}
+
+	// frames are small and frequent; buffer generously
+	setvbuf(out, NULL, _IOFBF, 1 << 20);
+
+	if (asciicast_recorder_open(&recorder, out, replay.width, replay.height)) {
+		fprintf(stderr, "%s: failed to start recording\n", cast_path);
+		goto close_out;
+	}
+
+	if (replay_run(&replay, &game, fps, record_frame, &recorder)) {
+		fprintf(stderr, "%s: failed to record replay\n", replay_path);
+		asciicast_recorder_close(&recorder);
+		goto close_out;
+	}
+
+	if (asciicast_recorder_close(&recorder)) {
+		fprintf(stderr, "%s: failed to write recording\n", cast_path);
+		goto close_out;
+	}
+
+	double game_sec = (double)game.ticks * GAME_TICK_USEC / 1e6;
+	double record_sec = monotonic_elapsed_sec(start);
+	fprintf(stderr, "%s: recorded %.1fs of play in %.3fs (%.0fx real time), score %d\n",
+			cast_path, game_sec, record_sec, record_sec > 0 ? game_sec / record_sec : 0, game.score);
+	ret = 0;
+
+close_out:
+	if (fclose(out))
+		ret = 1;
+release_replay:
+	replay_release(&replay);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+			{ "fps", required_argument, NULL, 'f' },
+			{ "batch", no_argument, NULL, 'b' },
+			{ "help", no_argument, NULL, 'h' },
+			{ NULL, 0, NULL, 0 }
+	};
+
+	int fps = RECORD_DEFAULT_FPS, batch = 0;
+	long value;
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+		switch (opt) {
+			case 'f':
+				if (parse_int(optarg, 0, 1000, &value)) {
+					fprintf(stderr, "invalid frame rate '%s'\n", optarg);
+					return 1;
+				}
+				fps = (int)value;
+				break;
+			case 'b':
+				batch = 1;
+				break;
+			case 'h':
+				print_usage(stdout, argv[0]);
+				return 0;
+			default:
+				print_usage(stderr, argv[0]);
+				return 1;
+		}
+	}
+
+	if (!batch) {
+		if (argc - optind != 2) {
+			print_usage(stderr, argv[0]);
+			return 1;
+		}
+
+		return record(argv[optind], argv[optind + 1], fps);
+	}
+
+	int failed = 0;
+	for (int i = optind; i < argc; i++) {
+		size_t len = strlen(argv[i]);
+		char *cast_path = malloc(len + sizeof(".cast"));
+		if (!cast_path) {
+			perror("malloc");
+			return 1;
+		}
+
+		memcpy(cast_path, argv[i], len);
+		memcpy(cast_path + len, ".cast", sizeof(".cast"));
+
+		failed |= record(argv[i], cast_path, fps);
+		free(cast_path);
+	}
+
+	return failed;
+}
@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <float.h>
+#include <getopt.h>
+
+#include "replay.h"
+#include "rollout.h"
+#include "monotonic-clock.h"
+#include "tool-options.h"
+
+/*
+ * tetris-rollout:
+ * Estimate the lines, score and survival to expect from a position, with
+ * Monte Carlo rollouts (see rollout.h).
+ *
+ * The position is taken from a replay, at a given tick or at every new
+ * tetrimino, so that the decisions in a recorded game can be graded: a
+ * placement that lowers the expected outcome compared to the position before
+ * it was a poor one. Without a replay, the empty well of a new game with the
+ * given seed is evaluated, which makes for a throughput benchmark.
+ * */
+
+struct rollout_target {
+	const struct rollout_options *options;
+	unsigned long at;
+	int each_piece;
+	size_t bag_index;
+	uint8_t piece;
+	int found;
+	int failed;
+};
+
+static void print_usage(FILE *stream, const char *prog)
+{
+	fprintf(stream, "usage: %s [options] [--at <tick> | --each-piece] [<replay>]\n", prog);
+	fprintf(stream, "\n");
+	fprintf(stream, "    --policy <name> place tetriminos 'heuristic'ally (default) or at 'random'\n");
+	fprintf(stream, "    --depth <n>     tetriminos placed per rollout (default 10)\n");
+	fprintf(stream, "    --rollouts <n>  most rollouts per position (default 100000)\n");
+	fprintf(stream, "    --min-rollouts <n>\n");
+	fprintf(stream, "                    fewest rollouts per position (default 1000)\n");
+	fprintf(stream, "    --confidence <lines>\n");
+	fprintf(stream, "                    stop once the 95%% interval of the lines is this narrow, or 0\n");
+	fprintf(stream, "                    to always run every rollout (default 0.05)\n");
+	fprintf(stream, "    --threads <n>   number of threads (default: one per core)\n");
+	fprintf(stream, "    --seed <n>      seed for the rollouts, and for the game without a replay\n");
+	fprintf(stream, "    --at <tick>     evaluate the first position of the replay at or after this tick\n");
+	fprintf(stream, "    --each-piece    evaluate the position at every new tetrimino of the replay\n");
+}
+
+static int evaluate(const struct tetris_game *game, const struct rollout_options *options)
+{
+	struct rollout_result result;
+	uint64_t start;
+
+	start = monotonic_usec();
+	if (rollout_evaluate(game, options, &result))
+		return 1;
+	double sec = monotonic_elapsed_sec(start);
+
+	printf("tick %lu piece %c: lines %.3f ± %.3f, score %.1f ± %.1f, survival %.3f ± %.3f (%lu rollouts, %.0f/s)\n",
+			game->ticks, tetrimino_name(game->well.tetrimino_type),
+			result.lines.mean, result.lines.interval,
+			result.score.mean, result.score.interval,
+			result.survival.mean, result.survival.interval,
+			result.rollouts, sec > 0 ? (double)result.rollouts / sec : 0);
+
+	return 0;
+}
+
+static int on_frame(void *data, uint64_t usec, struct tetris_game *game)
+{
+	struct rollout_target *target = data;
+	(void)usec;
+
+	if (target->each_piece) {
+		// a new tetrimino was drawn from the bag
+		if (game->well.tetrimino_bag_index == target->bag_index &&
+				game->well.tetrimino_type == target->piece)
+			return 0;
+
+		target->bag_index = game->well.tetrimino_bag_index;
+		target->piece = game->well.tetrimino_type;
+		if (game->running && evaluate(game, target->options))
+			target->failed = 1;
+
+		return target->failed;
+	}
+
+	if (game->ticks < target->at)
+		return 0;
+
+	target->found = 1;
+	if (evaluate(game, target->options))
+		target->failed = 1;
+
+	// nothing left to do; stop the playback
+	return 1;
+}
+
+static int evaluate_replay(const char *path, struct rollout_target *target)
+{
+	struct replay replay;
+	struct tetris_game game;
+
+	FILE *in = fopen(path, "r");
+	if (!in) {
+		perror(path);
+		return 1;
+	}
+
+	int ret = replay_read(&replay, in);
+	fclose(in);
+	if (ret) {
+		fprintf(stderr, "%s: not a valid replay\n", path);
+		return 1;
+	}
+
+	target->bag_index = (size_t)-1;
+	replay_run(&replay, &game, 0, on_frame, target);
+	replay_release(&replay);
+
+	if (!target->each_piece && !target->found) {
+		fprintf(stderr, "%s: the game ended before tick %lu\n", path, target->at);
+		return 1;
+	}
+
+	if (target->failed) {
+		fprintf(stderr, "%s: failed to run rollouts\n", path);
+		return 1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+			{ "policy", required_argument, NULL, 'p' },
+			{ "depth", required_argument, NULL, 'd' },
+			{ "rollouts", required_argument, NULL, 'n' },
+			{ "min-rollouts", required_argument, NULL, 'm' },
+			{ "confidence", required_argument, NULL, 'c' },
+			{ "threads", required_argument, NULL, 't' },
+			{ "seed", required_argument, NULL, 's' },
+			{ "at", required_argument, NULL, 'a' },
+			{ "each-piece", no_argument, NULL, 'e' },
+			{ "help", no_argument, NULL, 'h' },
+			{ NULL, 0, NULL, 0 }
+	};
+
+	struct rollout_options options;
+	struct rollout_target target;
+	long value;
+
+	rollout_options_init(&options);
+	memset(&target, 0, sizeof(target));
+	target.options = &options;
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+		switch (opt) {
+			case 'p':
+				if (!strcmp(optarg, "heuristic")) {
+					options.policy = ROLLOUT_POLICY_HEURISTIC;
+				} else if (!strcmp(optarg, "random")) {
+					options.policy = ROLLOUT_POLICY_RANDOM;
+				} else {
+					fprintf(stderr, "unknown policy '%s'\n", optarg);
+					return 1;
+				}
+				break;
+			case 'd':
+				if (parse_int(optarg, 1, INT_MAX, &value)) {
+					fprintf(stderr, "invalid depth '%s'\n", optarg);
+					return 1;
+				}
+				options.depth = (int)value;
+				break;
+			case 'n':
+				if (parse_int(optarg, 1, LONG_MAX, &value)) {
+					fprintf(stderr, "invalid number of rollouts '%s'\n", optarg);
+					return 1;
+				}
+				options.max_rollouts = (unsigned long)value;
+				break;
+			case 'm':
+				if (parse_int(optarg, 0, LONG_MAX, &value)) {
+					fprintf(stderr, "invalid number of rollouts '%s'\n", optarg);
+					return 1;
+				}
+				options.min_rollouts = (unsigned long)value;
+				break;
+			case 'c':
+				if (parse_double(optarg, 0, DBL_MAX, &options.confidence)) {
+					fprintf(stderr, "invalid confidence '%s'\n", optarg);
+					return 1;
+				}
+				break;
+			case 't':
+				if (parse_int(optarg, 1, TOOL_MAX_THREADS, &value)) {
+					fprintf(stderr, "invalid number of threads '%s'\n", optarg);
+					return 1;
+				}
+				options.threads = (int)value;
+				break;
+			case 's':
+				if (parse_u64(optarg, &options.seed)) {
+					fprintf(stderr, "invalid seed '%s'\n", optarg);
+					return 1;
+				}
+				break;
+			case 'a':
+				if (parse_int(optarg, 0, LONG_MAX, &value)) {
+					fprintf(stderr, "invalid tick '%s'\n", optarg);
+					return 1;
+				}
+				target.at = (unsigned long)value;
+				break;
+			case 'e':
+				target.each_piece = 1;
+				break;
+			case 'h':
+				print_usage(stdout, argv[0]);
+				return 0;
+			default:
+				print_usage(stderr, argv[0]);
+				return 1;
+		}
+	}
+
+	if (options.depth < 1 || !options.max_rollouts) {
+		fprintf(stderr, "depth and rollouts must be positive\n");
+		return 1;
+	}
+
+	if (argc - optind == 1)
+		return evaluate_replay(argv[optind], &target);
+
+	if (argc - optind != 0) {
+		print_usage(stderr, argv[0]);
+		return 1;
+	}
+
+	struct tetris_game game;
+	tetris_game_init(&game, BOARD_WIDTH, BOARD_HEIGHT, options.seed);
+	if (evaluate(&game, &options)) {
+		fprintf(stderr, "failed to run rollouts\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,396 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+
+#include "tetris-game.h"
+#include "evaluator.h"
+#include "search.h"
+#include "randomizer.h"
+#include "training-data.h"
+#include "well-metrics.h"
+#include "monotonic-clock.h"
+#include "tool-options.h"
+
+/*
+ * tetris-selfplay:
+ * Play games headlessly with a bot policy, as fast as the game logic allows,
+ * and report how they went.
+ *
+ * With --export, every decision is written out as a training record (see
+ * training-data.h): the position, every reachable placement, the one the
+ * policy chose, and the points and lines it earned. Game i is played with
+ * seed + i, and games are spread across threads, each with its own stream of
+ * records.
+ * */
+
+#define SELFPLAY_DEFAULT_GAMES 100
+#define SELFPLAY_DEFAULT_PIECES 1000
+
+#define POLICY_HEURISTIC 0
+#define POLICY_RANDOM 1
+#define POLICY_SEARCH 2
+
+struct selfplay_job {
+	pthread_mutex_t lock;
+	unsigned long next;
+	unsigned long games;
+	unsigned long pieces;
+	int policy;
+	int randomizer;
+	uint64_t seed;
+	const struct search_options *search;
+	struct training_writer *writer;
+	int failed;
+
+	unsigned long long placed;
+	unsigned long long lines;
+	unsigned long games_over;
+};
+
+static void print_usage(FILE *stream, const char *prog)
+{
+	fprintf(stream, "usage: %s [options]\n", prog);
+	fprintf(stream, "\n");
+	fprintf(stream, "    --games <n>     number of games (default %d)\n", SELFPLAY_DEFAULT_GAMES);
+	fprintf(stream, "    --pieces <n>    most tetriminos placed per game (default %d)\n", SELFPLAY_DEFAULT_PIECES);
+	fprintf(stream, "    --policy <name> place tetriminos 'heuristic'ally (default), at 'random', or with a\n");
+	fprintf(stream, "                    'search' of the queued tetriminos\n");
+	fprintf(stream, "    --depth <n>     tetriminos the search looks ahead, at most %d (default 4)\n", SEARCH_MAX_DEPTH);
+	fprintf(stream, "    --beam <n>      placements the search expands at each level, at most %d (default 4)\n",
+			SEARCH_MAX_BEAM);
+	fprintf(stream, "    --threads <n>   number of threads (default: one per core)\n");
+	fprintf(stream, "    --seed <n>      seed of the first game (default 1)\n");
+	fprintf(stream, "    --randomizer <name>\n");
+	fprintf(stream, "                    randomizer of every game (default 'bag')\n");
+	fprintf(stream, "    --export <file> write every decision to a training data file\n");
+	fprintf(stream, "    --candidates <n>\n");
+	fprintf(stream, "                    most candidate placements exported per position (default 64)\n");
+	fprintf(stream, "    --queue <n>     tetriminos exported per position, the current one included (default 8)\n");
+	fprintf(stream, "    --chunk <n>     records per chunk of the file (default 4096)\n");
+	fprintf(stream, "    --no-writer-thread\n");
+	fprintf(stream, "                    write chunks from the playing threads rather than a writer thread\n");
+	fprintf(stream, "    --metrics-file <file>\n");
+	fprintf(stream, "                    write counts of well operations to a file once done\n");
+}
+
+/*
+ * The index of the placement the policy picks, or `count` if it found none.
+ * */
+static size_t choose(const struct selfplay_job *job, const struct tetris_game *game,
+		const struct placement *placements, size_t count, uint64_t *random)
+{
+	struct placement best;
+
+	switch (job->policy) {
+		case POLICY_RANDOM:
+			return (size_t)((randomizer_next(random) >> 32) % count);
+		case POLICY_SEARCH:
+			if (search_best_placement(&game->well, job->search, &best, NULL))
+				return count;
+
+			for (size_t i = 0; i < count; i++) {
+				if (!memcmp(&placements[i], &best, sizeof(best)))
+					return i;
+			}
+			return count;
+		default:
+			return evaluator_best_placement(&game->well, placements, count, &evaluator_default_weights, NULL);
+	}
+}
+
+static void play_game(struct selfplay_job *job, struct training_stream *stream, uint64_t seed,
+		struct placement *placements)
+{
+	struct tetris_game game;
+	uint64_t random = randomizer_state(seed);
+
+	tetris_game_init_randomizer(&game, BOARD_WIDTH, BOARD_HEIGHT, seed, job->randomizer);
+
+	for (unsigned long piece = 0; piece < job->pieces && game.running; piece++) {
+		struct training_record record;
+		size_t count = tetrimino_placements(&game.well, placements);
+		size_t chosen = count ? choose(job, &game, placements, count, &random) : count;
+
+		if (chosen == count)
+			break;
+
+		// the record points into the well before the placement
+		struct tetris_well before = game.well;
+		int score = game.score, lines = game.lines;
+		if (tetris_game_place_trusted(&game, &placements[chosen]))
+			break;
+
+		__atomic_add_fetch(&job->placed, 1, __ATOMIC_RELAXED);
+		if (!stream)
+			continue;
+
+		record.game = seed;
+		record.piece = (uint32_t)piece;
+		record.reward = game.score - score;
+		record.lines = (uint8_t)(game.lines - lines);
+		record.done = (uint8_t)!game.running;
+		record.well = &before;
+		record.candidates = placements;
+		record.candidates_nr = count;
+		record.chosen = chosen;
+		if (training_record(stream, &record)) {
+			job->failed = 1;
+			break;
+		}
+	}
+
+	__atomic_add_fetch(&job->lines, (unsigned long long)game.lines, __ATOMIC_RELAXED);
+	if (!game.running)
+		__atomic_add_fetch(&job->games_over, 1, __ATOMIC_RELAXED);
+}
+
+static void *selfplay_worker(void *data)
+{
+	struct selfplay_job *job = data;
+	struct placement *placements = malloc(sizeof(struct placement) * PLACEMENTS_MAX);
+	struct training_stream *stream = NULL;
+
+	if (!placements || (job->writer && !(stream = training_stream_open(job->writer)))) {
+		free(placements);
+		job->failed = 1;
+		return NULL;
+	}
+
+	while (1) {
+		pthread_mutex_lock(&job->lock);
+		unsigned long index = job->next++;
+		int stop = index >= job->games || job->failed;
+		pthread_mutex_unlock(&job->lock);
+
+		if (stop)
+			break;
+
+		play_game(job, stream, job->seed + index, placements);
+	}
+
+	free(placements);
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+			{ "games", required_argument, NULL, 'g' },
+			{ "pieces", required_argument, NULL, 'p' },
+			{ "policy", required_argument, NULL, 'P' },
+			{ "depth", required_argument, NULL, 'd' },
+			{ "beam", required_argument, NULL, 'b' },
+			{ "threads", required_argument, NULL, 't' },
+			{ "seed", required_argument, NULL, 's' },
+			{ "randomizer", required_argument, NULL, 'R' },
+			{ "export", required_argument, NULL, 'e' },
+			{ "candidates", required_argument, NULL, 'c' },
+			{ "queue", required_argument, NULL, 'q' },
+			{ "chunk", required_argument, NULL, 'C' },
+			{ "no-writer-thread", no_argument, NULL, 'N' },
+			{ "metrics-file", required_argument, NULL, 'M' },
+			{ "help", no_argument, NULL, 'h' },
+			{ NULL, 0, NULL, 0 }
+	};
+
+	struct selfplay_job job;
+	struct search_options search;
+	struct training_options training;
+	struct training_writer writer;
+	const char *export = NULL;
+	const char *metrics = NULL;
+	int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	uint64_t start;
+	long value;
+
+	memset(&job, 0, sizeof(job));
+	job.games = SELFPLAY_DEFAULT_GAMES;
+	job.pieces = SELFPLAY_DEFAULT_PIECES;
+	job.policy = POLICY_HEURISTIC;
+	job.randomizer = RANDOMIZER_BAG;
+	job.seed = 1;
+	job.search = &search;
+	search_options_init(&search);
+	training_options_init(&training, BOARD_WIDTH, BOARD_HEIGHT);
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+		switch (opt) {
+			case 'g':
+				if (parse_int(optarg, 0, LONG_MAX, &value)) {
+					fprintf(stderr, "invalid number of games '%s'\n", optarg);
+					return 1;
+				}
+				job.games = (unsigned long)value;
+				break;
+			case 'p':
+				if (parse_int(optarg, 0, LONG_MAX, &value)) {
+					fprintf(stderr, "invalid number of pieces '%s'\n", optarg);
+					return 1;
+				}
+				job.pieces = (unsigned long)value;
+				break;
+			case 'P':
+				if (!strcmp(optarg, "heuristic")) {
+					job.policy = POLICY_HEURISTIC;
+				} else if (!strcmp(optarg, "random")) {
+					job.policy = POLICY_RANDOM;
+				} else if (!strcmp(optarg, "search")) {
+					job.policy = POLICY_SEARCH;
+				} else {
+					fprintf(stderr, "unknown policy '%s'\n", optarg);
+					return 1;
+				}
+				break;
+			case 'd':
+				if (parse_int(optarg, 1, SEARCH_MAX_DEPTH, &value)) {
+					fprintf(stderr, "invalid search depth '%s'\n", optarg);
+					return 1;
+				}
+				search.depth = (int)value;
+				break;
+			case 'b':
+				if (parse_int(optarg, 1, SEARCH_MAX_BEAM, &value)) {
+					fprintf(stderr, "invalid search beam '%s'\n", optarg);
+					return 1;
+				}
+				search.beam = (int)value;
+				break;
+			case 't':
+				if (parse_int(optarg, 1, TOOL_MAX_THREADS, &value)) {
+					fprintf(stderr, "invalid number of threads '%s'\n", optarg);
+					return 1;
+				}
+				threads = (int)value;
+				break;
+			case 's':
+				if (parse_u64(optarg, &job.seed)) {
+					fprintf(stderr, "invalid seed '%s'\n", optarg);
+					return 1;
+				}
+				break;
+			case 'R':
+				if ((job.randomizer = randomizer_parse(optarg)) < 0) {
+					fprintf(stderr, "unknown randomizer '%s'\n", optarg);
+					return 1;
+				}
+				break;
+			case 'e':
+				export = optarg;
+				break;
+			case 'c':
+				if (parse_int(optarg, 1, TRAINING_MAX_CANDIDATES, &value)) {
+					fprintf(stderr, "invalid number of candidates '%s'\n", optarg);
+					return 1;
+				}
+				training.max_candidates = (size_t)value;
+				break;
+			case 'q':
+				if (parse_int(optarg, 1, TETRIMINO_QUEUE_MAX + 1, &value)) {
+					fprintf(stderr, "invalid number of queued pieces '%s'\n", optarg);
+					return 1;
+				}
+				training.pieces = (size_t)value;
+				break;
+			case 'C':
+				if (parse_int(optarg, 1, LONG_MAX, &value)) {
+					fprintf(stderr, "invalid chunk size '%s'\n", optarg);
+					return 1;
+				}
+				training.chunk_records = (size_t)value;
+				break;
+			case 'N':
+				training.writer_thread = 0;
+				break;
+			case 'M':
+				metrics = optarg;
+				break;
+			case 'h':
+				print_usage(stdout, argv[0]);
+				return 0;
+			default:
+				print_usage(stderr, argv[0]);
+				return 1;
+		}
+	}
+
+	if (optind != argc) {
+		print_usage(stderr, argv[0]);
+		return 1;
+	}
+
+	if (search.depth < 1 || search.depth > SEARCH_MAX_DEPTH || search.beam < 1 || search.beam > SEARCH_MAX_BEAM) {
+		fprintf(stderr, "depth must be between 1 and %d, and beam between 1 and %d\n",
+				SEARCH_MAX_DEPTH, SEARCH_MAX_BEAM);
+		return 1;
+	}
+
+	if (metrics && !well_metrics_enabled()) {
+		fprintf(stderr, "built without well metrics; configure with -DTETRIS_WELL_METRICS=ON\n");
+		return 1;
+	}
+
+	FILE *out = NULL;
+	if (export) {
+		if (!(out = fopen(export, "wb"))) {
+			perror(export);
+			return 1;
+		}
+
+		if (training_writer_open(&writer, out, &training)) {
+			fprintf(stderr, "%s: invalid export options, or failed to start writing\n", export);
+			fclose(out);
+			return 1;
+		}
+		job.writer = &writer;
+	}
+
+	threads = threads > 0 ? threads : 1;
+	pthread_t *workers = malloc(sizeof(pthread_t) * (size_t)threads);
+	if (!workers)
+		return 1;
+
+	pthread_mutex_init(&job.lock, NULL);
+	start = monotonic_usec();
+
+	int started = 0;
+	for (; started < threads; started++) {
+		if (pthread_create(&workers[started], NULL, selfplay_worker, &job))
+			break;
+	}
+
+	for (int i = 0; i < started; i++)
+		pthread_join(workers[i], NULL);
+	free(workers);
+	pthread_mutex_destroy(&job.lock);
+
+	int failed = !started || job.failed;
+	if (out) {
+		failed |= training_writer_close(&writer);
+		failed |= fclose(out) != 0;
+	}
+	double sec = monotonic_elapsed_sec(start);
+
+	printf("Played %lu games (%lu over), placed %llu tetriminos and cleared %llu lines in %.2f s (%.0f placements/s).\n",
+			job.games, job.games_over, job.placed, job.lines, sec, sec > 0 ? (double)job.placed / sec : 0);
+	if (out) {
+		printf("Exported %llu records, %.1f MB (%.1f MB/s) to %s.\n", writer.records,
+				(double)writer.bytes / 1e6, sec > 0 ? (double)writer.bytes / 1e6 / sec : 0, export);
+	}
+
+	if (metrics && well_metrics_save(metrics)) {
+		perror(metrics);
+		return 1;
+	}
+
+	if (failed) {
+		fprintf(stderr, "failed to play or export every game\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <float.h>
+#include <getopt.h>
+
+#include "tuner.h"
+#include "monotonic-clock.h"
+#include "tool-options.h"
+
+/*
+ * tetris-tune:
+ * Tune the weights of the evaluator with a genetic algorithm (see tuner.h),
+ * printing the fittest weights of every generation.
+ *
+ * With --checkpoint, the tuner is saved after every generation, and --resume
+ * carries on from the saved one; the options it was started with are kept,
+ * except for the number of threads.
+ * */
+
+#define TUNE_DEFAULT_GENERATIONS 10
+
+static void print_usage(FILE *stream, const char *prog)
+{
+	fprintf(stream, "usage: %s [options]\n", prog);
+	fprintf(stream, "\n");
+	fprintf(stream, "    --population <n>  candidates per generation (default 50)\n");
+	fprintf(stream, "    --games <n>       games played by every candidate per generation (default 20)\n");
+	fprintf(stream, "    --pieces <n>      most tetriminos placed per game (default 500)\n");
+	fprintf(stream, "    --generations <n> generations to run (default %d)\n", TUNE_DEFAULT_GENERATIONS);
+	fprintf(stream, "    --mutation <x>    largest change of a weight by a mutation (default 0.2)\n");
+	fprintf(stream, "    --threads <n>     number of threads (default: one per core)\n");
+	fprintf(stream, "    --seed <n>        seed of the population and games (default 1)\n");
+	fprintf(stream, "    --checkpoint <file>\n");
+	fprintf(stream, "                      save the tuner to the file after every generation\n");
+	fprintf(stream, "    --resume          carry on from the checkpoint\n");
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+			{ "population", required_argument, NULL, 'P' },
+			{ "games", required_argument, NULL, 'g' },
+			{ "pieces", required_argument, NULL, 'p' },
+			{ "generations", required_argument, NULL, 'G' },
+			{ "mutation", required_argument, NULL, 'm' },
+			{ "threads", required_argument, NULL, 't' },
+			{ "seed", required_argument, NULL, 's' },
+			{ "checkpoint", required_argument, NULL, 'c' },
+			{ "resume", no_argument, NULL, 'r' },
+			{ "help", no_argument, NULL, 'h' },
+			{ NULL, 0, NULL, 0 }
+	};
+
+	struct tuner_options options;
+	struct tuner tuner;
+	unsigned long generations = TUNE_DEFAULT_GENERATIONS;
+	const char *checkpoint = NULL;
+	int resume = 0;
+	long value;
+
+	tuner_options_init(&options);
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+		switch (opt) {
+			case 'P':
+				if (parse_int(optarg, 2, LONG_MAX, &value)) {
+					fprintf(stderr, "invalid population '%s'\n", optarg);
+					return 1;
+				}
+				options.population = (size_t)value;
+				break;
+			case 'g':
+				if (parse_int(optarg, 1, LONG_MAX, &value)) {
+					fprintf(stderr, "invalid number of games '%s'\n", optarg);
+					return 1;
+				}
+				options.games = (unsigned long)value;
+				break;
+			case 'p':
+				if (parse_int(optarg, 1, LONG_MAX, &value)) {
+					fprintf(stderr, "invalid number of pieces '%s'\n", optarg);
+					return 1;
+				}
+				options.pieces = (unsigned long)value;
+				break;
+			case 'G':
+				if (parse_int(optarg, 0, LONG_MAX, &value)) {
+					fprintf(stderr, "invalid number of generations '%s'\n", optarg);
+					return 1;
+				}
+				generations = (unsigned long)value;
+				break;
+			case 'm':
+				if (parse_double(optarg, 0, DBL_MAX, &options.mutation)) {
+					fprintf(stderr, "invalid mutation '%s'\n", optarg);
+					return 1;
+				}
+				break;
+			case 't':
+				if (parse_int(optarg, 1, TOOL_MAX_THREADS, &value)) {
+					fprintf(stderr, "invalid number of threads '%s'\n", optarg);
+					return 1;
+				}
+				options.threads = (int)value;
+				break;
+			case 's':
+				if (parse_u64(optarg, &options.seed)) {
+					fprintf(stderr, "invalid seed '%s'\n", optarg);
+					return 1;
+				}
+				break;
+			case 'c':
+				checkpoint = optarg;
+				break;
+			case 'r':
+				resume = 1;
+				break;
+			case 'h':
+				print_usage(stdout, argv[0]);
+				return 0;
+			default:
+				print_usage(stderr, argv[0]);
+				return 1;
+		}
+	}
+
+	if (optind != argc || (resume && !checkpoint)) {
+		print_usage(stderr, argv[0]);
+		return 1;
+	}
+
+	if (resume) {
+		if (tuner_load(&tuner, checkpoint, options.threads)) {
+			fprintf(stderr, "%s: not a valid checkpoint\n", checkpoint);
+			return 1;
+		}
+		printf("Resumed at generation %lu with a population of %zu.\n", tuner.generation,
+				tuner.options.population);
+	} else if (tuner_init(&tuner, &options)) {
+		fprintf(stderr, "population must be at least 2, games and pieces at least 1, and mutation positive\n");
+		return 1;
+	}
+
+	for (unsigned long i = 0; i < generations; i++) {
+		uint64_t start;
+		start = monotonic_usec();
+
+		if (tuner_evaluate(&tuner)) {
+			fprintf(stderr, "failed to evaluate generation %lu\n", tuner.generation);
+			tuner_release(&tuner);
+			return 1;
+		}
+
+		double mean = 0;
+		for (size_t j = 0; j < tuner.options.population; j++)
+			mean += tuner.fitness[j];
+		mean /= (double)tuner.options.population;
+
+		size_t best = tuner_best(&tuner);
+		const struct evaluator_weights *weights = &tuner.population[best];
+		printf("generation %lu: best %.1f, mean %.1f lines (%.1f s)\n", tuner.generation, tuner.fitness[best],
+				mean, monotonic_elapsed_sec(start));
+		printf("    height %.6f, holes %.6f, bumpiness %.6f, transitions %.6f, lines %.6f\n",
+				weights->aggregate_height, weights->holes, weights->bumpiness, weights->transitions, weights->lines);
+		fflush(stdout);
+
+		tuner_evolve(&tuner);
+		if (checkpoint && tuner_save(&tuner, checkpoint)) {
+			perror(checkpoint);
+			tuner_release(&tuner);
+			return 1;
+		}
+	}
+
+	tuner_release(&tuner);
+	return 0;
+}
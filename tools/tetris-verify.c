@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <dirent.h>
+#include <pthread.h>
+
+#include "submission.h"
+#include "monotonic-clock.h"
+#include "tool-options.h"
+
+/*
+ * tetris-verify:
+ * Verify score submissions (see submission.h) by playing back their replays,
+ * and write one line of results per submission, in the order of their paths:
+ * ```
+ * accept <path> tick 0 score <score> lines <lines> level <level>
+ * reject <path> <verdict> tick <tick> score <score> lines <lines> level <level>
+ * ```
+ * For a rejected submission, the tick is the first at which the replayed game
+ * diverged from the claim, and the score, lines and level are those of the
+ * replayed game at that tick. Accepted submissions give the final result.
+ *
+ * Submissions are given as files, or as spool directories in which every
+ * file with the SUBMISSION_SUFFIX is a submission. They are spread across
+ * threads, each mapping and playing back its own files.
+ * */
+
+#define SUBMISSION_SUFFIX ".submission"
+
+struct verify_job {
+	char **paths;
+	struct submission_result *results;
+	size_t paths_nr;
+	size_t next;
+};
+
+static void print_usage(FILE *stream, const char *prog)
+{
+	fprintf(stream, "usage: %s [options] <submission|spool directory>...\n", prog);
+	fprintf(stream, "\n");
+	fprintf(stream, "    --output <file> write the results to a file rather than standard output\n");
+	fprintf(stream, "    --threads <n>   number of threads (default: one per core)\n");
+}
+
+static int add_path(char ***paths, size_t *count, size_t *alloc, char *path)
+{
+	if (!path)
+		return 1;
+
+	if (*count == *alloc) {
+		size_t grown_alloc = *alloc ? *alloc * 2 : 1024;
+		char **grown = realloc(*paths, grown_alloc * sizeof(*grown));
+		if (!grown) {
+			free(path);
+			return 1;
+		}
+		*paths = grown;
+		*alloc = grown_alloc;
+	}
+
+	(*paths)[(*count)++] = path;
+	return 0;
+}
+
+/*
+ * Add every submission in the spool directory. Returns non-zero if the
+ * directory can't be read.
+ * */
+static int scan_spool(const char *spool, DIR *dir, char ***paths, size_t *count, size_t *alloc)
+{
+	size_t suffix_len = strlen(SUBMISSION_SUFFIX);
+	struct dirent *entry;
+
+	while ((entry = readdir(dir))) {
+		size_t len = strlen(entry->d_name);
+		if (entry->d_name[0] == '.' || len <= suffix_len || strcmp(entry->d_name + len - suffix_len, SUBMISSION_SUFFIX))
+			continue;
+
+		char *path = malloc(strlen(spool) + len + 2);
+		if (path)
+			sprintf(path, "%s/%s", spool, entry->d_name);
+		if (add_path(paths, count, alloc, path))
+			return 1;
+	}
+
+	return 0;
+}
+
+static int compare_paths(const void *a, const void *b)
+{
+	return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static void *verify_worker(void *data)
+{
+	struct verify_job *job = data;
+
+	while (1) {
+		size_t index = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+		if (index >= job->paths_nr)
+			break;
+
+		submission_verify_file(job->paths[index], &job->results[index]);
+	}
+
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+			{ "output", required_argument, NULL, 'o' },
+			{ "threads", required_argument, NULL, 't' },
+			{ "help", no_argument, NULL, 'h' },
+			{ NULL, 0, NULL, 0 }
+	};
+
+	struct verify_job job;
+	const char *output = NULL;
+	int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	size_t alloc = 0;
+	uint64_t start;
+	long value;
+	FILE *out = NULL;
+	int ret = 1;
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+		switch (opt) {
+			case 'o':
+				output = optarg;
+				break;
+			case 't':
+				if (parse_int(optarg, 1, TOOL_MAX_THREADS, &value)) {
+					fprintf(stderr, "invalid number of threads '%s'\n", optarg);
+					return 1;
+				}
+				threads = (int)value;
+				break;
+			case 'h':
+				print_usage(stdout, argv[0]);
+				return 0;
+			default:
+				print_usage(stderr, argv[0]);
+				return 1;
+		}
+	}
+
+	if (optind == argc) {
+		print_usage(stderr, argv[0]);
+		return 1;
+	}
+
+	memset(&job, 0, sizeof(job));
+	for (int i = optind; i < argc; i++) {
+		DIR *dir = opendir(argv[i]);
+		int failed = dir ? scan_spool(argv[i], dir, &job.paths, &job.paths_nr, &alloc)
+				: add_path(&job.paths, &job.paths_nr, &alloc, strdup(argv[i]));
+
+		if (dir)
+			closedir(dir);
+		if (failed) {
+			fprintf(stderr, "%s: failed to list submissions\n", argv[i]);
+			goto release;
+		}
+	}
+
+	qsort(job.paths, job.paths_nr, sizeof(*job.paths), compare_paths);
+
+	if (!(out = output ? fopen(output, "w") : stdout)) {
+		perror(output);
+		goto release;
+	}
+
+	threads = threads > 0 ? threads : 1;
+	pthread_t *workers = calloc((size_t)threads, sizeof(*workers));
+	job.results = calloc(job.paths_nr ? job.paths_nr : 1, sizeof(*job.results));
+	if (!workers || !job.results) {
+		free(workers);
+		goto close_output;
+	}
+
+	start = monotonic_usec();
+
+	int started = 0;
+	for (; started < threads; started++) {
+		if (pthread_create(&workers[started], NULL, verify_worker, &job))
+			break;
+	}
+	for (int i = 0; i < started; i++)
+		pthread_join(workers[i], NULL);
+	free(workers);
+
+	double sec = monotonic_elapsed_sec(start);
+	if (!started)
+		goto close_output;
+
+	size_t accepted = 0;
+	for (size_t i = 0; i < job.paths_nr; i++) {
+		const struct submission_result *result = &job.results[i];
+
+		if (result->verdict == SUBMISSION_INVALID) {
+			fprintf(out, "reject %s invalid\n", job.paths[i]);
+			continue;
+		}
+
+		fprintf(out, "%s %s", result->verdict ? "reject" : "accept", job.paths[i]);
+		if (result->verdict)
+			fprintf(out, " %s", submission_verdict_name(result->verdict));
+		fprintf(out, " tick %lu score %d lines %d level %d\n", result->tick, result->score, result->lines,
+				result->level);
+		accepted += !result->verdict;
+	}
+
+	fprintf(stderr, "Verified %zu submissions (%zu accepted, %zu rejected) in %.2f s (%.3f ms each).\n",
+			job.paths_nr, accepted, job.paths_nr - accepted, sec,
+			job.paths_nr ? sec * 1e3 * started / (double)job.paths_nr : 0);
+	ret = ferror(out) != 0;
+
+close_output:
+	if (out != stdout && fclose(out))
+		ret = 1;
+release:
+	for (size_t i = 0; i < job.paths_nr; i++)
+		free(job.paths[i]);
+	free(job.paths);
+	free(job.results);
+
+	return ret;
+}
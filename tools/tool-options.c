@@ -0,0 +1,45 @@
+#include <stdlib.h>
+#include <errno.h>
+
+#include "tool-options.h"
+
+int parse_int(const char *arg, long min, long max, long *value)
+{
+	char *end;
+	errno = 0;
+	long parsed = strtol(arg, &end, 10);
+	if (*arg == '\0' || *end != '\0' || errno || parsed < min || parsed > max)
+		return 1;
+
+	*value = parsed;
+	return 0;
+}
+
+int parse_u64(const char *arg, uint64_t *value)
+{
+	char *end;
+
+	// strtoull() would negate a leading minus sign rather than reject it
+	if (*arg < '0' || *arg > '9')
+		return 1;
+
+	errno = 0;
+	unsigned long long parsed = strtoull(arg, &end, 10);
+	if (*end != '\0' || errno)
+		return 1;
+
+	*value = (uint64_t)parsed;
+	return 0;
+}
+
+int parse_double(const char *arg, double min, double max, double *value)
+{
+	char *end;
+	errno = 0;
+	double parsed = strtod(arg, &end);
+	if (*arg == '\0' || *end != '\0' || errno || !(parsed >= min && parsed <= max))
+		return 1;
+
+	*value = parsed;
+	return 0;
+}
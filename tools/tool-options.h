@@ -0,0 +1,36 @@
+#ifndef TETRIS_TOOL_OPTIONS_H
+#define TETRIS_TOOL_OPTIONS_H
+
+#include <stdint.h>
+
+/**
+ * tool-options:
+ * Strict parsing of the numeric arguments of the tools. Unlike atoi() and
+ * friends, an argument that isn't entirely a number, or is out of range, is
+ * rejected rather than read as zero or silently truncated.
+ * */
+
+/**
+ * The most threads a tool can be asked to start.
+ * */
+#define TOOL_MAX_THREADS 1024
+
+/**
+ * Parse a decimal integer between `min` and `max`. Returns non-zero if the
+ * argument isn't one.
+ * */
+int parse_int(const char *arg, long min, long max, long *value);
+
+/**
+ * Parse an unsigned 64-bit decimal integer, such as a seed. Returns non-zero
+ * if the argument isn't one.
+ * */
+int parse_u64(const char *arg, uint64_t *value);
+
+/**
+ * Parse a decimal number between `min` and `max`. Returns non-zero if the
+ * argument isn't one.
+ * */
+int parse_double(const char *arg, double min, double max, double *value);
+
+#endif //TETRIS_TOOL_OPTIONS_H